@@ -6,15 +6,15 @@
  * PhilPSX.c - Copyright Phillip Potter, 2020, under GPLv3
  */
 
-/* Included for profiling purposes*/
+/* Included for timing purposes*/
 #define _POSIX_C_SOURCE 200809L
 #include <time.h>
-#include <gperftools/profiler.h>
 
 #include <pthread.h>
 #include <stdio.h>
 #include <stdbool.h>
 #include <stdint.h>
+#include <stdlib.h>
 #include <string.h>
 #include <SDL2/SDL.h>
 #include "headers/WorkQueue.h"
@@ -26,6 +26,9 @@
 #include "headers/DMAArbiter.h"
 #include "headers/ControllerIO.h"
 #include "headers/SystemInterlink.h"
+#include "headers/Profiler.h"
+#include "headers/PSXExe.h"
+#include "headers/Lockstep.h"
 
 /*
  * This struct stores references to all emulated components.
@@ -38,6 +41,9 @@ typedef struct {
 	DMAArbiter *dma;
 	ControllerIO *cio;
 	SystemInterlink *smi;
+	Profiler *profiler;	// NULL unless profiling is enabled
+	PSXExe *exe;		// NULL unless an executable is sideloaded
+	bool headless;		// True if there is no window or OpenGL context
 } Console;
 
 /*
@@ -60,11 +66,13 @@ typedef struct {
 
 // Forward declarations for functions related to setup/cleanup of emulator:
 static bool setupEmu(Console *console, int numOfArgs, char **args,
-		WorkQueue *wq, SDL_Window *window);
+		WorkQueue *wq, SDL_Window *window, bool reference);
 static void cleanupEmu(Console *console);
 static void *renderingFunction(void *arg);
+static void *nullRenderingFunction(void *arg);
 static void *emulatorFunction(void *arg);
 static bool setupSDL(void);
+static int runHeadless(int numOfArgs, char **args);
 
 // PhilPSX entry point
 int main(int argc, char **argv)
@@ -75,6 +83,14 @@ int main(int argc, char **argv)
 	// Variables
 	int retval = 0;
 	EmulatorState es;
+
+	// Run without a window or OpenGL context if requested
+	for (int i = 1; i < argc; ++i) {
+		if (strlen(argv[i]) == 9 && strncmp(argv[i], "-headless", 9) == 0) {
+			retval = runHeadless(argc - 1, argv + 1);
+			goto end;
+		}
+	}
 	
 	// Setup SDL
 	if (!setupSDL()) {
@@ -130,7 +146,7 @@ int main(int argc, char **argv)
 	
 	// Setup console itself
 	Console console;
-	if (!setupEmu(&console, argc - 1, argv + 1, wq, sdl.window)) {
+	if (!setupEmu(&console, argc - 1, argv + 1, wq, sdl.window, false)) {
 		fprintf(stderr, "PhilPSX: Couldn't create console\n");
 		retval = 1;
 		goto cleanup_workqueue;
@@ -234,10 +250,14 @@ int main(int argc, char **argv)
 
 /*
  * This sets up all the components of the virtual PlayStation and links them
- * together properly.
+ * together properly. If window is NULL, the emulator is setup to run
+ * headless, without any OpenGL state in the GPU, and with a profiler so
+ * the time spent in each subsystem can be reported. If reference is true, the
+ * CPU is left as the plain interpreter whatever flags were given, without
+ * tracing, so the console can be used to check a faster one.
  */
 static bool setupEmu(Console *console, int numOfArgs, char **args,
-		WorkQueue *wq, SDL_Window *window)
+		WorkQueue *wq, SDL_Window *window, bool reference)
 {
 	// Parse BIOS path from command line arguments
 	bool biosSpecified = false;
@@ -269,13 +289,99 @@ static bool setupEmu(Console *console, int numOfArgs, char **args,
 		}
 	}
 
+	// Parse executable path from command line arguments
+	bool exeSpecified = false;
+	int exePathIndex = 0;
+	for (int i = 0; i < numOfArgs; ++i) {
+		if (strlen(args[i]) == 4 && strncmp(args[i], "-exe", 4) == 0) {
+			if (i + 1 < numOfArgs) {
+				exeSpecified = true;
+				exePathIndex = i + 1;
+				break;
+			}
+		}
+	}
+
+	// Parse fast boot choice from command line arguments
+	bool fastBootSpecified = false;
+	for (int i = 0; i < numOfArgs; ++i) {
+		if (strlen(args[i]) == 9 && strncmp(args[i], "-fastboot", 9) == 0) {
+			fastBootSpecified = true;
+			break;
+		}
+	}
+	if (fastBootSpecified && (!cdSpecified || exeSpecified)) {
+		fprintf(stderr, "PhilPSX: Fast boot needs a CD and no executable\n");
+		goto end;
+	}
+
+	// Parse profiler output path from command line arguments
+	bool profileSpecified = false;
+	int profilePathIndex = 0;
+	for (int i = 0; i < numOfArgs; ++i) {
+		if (strlen(args[i]) == 8 && strncmp(args[i], "-profile", 8) == 0) {
+			if (i + 1 < numOfArgs) {
+				profileSpecified = true;
+				profilePathIndex = i + 1;
+				break;
+			}
+		}
+	}
+
+	// Parse CPU core choice from command line arguments
+	bool recompilerSpecified = false;
+	for (int i = 0; i < numOfArgs; ++i) {
+		if (strlen(args[i]) == 4 && strncmp(args[i], "-jit", 4) == 0) {
+			recompilerSpecified = true;
+			break;
+		}
+	}
+
+	// Parse BIOS function emulation choice from command line arguments
+	bool hleSpecified = false;
+	for (int i = 0; i < numOfArgs; ++i) {
+		if (strlen(args[i]) == 4 && strncmp(args[i], "-hle", 4) == 0) {
+			hleSpecified = true;
+			break;
+		}
+	}
+
+	// Parse trace output path from command line arguments
+	bool traceSpecified = false;
+	int tracePathIndex = 0;
+	for (int i = 0; i < numOfArgs; ++i) {
+		if (strlen(args[i]) == 6 && strncmp(args[i], "-trace", 6) == 0) {
+			if (i + 1 < numOfArgs) {
+				traceSpecified = true;
+				tracePathIndex = i + 1;
+				break;
+			}
+		}
+	}
+
 	// Initialise components
+	console->headless = !window;
+
 	// CPU
 	console->cpu = construct_R3051();
 	if (!console->cpu) {
 		fprintf(stderr, "PhilPSX: R3051 setup failed\n");
 		goto end;
 	}
+	if (recompilerSpecified && !reference &&
+			!R3051_enableRecompiler(console->cpu)) {
+		fprintf(stderr, "PhilPSX: R3051 recompiler setup failed\n");
+		goto cleanup_cpu;
+	}
+	if (hleSpecified && !reference && !R3051_enableHLE(console->cpu)) {
+		fprintf(stderr, "PhilPSX: BIOS function emulation setup failed\n");
+		goto cleanup_cpu;
+	}
+	if (traceSpecified && !reference &&
+			!R3051_enableTracing(console->cpu, args[tracePathIndex])) {
+		fprintf(stderr, "PhilPSX: Trace recorder setup failed\n");
+		goto cleanup_cpu;
+	}
 	
 	// SystemInterlink
 	console->smi = construct_SystemInterlink(args[biosPathIndex]);
@@ -292,10 +398,12 @@ static bool setupEmu(Console *console, int numOfArgs, char **args,
 	}
 	
 	// Set OpenGL state
-	GPU_setGLFunctionPointers(console->gpu);
-	if (!GPU_initGL(console->gpu)) {
-		fprintf(stderr, "PhilPSX: GPU GL setup failed\n");
-		goto cleanup_gpu;
+	if (!console->headless) {
+		GPU_setGLFunctionPointers(console->gpu);
+		if (!GPU_initGL(console->gpu)) {
+			fprintf(stderr, "PhilPSX: GPU GL setup failed\n");
+			goto cleanup_gpu;
+		}
 	}
 	
 	// SPU
@@ -333,6 +441,31 @@ static bool setupEmu(Console *console, int numOfArgs, char **args,
 			goto cleanup_cio;
 		}
 	}
+
+	// Profiler, if one was requested or we are headless
+	console->profiler = NULL;
+	if (profileSpecified || console->headless) {
+		console->profiler = construct_Profiler(console->cpu,
+				profileSpecified ? args[profilePathIndex] : NULL);
+		if (!console->profiler) {
+			fprintf(stderr, "PhilPSX: Profiler setup failed\n");
+			goto cleanup_cio;
+		}
+	}
+
+	// Executable to start in place of the BIOS shell, if one was specified
+	// or fast boot of the CD was requested
+	console->exe = NULL;
+	if (exeSpecified || fastBootSpecified) {
+		console->exe = exeSpecified ?
+				construct_PSXExe(args[exePathIndex]) :
+				construct_PSXExeFromDisc(console->cdrom);
+		if (!console->exe) {
+			fprintf(stderr, "PhilPSX: Loading of executable failed\n");
+			goto cleanup_profiler;
+		}
+		R3051_setExe(console->cpu, console->exe);
+	}
 	
 	// Link components together and set their parameters
 	
@@ -343,6 +476,7 @@ static bool setupEmu(Console *console, int numOfArgs, char **args,
 	SystemInterlink_setCdrom(console->smi, console->cdrom);
 	SystemInterlink_setDma(console->smi, console->dma);
 	SystemInterlink_setControllerIO(console->smi, console->cio);
+	SystemInterlink_setProfiler(console->smi, console->profiler);
 	
 	// Link interlink back to those components where needed
 	R3051_setMemoryInterface(console->cpu, console->smi);
@@ -367,6 +501,10 @@ static bool setupEmu(Console *console, int numOfArgs, char **args,
 	return true;
 	
 	// Cleanup path:
+	cleanup_profiler:
+	if (console->profiler)
+		destruct_Profiler(console->profiler);
+
 	cleanup_cio:
 	destruct_ControllerIO(console->cio);
 	
@@ -380,7 +518,8 @@ static bool setupEmu(Console *console, int numOfArgs, char **args,
 	destruct_SPU(console->spu);
 	
 	cleanup_gl:
-	GPU_cleanupGL(console->gpu);
+	if (!console->headless)
+		GPU_cleanupGL(console->gpu);
 	
 	cleanup_gpu:
 	destruct_GPU(console->gpu);
@@ -402,11 +541,16 @@ static void cleanupEmu(Console *console)
 {
 	// Cleanup resources - the CD image is cleaned up automatically
 	// by its destructor if present
+	if (console->exe)
+		destruct_PSXExe(console->exe);
+	if (console->profiler)
+		destruct_Profiler(console->profiler);
 	destruct_ControllerIO(console->cio);
 	destruct_DMAArbiter(console->dma);
 	destruct_CDROMDrive(console->cdrom);
 	destruct_SPU(console->spu);
-	GPU_cleanupGL(console->gpu);
+	if (!console->headless)
+		GPU_cleanupGL(console->gpu);
 	destruct_GPU(console->gpu);
 	destruct_SystemInterlink(console->smi);
 	destruct_R3051(console->cpu);
@@ -468,6 +612,26 @@ static void *renderingFunction(void *arg)
 	return NULL;
 }
 
+/*
+ * This function is intended to be called in a dedicated thread when running
+ * headless. It takes work items from the emulator thread and returns them
+ * without executing them, so nothing is rendered.
+ */
+static void *nullRenderingFunction(void *arg)
+{
+	WorkQueue *wq = arg;
+
+	// Keep discarding items until processing is ended
+	while (true) {
+		GpuCommand *command = WorkQueue_waitForItem(wq);
+		if (!command)
+			break;
+		WorkQueue_returnItem(wq, command);
+	}
+
+	return NULL;
+}
+
 /*
  * This function is intended to be called in a dedicated thread, to initialise
  * the emulator's components and begin executing the PlayStation software.
@@ -490,8 +654,9 @@ static void *emulatorFunction(void *arg)
 	int64_t cycles = 0;
 	clock_gettime(CLOCK_REALTIME, &t1);
 	
-	// Start gperftools log
-	ProfilerStart("philpsx_emulator_thread.log");
+	// Start sampling guest code if profiling was requested
+	if (console->profiler)
+		Profiler_start(console->profiler);
 	
 	while (true) {
 		
@@ -514,9 +679,12 @@ static void *emulatorFunction(void *arg)
 			cycles -= 33868800;
 		}
 	}
-	ProfilerStop();
 
 	end:
+	// Stop sampling and write out profile
+	if (console->profiler)
+		Profiler_stop(console->profiler);
+
 	fprintf(stdout, "PhilPSX: Ended emulator thread\n");
 	
 	// Set work queue to stop processing and notify
@@ -590,4 +758,163 @@ static bool setupSDL(void)
 	
 	end:
 	return false;
+}
+
+/*
+ * This function runs the emulator without a window or OpenGL context, for
+ * a fixed number of frames (-frames) or CPU cycles (-cycles), as fast as
+ * possible. It then prints a summary of the run on a single line in JSON
+ * format, so that performance can be tracked on machines without a display.
+ * With -lockstep, a second console running the plain interpreter is kept in
+ * step with the first, and the run stops at the first point they differ.
+ */
+static int runHeadless(int numOfArgs, char **args)
+{
+	// Variables
+	int retval = 1;
+
+	// Parse frame and cycle limits from command line arguments, defaulting
+	// to ten seconds of NTSC frames
+	int64_t frameLimit = 0;
+	int64_t cycleLimit = 0;
+	for (int i = 0; i < numOfArgs; ++i) {
+		if (strlen(args[i]) == 7 && strncmp(args[i], "-frames", 7) == 0) {
+			if (i + 1 < numOfArgs)
+				frameLimit = strtoll(args[i + 1], NULL, 10);
+		} else if (strlen(args[i]) == 7 &&
+				strncmp(args[i], "-cycles", 7) == 0) {
+			if (i + 1 < numOfArgs)
+				cycleLimit = strtoll(args[i + 1], NULL, 10);
+		}
+	}
+	if (frameLimit <= 0 && cycleLimit <= 0)
+		frameLimit = 600;
+
+	// Parse lockstep choice from command line arguments
+	bool lockstepSpecified = false;
+	for (int i = 0; i < numOfArgs; ++i) {
+		if (strlen(args[i]) == 9 && strncmp(args[i], "-lockstep", 9) == 0) {
+			lockstepSpecified = true;
+			break;
+		}
+	}
+
+	// Setup WorkQueue
+	WorkQueue *wq = construct_WorkQueue();
+	if (!wq) {
+		fprintf(stderr, "PhilPSX: Couldn't initialise work queue\n");
+		goto end;
+	}
+
+	// Setup console itself
+	Console console;
+	if (!setupEmu(&console, numOfArgs, args, wq, NULL, false)) {
+		fprintf(stderr, "PhilPSX: Couldn't create console\n");
+		goto cleanup_workqueue;
+	}
+
+	// Setup reference console and keep it in step with the first one, if
+	// lockstep validation was requested
+	Console referenceConsole;
+	Lockstep *lockstep = NULL;
+	if (lockstepSpecified) {
+		if (!setupEmu(&referenceConsole, numOfArgs, args, wq, NULL, true)) {
+			fprintf(stderr, "PhilPSX: Couldn't create reference console\n");
+			goto cleanup_console;
+		}
+		lockstep = construct_Lockstep(referenceConsole.cpu, console.cpu);
+		if (!lockstep) {
+			fprintf(stderr, "PhilPSX: Lockstep setup failed\n");
+			goto cleanup_reference_console;
+		}
+	}
+
+	// Create thread to discard rendering work
+	pthread_t renderingThread;
+	if (pthread_create(&renderingThread, NULL, &nullRenderingFunction, wq)) {
+		fprintf(stderr, "PhilPSX: Couldn't start rendering thread\n");
+		goto cleanup_lockstep;
+	}
+
+	// Run emulator until we reach the frame or cycle limit
+	struct timespec t1, t2;
+	int64_t cycles = 0;
+	int64_t frames = 0;
+	int64_t startInstructions = R3051_getInstructionCount(console.cpu);
+	Profiler_start(console.profiler);
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+	while ((frameLimit <= 0 || frames < frameLimit) &&
+			(cycleLimit <= 0 || cycles < cycleLimit)) {
+		if (lockstep) {
+			cycles += Lockstep_executeInstructions(lockstep);
+			if (Lockstep_hasDiverged(lockstep))
+				break;
+		} else {
+			cycles += R3051_executeInstructions(console.cpu);
+		}
+		frames = GPU_getFrameCount(console.gpu);
+	}
+	clock_gettime(CLOCK_MONOTONIC, &t2);
+	Profiler_stop(console.profiler);
+	int64_t instructions =
+			R3051_getInstructionCount(console.cpu) - startInstructions;
+
+	// Print summary
+	double seconds = (t2.tv_sec - t1.tv_sec) +
+			(t2.tv_nsec - t1.tv_nsec) / 1000000000.0;
+	double emulatedMhz = cycles / seconds / 1000000.0;
+	fprintf(stdout, "PhilPSX: Benchmark: {\"frames\": %ld, \"cycles\": %ld, "
+			"\"instructions\": %ld, \"seconds\": %.3f, "
+			"\"emulated_mips\": %.2f, \"emulated_mhz\": %.2f, "
+			"\"speed\": %.3f, \"fps\": %.2f, \"cpu\": %.2f, \"gte\": %.2f, "
+			"\"gpu\": %.2f, \"dma\": %.2f, \"cdrom\": %.2f}\n",
+			(long)frames, (long)cycles, (long)instructions, seconds,
+			instructions / seconds / 1000000.0, emulatedMhz,
+			emulatedMhz / 33.8688, frames / seconds,
+			Profiler_getSubsystemShare(console.profiler,
+			PHILPSX_PROFILER_CPU),
+			Profiler_getSubsystemShare(console.profiler,
+			PHILPSX_PROFILER_GTE),
+			Profiler_getSubsystemShare(console.profiler,
+			PHILPSX_PROFILER_GPU),
+			Profiler_getSubsystemShare(console.profiler,
+			PHILPSX_PROFILER_DMA),
+			Profiler_getSubsystemShare(console.profiler,
+			PHILPSX_PROFILER_CDROM));
+	retval = 0;
+
+	// Print lockstep result, failing the run if a divergence was found
+	if (lockstep) {
+		if (Lockstep_hasDiverged(lockstep)) {
+			fprintf(stdout, "PhilPSX: Lockstep: Diverged\n");
+			retval = 1;
+		} else {
+			fprintf(stdout, "PhilPSX: Lockstep: No divergence in %ld "
+					"cycles\n", (long)cycles);
+		}
+	}
+
+	// Stop rendering thread
+	WorkQueue_endProcessingByRenderingThread(wq);
+	pthread_join(renderingThread, NULL);
+
+	// Cleanup lockstep validation and reference console
+	cleanup_lockstep:
+	if (lockstep)
+		destruct_Lockstep(lockstep);
+
+	cleanup_reference_console:
+	if (lockstepSpecified)
+		cleanupEmu(&referenceConsole);
+
+	// Cleanup console
+	cleanup_console:
+	cleanupEmu(&console);
+
+	// Cleanup work queue
+	cleanup_workqueue:
+	destruct_WorkQueue(wq);
+
+	end:
+	return retval;
 }
\ No newline at end of file
@@ -0,0 +1,300 @@
+/*
+ * This C file models the high-level emulation of BIOS library functions as a
+ * class. When the R3051 reaches the A0h function dispatcher, the function
+ * number in t1 is checked against a set of simple library routines (such as
+ * memcpy, memset and strlen), and if it is one of them, it is run natively,
+ * accounting a cycle cost close to what the BIOS code would take before
+ * returning to the caller. Anything else, including calls with arguments the
+ * BIOS treats specially (NULL pointers or non-positive lengths), and
+ * functions whose table entry has been patched to point outside the BIOS, is
+ * left to the BIOS code itself.
+ *
+ * BiosHLE.c - Copyright Phillip Potter, 2020, under GPLv3
+ */
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "../headers/BiosHLE.h"
+#include "../headers/R3051_all.h"
+#include "../headers/SystemInterlink.h"
+
+// Physical addresses of the A0h dispatcher and its function table
+#define PHILPSX_BIOSHLE_A0_DISPATCHER 0xA0
+#define PHILPSX_BIOSHLE_A0_TABLE 0x200
+
+// A0h function numbers
+#define PHILPSX_BIOSHLE_ABS 0x0E
+#define PHILPSX_BIOSHLE_LABS 0x0F
+#define PHILPSX_BIOSHLE_STRCAT 0x15
+#define PHILPSX_BIOSHLE_STRCPY 0x19
+#define PHILPSX_BIOSHLE_STRLEN 0x1B
+#define PHILPSX_BIOSHLE_TOUPPER 0x25
+#define PHILPSX_BIOSHLE_TOLOWER 0x26
+#define PHILPSX_BIOSHLE_BCOPY 0x27
+#define PHILPSX_BIOSHLE_BZERO 0x28
+#define PHILPSX_BIOSHLE_MEMCPY 0x2A
+#define PHILPSX_BIOSHLE_MEMSET 0x2B
+#define PHILPSX_BIOSHLE_RAND 0x2F
+#define PHILPSX_BIOSHLE_SRAND 0x30
+
+// Cycle costs of the dispatcher plus function entry and exit, and of each
+// byte handled by the copying and scanning loops of the BIOS
+#define PHILPSX_BIOSHLE_CALL_CYCLES 40
+#define PHILPSX_BIOSHLE_COPY_CYCLES 8
+#define PHILPSX_BIOSHLE_SCAN_CYCLES 6
+
+// Longest length or string handled natively (the size of RAM)
+#define PHILPSX_BIOSHLE_MAX_LENGTH 0x200000
+
+// Register numbers used by the calling convention
+#define PHILPSX_BIOSHLE_V0 2
+#define PHILPSX_BIOSHLE_A0 4
+#define PHILPSX_BIOSHLE_A1 5
+#define PHILPSX_BIOSHLE_A2 6
+#define PHILPSX_BIOSHLE_T1 9
+#define PHILPSX_BIOSHLE_RA 31
+
+// Forward declarations for functions private to this class
+// BiosHLE-related stuff:
+static void BiosHLE_copyBytes(R3051 *cpu, int32_t destination,
+		int32_t source, int32_t length);
+static void BiosHLE_fillBytes(R3051 *cpu, int32_t destination, int8_t value,
+		int32_t length);
+static int8_t BiosHLE_readByte(R3051 *cpu, int32_t address);
+static int32_t BiosHLE_stringLength(R3051 *cpu, int32_t address);
+static void BiosHLE_writeByte(R3051 *cpu, int32_t address, int8_t value);
+
+/*
+ * This struct contains the state kept by emulated BIOS functions between
+ * calls.
+ */
+struct BiosHLE {
+
+	// Random number generator state, only valid once srand has been called
+	// through us, so that rand never diverges from the BIOS copy of it
+	int32_t randomSeed;
+	bool randomSeedValid;
+};
+
+/*
+ * This constructs a BiosHLE object.
+ */
+BiosHLE *construct_BiosHLE(void)
+{
+	// Allocate BiosHLE struct
+	BiosHLE *hle = malloc(sizeof(BiosHLE));
+	if (!hle) {
+		fprintf(stderr, "PhilPSX: BiosHLE: Couldn't allocate memory for "
+				"BiosHLE struct\n");
+		goto end;
+	}
+
+	// Setup random number generator state
+	hle->randomSeed = 0;
+	hle->randomSeedValid = false;
+
+	// Normal return:
+	return hle;
+
+	// Cleanup path:
+	end:
+	return hle;
+}
+
+/*
+ * This destructs a BiosHLE object.
+ */
+void destruct_BiosHLE(BiosHLE *hle)
+{
+	free(hle);
+}
+
+/*
+ * This function checks whether the CPU is at the A0h dispatcher with a
+ * function we emulate, and if so runs it and returns to the caller, with the
+ * cycles it took passed on to the rest of the system. It returns false if
+ * the CPU should carry on executing BIOS code as normal.
+ */
+bool BiosHLE_handleCall(BiosHLE *hle, R3051 *cpu)
+{
+	// Check we are at the dispatcher
+	if ((cpu->programCounter & 0x1FFFFFFF) != PHILPSX_BIOSHLE_A0_DISPATCHER)
+		return false;
+
+	// Check the table entry still points at the BIOS, so functions
+	// replaced by the game or kernel are left alone
+	int32_t function = cpu->generalRegisters[PHILPSX_BIOSHLE_T1];
+	if (function < 0 || function > PHILPSX_BIOSHLE_SRAND)
+		return false;
+	int32_t entry = SystemInterlink_readWord(cpu->system,
+			PHILPSX_BIOSHLE_A0_TABLE + function * 4);
+	if ((entry & 0x1FF00000) != 0x1FC00000)
+		return false;
+
+	// Run function
+	int32_t *registers = cpu->generalRegisters;
+	int32_t arg0 = registers[PHILPSX_BIOSHLE_A0];
+	int32_t arg1 = registers[PHILPSX_BIOSHLE_A1];
+	int32_t arg2 = registers[PHILPSX_BIOSHLE_A2];
+	int32_t retVal = 0;
+	int32_t cycles = PHILPSX_BIOSHLE_CALL_CYCLES;
+	switch (function) {
+		case PHILPSX_BIOSHLE_ABS:
+		case PHILPSX_BIOSHLE_LABS:
+			retVal = (arg0 < 0) ? (int32_t)(0U - (uint32_t)arg0) : arg0;
+			break;
+		case PHILPSX_BIOSHLE_STRCAT:
+		{
+			if (arg0 == 0 || arg1 == 0)
+				return false;
+			int32_t destinationLength = BiosHLE_stringLength(cpu, arg0);
+			int32_t sourceLength = BiosHLE_stringLength(cpu, arg1);
+			if (destinationLength == -1 || sourceLength == -1)
+				return false;
+			BiosHLE_copyBytes(cpu, arg0 + destinationLength, arg1,
+					sourceLength + 1);
+			cycles += destinationLength * PHILPSX_BIOSHLE_SCAN_CYCLES +
+					(sourceLength + 1) * PHILPSX_BIOSHLE_COPY_CYCLES;
+			retVal = arg0;
+		}
+			break;
+		case PHILPSX_BIOSHLE_STRCPY:
+		{
+			if (arg0 == 0 || arg1 == 0)
+				return false;
+			int32_t sourceLength = BiosHLE_stringLength(cpu, arg1);
+			if (sourceLength == -1)
+				return false;
+			BiosHLE_copyBytes(cpu, arg0, arg1, sourceLength + 1);
+			cycles += (sourceLength + 1) * PHILPSX_BIOSHLE_COPY_CYCLES;
+			retVal = arg0;
+		}
+			break;
+		case PHILPSX_BIOSHLE_STRLEN:
+		{
+			if (arg0 == 0)
+				return false;
+			int32_t length = BiosHLE_stringLength(cpu, arg0);
+			if (length == -1)
+				return false;
+			cycles += length * PHILPSX_BIOSHLE_SCAN_CYCLES;
+			retVal = length;
+		}
+			break;
+		case PHILPSX_BIOSHLE_TOUPPER:
+			retVal = arg0 & 0xFF;
+			if (retVal >= 'a' && retVal <= 'z')
+				retVal -= 0x20;
+			break;
+		case PHILPSX_BIOSHLE_TOLOWER:
+			retVal = arg0 & 0xFF;
+			if (retVal >= 'A' && retVal <= 'Z')
+				retVal += 0x20;
+			break;
+		case PHILPSX_BIOSHLE_BCOPY:
+			if (arg0 == 0 || arg1 == 0 || arg2 <= 0 ||
+					arg2 > PHILPSX_BIOSHLE_MAX_LENGTH)
+				return false;
+			BiosHLE_copyBytes(cpu, arg1, arg0, arg2);
+			cycles += arg2 * PHILPSX_BIOSHLE_COPY_CYCLES;
+			retVal = arg1;
+			break;
+		case PHILPSX_BIOSHLE_BZERO:
+			if (arg0 == 0 || arg1 <= 0 || arg1 > PHILPSX_BIOSHLE_MAX_LENGTH)
+				return false;
+			BiosHLE_fillBytes(cpu, arg0, 0, arg1);
+			cycles += arg1 * PHILPSX_BIOSHLE_SCAN_CYCLES;
+			retVal = arg0;
+			break;
+		case PHILPSX_BIOSHLE_MEMCPY:
+			if (arg0 == 0 || arg1 == 0 || arg2 <= 0 ||
+					arg2 > PHILPSX_BIOSHLE_MAX_LENGTH)
+				return false;
+			BiosHLE_copyBytes(cpu, arg0, arg1, arg2);
+			cycles += arg2 * PHILPSX_BIOSHLE_COPY_CYCLES;
+			retVal = arg0;
+			break;
+		case PHILPSX_BIOSHLE_MEMSET:
+			if (arg0 == 0 || arg2 <= 0 || arg2 > PHILPSX_BIOSHLE_MAX_LENGTH)
+				return false;
+			BiosHLE_fillBytes(cpu, arg0, (int8_t)arg1, arg2);
+			cycles += arg2 * PHILPSX_BIOSHLE_SCAN_CYCLES;
+			retVal = arg0;
+			break;
+		case PHILPSX_BIOSHLE_RAND:
+			if (!hle->randomSeedValid)
+				return false;
+			hle->randomSeed = (int32_t)((uint32_t)hle->randomSeed *
+					0x41C64E6DU + 0x3039U);
+			retVal = ((uint32_t)hle->randomSeed >> 16) & 0x7FFF;
+			break;
+		case PHILPSX_BIOSHLE_SRAND:
+			hle->randomSeed = arg0;
+			hle->randomSeedValid = true;
+			break;
+		default:
+			return false;
+	}
+
+	// Return to caller
+	registers[PHILPSX_BIOSHLE_V0] = retVal;
+	cpu->programCounter = registers[PHILPSX_BIOSHLE_RA];
+	cpu->cycles = cycles;
+	cpu->totalCycles += cycles;
+	SystemInterlink_appendSyncCycles(cpu->system, cycles);
+	return true;
+}
+
+/*
+ * This function copies length bytes from source to destination, a byte at
+ * a time from the start as the BIOS does, so overlapping ranges end up the
+ * same too.
+ */
+static void BiosHLE_copyBytes(R3051 *cpu, int32_t destination,
+		int32_t source, int32_t length)
+{
+	for (int32_t i = 0; i < length; ++i)
+		BiosHLE_writeByte(cpu, destination + i,
+				BiosHLE_readByte(cpu, source + i));
+}
+
+/*
+ * This function sets length bytes starting at destination to value.
+ */
+static void BiosHLE_fillBytes(R3051 *cpu, int32_t destination, int8_t value,
+		int32_t length)
+{
+	for (int32_t i = 0; i < length; ++i)
+		BiosHLE_writeByte(cpu, destination + i, value);
+}
+
+/*
+ * This function reads a byte from the specified virtual address.
+ */
+static int8_t BiosHLE_readByte(R3051 *cpu, int32_t address)
+{
+	return SystemInterlink_readByte(cpu->system, address & 0x1FFFFFFF);
+}
+
+/*
+ * This function returns the length of the string at the specified virtual
+ * address, or -1 if it is not terminated within the maximum length.
+ */
+static int32_t BiosHLE_stringLength(R3051 *cpu, int32_t address)
+{
+	for (int32_t i = 0; i < PHILPSX_BIOSHLE_MAX_LENGTH; ++i) {
+		if (BiosHLE_readByte(cpu, address + i) == 0)
+			return i;
+	}
+
+	return -1;
+}
+
+/*
+ * This function writes a byte to the specified virtual address.
+ */
+static void BiosHLE_writeByte(R3051 *cpu, int32_t address, int8_t value)
+{
+	SystemInterlink_writeByte(cpu->system, address & 0x1FFFFFFF, value);
+}
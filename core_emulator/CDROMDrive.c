@@ -44,14 +44,33 @@ static bool CDROMDrive_ignoreBit(CDROMDrive *cdrom);
 static bool CDROMDrive_isReading(CDROMDrive *cdrom);
 static bool CDROMDrive_isSeeking(CDROMDrive *cdrom);
 static bool CDROMDrive_motorStatus(CDROMDrive *cdrom);
+static int8_t CDROMDrive_readPortByte(void *object, int32_t address);
+static int16_t CDROMDrive_readPortHalfword(void *object, int32_t address);
+static int32_t CDROMDrive_readPortWord(void *object, int32_t address);
 static bool CDROMDrive_seekError(CDROMDrive *cdrom);
 static bool CDROMDrive_shellOpen(CDROMDrive *cdrom);
 static void CDROMDrive_triggerInterrupt(CDROMDrive *cdrom, int32_t interruptNum,
 		int32_t delay);
 static bool CDROMDrive_wholeSector(CDROMDrive *cdrom);
+static void CDROMDrive_writePortByte(void *object, int32_t address,
+		int8_t value);
+static void CDROMDrive_writePortHalfword(void *object, int32_t address,
+		int16_t value);
+static void CDROMDrive_writePortWord(void *object, int32_t address,
+		int32_t word);
 static bool CDROMDrive_xaAdpcm(CDROMDrive *cdrom);
 static bool CDROMDrive_xaFilter(CDROMDrive *cdrom);
 
+// Handlers for our I/O ports
+static const IOPortHandlers cdromPortHandlers = {
+	.readByte = CDROMDrive_readPortByte,
+	.readHalfword = CDROMDrive_readPortHalfword,
+	.readWord = CDROMDrive_readPortWord,
+	.writeByte = CDROMDrive_writePortByte,
+	.writeHalfword = CDROMDrive_writePortHalfword,
+	.writeWord = CDROMDrive_writePortWord
+};
+
 /*
  * This struct encapsulates the state of the CD-ROM module.
  */
@@ -357,6 +376,26 @@ int8_t CDROMDrive_read1803(CDROMDrive *cdrom)
 	return retVal;
 }
 
+/*
+ * This function copies the 0x800 bytes of user data from the Mode 2 Form 1
+ * sector at the specified logical block address straight into destination,
+ * bypassing the drive's command interface. It returns false if there is no
+ * CD loaded.
+ */
+bool CDROMDrive_readDataSector(CDROMDrive *cdrom, int32_t lba,
+		int8_t *destination)
+{
+	if (CD_isEmpty(cdrom->cd))
+		return false;
+
+	// Logical block addresses start after the two second pregap
+	int64_t startAddress = (lba + 150) * 2352L + 24;
+	for (int32_t i = 0; i < 0x800; ++i)
+		destination[i] = CD_readByte(cdrom->cd, startAddress++);
+
+	return true;
+}
+
 /*
  * This lets us set the interrupt flag register contents manually.
  */
@@ -371,6 +410,10 @@ void CDROMDrive_setInterruptNumber(CDROMDrive *cdrom, int32_t interruptNum)
 void CDROMDrive_setMemoryInterface(CDROMDrive *cdrom, SystemInterlink *smi)
 {
 	cdrom->system = smi;
+
+	// Register handlers for our I/O ports
+	SystemInterlink_setIOPortHandlers(smi, 0x1F801800, 0x4,
+			&cdromPortHandlers, cdrom);
 }
 
 /*
@@ -853,6 +896,11 @@ static bool CDROMDrive_enableReportInterrupts(CDROMDrive *cdrom)
 static void CDROMDrive_executeCommand(CDROMDrive *cdrom, int32_t commandNum,
 		bool secondResponse)
 {
+	// Attribute time spent here to the CD-ROM drive when profiling
+	Profiler *profiler = SystemInterlink_getProfiler(cdrom->system);
+	int32_t previousSubsystem = Profiler_enterSubsystem(profiler,
+			PHILPSX_PROFILER_CDROM);
+
 	// Execute command or deal with second response
 	if (!secondResponse) {
 		switch (commandNum) {
@@ -917,6 +965,8 @@ static void CDROMDrive_executeCommand(CDROMDrive *cdrom, int32_t commandNum,
 				break;
 		}
 	}
+
+	Profiler_leaveSubsystem(profiler, previousSubsystem);
 }
 
 /*
@@ -1018,6 +1068,53 @@ static bool CDROMDrive_motorStatus(CDROMDrive *cdrom)
 	return cdrom->motorStatus;
 }
 
+/*
+ * This function handles byte reads from our I/O ports.
+ */
+static int8_t CDROMDrive_readPortByte(void *object, int32_t address)
+{
+	CDROMDrive *cdrom = object;
+	int8_t retVal = 0;
+
+	switch (address & 0x3) {
+		case 0:
+			retVal = CDROMDrive_read1800(cdrom);
+			break;
+		case 1:
+			retVal = CDROMDrive_read1801(cdrom);
+			break;
+		case 2:
+			retVal = CDROMDrive_read1802(cdrom);
+			break;
+		case 3:
+			retVal = CDROMDrive_read1803(cdrom);
+			break;
+	}
+
+	return retVal;
+}
+
+/*
+ * This function handles halfword reads from our I/O ports. As each port is
+ * only a byte wide, both bytes come from the same one.
+ */
+static int16_t CDROMDrive_readPortHalfword(void *object, int32_t address)
+{
+	int16_t retVal = CDROMDrive_readPortByte(object, address) & 0xFF;
+	retVal |= (CDROMDrive_readPortByte(object, address) & 0xFF) << 8;
+
+	return retVal;
+}
+
+/*
+ * This function handles word reads from our I/O ports, which are not allowed,
+ * so it just returns 0.
+ */
+static int32_t CDROMDrive_readPortWord(void *object, int32_t address)
+{
+	return 0;
+}
+
 /*
  * This tells us if there was a seek error.
  */
@@ -1063,6 +1160,51 @@ static bool CDROMDrive_wholeSector(CDROMDrive *cdrom)
 	return cdrom->wholeSector;
 }
 
+/*
+ * This function handles byte writes to our I/O ports.
+ */
+static void CDROMDrive_writePortByte(void *object, int32_t address,
+		int8_t value)
+{
+	CDROMDrive *cdrom = object;
+
+	switch (address & 0x3) {
+		case 0:
+			CDROMDrive_write1800(cdrom, value);
+			break;
+		case 1:
+			CDROMDrive_write1801(cdrom, value);
+			break;
+		case 2:
+			CDROMDrive_write1802(cdrom, value);
+			break;
+		case 3:
+			CDROMDrive_write1803(cdrom, value);
+			break;
+	}
+}
+
+/*
+ * This function handles halfword writes to our I/O ports. As each port is
+ * only a byte wide, both bytes go to the same one.
+ */
+static void CDROMDrive_writePortHalfword(void *object, int32_t address,
+		int16_t value)
+{
+	CDROMDrive_writePortByte(object, address, (int8_t)value);
+	CDROMDrive_writePortByte(object, address, (int8_t)(value >> 8));
+}
+
+/*
+ * This function handles word writes to our I/O ports, which are not allowed,
+ * so it does nothing.
+ */
+static void CDROMDrive_writePortWord(void *object, int32_t address,
+		int32_t word)
+{
+	;
+}
+
 /*
  * This tells us if we should be sending XA-ADPCM sectors to the SPU.
  */
@@ -0,0 +1,59 @@
+/*
+ * This C file models a clock domain as a class. Each clock domain counts the
+ * ticks of a clock running at a fixed ratio to the CPU clock, using integer
+ * arithmetic only, so converting between CPU cycles and ticks in either
+ * direction is exact no matter how often it is done.
+ *
+ * ClockDomain.c - Copyright Phillip Potter, 2020, under GPLv3
+ */
+#include <stdint.h>
+#include <stdbool.h>
+#include "../headers/ClockDomain.h"
+
+/*
+ * This constructs a ClockDomain object using the pre-allocated struct
+ * referenced by clock. It ticks every divisor / multiplier CPU cycles, with
+ * ticks counted from the specified CPU cycle.
+ */
+void construct_ClockDomain(ClockDomain *clock, int64_t multiplier,
+		int64_t divisor, int64_t cycle)
+{
+	clock->multiplier = multiplier;
+	clock->divisor = divisor;
+	clock->origin = cycle * multiplier;
+}
+
+/*
+ * This function returns the number of whole ticks between the origin and the
+ * specified CPU cycle, and moves the origin on past them. Any part of a tick
+ * left over is carried into the next count.
+ */
+int64_t ClockDomain_consumeTicks(ClockDomain *clock, int64_t cycle)
+{
+	int64_t ticks = ClockDomain_getTicks(clock, cycle);
+	clock->origin += ticks * clock->divisor;
+	return ticks;
+}
+
+/*
+ * This function returns the first CPU cycle by which the specified number of
+ * ticks will have happened since the origin, or INT64_MAX if the clock is
+ * stopped.
+ */
+int64_t ClockDomain_getCycleOfTick(ClockDomain *clock, int64_t ticks)
+{
+	if (clock->multiplier == 0)
+		return INT64_MAX;
+
+	return (clock->origin + ticks * clock->divisor + clock->multiplier - 1) /
+			clock->multiplier;
+}
+
+/*
+ * This function returns the number of whole ticks between the origin and the
+ * specified CPU cycle, without moving the origin.
+ */
+int64_t ClockDomain_getTicks(ClockDomain *clock, int64_t cycle)
+{
+	return (cycle * clock->multiplier - clock->origin) / clock->divisor;
+}
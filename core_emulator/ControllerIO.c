@@ -13,8 +13,17 @@
 
 // Forward declarations for functions private to this class
 // ControllerIO-related stuff:
+static int8_t ControllerIO_readPortByte(void *object, int32_t address);
 static void ControllerIO_updateBaudrateTimer(ControllerIO *cio);
 static void ControllerIO_updateJoyStat(ControllerIO *cio);
+static void ControllerIO_writePortByte(void *object, int32_t address,
+		int8_t value);
+
+// Handlers for our I/O ports
+static const IOPortHandlers controllerIOPortHandlers = {
+	.readByte = ControllerIO_readPortByte,
+	.writeByte = ControllerIO_writePortByte
+};
 
 /*
  * This struct encapsulates the state of the IO subsystem.
@@ -35,8 +44,8 @@ struct ControllerIO {
 	int32_t joyMode; // JOY_MODE
 	int32_t joyCtrl; // JOY_CTRL
 
-	// Store number of cycles to change timer by
-	int32_t cycles;
+	// Store global cycle count the timer was last updated at
+	int64_t lastSyncCycle;
 };
 
 /*
@@ -63,8 +72,8 @@ ControllerIO *construct_ControllerIO(void)
 	cio->joyMode = 0;
 	cio->joyCtrl = 0;
 
-	// Setup cycle store
-	cio->cycles = 0;
+	// Setup last sync point
+	cio->lastSyncCycle = 0;
 	
 	// Normal return:
 	return cio;
@@ -82,14 +91,6 @@ void destruct_ControllerIO(ControllerIO *cio)
 	free(cio);
 }
 
-/*
- * This function appends the cycles we need to sync the baudrate timer by.
- */
-void ControllerIO_appendSyncCycles(ControllerIO *cio, int32_t cycles)
-{
-	cio->cycles += cycles;
-}
-
 /*
  * This function reads bytes from the right place in the object.
  */
@@ -199,20 +200,36 @@ void ControllerIO_writeByte(ControllerIO *cio, int32_t address, int8_t value)
 void ControllerIO_setMemoryInterface(ControllerIO *cio, SystemInterlink *smi)
 {
 	cio->system = smi;
+
+	// Register handlers for our I/O ports
+	SystemInterlink_setIOPortHandlers(smi, 0x1F801040, 0x10,
+			&controllerIOPortHandlers, cio);
+}
+
+/*
+ * This function handles byte reads from our I/O ports.
+ */
+static int8_t ControllerIO_readPortByte(void *object, int32_t address)
+{
+	return ControllerIO_readByte(object, address);
 }
 
 /*
- * This function updates the baudrate timer.
+ * This function updates the baudrate timer by the number of CPU cycles that
+ * have passed since it was last updated. This only needs doing when the
+ * registers are accessed, so the timer has no scheduled events.
  */
 static void ControllerIO_updateBaudrateTimer(ControllerIO *cio)
 {
-	int32_t baudRate = logical_rshift(cio->joyStat, 11) & 0x1FFFFF;
-	baudRate -= cio->cycles;
-	cio->cycles = 0;
+	int64_t currentCycle =
+			Scheduler_getCycles(SystemInterlink_getScheduler(cio->system));
+	int64_t baudRate = logical_rshift(cio->joyStat, 11) & 0x1FFFFF;
+	baudRate -= currentCycle - cio->lastSyncCycle;
+	cio->lastSyncCycle = currentCycle;
 	if (baudRate < 0) {
 		baudRate = cio->joyBaud * (cio->joyMode & 0x3) / 2;
 	}
-	cio->joyStat = (baudRate << 11) | (cio->joyStat & 0x7FF);
+	cio->joyStat = ((int32_t)baudRate << 11) | (cio->joyStat & 0x7FF);
 }
 
 /*
@@ -221,4 +238,13 @@ static void ControllerIO_updateBaudrateTimer(ControllerIO *cio)
 static void ControllerIO_updateJoyStat(ControllerIO *cio)
 {
 	cio->joyStat |= 0x7;
+}
+
+/*
+ * This function handles byte writes to our I/O ports.
+ */
+static void ControllerIO_writePortByte(void *object, int32_t address,
+		int8_t value)
+{
+	ControllerIO_writeByte(object, address, value);
 }
\ No newline at end of file
@@ -13,6 +13,11 @@
 #include "../headers/Cop0_all.h"
 #include "../headers/math_utils.h"
 
+// Forward declarations for functions private to this class
+// Cop0-related stuff:
+static void Cop0_updateInterruptPending(Cop0 *sccp);
+static void Cop0_updateSegments(Cop0 *sccp);
+
 /*
  * This constructs a Cop0 object using the pre-allocated struct referenced by
  * sccp.
@@ -42,6 +47,8 @@ void Cop0_reset(Cop0 *sccp)
 											// status register to 0
 
 	sccp->conditionLine = false;
+	Cop0_updateInterruptPending(sccp);
+	Cop0_updateSegments(sccp);
 }
 
 /*
@@ -60,6 +67,30 @@ void Cop0_setConditionLineStatus(Cop0 *sccp, bool status)
 	sccp->conditionLine = status;
 }
 
+/*
+ * This function returns whether an interrupt should be taken, which is the
+ * case when interrupts are enabled and one of the interrupt bits of the
+ * cause register is set and not masked off in the status register.
+ */
+bool Cop0_isInterruptPending(Cop0 *sccp)
+{
+	return sccp->interruptPending;
+}
+
+/*
+ * This function sets the state of the hardware interrupt line, which is
+ * reflected in bit 10 of the cause register.
+ */
+void Cop0_setInterruptLine(Cop0 *sccp, bool asserted)
+{
+	if (asserted)
+		sccp->copRegisters[13] |= 0x400;
+	else
+		sccp->copRegisters[13] &= 0xFFFFFBFF;
+
+	Cop0_updateInterruptPending(sccp);
+}
+
 /**
  * This executes the RFE Cop0 instruction.
  */
@@ -179,6 +210,13 @@ void Cop0_writeReg(Cop0 *sccp, int32_t reg, int32_t value, bool override)
 				break;
 		}
 	}
+
+	// Recalculate interrupt status if status or cause register changed, and
+	// segment table if status register changed
+	if (reg == 12 || reg == 13)
+		Cop0_updateInterruptPending(sccp);
+	if (reg == 12)
+		Cop0_updateSegments(sccp);
 }
 
 /*
@@ -197,38 +235,24 @@ void Cop0_setCacheMiss(Cop0 *sccp, bool value)
 	Cop0_writeReg(sccp, 12, statusReg, true);
 }
 
+/*
+ * This function returns the segment table entry for the supplied virtual
+ * address, so callers needing its translation, cacheability and
+ * permission can get them with one lookup.
+ */
+const Cop0Segment *Cop0_getSegment(Cop0 *sccp, int32_t virtualAddress)
+{
+	return &sccp->segments[logical_rshift(virtualAddress, 29)];
+}
+
 /*
  * This function transforms a virtual address into a physical one.
  * It is designed for the base model of the processor which has no TLB.
  */
 int32_t Cop0_virtualToPhysical(Cop0 *sccp, int32_t virtualAddress)
 {
-	// Declare temp variable to hold new address
-	// and mask top 32-bits so we always get an unsigned value.
-	int64_t physicalAddress = virtualAddress & 0xFFFFFFFFL;
-
-	// Below is the map used in the PS1
-
-	// Make correct modifications to address
-	if (physicalAddress >= 0L &&
-			physicalAddress < 0x80000000L) { // kuseg address
-		// Do nothing
-		;
-	} else if (physicalAddress >= 0x80000000L &&
-			physicalAddress < 0xA0000000L) { // kseg0 address
-		// Subtract 0x80000000L
-		physicalAddress -= 0x80000000L;
-	} else if (physicalAddress >= 0xA0000000L &&
-			physicalAddress < 0xC0000000L) { // kseg1 address
-		// Subtract 0xA0000000L
-		physicalAddress -= 0xA0000000L;
-	} else if (physicalAddress >= 0xC0000000L &&
-			physicalAddress < 0x100000000L) { // kseg2 address
-		// Do nothing, this only includes cache control on PSX
-		;
-	}
-
-	return (int32_t)physicalAddress;
+	return virtualAddress &
+			sccp->segments[logical_rshift(virtualAddress, 29)].physicalMask;
 }
 
 /*
@@ -236,16 +260,7 @@ int32_t Cop0_virtualToPhysical(Cop0 *sccp, int32_t virtualAddress)
  */
 bool Cop0_isCacheable(Cop0 *sccp, int32_t virtualAddress)
 {
-	// Declare temp variable to hold new address
-	// and mask top 32-bits so we always get an unsigned value, as well as
-	// return variable
-	int64_t tempAddress = virtualAddress & 0xFFFFFFFFL;
-	bool retVal = false;
-
-	if (tempAddress >= 0L && tempAddress < 0xA0000000L)
-		retVal = true;
-
-	return retVal;
+	return sccp->segments[logical_rshift(virtualAddress, 29)].cacheable;
 }
 
 /*
@@ -253,12 +268,7 @@ bool Cop0_isCacheable(Cop0 *sccp, int32_t virtualAddress)
  */
 bool Cop0_areWeInKernelMode(Cop0 *sccp)
 {
-	bool retVal = false;
-
-	if ((sccp->copRegisters[12] & 0x2) == 0)
-		retVal = true;
-
-	return retVal;
+	return sccp->kernelMode;
 }
 
 /**
@@ -281,13 +291,7 @@ bool Cop0_userModeOppositeByteOrdering(Cop0 *sccp)
  */
 bool Cop0_isAddressAllowed(Cop0 *sccp, int32_t virtualAddress)
 {
-	bool retVal = true;
-
-	if ((virtualAddress & 0x80000000) == 0x80000000 &&
-			!Cop0_areWeInKernelMode(sccp))
-		retVal = false;
-
-	return retVal;
+	return sccp->segments[logical_rshift(virtualAddress, 29)].allowed;
 }
 
 /*
@@ -295,13 +299,7 @@ bool Cop0_isAddressAllowed(Cop0 *sccp, int32_t virtualAddress)
  */
 bool Cop0_areCachesSwapped(Cop0 *sccp)
 {
-	bool retVal = false;
-
-	// Disable cache swapping
-	/*if ((sccp->copRegisters[12] & 0x00020000) == 0x00020000)
-		retVal = true;*/
-
-	return retVal;
+	return sccp->cachesSwapped;
 }
 
 /*
@@ -309,12 +307,7 @@ bool Cop0_areCachesSwapped(Cop0 *sccp)
  */
 bool Cop0_isDataCacheIsolated(Cop0 *sccp)
 {
-	bool retVal = false;
-
-	if ((sccp->copRegisters[12] & 0x00010000) == 0x00010000)
-		retVal = true;
-
-	return retVal;
+	return sccp->dataCacheIsolated;
 }
 
 /*
@@ -325,4 +318,65 @@ bool Cop0_isCoProcessorUsable(Cop0 *sccp, int32_t copNum)
 	int32_t usableFlags = logical_rshift(sccp->copRegisters[12], 28);
 	usableFlags = logical_rshift(usableFlags, copNum) & 0x1;
 	return usableFlags == 1;
+}
+
+/*
+ * This function recalculates whether an interrupt is pending from the
+ * status and cause registers.
+ */
+static void Cop0_updateInterruptPending(Cop0 *sccp)
+{
+	int32_t statusRegister = sccp->copRegisters[12];
+	int32_t causeRegister = sccp->copRegisters[13];
+
+	sccp->interruptPending = (statusRegister & 0x1) == 0x1 &&
+			(statusRegister & causeRegister & 0x0000FF00) != 0;
+}
+
+/*
+ * This function rebuilds the segment table and mode flags from the status
+ * register. Kuseg is always accessible and untranslated, whereas kseg0 and
+ * kseg1 map onto the first 512MB of physical memory, and are only
+ * accessible (along with kseg2) in kernel mode. Only kuseg and kseg0 are
+ * cacheable.
+ */
+static void Cop0_updateSegments(Cop0 *sccp)
+{
+	int32_t statusRegister = sccp->copRegisters[12];
+
+	// Mode flags
+	sccp->kernelMode = (statusRegister & 0x2) == 0;
+	sccp->dataCacheIsolated = (statusRegister & 0x00010000) == 0x00010000;
+
+	// Disable cache swapping
+	/*sccp->cachesSwapped = (statusRegister & 0x00020000) == 0x00020000;*/
+	sccp->cachesSwapped = false;
+
+	// Segment table
+	for (int32_t i = 0; i < 8; ++i) {
+		Cop0Segment *segment = &sccp->segments[i];
+		switch (i) {
+			case 4: // kseg0
+				segment->physicalMask = 0x1FFFFFFF;
+				segment->cacheable = true;
+				segment->allowed = sccp->kernelMode;
+				break;
+			case 5: // kseg1
+				segment->physicalMask = 0x1FFFFFFF;
+				segment->cacheable = false;
+				segment->allowed = sccp->kernelMode;
+				break;
+			case 6: // kseg2
+			case 7:
+				segment->physicalMask = 0xFFFFFFFF;
+				segment->cacheable = false;
+				segment->allowed = sccp->kernelMode;
+				break;
+			default: // kuseg
+				segment->physicalMask = 0xFFFFFFFF;
+				segment->cacheable = true;
+				segment->allowed = true;
+				break;
+		}
+	}
 }
\ No newline at end of file
@@ -10,6 +10,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include "../headers/Cop2_all.h"
+#include "../headers/GteKernels.h"
 #include "../headers/math_utils.h"
 
 // Unsigned Newton-Raphson algorithm array - values taken from NOPSX 
@@ -62,6 +63,12 @@ static void Cop2_handleRTPT(Cop2 *gte, int32_t opcode);
 static void Cop2_handleGPF(Cop2 *gte, int32_t opcode);
 static void Cop2_handleGPL(Cop2 *gte, int32_t opcode);
 static void Cop2_handleNCCT(Cop2 *gte, int32_t opcode);
+static void Cop2_readControlVector(Cop2 *gte, int32_t reg, int64_t *vector);
+static void Cop2_readVector(Cop2 *gte, int32_t index, int64_t *vector);
+static void Cop2_unpackControlReg(Cop2 *gte, int32_t reg);
+static void Cop2_unpackDataReg(Cop2 *gte, int32_t reg);
+static void Cop2_storeColourResults(Cop2 *gte, const GteResult *results);
+static void Cop2_resolveFlags(Cop2 *gte);
 
 /*
  * This constructs a Cop2 object using the pre-allocated struct referenced by
@@ -72,6 +79,14 @@ void construct_Cop2(Cop2 *gte)
 	// Zero out register arrays
 	memset(gte->controlRegisters, 0, sizeof(gte->controlRegisters));
 	memset(gte->dataRegisters, 0, sizeof(gte->dataRegisters));
+	memset(gte->rotationMatrix, 0, sizeof(gte->rotationMatrix));
+	memset(gte->lightMatrix, 0, sizeof(gte->lightMatrix));
+	memset(gte->colourMatrix, 0, sizeof(gte->colourMatrix));
+	memset(gte->vectors, 0, sizeof(gte->vectors));
+	gte->flagsPending = false;
+
+	// Choose fastest arithmetic kernels for this CPU
+	gte->kernels = GteKernels_select();
 
 	// Reset
 	Cop2_reset(gte);
@@ -102,6 +117,11 @@ int32_t Cop2_gteFunction(Cop2 *gte, int32_t opcode)
 {
 	// Cycles to return
 	int32_t cycles = 0;
+
+	// Every implemented function sets the flag register afresh, replacing
+	// any flags still pending from the last one
+	bool flagsPending = gte->flagsPending;
+	gte->flagsPending = false;
 	
 	// Determine which function to handle
 	switch (opcode & 0x3F) {
@@ -194,6 +214,8 @@ int32_t Cop2_gteFunction(Cop2 *gte, int32_t opcode)
 			cycles = 39;
 			break;
 		default:
+			// Unimplemented functions leave the flag register alone
+			gte->flagsPending = flagsPending;
 			break;
 	}
 	
@@ -220,6 +242,12 @@ int32_t Cop2_readControlReg(Cop2 *gte, int32_t reg)
 			if ((retVal & 0x8000) == 0x8000)
 				retVal |= 0xFFFF0000;
 			break;
+		case 31:
+			// Work out flags left pending by RTPS or RTPT first
+			if (gte->flagsPending)
+				Cop2_resolveFlags(gte);
+			retVal = gte->controlRegisters[reg];
+			break;
 		default:
 			retVal = gte->controlRegisters[reg];
 			break;
@@ -301,6 +329,13 @@ void Cop2_writeControlReg(Cop2 *gte, int32_t reg, int32_t value, bool override)
 				break;
 		}
 	}
+
+	// Writing the flag register replaces any pending flags
+	if (reg == 31)
+		gte->flagsPending = false;
+
+	// Update unpacked copy if needed
+	Cop2_unpackControlReg(gte, reg);
 }
 
 /*
@@ -354,6 +389,9 @@ void Cop2_writeDataReg(Cop2 *gte, int32_t reg, int32_t value, bool override)
 				break;
 		}
 	}
+
+	// Update unpacked copy if needed
+	Cop2_unpackDataReg(gte, reg);
 }
 
 /*
@@ -361,64 +399,24 @@ void Cop2_writeDataReg(Cop2 *gte, int32_t reg, int32_t value, bool override)
  */
 static void Cop2_handleRTPS(Cop2 *gte, int32_t opcode)
 {
-	// Clear flag register
-	gte->controlRegisters[31] = 0;
-
 	// Filter out sf bit
 	int32_t sf = (opcode & 0x80000) == 0x80000 ? 1 : 0;
 
 	// Retrieve rotation matrix values
-	int64_t rt11 =
-			0xFFFF & gte->controlRegisters[0]; // RT11
-	int64_t rt12 =
-			0xFFFF & logical_rshift(gte->controlRegisters[0], 16); // RT12
-	int64_t rt13 =
-			0xFFFF & gte->controlRegisters[1]; // RT13
-	int64_t rt21 =
-			0xFFFF & logical_rshift(gte->controlRegisters[1], 16); // RT21
-	int64_t rt22 =
-			0xFFFF & gte->controlRegisters[2]; // RT22
-	int64_t rt23 =
-			0xFFFF & logical_rshift(gte->controlRegisters[2], 16); // RT23
-	int64_t rt31 =
-			0xFFFF & gte->controlRegisters[3]; // RT31
-	int64_t rt32 =
-			0xFFFF & logical_rshift(gte->controlRegisters[3], 16); // RT32
-	int64_t rt33 =
-			0xFFFF & gte->controlRegisters[4]; // RT33
-
-	// Sign extend rotation matrix values if necessary
-	if ((rt11 & 0x8000L) == 0x8000L)
-		rt11 |= 0xFFFFFFFFFFFF0000L;
-	if ((rt12 & 0x8000L) == 0x8000L)
-		rt12 |= 0xFFFFFFFFFFFF0000L;
-	if ((rt13 & 0x8000L) == 0x8000L)
-		rt13 |= 0xFFFFFFFFFFFF0000L;
-	if ((rt21 & 0x8000L) == 0x8000L)
-		rt21 |= 0xFFFFFFFFFFFF0000L;
-	if ((rt22 & 0x8000L) == 0x8000L)
-		rt22 |= 0xFFFFFFFFFFFF0000L;
-	if ((rt23 & 0x8000L) == 0x8000L)
-		rt23 |= 0xFFFFFFFFFFFF0000L;
-	if ((rt31 & 0x8000L) == 0x8000L)
-		rt31 |= 0xFFFFFFFFFFFF0000L;
-	if ((rt32 & 0x8000L) == 0x8000L)
-		rt32 |= 0xFFFFFFFFFFFF0000L;
-	if ((rt33 & 0x8000L) == 0x8000L)
-		rt33 |= 0xFFFFFFFFFFFF0000L;
+	int64_t rt11 = gte->rotationMatrix[0]; // RT11
+	int64_t rt12 = gte->rotationMatrix[1]; // RT12
+	int64_t rt13 = gte->rotationMatrix[2]; // RT13
+	int64_t rt21 = gte->rotationMatrix[3]; // RT21
+	int64_t rt22 = gte->rotationMatrix[4]; // RT22
+	int64_t rt23 = gte->rotationMatrix[5]; // RT23
+	int64_t rt31 = gte->rotationMatrix[6]; // RT31
+	int64_t rt32 = gte->rotationMatrix[7]; // RT32
+	int64_t rt33 = gte->rotationMatrix[8]; // RT33
 
 	// Retrieve vector 0 values
-	int64_t vx0 = 0xFFFF & gte->dataRegisters[0]; // VX0
-	int64_t vy0 = 0xFFFF & logical_rshift(gte->dataRegisters[0], 16); // VY0
-	int64_t vz0 = 0xFFFF & gte->dataRegisters[1]; // VZ0
-
-	// Sign extend vector 0 values if necessary
-	if ((vx0 & 0x8000L) == 0x8000L)
-		vx0 |= 0xFFFFFFFFFFFF0000L;
-	if ((vy0 & 0x8000L) == 0x8000L)
-		vy0 |= 0xFFFFFFFFFFFF0000L;
-	if ((vz0 & 0x8000L) == 0x8000L)
-		vz0 |= 0xFFFFFFFFFFFF0000L;
+	int64_t vx0 = gte->vectors[0]; // VX0
+	int64_t vy0 = gte->vectors[1]; // VY0
+	int64_t vz0 = gte->vectors[2]; // VZ0
 
 	// Retrieve translation vector values
 	int64_t trX = 0xFFFFFFFFL & gte->controlRegisters[5]; // TRX
@@ -460,84 +458,22 @@ static void Cop2_handleRTPS(Cop2 *gte, int32_t opcode)
 	mac2 = mac2 >> (sf * 12);
 	mac3 = mac3 >> (sf * 12);
 
-	// Set MAC1, MAC2 and MAC3 flags as needed
-
-	// MAC1
-	if (mac1 > 0x80000000000L)
-		gte->controlRegisters[31] |= 0x40000000;
-	else if (mac1 < -0x80000000000L)
-		gte->controlRegisters[31] |= 0x8000000;
-
-	// MAC2
-	if (mac2 > 0x80000000000L)
-		gte->controlRegisters[31] |= 0x20000000;
-	else if (mac2 < -0x80000000000L)
-		gte->controlRegisters[31] |= 0x4000000;
-
-	// MAC3
-	if (mac3 > 0x80000000000L)
-		gte->controlRegisters[31] |= 0x10000000;
-	else if (mac3 < -0x80000000000L)
-		gte->controlRegisters[31] |= 0x2000000;
-
-	// Set IR1, IR2 and IR3 - dealing with flags too,
-	// saturation should be -0x8000..0x7FFF, regardless of lm bit
-
-	// IR1
-	int64_t ir1 = 0, ir2 = 0, ir3 = 0;
-	if (mac1 < -0x8000) {
+	// Set IR1, IR2 and IR3 - saturation should be -0x8000..0x7FFF,
+	// regardless of lm bit (flags are left to Cop2_resolveFlags)
+	int64_t ir1 = mac1, ir2 = mac2, ir3 = mac3;
+	if (ir1 < -0x8000)
 		ir1 = -0x8000;
-		gte->controlRegisters[31] |= 0x1000000;
-	} else if (mac1 > 0x7FFF) {
+	else if (ir1 > 0x7FFF)
 		ir1 = 0x7FFF;
-		gte->controlRegisters[31] |= 0x1000000;
-	} else {
-		ir1 = (int32_t)mac1;
-	}
-
-	// IR2
-	if (mac2 < -0x8000) {
+	if (ir2 < -0x8000)
 		ir2 = -0x8000;
-		gte->controlRegisters[31] |= 0x800000;
-	} else if (mac2 > 0x7FFF) {
+	else if (ir2 > 0x7FFF)
 		ir2 = 0x7FFF;
-		gte->controlRegisters[31] |= 0x800000;
-	} else {
-		ir2 = (int32_t)mac2;
-	}
-
-	// IR3
-	if (mac3 < -0x8000) {
+	if (ir3 < -0x8000)
 		ir3 = -0x8000;
-
-		// Deal with quirk in IR3 flag handling
-		if (sf == 0) {
-			uint64_t u_mac3 = (uint64_t)mac3;
-			bool needsSignExtension = (u_mac3 & 0x8000000000000000UL) ==
-										0x8000000000000000UL;
-			int64_t temp = u_mac3 >> 12;
-			if (needsSignExtension)
-				temp |= 0xFFF0000000000000UL;
-			if (temp > 0x7FFF || temp < -0x8000)
-				gte->controlRegisters[31] |= 0x400000;
-		} else {
-			gte->controlRegisters[31] |= 0x400000;
-		}
-	} else if (mac3 > 0x7FFF) {
+	else if (ir3 > 0x7FFF)
 		ir3 = 0x7FFF;
 
-		// Deal with quirk in IR3 flag handling
-		if (sf == 0) {
-			int64_t temp = mac3 >> 12;
-			if (temp > 0x7FFF || temp < -0x8000)
-				gte->controlRegisters[31] |= 0x400000;
-		} else {
-			gte->controlRegisters[31] |= 0x400000;
-		}
-	} else {
-		ir3 = (int32_t)mac3;
-	}
-
 	// Write back to real registers
 	gte->dataRegisters[25] = (int32_t)mac1; // MAC1
 	gte->dataRegisters[26] = (int32_t)mac2; // MAC2
@@ -546,30 +482,22 @@ static void Cop2_handleRTPS(Cop2 *gte, int32_t opcode)
 	gte->dataRegisters[10] = (int32_t)ir2; // IR2
 	gte->dataRegisters[11] = (int32_t)ir3; // IR3
 
-	// Calculate SZ3 and move FIFO along, also setting SZ3 flag if needed
+	// Calculate SZ3 and move FIFO along
 	gte->dataRegisters[16] = gte->dataRegisters[17]; // SZ1 to SZ0
 	gte->dataRegisters[17] = gte->dataRegisters[18]; // SZ2 to SZ1
 	gte->dataRegisters[18] = gte->dataRegisters[19]; // SZ3 to SZ2
-	uint64_t u_mac3 = (uint64_t)mac3;
-	bool needsSignExtension = (u_mac3 & 0x8000000000000000UL) ==
-								0x8000000000000000UL;
-	int32_t shiftBy = (1 - sf) * 12;
-	int64_t temp_sz3 = u_mac3 >> shiftBy;
-	if (needsSignExtension && shiftBy == 12)
-		temp_sz3 |= 0xFFF0000000000000UL;
-	if (temp_sz3 < 0) {
+	int64_t temp_sz3 = mac3 >> ((1 - sf) * 12);
+	if (temp_sz3 < 0)
 		temp_sz3 = 0;
-		gte->controlRegisters[31] |= 0x40000;
-	} else if (temp_sz3 > 0xFFFF) {
+	else if (temp_sz3 > 0xFFFF)
 		temp_sz3 = 0xFFFF;
-		gte->controlRegisters[31] |= 0x40000;
-	}
 	gte->dataRegisters[19] = (int32_t)temp_sz3;
 
 	// Begin second phase of calculations - use Unsigned Newton-Raphson
 	// division algorithm from NOPSX documentation
 	int64_t mac0 = 0, sx2 = 0, sy2 = 0, ir0 = 0;
 	int64_t divisionResult = 0;
+	gte->pendingFlags = 0;
 	if (h < temp_sz3 * 2) {
 
 		// Count leading zeroes in SZ3
@@ -594,62 +522,31 @@ static void Cop2_handleRTPS(Cop2 *gte, int32_t opcode)
 
 	} else {
 		divisionResult = 0x1FFFFL;
-		gte->controlRegisters[31] |= 0x20000;
+		gte->pendingFlags = 0x20000;
 	}
 
-	// Use division result and set MAC0 flag if needed
-	mac0 = divisionResult * ir1 + ofx;
-	if (mac0 > 0x80000000L)
-		gte->controlRegisters[31] |= 0x10000;
-	else if (mac0 < -0x80000000L)
-		gte->controlRegisters[31] |= 0x8000;
-	mac0 &= 0xFFFFFFFFL;
-	if ((mac0 & 0x80000000L) == 0x80000000L)
-		mac0 |= 0xFFFFFFFF00000000L;
-	sx2 = mac0 / 0x10000;
-	mac0 = divisionResult * ir2 + ofy;
-	if (mac0 > 0x80000000L)
-		gte->controlRegisters[31] |= 0x10000;
-	else if (mac0 < -0x80000000L)
-		gte->controlRegisters[31] |= 0x8000;
-	mac0 &= 0xFFFFFFFFL;
-	if ((mac0 & 0x80000000L) == 0x80000000L)
-		mac0 |= 0xFFFFFFFF00000000L;
-	sy2 = mac0 / 0x10000;
-	mac0 = divisionResult * dqa + dqb;
-	if (mac0 > 0x80000000L)
-		gte->controlRegisters[31] |= 0x10000;
-	else if (mac0 < -0x80000000L)
-		gte->controlRegisters[31] |= 0x8000;
-	mac0 &= 0xFFFFFFFFL;
-	if ((mac0 & 0x80000000L) == 0x80000000L)
-		mac0 |= 0xFFFFFFFF00000000L;
+	// Use division result, keeping the untruncated MAC0 values for the flags
+	gte->pendingMac0[0] = divisionResult * ir1 + ofx;
+	gte->pendingMac0[1] = divisionResult * ir2 + ofy;
+	gte->pendingMac0[2] = divisionResult * dqa + dqb;
+	sx2 = (int32_t)gte->pendingMac0[0] / 0x10000;
+	sy2 = (int32_t)gte->pendingMac0[1] / 0x10000;
+	mac0 = (int32_t)gte->pendingMac0[2];
 	ir0 = mac0 / 0x1000;
 
-	// Adjust results for saturation and set flags if needed
-	if (sx2 > 0x3FFL) {
+	// Adjust results for saturation
+	if (sx2 > 0x3FFL)
 		sx2 = 0x3FFL;
-		gte->controlRegisters[31] |= 0x4000;
-	} else if (sx2 < -0x400) {
+	else if (sx2 < -0x400)
 		sx2 = -0x400;
-		gte->controlRegisters[31] |= 0x4000;
-	}
-
-	if (sy2 > 0x3FFL) {
+	if (sy2 > 0x3FFL)
 		sy2 = 0x3FFL;
-		gte->controlRegisters[31] |= 0x2000;
-	} else if (sy2 < -0x400) {
+	else if (sy2 < -0x400)
 		sy2 = -0x400;
-		gte->controlRegisters[31] |= 0x2000;
-	}
-
-	if (ir0 < 0) {
+	if (ir0 < 0)
 		ir0 = 0;
-		gte->controlRegisters[31] |= 0x1000;
-	} else if (ir0 > 0x1000) {
+	else if (ir0 > 0x1000)
 		ir0 = 0x1000;
-		gte->controlRegisters[31] |= 0x1000;
-	}
 
 	// Store values back to correct registers
 
@@ -666,9 +563,12 @@ static void Cop2_handleRTPS(Cop2 *gte, int32_t opcode)
 	// IR0
 	gte->dataRegisters[8] = (int32_t)ir0;
 
-	// Calculate bit 31 of flag register
-	if ((gte->controlRegisters[31] & 0x7F87E000) != 0)
-		gte->controlRegisters[31] |= 0x80000000;
+	// Leave the flag register to be worked out if it is read
+	gte->pendingMac[0] = mac1;
+	gte->pendingMac[1] = mac2;
+	gte->pendingMac[2] = mac3;
+	gte->pendingSf = sf;
+	gte->flagsPending = true;
 }
 
 /*
@@ -739,23 +639,17 @@ static void Cop2_handleOP(Cop2 *gte, int32_t opcode)
 	int64_t ir3 = 0xFFFF & gte->dataRegisters[11]; // IR3
 
 	// Fetch RT11, RT22, RT33 values
-	int64_t d1 = 0xFFFF & gte->controlRegisters[0]; // RT11
-	int64_t d2 = 0xFFFF & gte->controlRegisters[2]; // RT22
-	int64_t d3 = 0xFFFF & gte->controlRegisters[4]; // RT33
+	int64_t d1 = gte->rotationMatrix[0]; // RT11
+	int64_t d2 = gte->rotationMatrix[4]; // RT22
+	int64_t d3 = gte->rotationMatrix[8]; // RT33
 
-	// Sign extend both sets of values
+	// Sign extend IR values
 	if ((ir1 & 0x8000L) == 0x8000L)
 		ir1 |= 0xFFFFFFFFFFFF0000L;
 	if ((ir2 & 0x8000L) == 0x8000L)
 		ir2 |= 0xFFFFFFFFFFFF0000L;
 	if ((ir3 & 0x8000L) == 0x8000L)
 		ir3 |= 0xFFFFFFFFFFFF0000L;
-	if ((d1 & 0x8000L) == 0x8000L)
-		d1 |= 0xFFFFFFFFFFFF0000L;
-	if ((d2 & 0x8000L) == 0x8000L)
-		d2 |= 0xFFFFFFFFFFFF0000L;
-	if ((d3 & 0x8000L) == 0x8000L)
-		d3 |= 0xFFFFFFFFFFFF0000L;
 
 	// Perform calculation
 	int64_t temp1 = ir3 * d2 - ir2 * d3;
@@ -1311,9 +1205,6 @@ static void Cop2_handleINTPL(Cop2 *gte, int32_t opcode)
  */
 static void Cop2_handleMVMVA(Cop2 *gte, int32_t opcode)
 {
-	// Clear flag register
-	gte->controlRegisters[31] = 0;
-
 	// Filter out sf bit
 	int32_t sf = (opcode & 0x80000) == 0x80000 ? 1 : 0;
 
@@ -1330,282 +1221,91 @@ static void Cop2_handleMVMVA(Cop2 *gte, int32_t opcode)
 	int32_t mMatrix = logical_rshift((opcode & 0x60000), 17);
 
 	// Declare and store correct translation vector values
-	int64_t tv1 = 0, tv2 = 0, tv3 = 0;
+	int64_t translation[3] = { 0, 0, 0 };
 	switch (tVec) {
 		case 0: // TR
-			tv1 = 0xFFFFFFFFL & gte->controlRegisters[5]; // TRX
-			tv2 = 0xFFFFFFFFL & gte->controlRegisters[6]; // TRY
-			tv3 = 0xFFFFFFFFL & gte->controlRegisters[7]; // TRZ
+			Cop2_readControlVector(gte, 5, translation);
 			break;
 		case 1: // BK
-			tv1 = 0xFFFFFFFFL & gte->controlRegisters[13]; // RBK
-			tv2 = 0xFFFFFFFFL & gte->controlRegisters[14]; // GBK
-			tv3 = 0xFFFFFFFFL & gte->controlRegisters[15]; // BBK
+			Cop2_readControlVector(gte, 13, translation);
 			break;
 		case 2: // FC
-			tv1 = 0xFFFFFFFFL & gte->controlRegisters[21]; // RFC
-			tv2 = 0xFFFFFFFFL & gte->controlRegisters[22]; // GFC
-			tv3 = 0xFFFFFFFFL & gte->controlRegisters[23]; // BFC
+			Cop2_readControlVector(gte, 21, translation);
 			break;
 		case 3: // None (do nothing as 0 already set)
 			break;
 	}
 
-	// Sign extend translation vector values
-	if ((tv1 & 0x80000000L) == 0x80000000L)
-		tv1 |= 0xFFFFFFFF00000000L;
-	if ((tv2 & 0x80000000L) == 0x80000000L)
-		tv2 |= 0xFFFFFFFF00000000L;
-	if ((tv3 & 0x80000000L) == 0x80000000L)
-		tv3 |= 0xFFFFFFFF00000000L;
-
 	// Declare and store correct multiply vector values
-	int64_t mv1 = 0, mv2 = 0, mv3 = 0;
+	int64_t vector[3] = { 0, 0, 0 };
 	switch (mVec) {
 		case 0: // V0
-			mv1 = 0xFFFF & gte->dataRegisters[0]; // VX0
-			mv2 = 0xFFFF & logical_rshift(gte->dataRegisters[0], 16); // VY0
-			mv3 = 0xFFFF & gte->dataRegisters[1]; // VZ0
-			break;
 		case 1: // V1
-			mv1 = 0xFFFF & gte->dataRegisters[2]; // VX1
-			mv2 = 0xFFFF & logical_rshift(gte->dataRegisters[2], 16); // VY1
-			mv3 = 0xFFFF & gte->dataRegisters[3]; // VZ1
-			break;
 		case 2: // V2
-			mv1 = 0xFFFF & gte->dataRegisters[4]; // VX2
-			mv2 = 0xFFFF & logical_rshift(gte->dataRegisters[4], 16); // VY2
-			mv3 = 0xFFFF & gte->dataRegisters[5]; // VZ2
+			Cop2_readVector(gte, mVec, vector);
 			break;
 		case 3: // [IR1,IR2,IR3]
-			mv1 = 0xFFFF & gte->dataRegisters[9]; // IR1
-			mv2 = 0xFFFF & gte->dataRegisters[10]; // IR2
-			mv3 = 0xFFFF & gte->dataRegisters[11]; // IR3
+			vector[0] = (int16_t)gte->dataRegisters[9]; // IR1
+			vector[1] = (int16_t)gte->dataRegisters[10]; // IR2
+			vector[2] = (int16_t)gte->dataRegisters[11]; // IR3
 			break;
 	}
 
-	// Sign extend multiply vector values
-	if ((mv1 & 0x8000L) == 0x8000L)
-		mv1 |= 0xFFFFFFFFFFFF0000L;
-	if ((mv2 & 0x8000L) == 0x8000L)
-		mv2 |= 0xFFFFFFFFFFFF0000L;
-	if ((mv3 & 0x8000L) == 0x8000L)
-		mv3 |= 0xFFFFFFFFFFFF0000L;
-
-	// Declare and store correct multiply matrix values
-	int64_t mx11 = 0, mx12 = 0, mx13 = 0, mx21 = 0,
-			mx22 = 0, mx23 = 0, mx31 = 0, mx32 = 0, mx33 = 0;
+	// Point at correct multiply matrix, building the garbage matrix the same
+	// way as the real ones if needed
+	const int16_t *matrix = gte->rotationMatrix;
+	int16_t garbageMatrix[9];
 	switch (mMatrix) {
 		case 0: // Rotation matrix
-			mx11 =
-				0xFFFF & gte->controlRegisters[0]; // RT11;
-			mx12 =
-				0xFFFF & logical_rshift(gte->controlRegisters[0], 16); // RT12
-			mx13 =
-				0xFFFF & gte->controlRegisters[1]; // RT13
-			mx21 =
-				0xFFFF & logical_rshift(gte->controlRegisters[1], 16); // RT21
-			mx22 =
-				0xFFFF & gte->controlRegisters[2]; // RT22
-			mx23 =
-				0xFFFF & logical_rshift(gte->controlRegisters[2], 16); // RT23
-			mx31 =
-				0xFFFF & gte->controlRegisters[3]; // RT31
-			mx32 =
-				0xFFFF & logical_rshift(gte->controlRegisters[3], 16); // RT32
-			mx33 =
-				0xFFFF & gte->controlRegisters[4]; // RT33
+			matrix = gte->rotationMatrix;
 			break;
 		case 1: // Light matrix
-			mx11 =
-				0xFFFF & gte->controlRegisters[8]; // L11;
-			mx12 =
-				0xFFFF & logical_rshift(gte->controlRegisters[8], 16); // L12
-			mx13 =
-				0xFFFF & gte->controlRegisters[9]; // L13
-			mx21 =
-				0xFFFF & logical_rshift(gte->controlRegisters[9], 16); // L21
-			mx22 =
-				0xFFFF & gte->controlRegisters[10]; // L22
-			mx23 =
-				0xFFFF & logical_rshift(gte->controlRegisters[10], 16); // L23
-			mx31 =
-				0xFFFF & gte->controlRegisters[11]; // L31
-			mx32 =
-				0xFFFF & logical_rshift(gte->controlRegisters[11], 16); // L32
-			mx33 =
-				0xFFFF & gte->controlRegisters[12]; // L33
+			matrix = gte->lightMatrix;
 			break;
 		case 2: // Colour matrix
-			mx11 =
-				0xFFFF & gte->controlRegisters[16]; // LR1;
-			mx12 =
-				0xFFFF & logical_rshift(gte->controlRegisters[16], 16); // LR2
-			mx13 =
-				0xFFFF & gte->controlRegisters[17]; // LR3
-			mx21 =
-				0xFFFF & logical_rshift(gte->controlRegisters[17], 16); // LG1
-			mx22 =
-				0xFFFF & gte->controlRegisters[18]; // LG2
-			mx23 =
-				0xFFFF & logical_rshift(gte->controlRegisters[18], 16); // LG3
-			mx31 =
-				0xFFFF & gte->controlRegisters[19]; // LB1
-			mx32 =
-				0xFFFF & logical_rshift(gte->controlRegisters[19], 16); // LB2
-			mx33 =
-				0xFFFF & gte->controlRegisters[20]; // LB3
+			matrix = gte->colourMatrix;
 			break;
 		case 3: // Reserved (garbage matrix)
-			mx11 = -0x60;
-			mx12 = 0x60;
-			mx13 = 0xFFFF & gte->dataRegisters[8]; // IR0
-			mx21 = 0xFFFF & gte->controlRegisters[1]; // RT13
-			mx22 = 0xFFFF & gte->controlRegisters[1]; // RT13
-			mx23 = 0xFFFF & gte->controlRegisters[1]; // RT13
-			mx31 = 0xFFFF & gte->controlRegisters[2]; // RT22
-			mx32 = 0xFFFF & gte->controlRegisters[2]; // RT22
-			mx33 = 0xFFFF & gte->controlRegisters[2]; // RT22                
+		{
+			int16_t rt13 = gte->rotationMatrix[2]; // RT13
+			int16_t rt22 = gte->rotationMatrix[4]; // RT22
+			garbageMatrix[0] = -0x60;
+			garbageMatrix[1] = 0x60;
+			garbageMatrix[2] = (int16_t)gte->dataRegisters[8]; // IR0
+			garbageMatrix[3] = rt13;
+			garbageMatrix[4] = rt13;
+			garbageMatrix[5] = rt13;
+			garbageMatrix[6] = rt22;
+			garbageMatrix[7] = rt22;
+			garbageMatrix[8] = rt22;
+			matrix = garbageMatrix;
+		}
 			break;
 	}
 
-	// Sign extend multiply matrix values
-	if ((mx11 & 0x8000L) == 0x8000L && mMatrix != 3)
-		mx11 |= 0xFFFFFFFFFFFF0000L;
-	if ((mx12 & 0x8000L) == 0x8000L && mMatrix != 3)
-		mx12 |= 0xFFFFFFFFFFFF0000L;
-	if ((mx13 & 0x8000L) == 0x8000L)
-		mx13 |= 0xFFFFFFFFFFFF0000L;
-	if ((mx21 & 0x8000L) == 0x8000L)
-		mx21 |= 0xFFFFFFFFFFFF0000L;
-	if ((mx22 & 0x8000L) == 0x8000L)
-		mx22 |= 0xFFFFFFFFFFFF0000L;
-	if ((mx23 & 0x8000L) == 0x8000L)
-		mx23 |= 0xFFFFFFFFFFFF0000L;
-	if ((mx31 & 0x8000L) == 0x8000L)
-		mx31 |= 0xFFFFFFFFFFFF0000L;
-	if ((mx32 & 0x8000L) == 0x8000L)
-		mx32 |= 0xFFFFFFFFFFFF0000L;
-	if ((mx33 & 0x8000L) == 0x8000L)
-		mx33 |= 0xFFFFFFFFFFFF0000L;
-
-	// Declare temporary variables and do calculations
-	int64_t temp1 = 0, temp2 = 0, temp3 = 0;
-	if (tVec != 2) {
-		temp1 = tv1 * 0x1000L + mx11 * mv1 + mx12 * mv2 + mx13 * mv3;
-		temp2 = tv2 * 0x1000L + mx21 * mv1 + mx22 * mv2 + mx23 * mv3;
-		temp3 = tv3 * 0x1000L + mx31 * mv1 + mx32 * mv2 + mx33 * mv3;
-	} else { // Account for faulty FC vector calculation on real hardware
-		temp1 = mx13 * mv3;
-		temp2 = mx23 * mv3;
-		temp3 = mx33 * mv3;
+	// Account for faulty FC vector calculation on real hardware, which
+	// only uses the last column of the matrix
+	if (tVec == 2) {
+		translation[0] = translation[1] = translation[2] = 0;
+		vector[0] = vector[1] = 0;
 	}
 
-	// Shift results right by (sf * 12) bits, preserving sign bit
-	temp1 = temp1 >> (sf * 12);
-	temp2 = temp2 >> (sf * 12);
-	temp3 = temp3 >> (sf * 12);
+	// Do calculations, setting MAC1, MAC2 and MAC3 and saturating them to
+	// IR1, IR2 and IR3 within -0x8000..0x7FFF or 0..0x7FFF depending on lm
+	GteResult result;
+	gte->kernels->transform(matrix, vector, translation, sf,
+			(lm == 1) ? 0 : -0x8000L, &result);
+	gte->controlRegisters[31] = result.flags;
 
 	// Set MAC1, MAC2 and MAC3 registers
-	gte->dataRegisters[25] = (int32_t)temp1; // MAC1
-	gte->dataRegisters[26] = (int32_t)temp2; // MAC2
-	gte->dataRegisters[27] = (int32_t)temp3; // MAC3
-
-	// Set relevant MAC1, MAC2 and MAC3 flag bits
-
-	// MAC1
-	if (temp1 > 0x80000000000L)
-		gte->controlRegisters[31] |= 0x40000000;
-	else if (temp1 < -0x80000000000L)
-		gte->controlRegisters[31] |= 0x8000000;
-
-	// MAC2
-	if (temp2 > 0x80000000000L)
-		gte->controlRegisters[31] |= 0x20000000;
-	else if (temp2 < -0x80000000000L)
-		gte->controlRegisters[31] |= 0x4000000;
-
-	// MAC3
-	if (temp3 > 0x80000000000L)
-		gte->controlRegisters[31] |= 0x10000000;
-	else if (temp3 < -0x80000000000L)
-		gte->controlRegisters[31] |= 0x2000000;
-
-	// Set IR1, IR2 and IR3 registers and saturation flag bits
-	switch (lm) {
-		case 0: // Saturate to -0x8000..0x7FFF
-		{
-			// IR1
-			if (temp1 < -0x8000) {
-				gte->dataRegisters[9] = -0x8000;
-				gte->controlRegisters[31] |= 0x1000000;
-			} else if (temp1 > 0x7FFF) {
-				gte->dataRegisters[9] = 0x7FFF;
-				gte->controlRegisters[31] |= 0x1000000;
-			} else {
-				gte->dataRegisters[9] = (int32_t)temp1;
-			}
-
-			// IR2
-			if (temp2 < -0x8000) {
-				gte->dataRegisters[10] = -0x8000;
-				gte->controlRegisters[31] |= 0x800000;
-			} else if (temp2 > 0x7FFF) {
-				gte->dataRegisters[10] = 0x7FFF;
-				gte->controlRegisters[31] |= 0x800000;
-			} else {
-				gte->dataRegisters[10] = (int32_t)temp2;
-			}
-
-			// IR3
-			if (temp3 < -0x8000) {
-				gte->dataRegisters[11] = -0x8000;
-				gte->controlRegisters[31] |= 0x400000;
-			} else if (temp3 > 0x7FFF) {
-				gte->dataRegisters[11] = 0x7FFF;
-				gte->controlRegisters[31] |= 0x400000;
-			} else {
-				gte->dataRegisters[11] = (int32_t)temp3;
-			}
-		}
-			break;
-		case 1: // Saturate to 0..0x7FFF
-		{
-			// IR1
-			if (temp1 < 0) {
-				gte->dataRegisters[9] = 0;
-				gte->controlRegisters[31] |= 0x1000000;
-			} else if (temp1 > 0x7FFF) {
-				gte->dataRegisters[9] = 0x7FFF;
-				gte->controlRegisters[31] |= 0x1000000;
-			} else {
-				gte->dataRegisters[9] = (int32_t)temp1;
-			}
-
-			// IR2
-			if (temp2 < 0) {
-				gte->dataRegisters[10] = 0;
-				gte->controlRegisters[31] |= 0x800000;
-			} else if (temp2 > 0x7FFF) {
-				gte->dataRegisters[10] = 0x7FFF;
-				gte->controlRegisters[31] |= 0x800000;
-			} else {
-				gte->dataRegisters[10] = (int32_t)temp2;
-			}
+	gte->dataRegisters[25] = (int32_t)result.mac[0]; // MAC1
+	gte->dataRegisters[26] = (int32_t)result.mac[1]; // MAC2
+	gte->dataRegisters[27] = (int32_t)result.mac[2]; // MAC3
 
-			// IR3
-			if (temp3 < 0) {
-				gte->dataRegisters[11] = 0;
-				gte->controlRegisters[31] |= 0x400000;
-			} else if (temp3 > 0x7FFF) {
-				gte->dataRegisters[11] = 0x7FFF;
-				gte->controlRegisters[31] |= 0x400000;
-			} else {
-				gte->dataRegisters[11] = (int32_t)temp3;
-			}
-		}
-			break;
-	}
+	// Set IR1, IR2 and IR3 registers
+	gte->dataRegisters[9] = (int32_t)result.ir[0]; // IR1
+	gte->dataRegisters[10] = (int32_t)result.ir[1]; // IR2
+	gte->dataRegisters[11] = (int32_t)result.ir[2]; // IR3
 
 	// Calculate bit 31 of flag register
 	if ((gte->controlRegisters[31] & 0x7F87E000) != 0)
@@ -1627,66 +1327,26 @@ static void Cop2_handleNCDS(Cop2 *gte, int32_t opcode)
 	int32_t lm = (opcode & 0x400) == 0x400 ? 1 : 0;
 
 	// Retrieve light matrix values
-	int64_t l11 = 0xFFFF & gte->controlRegisters[8]; // L11
-	int64_t l12 = 0xFFFF & logical_rshift(gte->controlRegisters[8], 16); // L12
-	int64_t l13 = 0xFFFF & gte->controlRegisters[9]; // L13
-	int64_t l21 = 0xFFFF & logical_rshift(gte->controlRegisters[9], 16); // L21
-	int64_t l22 = 0xFFFF & gte->controlRegisters[10]; // L22
-	int64_t l23 = 0xFFFF & logical_rshift(gte->controlRegisters[10], 16); // L23
-	int64_t l31 = 0xFFFF & gte->controlRegisters[11]; // L31
-	int64_t l32 = 0xFFFF & logical_rshift(gte->controlRegisters[11], 16); // L32
-	int64_t l33 = 0xFFFF & gte->controlRegisters[12]; // L33
-
-	// Sign extend light matrix values if needed
-	if ((l11 & 0x8000L) == 0x8000L)
-		l11 |= 0xFFFFFFFFFFFF0000L;
-	if ((l12 & 0x8000L) == 0x8000L)
-		l12 |= 0xFFFFFFFFFFFF0000L;
-	if ((l13 & 0x8000L) == 0x8000L)
-		l13 |= 0xFFFFFFFFFFFF0000L;
-	if ((l21 & 0x8000L) == 0x8000L)
-		l21 |= 0xFFFFFFFFFFFF0000L;
-	if ((l22 & 0x8000L) == 0x8000L)
-		l22 |= 0xFFFFFFFFFFFF0000L;
-	if ((l23 & 0x8000L) == 0x8000L)
-		l23 |= 0xFFFFFFFFFFFF0000L;
-	if ((l31 & 0x8000L) == 0x8000L)
-		l31 |= 0xFFFFFFFFFFFF0000L;
-	if ((l32 & 0x8000L) == 0x8000L)
-		l32 |= 0xFFFFFFFFFFFF0000L;
-	if ((l33 & 0x8000L) == 0x8000L)
-		l33 |= 0xFFFFFFFFFFFF0000L;
+	int64_t l11 = gte->lightMatrix[0]; // L11
+	int64_t l12 = gte->lightMatrix[1]; // L12
+	int64_t l13 = gte->lightMatrix[2]; // L13
+	int64_t l21 = gte->lightMatrix[3]; // L21
+	int64_t l22 = gte->lightMatrix[4]; // L22
+	int64_t l23 = gte->lightMatrix[5]; // L23
+	int64_t l31 = gte->lightMatrix[6]; // L31
+	int64_t l32 = gte->lightMatrix[7]; // L32
+	int64_t l33 = gte->lightMatrix[8]; // L33
 
 	// Retrieve light colour matrix values
-	int64_t lr1 = 0xFFFF & gte->controlRegisters[16]; // LR1
-	int64_t lr2 = 0xFFFF & logical_rshift(gte->controlRegisters[16], 16); // LR2
-	int64_t lr3 = 0xFFFF & gte->controlRegisters[17]; // LR3
-	int64_t lg1 = 0xFFFF & logical_rshift(gte->controlRegisters[17], 16); // LG1
-	int64_t lg2 = 0xFFFF & gte->controlRegisters[18]; // LG2
-	int64_t lg3 = 0xFFFF & logical_rshift(gte->controlRegisters[18], 16); // LG3
-	int64_t lb1 = 0xFFFF & gte->controlRegisters[19]; // LB1
-	int64_t lb2 = 0xFFFF & logical_rshift(gte->controlRegisters[19], 16); // LB2
-	int64_t lb3 = 0xFFFF & gte->controlRegisters[20]; // LB3
-
-	// Sign extend light colour matrix values if needed
-	if ((lr1 & 0x8000L) == 0x8000L)
-		lr1 |= 0xFFFFFFFFFFFF0000L;
-	if ((lr2 & 0x8000L) == 0x8000L)
-		lr2 |= 0xFFFFFFFFFFFF0000L;
-	if ((lr3 & 0x8000L) == 0x8000L)
-		lr3 |= 0xFFFFFFFFFFFF0000L;
-	if ((lg1 & 0x8000L) == 0x8000L)
-		lg1 |= 0xFFFFFFFFFFFF0000L;
-	if ((lg2 & 0x8000L) == 0x8000L)
-		lg2 |= 0xFFFFFFFFFFFF0000L;
-	if ((lg3 & 0x8000L) == 0x8000L)
-		lg3 |= 0xFFFFFFFFFFFF0000L;
-	if ((lb1 & 0x8000L) == 0x8000L)
-		lb1 |= 0xFFFFFFFFFFFF0000L;
-	if ((lb2 & 0x8000L) == 0x8000L)
-		lb2 |= 0xFFFFFFFFFFFF0000L;
-	if ((lb3 & 0x8000L) == 0x8000L)
-		lb3 |= 0xFFFFFFFFFFFF0000L;
+	int64_t lr1 = gte->colourMatrix[0]; // LR1
+	int64_t lr2 = gte->colourMatrix[1]; // LR2
+	int64_t lr3 = gte->colourMatrix[2]; // LR3
+	int64_t lg1 = gte->colourMatrix[3]; // LG1
+	int64_t lg2 = gte->colourMatrix[4]; // LG2
+	int64_t lg3 = gte->colourMatrix[5]; // LG3
+	int64_t lb1 = gte->colourMatrix[6]; // LB1
+	int64_t lb2 = gte->colourMatrix[7]; // LB2
+	int64_t lb3 = gte->colourMatrix[8]; // LB3
 
 	// Retrieve background colour values
 	int64_t rbk = 0xFFFFFFFFL & gte->controlRegisters[13]; // RBK
@@ -1728,17 +1388,9 @@ static void Cop2_handleNCDS(Cop2 *gte, int32_t opcode)
 	int64_t code = 0xFF & logical_rshift(gte->dataRegisters[6], 24); // CODE
 
 	// Retrieve V0 values
-	int64_t vx0 = 0xFFFF & gte->dataRegisters[0]; // VX0
-	int64_t vy0 = 0xFFFF & logical_rshift(gte->dataRegisters[0], 16); // VY0
-	int64_t vz0 = 0xFFFF & gte->dataRegisters[1]; // VZ0
-
-	// Sign extend V0 values if necessary
-	if ((vx0 & 0x8000L) == 0x8000L)
-		vx0 |= 0xFFFFFFFFFFFF0000L;
-	if ((vy0 & 0x8000L) == 0x8000L)
-		vy0 |= 0xFFFFFFFFFFFF0000L;
-	if ((vz0 & 0x8000L) == 0x8000L)
-		vz0 |= 0xFFFFFFFFFFFF0000L;
+	int64_t vx0 = gte->vectors[0]; // VX0
+	int64_t vy0 = gte->vectors[1]; // VY0
+	int64_t vz0 = gte->vectors[2]; // VZ0
 
 	// Perform first stage of calculation
 	int64_t mac1 = l11 * vx0 + l12 * vy0 + l13 * vz0;
@@ -2099,35 +1751,15 @@ static void Cop2_handleCDP(Cop2 *gte, int32_t opcode)
 	int64_t code = 0xFF & logical_rshift(gte->dataRegisters[6], 24); // CODE
 
 	// Retrieve light colour matrix values
-	int64_t lr1 = 0xFFFF & gte->controlRegisters[16]; // LR1
-	int64_t lr2 = 0xFFFF & logical_rshift(gte->controlRegisters[16], 16); // LR2
-	int64_t lr3 = 0xFFFF & gte->controlRegisters[17]; // LR3
-	int64_t lg1 = 0xFFFF & logical_rshift(gte->controlRegisters[17], 16); // LG1
-	int64_t lg2 = 0xFFFF & gte->controlRegisters[18]; // LG2
-	int64_t lg3 = 0xFFFF & logical_rshift(gte->controlRegisters[18], 16); // LG3
-	int64_t lb1 = 0xFFFF & gte->controlRegisters[19]; // LB1
-	int64_t lb2 = 0xFFFF & logical_rshift(gte->controlRegisters[19], 16); // LB2
-	int64_t lb3 = 0xFFFF & gte->controlRegisters[20]; // LB3
-
-	// Sign extend light colour matrix values if needed
-	if ((lr1 & 0x8000L) == 0x8000L)
-		lr1 |= 0xFFFFFFFFFFFF0000L;
-	if ((lr2 & 0x8000L) == 0x8000L)
-		lr2 |= 0xFFFFFFFFFFFF0000L;
-	if ((lr3 & 0x8000L) == 0x8000L)
-		lr3 |= 0xFFFFFFFFFFFF0000L;
-	if ((lg1 & 0x8000L) == 0x8000L)
-		lg1 |= 0xFFFFFFFFFFFF0000L;
-	if ((lg2 & 0x8000L) == 0x8000L)
-		lg2 |= 0xFFFFFFFFFFFF0000L;
-	if ((lg3 & 0x8000L) == 0x8000L)
-		lg3 |= 0xFFFFFFFFFFFF0000L;
-	if ((lb1 & 0x8000L) == 0x8000L)
-		lb1 |= 0xFFFFFFFFFFFF0000L;
-	if ((lb2 & 0x8000L) == 0x8000L)
-		lb2 |= 0xFFFFFFFFFFFF0000L;
-	if ((lb3 & 0x8000L) == 0x8000L)
-		lb3 |= 0xFFFFFFFFFFFF0000L;
+	int64_t lr1 = gte->colourMatrix[0]; // LR1
+	int64_t lr2 = gte->colourMatrix[1]; // LR2
+	int64_t lr3 = gte->colourMatrix[2]; // LR3
+	int64_t lg1 = gte->colourMatrix[3]; // LG1
+	int64_t lg2 = gte->colourMatrix[4]; // LG2
+	int64_t lg3 = gte->colourMatrix[5]; // LG3
+	int64_t lb1 = gte->colourMatrix[6]; // LB1
+	int64_t lb2 = gte->colourMatrix[7]; // LB2
+	int64_t lb3 = gte->colourMatrix[8]; // LB3
 
 	// Perform first stage of calculation
 	int64_t mac1 = rbk * 0x1000 + lr1 * ir1 + lr2 * ir2 + lr3 * ir3;
@@ -2371,67 +2003,50 @@ static void Cop2_handleNCDT(Cop2 *gte, int32_t opcode)
 	// Filter out lm bit
 	int32_t lm = (opcode & 0x400) == 0x400 ? 1 : 0;
 
+	// Perform calculation for V0, V1 and V2 in one go, as none of them
+	// depends on results from the previous one, then store results
+	GteResult results[3];
+	gte->kernels->lightVertices(gte->lightMatrix, gte->colourMatrix,
+			gte->vectors, gte->controlRegisters, gte->dataRegisters, true,
+			sf, (lm == 1) ? 0 : -0x8000L, results);
+	Cop2_storeColourResults(gte, results);
+}
+
+/*
+ * This function handles the NCCS GTE function.
+ */
+static void Cop2_handleNCCS(Cop2 *gte, int32_t opcode)
+{
+	// Clear flag register
+	gte->controlRegisters[31] = 0;
+
+	// Filter out sf bit
+	int32_t sf = (opcode & 0x80000) == 0x80000 ? 1 : 0;
+
+	// Filter out lm bit
+	int32_t lm = (opcode & 0x400) == 0x400 ? 1 : 0;
+
 	// Retrieve light matrix values
-	int64_t l11 = 0xFFFF & gte->controlRegisters[8]; // L11
-	int64_t l12 = 0xFFFF & logical_rshift(gte->controlRegisters[8], 16); // L12
-	int64_t l13 = 0xFFFF & gte->controlRegisters[9]; // L13
-	int64_t l21 = 0xFFFF & logical_rshift(gte->controlRegisters[9], 16); // L21
-	int64_t l22 = 0xFFFF & gte->controlRegisters[10]; // L22
-	int64_t l23 = 0xFFFF & logical_rshift(gte->controlRegisters[10], 16); // L23
-	int64_t l31 = 0xFFFF & gte->controlRegisters[11]; // L31
-	int64_t l32 = 0xFFFF & logical_rshift(gte->controlRegisters[11], 16); // L32
-	int64_t l33 = 0xFFFF & gte->controlRegisters[12]; // L33
-
-	// Sign extend light matrix values if needed
-	if ((l11 & 0x8000L) == 0x8000L)
-		l11 |= 0xFFFFFFFFFFFF0000L;
-	if ((l12 & 0x8000L) == 0x8000L)
-		l12 |= 0xFFFFFFFFFFFF0000L;
-	if ((l13 & 0x8000L) == 0x8000L)
-		l13 |= 0xFFFFFFFFFFFF0000L;
-	if ((l21 & 0x8000L) == 0x8000L)
-		l21 |= 0xFFFFFFFFFFFF0000L;
-	if ((l22 & 0x8000L) == 0x8000L)
-		l22 |= 0xFFFFFFFFFFFF0000L;
-	if ((l23 & 0x8000L) == 0x8000L)
-		l23 |= 0xFFFFFFFFFFFF0000L;
-	if ((l31 & 0x8000L) == 0x8000L)
-		l31 |= 0xFFFFFFFFFFFF0000L;
-	if ((l32 & 0x8000L) == 0x8000L)
-		l32 |= 0xFFFFFFFFFFFF0000L;
-	if ((l33 & 0x8000L) == 0x8000L)
-		l33 |= 0xFFFFFFFFFFFF0000L;
+	int64_t l11 = gte->lightMatrix[0]; // L11
+	int64_t l12 = gte->lightMatrix[1]; // L12
+	int64_t l13 = gte->lightMatrix[2]; // L13
+	int64_t l21 = gte->lightMatrix[3]; // L21
+	int64_t l22 = gte->lightMatrix[4]; // L22
+	int64_t l23 = gte->lightMatrix[5]; // L23
+	int64_t l31 = gte->lightMatrix[6]; // L31
+	int64_t l32 = gte->lightMatrix[7]; // L32
+	int64_t l33 = gte->lightMatrix[8]; // L33
 
 	// Retrieve light colour matrix values
-	int64_t lr1 = 0xFFFF & gte->controlRegisters[16]; // LR1
-	int64_t lr2 = 0xFFFF & logical_rshift(gte->controlRegisters[16], 16); // LR2
-	int64_t lr3 = 0xFFFF & gte->controlRegisters[17]; // LR3
-	int64_t lg1 = 0xFFFF & logical_rshift(gte->controlRegisters[17], 16); // LG1
-	int64_t lg2 = 0xFFFF & gte->controlRegisters[18]; // LG2
-	int64_t lg3 = 0xFFFF & logical_rshift(gte->controlRegisters[18], 16); // LG3
-	int64_t lb1 = 0xFFFF & gte->controlRegisters[19]; // LB1
-	int64_t lb2 = 0xFFFF & logical_rshift(gte->controlRegisters[19], 16); // LB2
-	int64_t lb3 = 0xFFFF & gte->controlRegisters[20]; // LB3
-
-	// Sign extend light colour matrix values if needed
-	if ((lr1 & 0x8000L) == 0x8000L)
-		lr1 |= 0xFFFFFFFFFFFF0000L;
-	if ((lr2 & 0x8000L) == 0x8000L)
-		lr2 |= 0xFFFFFFFFFFFF0000L;
-	if ((lr3 & 0x8000L) == 0x8000L)
-		lr3 |= 0xFFFFFFFFFFFF0000L;
-	if ((lg1 & 0x8000L) == 0x8000L)
-		lg1 |= 0xFFFFFFFFFFFF0000L;
-	if ((lg2 & 0x8000L) == 0x8000L)
-		lg2 |= 0xFFFFFFFFFFFF0000L;
-	if ((lg3 & 0x8000L) == 0x8000L)
-		lg3 |= 0xFFFFFFFFFFFF0000L;
-	if ((lb1 & 0x8000L) == 0x8000L)
-		lb1 |= 0xFFFFFFFFFFFF0000L;
-	if ((lb2 & 0x8000L) == 0x8000L)
-		lb2 |= 0xFFFFFFFFFFFF0000L;
-	if ((lb3 & 0x8000L) == 0x8000L)
-		lb3 |= 0xFFFFFFFFFFFF0000L;
+	int64_t lr1 = gte->colourMatrix[0]; // LR1
+	int64_t lr2 = gte->colourMatrix[1]; // LR2
+	int64_t lr3 = gte->colourMatrix[2]; // LR3
+	int64_t lg1 = gte->colourMatrix[3]; // LG1
+	int64_t lg2 = gte->colourMatrix[4]; // LG2
+	int64_t lg3 = gte->colourMatrix[5]; // LG3
+	int64_t lb1 = gte->colourMatrix[6]; // LB1
+	int64_t lb2 = gte->colourMatrix[7]; // LB2
+	int64_t lb3 = gte->colourMatrix[8]; // LB3
 
 	// Retrieve background colour values
 	int64_t rbk = 0xFFFFFFFFL & gte->controlRegisters[13]; // RBK
@@ -2446,519 +2061,37 @@ static void Cop2_handleNCDT(Cop2 *gte, int32_t opcode)
 	if ((bbk & 0x80000000L) == 0x80000000L)
 		bbk |= 0xFFFFFFFF00000000L;
 
-	// Retrieve far colour values
-	int64_t rfc = 0xFFFFFFFFL & gte->controlRegisters[21]; // RFC
-	int64_t gfc = 0xFFFFFFFFL & gte->controlRegisters[22]; // GFC
-	int64_t bfc = 0xFFFFFFFFL & gte->controlRegisters[23]; // BFC
-
-	// Sign extend far colour values if needed
-	if ((rfc & 0x80000000L) == 0x80000000L)
-		rfc |= 0xFFFFFFFF00000000L;
-	if ((gfc & 0x80000000L) == 0x80000000L)
-		gfc |= 0xFFFFFFFF00000000L;
-	if ((bfc & 0x80000000L) == 0x80000000L)
-		bfc |= 0xFFFFFFFF00000000L;
-
-	// Retrieve IR0 value
-	int64_t ir0 = 0xFFFF & gte->dataRegisters[8]; // IR0
-
-	// Sign extend IR0 value if necessary
-	if ((ir0 & 0x8000L) == 0x8000L)
-		ir0 |= 0xFFFFFFFFFFFF0000L;
-
 	// Retrieve RGBC values
 	int64_t r = 0xFF & gte->dataRegisters[6]; // R
 	int64_t g = 0xFF & logical_rshift(gte->dataRegisters[6], 8); // G
 	int64_t b = 0xFF & logical_rshift(gte->dataRegisters[6], 16); // B
 	int64_t code = 0xFF & logical_rshift(gte->dataRegisters[6], 24); // CODE
 
-	// Repeat calculation for V0, V1 and V2
-	for (int32_t i = 0; i < 3; ++i) {
+	// Retrieve V0 values
+	int64_t vx0 = gte->vectors[0]; // VX0
+	int64_t vy0 = gte->vectors[1]; // VY0
+	int64_t vz0 = gte->vectors[2]; // VZ0
 
-		// Clear flag register
-		gte->controlRegisters[31] = 0;
+	// Perform first stage of calculation
+	int64_t mac1 = l11 * vx0 + l12 * vy0 + l13 * vz0;
+	int64_t mac2 = l21 * vx0 + l22 * vy0 + l23 * vz0;
+	int64_t mac3 = l31 * vx0 + l32 * vy0 + l33 * vz0;
 
-		// Retrieve Vx values
-		int64_t vxAny = 0, vyAny = 0, vzAny = 0;
-		switch (i) {
-			case 0:
-				vxAny =
-					0xFFFF & gte->dataRegisters[0]; // VX0
-				vyAny =
-					0xFFFF & logical_rshift(gte->dataRegisters[0], 16); // VY0
-				vzAny =
-					0xFFFF & gte->dataRegisters[1]; // VZ0
-				break;
-			case 1:
-				vxAny =
-					0xFFFF & gte->dataRegisters[2]; // VX1
-				vyAny =
-					0xFFFF & logical_rshift(gte->dataRegisters[2], 16); // VY1
-				vzAny =
-					0xFFFF & gte->dataRegisters[3]; // VZ1
-				break;
-			case 2:
-				vxAny =
-					0xFFFF & gte->dataRegisters[4]; // VX2
-				vyAny =
-					0xFFFF & logical_rshift(gte->dataRegisters[4], 16); // VY2
-				vzAny =
-					0xFFFF & gte->dataRegisters[5]; // VZ2
-				break;
-		}
+	// Shift right by (sf * 12) bits, preserving sign bit
+	mac1 = mac1 >> (sf * 12);
+	mac2 = mac2 >> (sf * 12);
+	mac3 = mac3 >> (sf * 12);
 
-		// Sign extend Vx values if necessary
-		if ((vxAny & 0x8000L) == 0x8000L) {
-			vxAny |= 0xFFFFFFFFFFFF0000L;
-		}
-		if ((vyAny & 0x8000L) == 0x8000L) {
-			vyAny |= 0xFFFFFFFFFFFF0000L;
-		}
-		if ((vzAny & 0x8000L) == 0x8000L) {
-			vzAny |= 0xFFFFFFFFFFFF0000L;
-		}
+	// Set flags and mask bits for MAC1, MAC2 and MAC3
+	if (mac1 > 0x80000000000L)
+		gte->controlRegisters[31] |= 0x40000000;
+	else if (mac1 < -0x80000000000L)
+		gte->controlRegisters[31] |= 0x8000000;
 
-		// Perform first stage of calculation
-		int64_t mac1 = l11 * vxAny + l12 * vyAny + l13 * vzAny;
-		int64_t mac2 = l21 * vxAny + l22 * vyAny + l23 * vzAny;
-		int64_t mac3 = l31 * vxAny + l32 * vyAny + l33 * vzAny;
-
-		// Shift right by (sf * 12) bits, preserving sign bit
-		mac1 = mac1 >> (sf * 12);
-		mac2 = mac2 >> (sf * 12);
-		mac3 = mac3 >> (sf * 12);
-
-		// Set flags and mask bits for MAC1, MAC2 and MAC3
-		if (mac1 > 0x80000000000L) {
-			gte->controlRegisters[31] |= 0x40000000;
-		} else if (mac1 < -0x80000000000L) {
-			gte->controlRegisters[31] |= 0x8000000;
-		}
-
-		if (mac2 > 0x80000000000L) {
-			gte->controlRegisters[31] |= 0x20000000;
-		} else if (mac2 < -0x80000000000L) {
-			gte->controlRegisters[31] |= 0x4000000;
-		}
-
-		if (mac3 > 0x80000000000L) {
-			gte->controlRegisters[31] |= 0x10000000;
-		} else if (mac3 < -0x80000000000L) {
-			gte->controlRegisters[31] |= 0x2000000;
-		}
-
-		// Setup IR1, IR2 and IR3
-		int64_t ir1 = 0, ir2 = 0, ir3 = 0;
-		int64_t lowerBound = (lm == 1) ? 0 : -0x8000L;
-
-		if (mac1 > 0x7FFFL) {
-			ir1 = 0x7FFFL;
-			gte->controlRegisters[31] |= 0x1000000;
-		} else if (mac1 < lowerBound) {
-			ir1 = lowerBound;
-			gte->controlRegisters[31] |= 0x1000000;
-		} else {
-			ir1 = mac1;
-		}
-
-		if (mac2 > 0x7FFFL) {
-			ir2 = 0x7FFFL;
-			gte->controlRegisters[31] |= 0x800000;
-		} else if (mac2 < lowerBound) {
-			ir2 = lowerBound;
-			gte->controlRegisters[31] |= 0x800000;
-		} else {
-			ir2 = mac2;
-		}
-
-		if (mac3 > 0x7FFFL) {
-			ir3 = 0x7FFFL;
-			gte->controlRegisters[31] |= 0x400000;
-		} else if (mac3 < lowerBound) {
-			ir3 = lowerBound;
-			gte->controlRegisters[31] |= 0x400000;
-		} else {
-			ir3 = mac3;
-		}
-
-		// Perform second stage of calculation
-		mac1 = rbk * 0x1000 + lr1 * ir1 + lr2 * ir2 + lr3 * ir3;
-		mac2 = gbk * 0x1000 + lg1 * ir1 + lg2 * ir2 + lg3 * ir3;
-		mac3 = bbk * 0x1000 + lb1 * ir1 + lb2 * ir2 + lb3 * ir3;
-
-		// Shift right by (sf * 12) bits, preserving sign bit
-		mac1 = mac1 >> (sf * 12);
-		mac2 = mac2 >> (sf * 12);
-		mac3 = mac3 >> (sf * 12);
-
-		// Set flags and mask bits for MAC1, MAC2 and MAC3 (again)
-		if (mac1 > 0x80000000000L) {
-			gte->controlRegisters[31] |= 0x40000000;
-		} else if (mac1 < -0x80000000000L) {
-			gte->controlRegisters[31] |= 0x8000000;
-		}
-
-		if (mac2 > 0x80000000000L) {
-			gte->controlRegisters[31] |= 0x20000000;
-		} else if (mac2 < -0x80000000000L) {
-			gte->controlRegisters[31] |= 0x4000000;
-		}
-
-		if (mac3 > 0x80000000000L) {
-			gte->controlRegisters[31] |= 0x10000000;
-		} else if (mac3 < -0x80000000000L) {
-			gte->controlRegisters[31] |= 0x2000000;
-		}
-
-		// Setup IR1, IR2 and IR3 (again)
-		if (mac1 > 0x7FFFL) {
-			ir1 = 0x7FFFL;
-			gte->controlRegisters[31] |= 0x1000000;
-		} else if (mac1 < lowerBound) {
-			ir1 = lowerBound;
-			gte->controlRegisters[31] |= 0x1000000;
-		} else {
-			ir1 = mac1;
-		}
-
-		if (mac2 > 0x7FFFL) {
-			ir2 = 0x7FFFL;
-			gte->controlRegisters[31] |= 0x800000;
-		} else if (mac2 < lowerBound) {
-			ir2 = lowerBound;
-			gte->controlRegisters[31] |= 0x800000;
-		} else {
-			ir2 = mac2;
-		}
-
-		if (mac3 > 0x7FFFL) {
-			ir3 = 0x7FFFL;
-			gte->controlRegisters[31] |= 0x400000;
-		} else if (mac3 < lowerBound) {
-			ir3 = lowerBound;
-			gte->controlRegisters[31] |= 0x400000;
-		} else {
-			ir3 = mac3;
-		}
-
-		// Perform first NCCx stage calculation
-		mac1 = r * ir1;
-		mac2 = g * ir2;
-		mac3 = b * ir3;
-
-		// Shift results left by four bits
-		mac1 = mac1 << 4;
-		mac2 = mac2 << 4;
-		mac3 = mac3 << 4;
-
-		// Check for and set MAC1, MAC2 and MAC3 flags again if needed
-		if (mac1 > 0x80000000000L) {
-			gte->controlRegisters[31] |= 0x40000000;
-		} else if (mac1 < -0x80000000000L) {
-			gte->controlRegisters[31] |= 0x8000000;
-		}
-
-		if (mac2 > 0x80000000000L) {
-			gte->controlRegisters[31] |= 0x20000000;
-		} else if (mac2 < -0x80000000000L) {
-			gte->controlRegisters[31] |= 0x4000000;
-		}
-
-		if (mac3 > 0x80000000000L) {
-			gte->controlRegisters[31] |= 0x10000000;
-		} else if (mac3 < -0x80000000000L) {
-			gte->controlRegisters[31] |= 0x2000000;
-		}
-
-		// Perform NCDx only calculation
-		ir1 = ((rfc << 12) - mac1) >> (sf * 12);
-		ir2 = ((gfc << 12) - mac2) >> (sf * 12);
-		ir3 = ((bfc << 12) - mac3) >> (sf * 12);
-
-		// Saturate IR1, IR2 and IR3 if needed, but ignoring lm bit
-		if (ir1 > 0x7FFFL) {
-			ir1 = 0x7FFFL;
-			gte->controlRegisters[31] |= 0x1000000;
-		} else if (ir1 < -0x8000L) {
-			ir1 = -0x8000L;
-			gte->controlRegisters[31] |= 0x1000000;
-		}
-
-		if (ir2 > 0x7FFFL) {
-			ir2 = 0x7FFFL;
-			gte->controlRegisters[31] |= 0x800000;
-		} else if (ir2 < -0x8000L) {
-			ir2 = -0x8000L;
-			gte->controlRegisters[31] |= 0x800000;
-		}
-
-		if (ir3 > 0x7FFFL) {
-			ir3 = 0x7FFFL;
-			gte->controlRegisters[31] |= 0x400000;
-		} else if (ir3 < -0x8000L) {
-			ir3 = -0x8000L;
-			gte->controlRegisters[31] |= 0x400000;
-		}
-
-		// Next stage of NCDx only calculation
-		mac1 = ir1 * ir0 + mac1;
-		mac2 = ir2 * ir0 + mac2;
-		mac3 = ir3 * ir0 + mac3;
-
-		// Check for and set MAC1, MAC2 and MAC3 flags again if needed
-		if (mac1 > 0x80000000000L) {
-			gte->controlRegisters[31] |= 0x40000000;
-		} else if (mac1 < -0x80000000000L) {
-			gte->controlRegisters[31] |= 0x8000000;
-		}
-
-		if (mac2 > 0x80000000000L) {
-			gte->controlRegisters[31] |= 0x20000000;
-		} else if (mac2 < -0x80000000000L) {
-			gte->controlRegisters[31] |= 0x4000000;
-		}
-
-		if (mac3 > 0x80000000000L) {
-			gte->controlRegisters[31] |= 0x10000000;
-		} else if (mac3 < -0x80000000000L) {
-			gte->controlRegisters[31] |= 0x2000000;
-		}
-
-		// Perform second NCCx stage calculation,
-		// shifting MAC1, MAC2 and MAC3 by (sf * 12), and preserving sign bit
-		mac1 = mac1 >> (sf * 12);
-		mac2 = mac2 >> (sf * 12);
-		mac3 = mac3 >> (sf * 12);
-
-		// Check for and set MAC1, MAC2 and MAC3 flags again if needed
-		if (mac1 > 0x80000000000L) {
-			gte->controlRegisters[31] |= 0x40000000;
-		} else if (mac1 < -0x80000000000L) {
-			gte->controlRegisters[31] |= 0x8000000;
-		}
-
-		if (mac2 > 0x80000000000L) {
-			gte->controlRegisters[31] |= 0x20000000;
-		} else if (mac2 < -0x80000000000L) {
-			gte->controlRegisters[31] |= 0x4000000;
-		}
-
-		if (mac3 > 0x80000000000L) {
-			gte->controlRegisters[31] |= 0x10000000;
-		} else if (mac3 < -0x80000000000L) {
-			gte->controlRegisters[31] |= 0x2000000;
-		}
-
-		// Store results back to IR1, IR2 and IR3
-		if (mac1 > 0x7FFFL) {
-			ir1 = 0x7FFFL;
-			gte->controlRegisters[31] |= 0x1000000;
-		} else if (mac1 < lowerBound) {
-			ir1 = lowerBound;
-			gte->controlRegisters[31] |= 0x1000000;
-		} else {
-			ir1 = mac1;
-		}
-
-		if (mac2 > 0x7FFFL) {
-			ir2 = 0x7FFFL;
-			gte->controlRegisters[31] |= 0x800000;
-		} else if (mac2 < lowerBound) {
-			ir2 = lowerBound;
-			gte->controlRegisters[31] |= 0x800000;
-		} else {
-			ir2 = mac2;
-		}
-
-		if (mac3 > 0x7FFFL) {
-			ir3 = 0x7FFFL;
-			gte->controlRegisters[31] |= 0x400000;
-		} else if (mac3 < lowerBound) {
-			ir3 = lowerBound;
-			gte->controlRegisters[31] |= 0x400000;
-		} else {
-			ir3 = mac3;
-		}
-
-		// Calculate result to be stored to colour FIFO
-		int64_t rOut = mac1 / 16;
-		int64_t gOut = mac2 / 16;
-		int64_t bOut = mac3 / 16;
-
-		// Check values and saturate + set flags if needed
-		if (rOut < 0) {
-			rOut = 0;
-			gte->controlRegisters[31] |= 0x200000;
-		} else if (rOut > 0xFF) {
-			rOut = 0xFF;
-			gte->controlRegisters[31] |= 0x200000;
-		}
-
-		if (gOut < 0) {
-			gOut = 0;
-			gte->controlRegisters[31] |= 0x100000;
-		} else if (gOut > 0xFF) {
-			gOut = 0xFF;
-			gte->controlRegisters[31] |= 0x100000;
-		}
-
-		if (bOut < 0) {
-			bOut = 0;
-			gte->controlRegisters[31] |= 0x80000;
-		} else if (bOut > 0xFF) {
-			bOut = 0xFF;
-			gte->controlRegisters[31] |= 0x80000;
-		}
-
-		// Calculate and set flag bit 31
-		if ((gte->controlRegisters[31] & 0x7F87E000) != 0) {
-			gte->controlRegisters[31] |= 0x80000000;
-		}
-
-		// Store all values back
-		gte->dataRegisters[25] = (int32_t)mac1; // MAC1
-		gte->dataRegisters[26] = (int32_t)mac2; // MAC2
-		gte->dataRegisters[27] = (int32_t)mac3; // MAC3
-
-		gte->dataRegisters[9] = (int32_t)ir1; // IR1
-		gte->dataRegisters[10] = (int32_t)ir2; // IR2
-		gte->dataRegisters[11] = (int32_t)ir3; // IR3
-
-		gte->dataRegisters[20] = gte->dataRegisters[21]; // RGB1 to RGB0
-		gte->dataRegisters[21] = gte->dataRegisters[22]; // RGB2 to RGB1
-		gte->dataRegisters[22] =
-			(int32_t)((code << 24) | (bOut << 16) | (gOut << 8) | rOut); // RGB2
-	}
-}
-
-/*
- * This function handles the NCCS GTE function.
- */
-static void Cop2_handleNCCS(Cop2 *gte, int32_t opcode)
-{
-	// Clear flag register
-	gte->controlRegisters[31] = 0;
-
-	// Filter out sf bit
-	int32_t sf = (opcode & 0x80000) == 0x80000 ? 1 : 0;
-
-	// Filter out lm bit
-	int32_t lm = (opcode & 0x400) == 0x400 ? 1 : 0;
-
-	// Retrieve light matrix values
-	int64_t l11 = 0xFFFF & gte->controlRegisters[8]; // L11
-	int64_t l12 = 0xFFFF & logical_rshift(gte->controlRegisters[8], 16); // L12
-	int64_t l13 = 0xFFFF & gte->controlRegisters[9]; // L13
-	int64_t l21 = 0xFFFF & logical_rshift(gte->controlRegisters[9], 16); // L21
-	int64_t l22 = 0xFFFF & gte->controlRegisters[10]; // L22
-	int64_t l23 = 0xFFFF & logical_rshift(gte->controlRegisters[10], 16); // L23
-	int64_t l31 = 0xFFFF & gte->controlRegisters[11]; // L31
-	int64_t l32 = 0xFFFF & logical_rshift(gte->controlRegisters[11], 16); // L32
-	int64_t l33 = 0xFFFF & gte->controlRegisters[12]; // L33
-
-	// Sign extend light matrix values if needed
-	if ((l11 & 0x8000L) == 0x8000L)
-		l11 |= 0xFFFFFFFFFFFF0000L;
-	if ((l12 & 0x8000L) == 0x8000L)
-		l12 |= 0xFFFFFFFFFFFF0000L;
-	if ((l13 & 0x8000L) == 0x8000L)
-		l13 |= 0xFFFFFFFFFFFF0000L;
-	if ((l21 & 0x8000L) == 0x8000L)
-		l21 |= 0xFFFFFFFFFFFF0000L;
-	if ((l22 & 0x8000L) == 0x8000L)
-		l22 |= 0xFFFFFFFFFFFF0000L;
-	if ((l23 & 0x8000L) == 0x8000L)
-		l23 |= 0xFFFFFFFFFFFF0000L;
-	if ((l31 & 0x8000L) == 0x8000L)
-		l31 |= 0xFFFFFFFFFFFF0000L;
-	if ((l32 & 0x8000L) == 0x8000L)
-		l32 |= 0xFFFFFFFFFFFF0000L;
-	if ((l33 & 0x8000L) == 0x8000L)
-		l33 |= 0xFFFFFFFFFFFF0000L;
-
-	// Retrieve light colour matrix values
-	int64_t lr1 = 0xFFFF & gte->controlRegisters[16]; // LR1
-	int64_t lr2 = 0xFFFF & logical_rshift(gte->controlRegisters[16], 16); // LR2
-	int64_t lr3 = 0xFFFF & gte->controlRegisters[17]; // LR3
-	int64_t lg1 = 0xFFFF & logical_rshift(gte->controlRegisters[17], 16); // LG1
-	int64_t lg2 = 0xFFFF & gte->controlRegisters[18]; // LG2
-	int64_t lg3 = 0xFFFF & logical_rshift(gte->controlRegisters[18], 16); // LG3
-	int64_t lb1 = 0xFFFF & gte->controlRegisters[19]; // LB1
-	int64_t lb2 = 0xFFFF & logical_rshift(gte->controlRegisters[19], 16); // LB2
-	int64_t lb3 = 0xFFFF & gte->controlRegisters[20]; // LB3
-
-	// Sign extend light colour matrix values if needed
-	if ((lr1 & 0x8000L) == 0x8000L)
-		lr1 |= 0xFFFFFFFFFFFF0000L;
-	if ((lr2 & 0x8000L) == 0x8000L)
-		lr2 |= 0xFFFFFFFFFFFF0000L;
-	if ((lr3 & 0x8000L) == 0x8000L)
-		lr3 |= 0xFFFFFFFFFFFF0000L;
-	if ((lg1 & 0x8000L) == 0x8000L)
-		lg1 |= 0xFFFFFFFFFFFF0000L;
-	if ((lg2 & 0x8000L) == 0x8000L)
-		lg2 |= 0xFFFFFFFFFFFF0000L;
-	if ((lg3 & 0x8000L) == 0x8000L)
-		lg3 |= 0xFFFFFFFFFFFF0000L;
-	if ((lb1 & 0x8000L) == 0x8000L)
-		lb1 |= 0xFFFFFFFFFFFF0000L;
-	if ((lb2 & 0x8000L) == 0x8000L)
-		lb2 |= 0xFFFFFFFFFFFF0000L;
-	if ((lb3 & 0x8000L) == 0x8000L)
-		lb3 |= 0xFFFFFFFFFFFF0000L;
-
-	// Retrieve background colour values
-	int64_t rbk = 0xFFFFFFFFL & gte->controlRegisters[13]; // RBK
-	int64_t gbk = 0xFFFFFFFFL & gte->controlRegisters[14]; // GBK
-	int64_t bbk = 0xFFFFFFFFL & gte->controlRegisters[15]; // BBK
-
-	// Sign extend background colour values if needed
-	if ((rbk & 0x80000000L) == 0x80000000L)
-		rbk |= 0xFFFFFFFF00000000L;
-	if ((gbk & 0x80000000L) == 0x80000000L)
-		gbk |= 0xFFFFFFFF00000000L;
-	if ((bbk & 0x80000000L) == 0x80000000L)
-		bbk |= 0xFFFFFFFF00000000L;
-
-	// Retrieve RGBC values
-	int64_t r = 0xFF & gte->dataRegisters[6]; // R
-	int64_t g = 0xFF & logical_rshift(gte->dataRegisters[6], 8); // G
-	int64_t b = 0xFF & logical_rshift(gte->dataRegisters[6], 16); // B
-	int64_t code = 0xFF & logical_rshift(gte->dataRegisters[6], 24); // CODE
-
-	// Retrieve V0 values
-	int64_t vx0 = 0xFFFF & gte->dataRegisters[0]; // VX0
-	int64_t vy0 = 0xFFFF & logical_rshift(gte->dataRegisters[0], 16); // VY0
-	int64_t vz0 = 0xFFFF & gte->dataRegisters[1]; // VZ0
-
-	// Sign extend V0 values if necessary
-	if ((vx0 & 0x8000L) == 0x8000L)
-		vx0 |= 0xFFFFFFFFFFFF0000L;
-	if ((vy0 & 0x8000L) == 0x8000L)
-		vy0 |= 0xFFFFFFFFFFFF0000L;
-	if ((vz0 & 0x8000L) == 0x8000L)
-		vz0 |= 0xFFFFFFFFFFFF0000L;
-
-	// Perform first stage of calculation
-	int64_t mac1 = l11 * vx0 + l12 * vy0 + l13 * vz0;
-	int64_t mac2 = l21 * vx0 + l22 * vy0 + l23 * vz0;
-	int64_t mac3 = l31 * vx0 + l32 * vy0 + l33 * vz0;
-
-	// Shift right by (sf * 12) bits, preserving sign bit
-	mac1 = mac1 >> (sf * 12);
-	mac2 = mac2 >> (sf * 12);
-	mac3 = mac3 >> (sf * 12);
-
-	// Set flags and mask bits for MAC1, MAC2 and MAC3
-	if (mac1 > 0x80000000000L)
-		gte->controlRegisters[31] |= 0x40000000;
-	else if (mac1 < -0x80000000000L)
-		gte->controlRegisters[31] |= 0x8000000;
-
-	if (mac2 > 0x80000000000L)
-		gte->controlRegisters[31] |= 0x20000000;
-	else if (mac2 < -0x80000000000L)
-		gte->controlRegisters[31] |= 0x4000000;
+	if (mac2 > 0x80000000000L)
+		gte->controlRegisters[31] |= 0x20000000;
+	else if (mac2 < -0x80000000000L)
+		gte->controlRegisters[31] |= 0x4000000;
 
 	if (mac3 > 0x80000000000L)
 		gte->controlRegisters[31] |= 0x10000000;
@@ -3231,35 +2364,15 @@ static void Cop2_handleCC(Cop2 *gte, int32_t opcode)
 	int64_t code = 0xFF & logical_rshift(gte->dataRegisters[6], 24); // CODE
 
 	// Retrieve light colour matrix values
-	int64_t lr1 = 0xFFFF & gte->controlRegisters[16]; // LR1
-	int64_t lr2 = 0xFFFF & logical_rshift(gte->controlRegisters[16], 16); // LR2
-	int64_t lr3 = 0xFFFF & gte->controlRegisters[17]; // LR3
-	int64_t lg1 = 0xFFFF & logical_rshift(gte->controlRegisters[17], 16); // LG1
-	int64_t lg2 = 0xFFFF & gte->controlRegisters[18]; // LG2
-	int64_t lg3 = 0xFFFF & logical_rshift(gte->controlRegisters[18], 16); // LG3
-	int64_t lb1 = 0xFFFF & gte->controlRegisters[19]; // LB1
-	int64_t lb2 = 0xFFFF & logical_rshift(gte->controlRegisters[19], 16); // LB2
-	int64_t lb3 = 0xFFFF & gte->controlRegisters[20]; // LB3
-
-	// Sign extend light colour matrix values if needed
-	if ((lr1 & 0x8000L) == 0x8000L)
-		lr1 |= 0xFFFFFFFFFFFF0000L;
-	if ((lr2 & 0x8000L) == 0x8000L)
-		lr2 |= 0xFFFFFFFFFFFF0000L;
-	if ((lr3 & 0x8000L) == 0x8000L)
-		lr3 |= 0xFFFFFFFFFFFF0000L;
-	if ((lg1 & 0x8000L) == 0x8000L)
-		lg1 |= 0xFFFFFFFFFFFF0000L;
-	if ((lg2 & 0x8000L) == 0x8000L)
-		lg2 |= 0xFFFFFFFFFFFF0000L;
-	if ((lg3 & 0x8000L) == 0x8000L)
-		lg3 |= 0xFFFFFFFFFFFF0000L;
-	if ((lb1 & 0x8000L) == 0x8000L)
-		lb1 |= 0xFFFFFFFFFFFF0000L;
-	if ((lb2 & 0x8000L) == 0x8000L)
-		lb2 |= 0xFFFFFFFFFFFF0000L;
-	if ((lb3 & 0x8000L) == 0x8000L)
-		lb3 |= 0xFFFFFFFFFFFF0000L;
+	int64_t lr1 = gte->colourMatrix[0]; // LR1
+	int64_t lr2 = gte->colourMatrix[1]; // LR2
+	int64_t lr3 = gte->colourMatrix[2]; // LR3
+	int64_t lg1 = gte->colourMatrix[3]; // LG1
+	int64_t lg2 = gte->colourMatrix[4]; // LG2
+	int64_t lg3 = gte->colourMatrix[5]; // LG3
+	int64_t lb1 = gte->colourMatrix[6]; // LB1
+	int64_t lb2 = gte->colourMatrix[7]; // LB2
+	int64_t lb3 = gte->colourMatrix[8]; // LB3
 
 	// Perform first stage of calculation
 	int64_t mac1 = rbk * 0x1000 + lr1 * ir1 + lr2 * ir2 + lr3 * ir3;
@@ -3456,66 +2569,26 @@ static void Cop2_handleNCS(Cop2 *gte, int32_t opcode)
 	int32_t lm = (opcode & 0x400) == 0x400 ? 1 : 0;
 
 	// Retrieve light matrix values
-	int64_t l11 = 0xFFFF & gte->controlRegisters[8]; // L11
-	int64_t l12 = 0xFFFF & logical_rshift(gte->controlRegisters[8], 16); // L12
-	int64_t l13 = 0xFFFF & gte->controlRegisters[9]; // L13
-	int64_t l21 = 0xFFFF & logical_rshift(gte->controlRegisters[9], 16); // L21
-	int64_t l22 = 0xFFFF & gte->controlRegisters[10]; // L22
-	int64_t l23 = 0xFFFF & logical_rshift(gte->controlRegisters[10], 16); // L23
-	int64_t l31 = 0xFFFF & gte->controlRegisters[11]; // L31
-	int64_t l32 = 0xFFFF & logical_rshift(gte->controlRegisters[11], 16); // L32
-	int64_t l33 = 0xFFFF & gte->controlRegisters[12]; // L33
-
-	// Sign extend light matrix values if needed
-	if ((l11 & 0x8000L) == 0x8000L)
-		l11 |= 0xFFFFFFFFFFFF0000L;
-	if ((l12 & 0x8000L) == 0x8000L)
-		l12 |= 0xFFFFFFFFFFFF0000L;
-	if ((l13 & 0x8000L) == 0x8000L)
-		l13 |= 0xFFFFFFFFFFFF0000L;
-	if ((l21 & 0x8000L) == 0x8000L)
-		l21 |= 0xFFFFFFFFFFFF0000L;
-	if ((l22 & 0x8000L) == 0x8000L)
-		l22 |= 0xFFFFFFFFFFFF0000L;
-	if ((l23 & 0x8000L) == 0x8000L)
-		l23 |= 0xFFFFFFFFFFFF0000L;
-	if ((l31 & 0x8000L) == 0x8000L)
-		l31 |= 0xFFFFFFFFFFFF0000L;
-	if ((l32 & 0x8000L) == 0x8000L)
-		l32 |= 0xFFFFFFFFFFFF0000L;
-	if ((l33 & 0x8000L) == 0x8000L)
-		l33 |= 0xFFFFFFFFFFFF0000L;
+	int64_t l11 = gte->lightMatrix[0]; // L11
+	int64_t l12 = gte->lightMatrix[1]; // L12
+	int64_t l13 = gte->lightMatrix[2]; // L13
+	int64_t l21 = gte->lightMatrix[3]; // L21
+	int64_t l22 = gte->lightMatrix[4]; // L22
+	int64_t l23 = gte->lightMatrix[5]; // L23
+	int64_t l31 = gte->lightMatrix[6]; // L31
+	int64_t l32 = gte->lightMatrix[7]; // L32
+	int64_t l33 = gte->lightMatrix[8]; // L33
 
 	// Retrieve light colour matrix values
-	int64_t lr1 = 0xFFFF & gte->controlRegisters[16]; // LR1
-	int64_t lr2 = 0xFFFF & logical_rshift(gte->controlRegisters[16], 16); // LR2
-	int64_t lr3 = 0xFFFF & gte->controlRegisters[17]; // LR3
-	int64_t lg1 = 0xFFFF & logical_rshift(gte->controlRegisters[17], 16); // LG1
-	int64_t lg2 = 0xFFFF & gte->controlRegisters[18]; // LG2
-	int64_t lg3 = 0xFFFF & logical_rshift(gte->controlRegisters[18], 16); // LG3
-	int64_t lb1 = 0xFFFF & gte->controlRegisters[19]; // LB1
-	int64_t lb2 = 0xFFFF & logical_rshift(gte->controlRegisters[19], 16); // LB2
-	int64_t lb3 = 0xFFFF & gte->controlRegisters[20]; // LB3
-
-	// Sign extend light colour matrix values if needed
-	if ((lr1 & 0x8000L) == 0x8000L)
-		lr1 |= 0xFFFFFFFFFFFF0000L;
-	if ((lr2 & 0x8000L) == 0x8000L)
-		lr2 |= 0xFFFFFFFFFFFF0000L;
-	if ((lr3 & 0x8000L) == 0x8000L)
-		lr3 |= 0xFFFFFFFFFFFF0000L;
-	if ((lg1 & 0x8000L) == 0x8000L)
-		lg1 |= 0xFFFFFFFFFFFF0000L;
-	if ((lg2 & 0x8000L) == 0x8000L)
-		lg2 |= 0xFFFFFFFFFFFF0000L;
-	if ((lg3 & 0x8000L) == 0x8000L)
-		lg3 |= 0xFFFFFFFFFFFF0000L;
-	if ((lb1 & 0x8000L) == 0x8000L)
-		lb1 |= 0xFFFFFFFFFFFF0000L;
-	if ((lb2 & 0x8000L) == 0x8000L)
-		lb2 |= 0xFFFFFFFFFFFF0000L;
-	if ((lb3 & 0x8000L) == 0x8000L)
-		lb3 |= 0xFFFFFFFFFFFF0000L;
+	int64_t lr1 = gte->colourMatrix[0]; // LR1
+	int64_t lr2 = gte->colourMatrix[1]; // LR2
+	int64_t lr3 = gte->colourMatrix[2]; // LR3
+	int64_t lg1 = gte->colourMatrix[3]; // LG1
+	int64_t lg2 = gte->colourMatrix[4]; // LG2
+	int64_t lg3 = gte->colourMatrix[5]; // LG3
+	int64_t lb1 = gte->colourMatrix[6]; // LB1
+	int64_t lb2 = gte->colourMatrix[7]; // LB2
+	int64_t lb3 = gte->colourMatrix[8]; // LB3
 
 	// Retrieve background colour values
 	int64_t rbk = 0xFFFFFFFFL & gte->controlRegisters[13]; // RBK
@@ -3537,17 +2610,9 @@ static void Cop2_handleNCS(Cop2 *gte, int32_t opcode)
 	int64_t code = 0xFF & logical_rshift(gte->dataRegisters[6], 24); // CODE
 
 	// Retrieve V0 values
-	int64_t vx0 = 0xFFFF & gte->dataRegisters[0]; // VX0
-	int64_t vy0 = 0xFFFF & logical_rshift(gte->dataRegisters[0], 16); // VY0
-	int64_t vz0 = 0xFFFF & gte->dataRegisters[1]; // VZ0
-
-	// Sign extend V0 values if necessary
-	if ((vx0 & 0x8000L) == 0x8000L)
-		vx0 |= 0xFFFFFFFFFFFF0000L;
-	if ((vy0 & 0x8000L) == 0x8000L)
-		vy0 |= 0xFFFFFFFFFFFF0000L;
-	if ((vz0 & 0x8000L) == 0x8000L)
-		vz0 |= 0xFFFFFFFFFFFF0000L;
+	int64_t vx0 = gte->vectors[0]; // VX0
+	int64_t vy0 = gte->vectors[1]; // VY0
+	int64_t vz0 = gte->vectors[2]; // VZ0
 
 	// Perform first stage of calculation
 	int64_t mac1 = l11 * vx0 + l12 * vy0 + l13 * vz0;
@@ -3727,66 +2792,26 @@ static void Cop2_handleNCT(Cop2 *gte, int32_t opcode)
 	int32_t lm = (opcode & 0x400) == 0x400 ? 1 : 0;
 
 	// Retrieve light matrix values
-	int64_t l11 = 0xFFFF & gte->controlRegisters[8]; // L11
-	int64_t l12 = 0xFFFF & logical_rshift(gte->controlRegisters[8], 16); // L12
-	int64_t l13 = 0xFFFF & gte->controlRegisters[9]; // L13
-	int64_t l21 = 0xFFFF & logical_rshift(gte->controlRegisters[9], 16); // L21
-	int64_t l22 = 0xFFFF & gte->controlRegisters[10]; // L22
-	int64_t l23 = 0xFFFF & logical_rshift(gte->controlRegisters[10], 16); // L23
-	int64_t l31 = 0xFFFF & gte->controlRegisters[11]; // L31
-	int64_t l32 = 0xFFFF & logical_rshift(gte->controlRegisters[11], 16); // L32
-	int64_t l33 = 0xFFFF & gte->controlRegisters[12]; // L33
-
-	// Sign extend light matrix values if needed
-	if ((l11 & 0x8000L) == 0x8000L)
-		l11 |= 0xFFFFFFFFFFFF0000L;
-	if ((l12 & 0x8000L) == 0x8000L)
-		l12 |= 0xFFFFFFFFFFFF0000L;
-	if ((l13 & 0x8000L) == 0x8000L)
-		l13 |= 0xFFFFFFFFFFFF0000L;
-	if ((l21 & 0x8000L) == 0x8000L)
-		l21 |= 0xFFFFFFFFFFFF0000L;
-	if ((l22 & 0x8000L) == 0x8000L)
-		l22 |= 0xFFFFFFFFFFFF0000L;
-	if ((l23 & 0x8000L) == 0x8000L)
-		l23 |= 0xFFFFFFFFFFFF0000L;
-	if ((l31 & 0x8000L) == 0x8000L)
-		l31 |= 0xFFFFFFFFFFFF0000L;
-	if ((l32 & 0x8000L) == 0x8000L)
-		l32 |= 0xFFFFFFFFFFFF0000L;
-	if ((l33 & 0x8000L) == 0x8000L)
-		l33 |= 0xFFFFFFFFFFFF0000L;
+	int64_t l11 = gte->lightMatrix[0]; // L11
+	int64_t l12 = gte->lightMatrix[1]; // L12
+	int64_t l13 = gte->lightMatrix[2]; // L13
+	int64_t l21 = gte->lightMatrix[3]; // L21
+	int64_t l22 = gte->lightMatrix[4]; // L22
+	int64_t l23 = gte->lightMatrix[5]; // L23
+	int64_t l31 = gte->lightMatrix[6]; // L31
+	int64_t l32 = gte->lightMatrix[7]; // L32
+	int64_t l33 = gte->lightMatrix[8]; // L33
 
 	// Retrieve light colour matrix values
-	int64_t lr1 = 0xFFFF & gte->controlRegisters[16]; // LR1
-	int64_t lr2 = 0xFFFF & logical_rshift(gte->controlRegisters[16], 16); // LR2
-	int64_t lr3 = 0xFFFF & gte->controlRegisters[17]; // LR3
-	int64_t lg1 = 0xFFFF & logical_rshift(gte->controlRegisters[17], 16); // LG1
-	int64_t lg2 = 0xFFFF & gte->controlRegisters[18]; // LG2
-	int64_t lg3 = 0xFFFF & logical_rshift(gte->controlRegisters[18], 16); // LG3
-	int64_t lb1 = 0xFFFF & gte->controlRegisters[19]; // LB1
-	int64_t lb2 = 0xFFFF & logical_rshift(gte->controlRegisters[19], 16); // LB2
-	int64_t lb3 = 0xFFFF & gte->controlRegisters[20]; // LB3
-
-	// Sign extend light colour matrix values if needed
-	if ((lr1 & 0x8000L) == 0x8000L)
-		lr1 |= 0xFFFFFFFFFFFF0000L;
-	if ((lr2 & 0x8000L) == 0x8000L)
-		lr2 |= 0xFFFFFFFFFFFF0000L;
-	if ((lr3 & 0x8000L) == 0x8000L)
-		lr3 |= 0xFFFFFFFFFFFF0000L;
-	if ((lg1 & 0x8000L) == 0x8000L)
-		lg1 |= 0xFFFFFFFFFFFF0000L;
-	if ((lg2 & 0x8000L) == 0x8000L)
-		lg2 |= 0xFFFFFFFFFFFF0000L;
-	if ((lg3 & 0x8000L) == 0x8000L)
-		lg3 |= 0xFFFFFFFFFFFF0000L;
-	if ((lb1 & 0x8000L) == 0x8000L)
-		lb1 |= 0xFFFFFFFFFFFF0000L;
-	if ((lb2 & 0x8000L) == 0x8000L)
-		lb2 |= 0xFFFFFFFFFFFF0000L;
-	if ((lb3 & 0x8000L) == 0x8000L)
-		lb3 |= 0xFFFFFFFFFFFF0000L;
+	int64_t lr1 = gte->colourMatrix[0]; // LR1
+	int64_t lr2 = gte->colourMatrix[1]; // LR2
+	int64_t lr3 = gte->colourMatrix[2]; // LR3
+	int64_t lg1 = gte->colourMatrix[3]; // LG1
+	int64_t lg2 = gte->colourMatrix[4]; // LG2
+	int64_t lg3 = gte->colourMatrix[5]; // LG3
+	int64_t lb1 = gte->colourMatrix[6]; // LB1
+	int64_t lb2 = gte->colourMatrix[7]; // LB2
+	int64_t lb3 = gte->colourMatrix[8]; // LB3
 
 	// Retrieve background colour values
 	int64_t rbk = 0xFFFFFFFFL & gte->controlRegisters[13]; // RBK
@@ -3810,48 +2835,13 @@ static void Cop2_handleNCT(Cop2 *gte, int32_t opcode)
 	// Repeat function three times, using V0, V1 and V2
 	for (int32_t i = 0; i < 3; ++i) {
 
-		// Clear flag register
-		gte->controlRegisters[31] = 0;
-
-		// Retrieve Vx values
-		int64_t vxAny = 0, vyAny = 0, vzAny = 0;
-		switch (i) {
-			case 0:
-				vxAny =
-					0xFFFF & gte->dataRegisters[0]; // VX0
-				vyAny =
-					0xFFFF & logical_rshift(gte->dataRegisters[0], 16); // VY0
-				vzAny =
-					0xFFFF & gte->dataRegisters[1]; // VZ0
-				break;
-			case 1:
-				vxAny =
-					0xFFFF & gte->dataRegisters[2]; // VX1
-				vyAny =
-					0xFFFF & logical_rshift(gte->dataRegisters[2], 16); // VY1
-				vzAny =
-					0xFFFF & gte->dataRegisters[3]; // VZ1
-				break;
-			case 2:
-				vxAny =
-					0xFFFF & gte->dataRegisters[4]; // VX2
-				vyAny =
-					0xFFFF & logical_rshift(gte->dataRegisters[4], 16); // VY2
-				vzAny =
-					0xFFFF & gte->dataRegisters[5]; // VZ2
-				break;
-		}
+		// Clear flag register
+		gte->controlRegisters[31] = 0;
 
-		// Sign extend Vx values if necessary
-		if ((vxAny & 0x8000L) == 0x8000L) {
-			vxAny |= 0xFFFFFFFFFFFF0000L;
-		}
-		if ((vyAny & 0x8000L) == 0x8000L) {
-			vyAny |= 0xFFFFFFFFFFFF0000L;
-		}
-		if ((vzAny & 0x8000L) == 0x8000L) {
-			vzAny |= 0xFFFFFFFFFFFF0000L;
-		}
+		// Retrieve Vx values
+		int64_t vxAny = gte->vectors[i * 3]; // VXi
+		int64_t vyAny = gte->vectors[i * 3 + 1]; // VYi
+		int64_t vzAny = gte->vectors[i * 3 + 2]; // VZi
 
 		// Perform first stage of calculation
 		int64_t mac1 = l11 * vxAny + l12 * vyAny + l13 * vzAny;
@@ -4315,221 +3305,12 @@ static void Cop2_handleDPCT(Cop2 *gte, int32_t opcode)
 	// Filter out lm bit
 	int32_t lm = (opcode & 0x400) == 0x400 ? 1 : 0;
 
-	// Retrieve IR0 value and define IR1, IR2 and IR3
-	int64_t ir0 = 0xFFFF & gte->dataRegisters[8]; // IR0
-
-	// Sign extend IR0 value
-	if ((ir0 & 0x8000L) == 0x8000L)
-		ir0 |= 0xFFFFFFFFFFFF0000L;
-
-	// Retrieve far colour values
-	int64_t rfc = 0xFFFFFFFFL & gte->controlRegisters[21];
-	int64_t gfc = 0xFFFFFFFFL & gte->controlRegisters[22];
-	int64_t bfc = 0xFFFFFFFFL & gte->controlRegisters[23];
-
-	// Sign extend far colour values
-	if ((rfc & 0x80000000L) == 0x80000000L)
-		rfc |= 0xFFFFFFFF00000000L;
-	if ((gfc & 0x80000000L) == 0x80000000L)
-		gfc |= 0xFFFFFFFF00000000L;
-	if ((bfc & 0x80000000L) == 0x80000000L)
-		bfc |= 0xFFFFFFFF00000000L;
-
-	// Repeat calculation three times
-	for (int32_t i = 0; i < 3; ++i) {
-
-		// Clear flag register
-		gte->controlRegisters[31] = 0;
-
-		// Retrieve CODE value from RGBC and RGB values from RGB0
-		int64_t r = 0xFF & gte->dataRegisters[20]; // R0
-		int64_t g = 0xFF & logical_rshift(gte->dataRegisters[20], 8); // G0
-		int64_t b = 0xFF & logical_rshift(gte->dataRegisters[20], 16); // B0
-		int64_t code = 0xFF & logical_rshift(gte->dataRegisters[6], 24); // CODE
-
-		// Perform DPCT-only calculation
-		int64_t mac1 = r << 16;
-		int64_t mac2 = g << 16;
-		int64_t mac3 = b << 16;
-
-		// Check for and set MAC1, MAC2 and MAC3 flags if needed
-		if (mac1 > 0x80000000000L) {
-			gte->controlRegisters[31] |= 0x40000000;
-		} else if (mac1 < -0x80000000000L) {
-			gte->controlRegisters[31] |= 0x8000000;
-		}
-
-		if (mac2 > 0x80000000000L) {
-			gte->controlRegisters[31] |= 0x20000000;
-		} else if (mac2 < -0x80000000000L) {
-			gte->controlRegisters[31] |= 0x4000000;
-		}
-
-		if (mac3 > 0x80000000000L) {
-			gte->controlRegisters[31] |= 0x10000000;
-		} else if (mac3 < -0x80000000000L) {
-			gte->controlRegisters[31] |= 0x2000000;
-		}
-
-		// Perform first common stage of calculation
-		int64_t ir1 = 0, ir2 = 0, ir3 = 0;
-		ir1 = ((rfc << 12) - mac1) >> (sf * 12);
-		ir2 = ((gfc << 12) - mac2) >> (sf * 12);
-		ir3 = ((bfc << 12) - mac3) >> (sf * 12);
-
-		// Saturate IR1, IR2 and IR3 results, setting flags as needed
-		if (ir1 > 0x7FFFL) {
-			ir1 = 0x7FFFL;
-			gte->controlRegisters[31] |= 0x1000000;
-		} else if (ir1 < -0x8000L) {
-			ir1 = -0x8000L;
-			gte->controlRegisters[31] |= 0x1000000;
-		}
-
-		if (ir2 > 0x7FFFL) {
-			ir2 = 0x7FFFL;
-			gte->controlRegisters[31] |= 0x800000;
-		} else if (ir2 < -0x8000L) {
-			ir2 = -0x8000L;
-			gte->controlRegisters[31] |= 0x800000;
-		}
-
-		if (ir3 > 0x7FFFL) {
-			ir3 = 0x7FFFL;
-			gte->controlRegisters[31] |= 0x400000;
-		} else if (ir3 < -0x8000L) {
-			ir3 = -0x8000L;
-			gte->controlRegisters[31] |= 0x400000;
-		}
-
-		// Continue first common stage of calculation
-		mac1 = ir1 * ir0 + mac1;
-		mac2 = ir2 * ir0 + mac2;
-		mac3 = ir3 * ir0 + mac3;
-
-		// Check for MAC1, MAC2 and MAC3 flags again and set accordingly
-		if (mac1 > 0x80000000000L) {
-			gte->controlRegisters[31] |= 0x40000000;
-		} else if (mac1 < -0x80000000000L) {
-			gte->controlRegisters[31] |= 0x8000000;
-		}
-
-		if (mac2 > 0x80000000000L) {
-			gte->controlRegisters[31] |= 0x20000000;
-		} else if (mac2 < -0x80000000000L) {
-			gte->controlRegisters[31] |= 0x4000000;
-		}
-
-		if (mac3 > 0x80000000000L) {
-			gte->controlRegisters[31] |= 0x10000000;
-		} else if (mac3 < -0x80000000000L) {
-			gte->controlRegisters[31] |= 0x2000000;
-		}
-
-		// Shift MAC1, MAC2 and MAC3 by (sf * 12) bits, preserving sign bit
-		mac1 = mac1 >> (sf * 12);
-		mac2 = mac2 >> (sf * 12);
-		mac3 = mac3 >> (sf * 12);
-
-		// Check for MAC1, MAC2 and MAC3 flags again and set accordingly
-		if (mac1 > 0x80000000000L) {
-			gte->controlRegisters[31] |= 0x40000000;
-		} else if (mac1 < -0x80000000000L) {
-			gte->controlRegisters[31] |= 0x8000000;
-		}
-
-		if (mac2 > 0x80000000000L) {
-			gte->controlRegisters[31] |= 0x20000000;
-		} else if (mac2 < -0x80000000000L) {
-			gte->controlRegisters[31] |= 0x4000000;
-		}
-
-		if (mac3 > 0x80000000000L) {
-			gte->controlRegisters[31] |= 0x10000000;
-		} else if (mac3 < -0x80000000000L) {
-			gte->controlRegisters[31] |= 0x2000000;
-		}
-
-		// Store MAC1, MAC2 and MAC3 to IR1, IR2 and IR3
-		int64_t lowerBound = (lm == 1) ? 0 : -0x8000L;
-		if (mac1 > 0x7FFFL) {
-			ir1 = 0x7FFFL;
-			gte->controlRegisters[31] |= 0x1000000;
-		} else if (mac1 < lowerBound) {
-			ir1 = lowerBound;
-			gte->controlRegisters[31] |= 0x1000000;
-		} else {
-			ir1 = mac1;
-		}
-
-		if (mac2 > 0x7FFFL) {
-			ir2 = 0x7FFFL;
-			gte->controlRegisters[31] |= 0x800000;
-		} else if (mac2 < lowerBound) {
-			ir2 = lowerBound;
-			gte->controlRegisters[31] |= 0x800000;
-		} else {
-			ir2 = mac2;
-		}
-
-		if (mac3 > 0x7FFFL) {
-			ir3 = 0x7FFFL;
-			gte->controlRegisters[31] |= 0x400000;
-		} else if (mac3 < lowerBound) {
-			ir3 = lowerBound;
-			gte->controlRegisters[31] |= 0x400000;
-		} else {
-			ir3 = mac3;
-		}
-
-		// Generate colour FIFO values and check/set flags as needed
-		int64_t rOut = mac1 / 16;
-		int64_t gOut = mac2 / 16;
-		int64_t bOut = mac3 / 16;
-
-		if (rOut < 0) {
-			rOut = 0;
-			gte->controlRegisters[31] |= 0x200000;
-		} else if (rOut > 0xFF) {
-			rOut = 0xFF;
-			gte->controlRegisters[31] |= 0x200000;
-		}
-
-		if (gOut < 0) {
-			gOut = 0;
-			gte->controlRegisters[31] |= 0x100000;
-		} else if (gOut > 0xFF) {
-			gOut = 0xFF;
-			gte->controlRegisters[31] |= 0x100000;
-		}
-
-		if (bOut < 0) {
-			bOut = 0;
-			gte->controlRegisters[31] |= 0x80000;
-		} else if (bOut > 0xFF) {
-			bOut = 0xFF;
-			gte->controlRegisters[31] |= 0x80000;
-		}
-
-		// Calculate bit 31 of flag register
-		if ((gte->controlRegisters[31] & 0x7F87E000) != 0) {
-			gte->controlRegisters[31] |= 0x80000000;
-		}
-
-		// Store values back to registers
-		gte->dataRegisters[25] = (int32_t)mac1; // MAC1
-		gte->dataRegisters[26] = (int32_t)mac2; // MAC2
-		gte->dataRegisters[27] = (int32_t)mac3; // MAC3
-
-		gte->dataRegisters[9] = (int32_t)ir1; // IR1
-		gte->dataRegisters[10] = (int32_t)ir2; // IR2
-		gte->dataRegisters[11] = (int32_t)ir3; // IR3
-
-		gte->dataRegisters[20] = gte->dataRegisters[21]; // RGB1 to RGB0
-		gte->dataRegisters[21] = gte->dataRegisters[22]; // RGB2 to RGB1
-		gte->dataRegisters[22] =
-			(int32_t)((code << 24) | (bOut << 16) | (gOut << 8) | rOut); // RGB2
-	}
+	// Perform calculation for RGB0, RGB1 and RGB2 in one go, as each one
+	// reaches RGB0 before being used, then store results
+	GteResult results[3];
+	gte->kernels->depthCueColours(gte->controlRegisters, gte->dataRegisters,
+			sf, (lm == 1) ? 0 : -0x8000L, results);
+	Cop2_storeColourResults(gte, results);
 }
 
 /*
@@ -4631,221 +3412,41 @@ static void Cop2_handleRTPT(Cop2 *gte, int32_t opcode)
 	// Filter out sf bit
 	int32_t sf = (opcode & 0x80000) == 0x80000 ? 1 : 0;
 
-	// Filter out lm bit
-	int32_t lm = (opcode & 0x400) == 0x400 ? 1 : 0;
-
-	// Retrieve rotation matrix values
-	int64_t rt11 =
-			0xFFFF & gte->controlRegisters[0]; // RT11
-	int64_t rt12 =
-			0xFFFF & logical_rshift(gte->controlRegisters[0], 16); // RT12
-	int64_t rt13 =
-			0xFFFF & gte->controlRegisters[1]; // RT13
-	int64_t rt21 =
-			0xFFFF & logical_rshift(gte->controlRegisters[1], 16); // RT21
-	int64_t rt22 =
-			0xFFFF & gte->controlRegisters[2]; // RT22
-	int64_t rt23 =
-			0xFFFF & logical_rshift(gte->controlRegisters[2], 16); // RT23
-	int64_t rt31 =
-			0xFFFF & gte->controlRegisters[3]; // RT31
-	int64_t rt32 =
-			0xFFFF & logical_rshift(gte->controlRegisters[3], 16); // RT32
-	int64_t rt33 =
-			0xFFFF & gte->controlRegisters[4]; // RT33
-
-	// Sign extend rotation matrix values if necessary
-	if ((rt11 & 0x8000L) == 0x8000L)
-		rt11 |= 0xFFFFFFFFFFFF0000L;
-	if ((rt12 & 0x8000L) == 0x8000L)
-		rt12 |= 0xFFFFFFFFFFFF0000L;
-	if ((rt13 & 0x8000L) == 0x8000L)
-		rt13 |= 0xFFFFFFFFFFFF0000L;
-	if ((rt21 & 0x8000L) == 0x8000L)
-		rt21 |= 0xFFFFFFFFFFFF0000L;
-	if ((rt22 & 0x8000L) == 0x8000L)
-		rt22 |= 0xFFFFFFFFFFFF0000L;
-	if ((rt23 & 0x8000L) == 0x8000L)
-		rt23 |= 0xFFFFFFFFFFFF0000L;
-	if ((rt31 & 0x8000L) == 0x8000L)
-		rt31 |= 0xFFFFFFFFFFFF0000L;
-	if ((rt32 & 0x8000L) == 0x8000L)
-		rt32 |= 0xFFFFFFFFFFFF0000L;
-	if ((rt33 & 0x8000L) == 0x8000L)
-		rt33 |= 0xFFFFFFFFFFFF0000L;
-
-	// Retrieve translation vector values
-	int64_t trX = 0xFFFFFFFFL & gte->controlRegisters[5]; // TRX
-	int64_t trY = 0xFFFFFFFFL & gte->controlRegisters[6]; // TRY
-	int64_t trZ = 0xFFFFFFFFL & gte->controlRegisters[7]; // TRZ
-
-	// Sign extend translation vector values if necessary
-	if ((trX & 0x80000000L) == 0x80000000L)
-		trX |= 0xFFFFFFFF00000000L;
-	if ((trY & 0x80000000L) == 0x80000000L)
-		trY |= 0xFFFFFFFF00000000L;
-	if ((trZ & 0x80000000L) == 0x80000000L)
-		trZ |= 0xFFFFFFFF00000000L;
+	// Transform V0, V1 and V2 by the rotation matrix and translation vector
+	// up front, as the rest of the calculation doesn't feed back into them
+	// (saturation should be -0x8000..0x7FFF, regardless of lm bit)
+	GteResult transformed[3];
+	gte->kernels->transformVertices(gte->rotationMatrix, gte->vectors,
+			gte->controlRegisters + 5, sf, transformed);
 
 	// Retrieve offset and distance values
 	int64_t ofx = 0xFFFFFFFFL & gte->controlRegisters[24];
-	int64_t ofy = 0xFFFFFFFFL & gte->controlRegisters[25];
-	int64_t h = 0xFFFF & gte->controlRegisters[26];
-	int64_t dqa = 0xFFFF & gte->controlRegisters[27];
-	int64_t dqb = 0xFFFFFFFFL & gte->controlRegisters[28];
-
-	// Sign extend signed values if needed
-	if ((ofx & 0x80000000L) == 0x80000000L)
-		ofx |= 0xFFFFFFFF00000000L;
-	if ((ofy & 0x80000000L) == 0x80000000L)
-		ofy |= 0xFFFFFFFF00000000L;
-	if ((dqa & 0x8000L) == 0x8000L)
-		dqa |= 0xFFFFFFFFFFFF0000L;
-	if ((dqb & 0x80000000L) == 0x80000000L)
-		dqb |= 0xFFFFFFFF00000000L;
-
-	// Do calculation three times, using a different vector
-	// with each iteration
-	for (int32_t i = 0; i < 3; ++i) {
-
-		// Clear flag register
-		gte->controlRegisters[31] = 0;
-
-		// Retrieve correct vector values
-		int64_t vxAny = 0, vyAny = 0, vzAny = 0;
-
-		switch (i) {
-			case 0:
-				vxAny =
-					0xFFFF & gte->dataRegisters[0]; // VX0
-				vyAny =
-					0xFFFF & logical_rshift(gte->dataRegisters[0], 16); // VY0
-				vzAny =
-					0xFFFF & gte->dataRegisters[1]; // VZ0
-				break;
-			case 1:
-				vxAny =
-					0xFFFF & gte->dataRegisters[2]; // VX1
-				vyAny =
-					0xFFFF & logical_rshift(gte->dataRegisters[2], 16); // VY1
-				vzAny =
-					0xFFFF & gte->dataRegisters[3]; // VZ1
-				break;
-			case 2:
-				vxAny =
-					0xFFFF & gte->dataRegisters[4]; // VX2
-				vyAny =
-					0xFFFF & logical_rshift(gte->dataRegisters[4], 16); // VY2
-				vzAny =
-					0xFFFF & gte->dataRegisters[5]; // VZ2
-				break;
-		}
-
-
-		// Sign extend vector values if necessary
-		if ((vxAny & 0x8000L) == 0x8000L) {
-			vxAny |= 0xFFFFFFFFFFFF0000L;
-		}
-		if ((vyAny & 0x8000L) == 0x8000L) {
-			vyAny |= 0xFFFFFFFFFFFF0000L;
-		}
-		if ((vzAny & 0x8000L) == 0x8000L) {
-			vzAny |= 0xFFFFFFFFFFFF0000L;
-		}
-
-		// Perform first stage of calculations
-		int64_t mac1 =
-				trX * 0x1000 + rt11 * vxAny + rt12 * vyAny + rt13 * vzAny;
-		int64_t mac2 =
-				trY * 0x1000 + rt21 * vxAny + rt22 * vyAny + rt23 * vzAny;
-		int64_t mac3 =
-				trZ * 0x1000 + rt31 * vxAny + rt32 * vyAny + rt33 * vzAny;
-
-		// Shift all three results by (sf * 12), preserving sign bit
-		mac1 = mac1 >> (sf * 12);
-		mac2 = mac2 >> (sf * 12);
-		mac3 = mac3 >> (sf * 12);
-
-		// Set MAC1, MAC2 and MAC3 flags as needed
-		// MAC1
-		if (mac1 > 0x80000000000L) {
-			gte->controlRegisters[31] |= 0x40000000;
-		} else if (mac1 < -0x80000000000L) {
-			gte->controlRegisters[31] |= 0x8000000;
-		}
-
-		// MAC2
-		if (mac2 > 0x80000000000L) {
-			gte->controlRegisters[31] |= 0x20000000;
-		} else if (mac2 < -0x80000000000L) {
-			gte->controlRegisters[31] |= 0x4000000;
-		}
-
-		// MAC3
-		if (mac3 > 0x80000000000L) {
-			gte->controlRegisters[31] |= 0x10000000;
-		} else if (mac3 < -0x80000000000L) {
-			gte->controlRegisters[31] |= 0x2000000;
-		}
+	int64_t ofy = 0xFFFFFFFFL & gte->controlRegisters[25];
+	int64_t h = 0xFFFF & gte->controlRegisters[26];
+	int64_t dqa = 0xFFFF & gte->controlRegisters[27];
+	int64_t dqb = 0xFFFFFFFFL & gte->controlRegisters[28];
 
-		// Set IR1, IR2 and IR3 - dealing with flags too
-		// saturation should be -0x8000..0x7FFF, regardless of lm bit
-		// IR1
-		int64_t ir1 = 0, ir2 = 0, ir3 = 0;
-		if (mac1 < -0x8000) {
-			ir1 = -0x8000;
-			gte->controlRegisters[31] |= 0x1000000;
-		} else if (mac1 > 0x7FFF) {
-			ir1 = 0x7FFF;
-			gte->controlRegisters[31] |= 0x1000000;
-		} else {
-			ir1 = (int32_t)mac1;
-		}
+	// Sign extend signed values if needed
+	if ((ofx & 0x80000000L) == 0x80000000L)
+		ofx |= 0xFFFFFFFF00000000L;
+	if ((ofy & 0x80000000L) == 0x80000000L)
+		ofy |= 0xFFFFFFFF00000000L;
+	if ((dqa & 0x8000L) == 0x8000L)
+		dqa |= 0xFFFFFFFFFFFF0000L;
+	if ((dqb & 0x80000000L) == 0x80000000L)
+		dqb |= 0xFFFFFFFF00000000L;
 
-		// IR2
-		if (mac2 < -0x8000) {
-			ir2 = -0x8000;
-			gte->controlRegisters[31] |= 0x800000;
-		} else if (mac2 > 0x7FFF) {
-			ir2 = 0x7FFF;
-			gte->controlRegisters[31] |= 0x800000;
-		} else {
-			ir2 = (int32_t)mac2;
-		}
+	// Do calculation three times, using a different vector
+	// with each iteration
+	for (int32_t i = 0; i < 3; ++i) {
 
-		// IR3
-		if (mac3 < -0x8000) {
-			ir3 = -0x8000;
-
-			// Deal with quirk in IR3 flag handling
-			if (sf == 0) {
-				uint64_t u_mac3 = (uint64_t)mac3;
-				bool needsSignExtension = (u_mac3 & 0x8000000000000000UL) ==
-											0x8000000000000000UL;
-				int64_t temp = u_mac3 >> 12;
-				if (needsSignExtension)
-					temp |= 0xFFF0000000000000UL;
-				if (temp > 0x7FFF || temp < -0x8000) {
-					gte->controlRegisters[31] |= 0x400000;
-				}
-			} else {
-				gte->controlRegisters[31] |= 0x400000;
-			}
-		} else if (mac3 > 0x7FFF) {
-			ir3 = 0x7FFF;
-
-			// Deal with quirk in IR3 flag handling
-			if (sf == 0) {
-				int64_t temp = mac3 >> 12;
-				if (temp > 0x7FFF || temp < -0x8000) {
-					gte->controlRegisters[31] |= 0x400000;
-				}
-			} else {
-				gte->controlRegisters[31] |= 0x400000;
-			}
-		} else {
-			ir3 = (int32_t)mac3;
-		}
+		// Start with results from first stage of calculations
+		int64_t mac1 = transformed[i].mac[0];
+		int64_t mac2 = transformed[i].mac[1];
+		int64_t mac3 = transformed[i].mac[2];
+		int64_t ir1 = transformed[i].ir[0];
+		int64_t ir2 = transformed[i].ir[1];
+		int64_t ir3 = transformed[i].ir[2];
 
 		// Write back to real registers
 		gte->dataRegisters[25] = (int32_t)mac1; // MAC1
@@ -4855,30 +3456,22 @@ static void Cop2_handleRTPT(Cop2 *gte, int32_t opcode)
 		gte->dataRegisters[10] = (int32_t)ir2; // IR2
 		gte->dataRegisters[11] = (int32_t)ir3; // IR3
 
-		// Calculate SZ3 and move FIFO along, also setting SZ3 flag if needed
+		// Calculate SZ3 and move FIFO along
 		gte->dataRegisters[16] = gte->dataRegisters[17]; // SZ1 to SZ0
 		gte->dataRegisters[17] = gte->dataRegisters[18]; // SZ2 to SZ1
 		gte->dataRegisters[18] = gte->dataRegisters[19]; // SZ3 to SZ2
-		uint64_t u_mac3 = (uint64_t)mac3;
-		bool needsSignExtension = (u_mac3 & 0x8000000000000000UL) ==
-									0x8000000000000000UL;
-		int32_t shiftBy = (1 - sf) * 12;
-		int64_t temp_sz3 = u_mac3 >> shiftBy;
-		if (needsSignExtension && shiftBy == 12)
-			temp_sz3 |= 0xFFF0000000000000UL;
-		if (temp_sz3 < 0) {
+		int64_t temp_sz3 = mac3 >> ((1 - sf) * 12);
+		if (temp_sz3 < 0)
 			temp_sz3 = 0;
-			gte->controlRegisters[31] |= 0x40000;
-		} else if (temp_sz3 > 0xFFFF) {
+		else if (temp_sz3 > 0xFFFF)
 			temp_sz3 = 0xFFFF;
-			gte->controlRegisters[31] |= 0x40000;
-		}
 		gte->dataRegisters[19] = (int32_t)temp_sz3;
 
 		// Begin second phase of calculations - use Unsigned Newton-Raphson
 		// division algorithm from NOPSX documentation
 		int64_t mac0 = 0, sx2 = 0, sy2 = 0, ir0 = 0;
 		int64_t divisionResult = 0;
+		gte->pendingFlags = 0;
 		if (h < temp_sz3 * 2) {
 
 			// Count leading zeroes in SZ3
@@ -4903,65 +3496,32 @@ static void Cop2_handleRTPT(Cop2 *gte, int32_t opcode)
 
 		} else {
 			divisionResult = 0x1FFFFL;
-			gte->controlRegisters[31] |= 0x20000;
+			gte->pendingFlags = 0x20000;
 		}
 
-		// Use division result and set MAC0 flags if needed
-		mac0 = divisionResult * ir1 + ofx;
-		if (mac0 > 0x80000000L) {
-			gte->controlRegisters[31] |= 0x10000;
-		} else if (mac0 < -0x80000000L) {
-			gte->controlRegisters[31] |= 0x8000;
-		}
-		mac0 &= 0xFFFFFFFFL;
-		if ((mac0 & 0x80000000L) == 0x80000000L)
-			mac0 |= 0xFFFFFFFF00000000L;
-		sx2 = mac0 / 0x10000;
-		mac0 = divisionResult * ir2 + ofy;
-		if (mac0 > 0x80000000L) {
-			gte->controlRegisters[31] |= 0x10000;
-		} else if (mac0 < -0x80000000L) {
-			gte->controlRegisters[31] |= 0x8000;
-		}
-		mac0 &= 0xFFFFFFFFL;
-		if ((mac0 & 0x80000000L) == 0x80000000L)
-			mac0 |= 0xFFFFFFFF00000000L;
-		sy2 = mac0 / 0x10000;
-		mac0 = divisionResult * dqa + dqb;
-		if (mac0 > 0x80000000L) {
-			gte->controlRegisters[31] |= 0x10000;
-		} else if (mac0 < -0x80000000L) {
-			gte->controlRegisters[31] |= 0x8000;
-		}
-		mac0 &= 0xFFFFFFFFL;
-		if ((mac0 & 0x80000000L) == 0x80000000L)
-			mac0 |= 0xFFFFFFFF00000000L;
+		// Use division result, keeping the untruncated MAC0 values for the
+		// flags (only the last vector's survive)
+		gte->pendingMac0[0] = divisionResult * ir1 + ofx;
+		gte->pendingMac0[1] = divisionResult * ir2 + ofy;
+		gte->pendingMac0[2] = divisionResult * dqa + dqb;
+		sx2 = (int32_t)gte->pendingMac0[0] / 0x10000;
+		sy2 = (int32_t)gte->pendingMac0[1] / 0x10000;
+		mac0 = (int32_t)gte->pendingMac0[2];
 		ir0 = mac0 / 0x1000;
 
-		// Adjust results for saturation and set flags if needed
-		if (sx2 > 0x3FFL) {
+		// Adjust results for saturation
+		if (sx2 > 0x3FFL)
 			sx2 = 0x3FFL;
-			gte->controlRegisters[31] |= 0x4000;
-		} else if (sx2 < -0x400) {
+		else if (sx2 < -0x400)
 			sx2 = -0x400;
-			gte->controlRegisters[31] |= 0x4000;
-		}
-
-		if (sy2 > 0x3FFL) {
+		if (sy2 > 0x3FFL)
 			sy2 = 0x3FFL;
-			gte->controlRegisters[31] |= 0x2000;
-		} else if (sy2 < -0x400) {
+		else if (sy2 < -0x400)
 			sy2 = -0x400;
-			gte->controlRegisters[31] |= 0x2000;
-		}
-
-		if (ir0 < 0) {
+		if (ir0 < 0)
 			ir0 = 0;
-			gte->controlRegisters[31] |= 0x1000;
-		} else if (ir0 > 0x1000) {
+		else if (ir0 > 0x1000)
 			ir0 = 0x1000;
-			gte->controlRegisters[31] |= 0x1000;
-		}
 
 		// Store values back to correct registers
 		// SXY FIFO registers
@@ -4982,9 +3542,13 @@ static void Cop2_handleRTPT(Cop2 *gte, int32_t opcode)
 
 	}
 
-	// Calculate bit 31 of flag register
-	if ((gte->controlRegisters[31] & 0x7F87E000) != 0)
-		gte->controlRegisters[31] |= 0x80000000;
+	// Leave the flag register to be worked out from the last vector's
+	// results if it is read
+	gte->pendingMac[0] = transformed[2].mac[0];
+	gte->pendingMac[1] = transformed[2].mac[1];
+	gte->pendingMac[2] = transformed[2].mac[2];
+	gte->pendingSf = sf;
+	gte->flagsPending = true;
 }
 
 /*
@@ -5215,480 +3779,278 @@ static void Cop2_handleGPL(Cop2 *gte, int32_t opcode)
 	int64_t lowerBound = (lm == 1) ? 0 : -0x8000L;
 
 	if (mac1 > 0x7FFFL) {
-		ir1 = 0x7FFFL;
-		gte->controlRegisters[31] |= 0x1000000;
-	} else if (mac1 < lowerBound) {
-		ir1 = lowerBound;
-		gte->controlRegisters[31] |= 0x1000000;
-	} else {
-		ir1 = mac1;
-	}
-
-	if (mac2 > 0x7FFFL) {
-		ir2 = 0x7FFFL;
-		gte->controlRegisters[31] |= 0x800000;
-	} else if (mac2 < lowerBound) {
-		ir2 = lowerBound;
-		gte->controlRegisters[31] |= 0x800000;
-	} else {
-		ir2 = mac2;
-	}
-
-	if (mac3 > 0x7FFFL) {
-		ir3 = 0x7FFFL;
-		gte->controlRegisters[31] |= 0x400000;
-	} else if (mac3 < lowerBound) {
-		ir3 = lowerBound;
-		gte->controlRegisters[31] |= 0x400000;
-	} else {
-		ir3 = mac3;
-	}
-
-	// Fetch code value from RGBC
-	int64_t code = logical_rshift(gte->dataRegisters[6], 24);
-
-	// Calculate colour FIFO entries
-	int64_t rOut = mac1 / 16;
-	int64_t gOut = mac2 / 16;
-	int64_t bOut = mac3 / 16;
-
-	// Saturate FIFO entries and set flags if needed
-	if (rOut < 0) {
-		rOut = 0;
-		gte->controlRegisters[31] |= 0x200000;
-	} else if (rOut > 0xFF) {
-		rOut = 0xFF;
-		gte->controlRegisters[31] |= 0x200000;
-	}
-
-	if (gOut < 0) {
-		gOut = 0;
-		gte->controlRegisters[31] |= 0x100000;
-	} else if (gOut > 0xFF) {
-		gOut = 0xFF;
-		gte->controlRegisters[31] |= 0x100000;
-	}
-
-	if (bOut < 0) {
-		bOut = 0;
-		gte->controlRegisters[31] |= 0x80000;
-	} else if (bOut > 0xFF) {
-		bOut = 0xFF;
-		gte->controlRegisters[31] |= 0x80000;
-	}
-
-	// Calculate bit 31 of flag register
-	if ((gte->controlRegisters[31] & 0x7F87E000) != 0)
-		gte->controlRegisters[31] |= 0x80000000;
-
-	// Store all values back
-	gte->dataRegisters[25] = (int32_t)mac1; // MAC1
-	gte->dataRegisters[26] = (int32_t)mac2; // MAC2
-	gte->dataRegisters[27] = (int32_t)mac3; // MAC3
-
-	gte->dataRegisters[9] = (int32_t)ir1; // IR1
-	gte->dataRegisters[10] = (int32_t)ir2; // IR2
-	gte->dataRegisters[11] = (int32_t)ir3; // IR3
-
-	gte->dataRegisters[20] = gte->dataRegisters[21]; // RGB1 to RGB0
-	gte->dataRegisters[21] = gte->dataRegisters[22]; // RGB2 to RGB1
-	gte->dataRegisters[22] =
-			(int32_t)((code << 24) | (bOut << 16) | (gOut << 8) | rOut); // RGB2
-}
-
-/*
- * This function handles the NCCT GTE function.
- */
-static void Cop2_handleNCCT(Cop2 *gte, int32_t opcode)
-{
-	// Filter out sf bit
-	int32_t sf = (opcode & 0x80000) == 0x80000 ? 1 : 0;
-
-	// Filter out lm bit
-	int32_t lm = (opcode & 0x400) == 0x400 ? 1 : 0;
-
-	// Retrieve light matrix values
-	int64_t l11 = 0xFFFF & gte->controlRegisters[8]; // L11
-	int64_t l12 = 0xFFFF & logical_rshift(gte->controlRegisters[8], 16); // L12
-	int64_t l13 = 0xFFFF & gte->controlRegisters[9]; // L13
-	int64_t l21 = 0xFFFF & logical_rshift(gte->controlRegisters[9], 16); // L21
-	int64_t l22 = 0xFFFF & gte->controlRegisters[10]; // L22
-	int64_t l23 = 0xFFFF & logical_rshift(gte->controlRegisters[10], 16); // L23
-	int64_t l31 = 0xFFFF & gte->controlRegisters[11]; // L31
-	int64_t l32 = 0xFFFF & logical_rshift(gte->controlRegisters[11], 16); // L32
-	int64_t l33 = 0xFFFF & gte->controlRegisters[12]; // L33
-
-	// Sign extend light matrix values if needed
-	if ((l11 & 0x8000L) == 0x8000L)
-		l11 |= 0xFFFFFFFFFFFF0000L;
-	if ((l12 & 0x8000L) == 0x8000L)
-		l12 |= 0xFFFFFFFFFFFF0000L;
-	if ((l13 & 0x8000L) == 0x8000L)
-		l13 |= 0xFFFFFFFFFFFF0000L;
-	if ((l21 & 0x8000L) == 0x8000L)
-		l21 |= 0xFFFFFFFFFFFF0000L;
-	if ((l22 & 0x8000L) == 0x8000L)
-		l22 |= 0xFFFFFFFFFFFF0000L;
-	if ((l23 & 0x8000L) == 0x8000L)
-		l23 |= 0xFFFFFFFFFFFF0000L;
-	if ((l31 & 0x8000L) == 0x8000L)
-		l31 |= 0xFFFFFFFFFFFF0000L;
-	if ((l32 & 0x8000L) == 0x8000L)
-		l32 |= 0xFFFFFFFFFFFF0000L;
-	if ((l33 & 0x8000L) == 0x8000L)
-		l33 |= 0xFFFFFFFFFFFF0000L;
-
-	// Retrieve light colour matrix values
-	int64_t lr1 = 0xFFFF & gte->controlRegisters[16]; // LR1
-	int64_t lr2 = 0xFFFF & logical_rshift(gte->controlRegisters[16], 16); // LR2
-	int64_t lr3 = 0xFFFF & gte->controlRegisters[17]; // LR3
-	int64_t lg1 = 0xFFFF & logical_rshift(gte->controlRegisters[17], 16); // LG1
-	int64_t lg2 = 0xFFFF & gte->controlRegisters[18]; // LG2
-	int64_t lg3 = 0xFFFF & logical_rshift(gte->controlRegisters[18], 16); // LG3
-	int64_t lb1 = 0xFFFF & gte->controlRegisters[19]; // LB1
-	int64_t lb2 = 0xFFFF & logical_rshift(gte->controlRegisters[19], 16); // LB2
-	int64_t lb3 = 0xFFFF & gte->controlRegisters[20]; // LB3
-
-	// Sign extend light colour matrix values if needed
-	if ((lr1 & 0x8000L) == 0x8000L)
-		lr1 |= 0xFFFFFFFFFFFF0000L;
-	if ((lr2 & 0x8000L) == 0x8000L)
-		lr2 |= 0xFFFFFFFFFFFF0000L;
-	if ((lr3 & 0x8000L) == 0x8000L)
-		lr3 |= 0xFFFFFFFFFFFF0000L;
-	if ((lg1 & 0x8000L) == 0x8000L)
-		lg1 |= 0xFFFFFFFFFFFF0000L;
-	if ((lg2 & 0x8000L) == 0x8000L)
-		lg2 |= 0xFFFFFFFFFFFF0000L;
-	if ((lg3 & 0x8000L) == 0x8000L)
-		lg3 |= 0xFFFFFFFFFFFF0000L;
-	if ((lb1 & 0x8000L) == 0x8000L)
-		lb1 |= 0xFFFFFFFFFFFF0000L;
-	if ((lb2 & 0x8000L) == 0x8000L)
-		lb2 |= 0xFFFFFFFFFFFF0000L;
-	if ((lb3 & 0x8000L) == 0x8000L)
-		lb3 |= 0xFFFFFFFFFFFF0000L;
-
-	// Retrieve background colour values
-	int64_t rbk = 0xFFFFFFFFL & gte->controlRegisters[13]; // RBK
-	int64_t gbk = 0xFFFFFFFFL & gte->controlRegisters[14]; // GBK
-	int64_t bbk = 0xFFFFFFFFL & gte->controlRegisters[15]; // BBK
-
-	// Sign extend background colour values if needed
-	if ((rbk & 0x80000000L) == 0x80000000L)
-		rbk |= 0xFFFFFFFF00000000L;
-	if ((gbk & 0x80000000L) == 0x80000000L)
-		gbk |= 0xFFFFFFFF00000000L;
-	if ((bbk & 0x80000000L) == 0x80000000L)
-		bbk |= 0xFFFFFFFF00000000L;
-
-	// Retrieve RGBC values
-	int64_t r = 0xFF & gte->dataRegisters[6]; // R
-	int64_t g = 0xFF & logical_rshift(gte->dataRegisters[6], 8); // G
-	int64_t b = 0xFF & logical_rshift(gte->dataRegisters[6], 16); // B
-	int64_t code = 0xFF & logical_rshift(gte->dataRegisters[6], 24); // CODE
-
-	// Repeat for vectors V0, V1 and V2
-	for (int32_t i = 0; i < 3; ++i) {
-
-		// Clear flag register
-		gte->controlRegisters[31] = 0;
-
-		// Retrieve Vx values
-		int64_t vxAny = 0, vyAny = 0, vzAny = 0;
-		switch (i) {
-			case 0:
-				vxAny =
-					0xFFFF & gte->dataRegisters[0]; // VX0
-				vyAny =
-					0xFFFF & logical_rshift(gte->dataRegisters[0], 16); // VY0
-				vzAny =
-					0xFFFF & gte->dataRegisters[1]; // VZ0
-				break;
-			case 1:
-				vxAny =
-					0xFFFF & gte->dataRegisters[2]; // VX1
-				vyAny =
-					0xFFFF & logical_rshift(gte->dataRegisters[2], 16); // VY1
-				vzAny =
-					0xFFFF & gte->dataRegisters[3]; // VZ1
-				break;
-			case 2:
-				vxAny =
-					0xFFFF & gte->dataRegisters[4]; // VX2
-				vyAny =
-					0xFFFF & logical_rshift(gte->dataRegisters[4], 16); // VY2
-				vzAny =
-					0xFFFF & gte->dataRegisters[5]; // VZ2
-				break;
-		}
-
-		// Sign extend V0 values if necessary
-		if ((vxAny & 0x8000L) == 0x8000L) {
-			vxAny |= 0xFFFFFFFFFFFF0000L;
-		}
-		if ((vyAny & 0x8000L) == 0x8000L) {
-			vyAny |= 0xFFFFFFFFFFFF0000L;
-		}
-		if ((vzAny & 0x8000L) == 0x8000L) {
-			vzAny |= 0xFFFFFFFFFFFF0000L;
-		}
-
-		// Perform first stage of calculation
-		int64_t mac1 = l11 * vxAny + l12 * vyAny + l13 * vzAny;
-		int64_t mac2 = l21 * vxAny + l22 * vyAny + l23 * vzAny;
-		int64_t mac3 = l31 * vxAny + l32 * vyAny + l33 * vzAny;
-
-		// Shift right by (sf * 12) bits, preserving sign bit
-		mac1 = mac1 >> (sf * 12);
-		mac2 = mac2 >> (sf * 12);
-		mac3 = mac3 >> (sf * 12);
-
-		// Set flags and mask bits for MAC1, MAC2 and MAC3
-		if (mac1 > 0x80000000000L) {
-			gte->controlRegisters[31] |= 0x40000000;
-		} else if (mac1 < -0x80000000000L) {
-			gte->controlRegisters[31] |= 0x8000000;
-		}
-
-		if (mac2 > 0x80000000000L) {
-			gte->controlRegisters[31] |= 0x20000000;
-		} else if (mac2 < -0x80000000000L) {
-			gte->controlRegisters[31] |= 0x4000000;
-		}
-
-		if (mac3 > 0x80000000000L) {
-			gte->controlRegisters[31] |= 0x10000000;
-		} else if (mac3 < -0x80000000000L) {
-			gte->controlRegisters[31] |= 0x2000000;
-		}
-
-		// Setup IR1, IR2 and IR3
-		int64_t ir1 = 0, ir2 = 0, ir3 = 0;
-		int64_t lowerBound = (lm == 1) ? 0 : -0x8000L;
-
-		if (mac1 > 0x7FFFL) {
-			ir1 = 0x7FFFL;
-			gte->controlRegisters[31] |= 0x1000000;
-		} else if (mac1 < lowerBound) {
-			ir1 = lowerBound;
-			gte->controlRegisters[31] |= 0x1000000;
-		} else {
-			ir1 = mac1;
-		}
-
-		if (mac2 > 0x7FFFL) {
-			ir2 = 0x7FFFL;
-			gte->controlRegisters[31] |= 0x800000;
-		} else if (mac2 < lowerBound) {
-			ir2 = lowerBound;
-			gte->controlRegisters[31] |= 0x800000;
-		} else {
-			ir2 = mac2;
-		}
-
-		if (mac3 > 0x7FFFL) {
-			ir3 = 0x7FFFL;
-			gte->controlRegisters[31] |= 0x400000;
-		} else if (mac3 < lowerBound) {
-			ir3 = lowerBound;
-			gte->controlRegisters[31] |= 0x400000;
-		} else {
-			ir3 = mac3;
-		}
-
-		// Perform second stage of calculation
-		mac1 = rbk * 0x1000 + lr1 * ir1 + lr2 * ir2 + lr3 * ir3;
-		mac2 = gbk * 0x1000 + lg1 * ir1 + lg2 * ir2 + lg3 * ir3;
-		mac3 = bbk * 0x1000 + lb1 * ir1 + lb2 * ir2 + lb3 * ir3;
-
-		// Shift right by (sf * 12) bits, preserving sign bit
-		mac1 = mac1 >> (sf * 12);
-		mac2 = mac2 >> (sf * 12);
-		mac3 = mac3 >> (sf * 12);
-
-		// Set flags and mask bits for MAC1, MAC2 and MAC3 (again)
-		if (mac1 > 0x80000000000L) {
-			gte->controlRegisters[31] |= 0x40000000;
-		} else if (mac1 < -0x80000000000L) {
-			gte->controlRegisters[31] |= 0x8000000;
-		}
+		ir1 = 0x7FFFL;
+		gte->controlRegisters[31] |= 0x1000000;
+	} else if (mac1 < lowerBound) {
+		ir1 = lowerBound;
+		gte->controlRegisters[31] |= 0x1000000;
+	} else {
+		ir1 = mac1;
+	}
 
-		if (mac2 > 0x80000000000L) {
-			gte->controlRegisters[31] |= 0x20000000;
-		} else if (mac2 < -0x80000000000L) {
-			gte->controlRegisters[31] |= 0x4000000;
-		}
+	if (mac2 > 0x7FFFL) {
+		ir2 = 0x7FFFL;
+		gte->controlRegisters[31] |= 0x800000;
+	} else if (mac2 < lowerBound) {
+		ir2 = lowerBound;
+		gte->controlRegisters[31] |= 0x800000;
+	} else {
+		ir2 = mac2;
+	}
 
-		if (mac3 > 0x80000000000L) {
-			gte->controlRegisters[31] |= 0x10000000;
-		} else if (mac3 < -0x80000000000L) {
-			gte->controlRegisters[31] |= 0x2000000;
-		}
+	if (mac3 > 0x7FFFL) {
+		ir3 = 0x7FFFL;
+		gte->controlRegisters[31] |= 0x400000;
+	} else if (mac3 < lowerBound) {
+		ir3 = lowerBound;
+		gte->controlRegisters[31] |= 0x400000;
+	} else {
+		ir3 = mac3;
+	}
 
-		// Setup IR1, IR2 and IR3 (again)
-		if (mac1 > 0x7FFFL) {
-			ir1 = 0x7FFFL;
-			gte->controlRegisters[31] |= 0x1000000;
-		} else if (mac1 < lowerBound) {
-			ir1 = lowerBound;
-			gte->controlRegisters[31] |= 0x1000000;
-		} else {
-			ir1 = mac1;
-		}
+	// Fetch code value from RGBC
+	int64_t code = logical_rshift(gte->dataRegisters[6], 24);
 
-		if (mac2 > 0x7FFFL) {
-			ir2 = 0x7FFFL;
-			gte->controlRegisters[31] |= 0x800000;
-		} else if (mac2 < lowerBound) {
-			ir2 = lowerBound;
-			gte->controlRegisters[31] |= 0x800000;
-		} else {
-			ir2 = mac2;
-		}
+	// Calculate colour FIFO entries
+	int64_t rOut = mac1 / 16;
+	int64_t gOut = mac2 / 16;
+	int64_t bOut = mac3 / 16;
 
-		if (mac3 > 0x7FFFL) {
-			ir3 = 0x7FFFL;
-			gte->controlRegisters[31] |= 0x400000;
-		} else if (mac3 < lowerBound) {
-			ir3 = lowerBound;
-			gte->controlRegisters[31] |= 0x400000;
-		} else {
-			ir3 = mac3;
-		}
+	// Saturate FIFO entries and set flags if needed
+	if (rOut < 0) {
+		rOut = 0;
+		gte->controlRegisters[31] |= 0x200000;
+	} else if (rOut > 0xFF) {
+		rOut = 0xFF;
+		gte->controlRegisters[31] |= 0x200000;
+	}
 
-		// Perform first NCCx stage calculation
-		mac1 = r * ir1;
-		mac2 = g * ir2;
-		mac3 = b * ir3;
+	if (gOut < 0) {
+		gOut = 0;
+		gte->controlRegisters[31] |= 0x100000;
+	} else if (gOut > 0xFF) {
+		gOut = 0xFF;
+		gte->controlRegisters[31] |= 0x100000;
+	}
 
-		// Shift results left by four bits
-		mac1 = mac1 << 4;
-		mac2 = mac2 << 4;
-		mac3 = mac3 << 4;
+	if (bOut < 0) {
+		bOut = 0;
+		gte->controlRegisters[31] |= 0x80000;
+	} else if (bOut > 0xFF) {
+		bOut = 0xFF;
+		gte->controlRegisters[31] |= 0x80000;
+	}
 
-		// Check for and set MAC1, MAC2 and MAC3 flags again if needed
-		if (mac1 > 0x80000000000L) {
-			gte->controlRegisters[31] |= 0x40000000;
-		} else if (mac1 < -0x80000000000L) {
-			gte->controlRegisters[31] |= 0x8000000;
-		}
+	// Calculate bit 31 of flag register
+	if ((gte->controlRegisters[31] & 0x7F87E000) != 0)
+		gte->controlRegisters[31] |= 0x80000000;
 
-		if (mac2 > 0x80000000000L) {
-			gte->controlRegisters[31] |= 0x20000000;
-		} else if (mac2 < -0x80000000000L) {
-			gte->controlRegisters[31] |= 0x4000000;
-		}
+	// Store all values back
+	gte->dataRegisters[25] = (int32_t)mac1; // MAC1
+	gte->dataRegisters[26] = (int32_t)mac2; // MAC2
+	gte->dataRegisters[27] = (int32_t)mac3; // MAC3
 
-		if (mac3 > 0x80000000000L) {
-			gte->controlRegisters[31] |= 0x10000000;
-		} else if (mac3 < -0x80000000000L) {
-			gte->controlRegisters[31] |= 0x2000000;
-		}
+	gte->dataRegisters[9] = (int32_t)ir1; // IR1
+	gte->dataRegisters[10] = (int32_t)ir2; // IR2
+	gte->dataRegisters[11] = (int32_t)ir3; // IR3
 
-		// Perform second NCCx stage calculation,
-		// shifting MAC1, MAC2 and MAC3 by (sf * 12), and preserving sign bit
-		mac1 = mac1 >> (sf * 12);
-		mac2 = mac2 >> (sf * 12);
-		mac3 = mac3 >> (sf * 12);
+	gte->dataRegisters[20] = gte->dataRegisters[21]; // RGB1 to RGB0
+	gte->dataRegisters[21] = gte->dataRegisters[22]; // RGB2 to RGB1
+	gte->dataRegisters[22] =
+			(int32_t)((code << 24) | (bOut << 16) | (gOut << 8) | rOut); // RGB2
+}
 
-		// Check for and set MAC1, MAC2 and MAC3 flags again if needed
-		if (mac1 > 0x80000000000L) {
-			gte->controlRegisters[31] |= 0x40000000;
-		} else if (mac1 < -0x80000000000L) {
-			gte->controlRegisters[31] |= 0x8000000;
-		}
+/*
+ * This function handles the NCCT GTE function.
+ */
+static void Cop2_handleNCCT(Cop2 *gte, int32_t opcode)
+{
+	// Filter out sf bit
+	int32_t sf = (opcode & 0x80000) == 0x80000 ? 1 : 0;
 
-		if (mac2 > 0x80000000000L) {
-			gte->controlRegisters[31] |= 0x20000000;
-		} else if (mac2 < -0x80000000000L) {
-			gte->controlRegisters[31] |= 0x4000000;
-		}
+	// Filter out lm bit
+	int32_t lm = (opcode & 0x400) == 0x400 ? 1 : 0;
 
-		if (mac3 > 0x80000000000L) {
-			gte->controlRegisters[31] |= 0x10000000;
-		} else if (mac3 < -0x80000000000L) {
-			gte->controlRegisters[31] |= 0x2000000;
-		}
+	// Perform calculation for V0, V1 and V2 in one go, as none of them
+	// depends on results from the previous one, then store results
+	GteResult results[3];
+	gte->kernels->lightVertices(gte->lightMatrix, gte->colourMatrix,
+			gte->vectors, gte->controlRegisters, gte->dataRegisters, false,
+			sf, (lm == 1) ? 0 : -0x8000L, results);
+	Cop2_storeColourResults(gte, results);
+}
 
-		// Store results back to IR1, IR2 and IR3
-		if (mac1 > 0x7FFFL) {
-			ir1 = 0x7FFFL;
-			gte->controlRegisters[31] |= 0x1000000;
-		} else if (mac1 < lowerBound) {
-			ir1 = lowerBound;
-			gte->controlRegisters[31] |= 0x1000000;
-		} else {
-			ir1 = mac1;
-		}
+/*
+ * This function reads three consecutive 32-bit control registers starting
+ * at reg into vector, sign extended.
+ */
+static void Cop2_readControlVector(Cop2 *gte, int32_t reg, int64_t *vector)
+{
+	vector[0] = gte->controlRegisters[reg];
+	vector[1] = gte->controlRegisters[reg + 1];
+	vector[2] = gte->controlRegisters[reg + 2];
+}
 
-		if (mac2 > 0x7FFFL) {
-			ir2 = 0x7FFFL;
-			gte->controlRegisters[31] |= 0x800000;
-		} else if (mac2 < lowerBound) {
-			ir2 = lowerBound;
-			gte->controlRegisters[31] |= 0x800000;
-		} else {
-			ir2 = mac2;
-		}
+/*
+ * This function reads the specified vector (V0, V1 or V2) into vector, sign
+ * extended.
+ */
+static void Cop2_readVector(Cop2 *gte, int32_t index, int64_t *vector)
+{
+	vector[0] = gte->vectors[index * 3]; // VXn
+	vector[1] = gte->vectors[index * 3 + 1]; // VYn
+	vector[2] = gte->vectors[index * 3 + 2]; // VZn
+}
 
-		if (mac3 > 0x7FFFL) {
-			ir3 = 0x7FFFL;
-			gte->controlRegisters[31] |= 0x400000;
-		} else if (mac3 < lowerBound) {
-			ir3 = lowerBound;
-			gte->controlRegisters[31] |= 0x400000;
-		} else {
-			ir3 = mac3;
-		}
+/*
+ * This function updates the unpacked copy of a matrix after one of its
+ * control registers has been written. Other registers are left alone.
+ */
+static void Cop2_unpackControlReg(Cop2 *gte, int32_t reg)
+{
+	// Determine which matrix the register belongs to, if any
+	int16_t *matrix = NULL;
+	int32_t index = 0;
+	if (reg <= 4) {
+		matrix = gte->rotationMatrix; // RT11 to RT33
+		index = reg;
+	} else if (reg >= 8 && reg <= 12) {
+		matrix = gte->lightMatrix; // L11 to L33
+		index = reg - 8;
+	} else if (reg >= 16 && reg <= 20) {
+		matrix = gte->colourMatrix; // LR1 to LB3
+		index = reg - 16;
+	} else {
+		return;
+	}
 
-		// Calculate result to be stored to colour FIFO
-		int64_t rOut = mac1 / 16;
-		int64_t gOut = mac2 / 16;
-		int64_t bOut = mac3 / 16;
+	// Unpack both elements, bar the upper half of the last register which
+	// is unused
+	int32_t value = gte->controlRegisters[reg];
+	matrix[index * 2] = (int16_t)value;
+	if (index < 4)
+		matrix[index * 2 + 1] = (int16_t)logical_rshift(value, 16);
+}
 
-		// Check values and saturate + set flags if needed
-		if (rOut < 0) {
-			rOut = 0;
-			gte->controlRegisters[31] |= 0x200000;
-		} else if (rOut > 0xFF) {
-			rOut = 0xFF;
-			gte->controlRegisters[31] |= 0x200000;
-		}
+/*
+ * This function updates the unpacked copy of V0, V1 or V2 after one of
+ * their data registers has been written. Other registers are left alone.
+ */
+static void Cop2_unpackDataReg(Cop2 *gte, int32_t reg)
+{
+	if (reg > 5)
+		return;
+
+	// Even registers hold VXn and VYn, odd ones VZn
+	int32_t value = gte->dataRegisters[reg];
+	int16_t *vector = gte->vectors + (reg / 2) * 3;
+	if ((reg & 1) == 0) {
+		vector[0] = (int16_t)value; // VXn
+		vector[1] = (int16_t)logical_rshift(value, 16); // VYn
+	} else {
+		vector[2] = (int16_t)value; // VZn
+	}
+}
 
-		if (gOut < 0) {
-			gOut = 0;
-			gte->controlRegisters[31] |= 0x100000;
-		} else if (gOut > 0xFF) {
-			gOut = 0xFF;
-			gte->controlRegisters[31] |= 0x100000;
-		}
+/*
+ * This function stores the results of a colour calculation for three
+ * vectors, as produced by a kernel, one after the other. Each goes through
+ * MAC1, MAC2, MAC3, IR1, IR2, IR3 and the flag register, so only the last
+ * remains there, and on to the colour FIFO along with CODE from RGBC.
+ */
+static void Cop2_storeColourResults(Cop2 *gte, const GteResult *results)
+{
+	// Pushing three colours replaces the whole colour FIFO, so write
+	// RGB0, RGB1 and RGB2 directly
+	int32_t code = gte->dataRegisters[6] & 0xFF000000; // CODE
+	for (int32_t i = 0; i < 3; ++i)
+		gte->dataRegisters[20 + i] = code |
+				(int32_t)((results[i].colour[2] << 16) |
+				(results[i].colour[1] << 8) |
+				results[i].colour[0]); // RGBx
+	const GteResult *last = results + 2;
 
-		if (bOut < 0) {
-			bOut = 0;
-			gte->controlRegisters[31] |= 0x80000;
-		} else if (bOut > 0xFF) {
-			bOut = 0xFF;
-			gte->controlRegisters[31] |= 0x80000;
-		}
+	// Calculate and set flag bit 31
+	int32_t flags = last->flags;
+	if ((flags & 0x7F87E000) != 0)
+		flags |= 0x80000000;
+	gte->controlRegisters[31] = flags;
 
-		// Calculate and set flag bit 31
-		if ((gte->controlRegisters[31] & 0x7F87E000) != 0) {
-			gte->controlRegisters[31] |= 0x80000000;
-		}
+	// Store all values back
+	gte->dataRegisters[25] = (int32_t)last->mac[0]; // MAC1
+	gte->dataRegisters[26] = (int32_t)last->mac[1]; // MAC2
+	gte->dataRegisters[27] = (int32_t)last->mac[2]; // MAC3
 
-		// Store all values back
-		gte->dataRegisters[25] = (int32_t)mac1; // MAC1
-		gte->dataRegisters[26] = (int32_t)mac2; // MAC2
-		gte->dataRegisters[27] = (int32_t)mac3; // MAC3
+	gte->dataRegisters[9] = (int32_t)last->ir[0]; // IR1
+	gte->dataRegisters[10] = (int32_t)last->ir[1]; // IR2
+	gte->dataRegisters[11] = (int32_t)last->ir[2]; // IR3
+}
+/*
+ * This function works out the flag register from the raw results left by the
+ * last RTPS or RTPT, giving exactly the bits those functions would have set.
+ */
+static void Cop2_resolveFlags(Cop2 *gte)
+{
+	// Retrieve raw results
+	int32_t flags = gte->pendingFlags;
+	int64_t mac1 = gte->pendingMac[0];
+	int64_t mac2 = gte->pendingMac[1];
+	int64_t mac3 = gte->pendingMac[2];
+	int32_t sf = gte->pendingSf;
+
+	// MAC1, MAC2 and MAC3 overflow
+	if (mac1 > 0x80000000000L)
+		flags |= 0x40000000;
+	else if (mac1 < -0x80000000000L)
+		flags |= 0x8000000;
+	if (mac2 > 0x80000000000L)
+		flags |= 0x20000000;
+	else if (mac2 < -0x80000000000L)
+		flags |= 0x4000000;
+	if (mac3 > 0x80000000000L)
+		flags |= 0x10000000;
+	else if (mac3 < -0x80000000000L)
+		flags |= 0x2000000;
+
+	// IR1, IR2 and IR3 saturation - without sf, the IR3 flag is only set if
+	// the value would still saturate when shifted
+	if (mac1 < -0x8000 || mac1 > 0x7FFF)
+		flags |= 0x1000000;
+	if (mac2 < -0x8000 || mac2 > 0x7FFF)
+		flags |= 0x800000;
+	if ((mac3 < -0x8000 || mac3 > 0x7FFF) &&
+			(sf == 1 || (mac3 >> 12) < -0x8000 || (mac3 >> 12) > 0x7FFF))
+		flags |= 0x400000;
+
+	// SZ3 saturation
+	int64_t sz3 = mac3 >> ((1 - sf) * 12);
+	if (sz3 < 0 || sz3 > 0xFFFF)
+		flags |= 0x40000;
+
+	// MAC0 overflow
+	for (int32_t i = 0; i < 3; ++i) {
+		if (gte->pendingMac0[i] > 0x80000000L)
+			flags |= 0x10000;
+		else if (gte->pendingMac0[i] < -0x80000000L)
+			flags |= 0x8000;
+	}
+
+	// SX2, SY2 and IR0 saturation
+	int64_t sx2 = (int32_t)gte->pendingMac0[0] / 0x10000;
+	int64_t sy2 = (int32_t)gte->pendingMac0[1] / 0x10000;
+	int64_t ir0 = (int32_t)gte->pendingMac0[2] / 0x1000;
+	if (sx2 > 0x3FFL || sx2 < -0x400)
+		flags |= 0x4000;
+	if (sy2 > 0x3FFL || sy2 < -0x400)
+		flags |= 0x2000;
+	if (ir0 < 0 || ir0 > 0x1000)
+		flags |= 0x1000;
 
-		gte->dataRegisters[9] = (int32_t)ir1; // IR1
-		gte->dataRegisters[10] = (int32_t)ir2; // IR2
-		gte->dataRegisters[11] = (int32_t)ir3; // IR3
+	// Calculate bit 31 of flag register
+	if ((flags & 0x7F87E000) != 0)
+		flags |= 0x80000000;
 
-		gte->dataRegisters[20] = gte->dataRegisters[21]; // RGB1 to RGB0
-		gte->dataRegisters[21] = gte->dataRegisters[22]; // RGB2 to RGB1
-		gte->dataRegisters[22] =
-			(int32_t)((code << 24) | (bOut << 16) | (gOut << 8) | rOut); // RGB2
-	}
+	// Store result
+	gte->controlRegisters[31] = flags;
+	gte->flagsPending = false;
 }
\ No newline at end of file
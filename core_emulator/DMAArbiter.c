@@ -38,6 +38,23 @@ static int32_t DMAArbiter_handleCDROM(DMAArbiter *dma);
 static void DMAArbiter_handleDMATransactions(DMAArbiter *dma);
 static int32_t DMAArbiter_handleGPU(DMAArbiter *dma);
 static int32_t DMAArbiter_handleOTC(DMAArbiter *dma);
+static int8_t DMAArbiter_readPortByte(void *object, int32_t address);
+static int32_t DMAArbiter_readPortWord(void *object, int32_t address);
+static void DMAArbiter_writePortByte(void *object, int32_t address,
+		int8_t value);
+static void DMAArbiter_writePortHalfword(void *object, int32_t address,
+		int16_t value);
+static void DMAArbiter_writePortWord(void *object, int32_t address,
+		int32_t word);
+
+// Handlers for our I/O ports
+static const IOPortHandlers dmaPortHandlers = {
+	.readByte = DMAArbiter_readPortByte,
+	.readWord = DMAArbiter_readPortWord,
+	.writeByte = DMAArbiter_writePortByte,
+	.writeHalfword = DMAArbiter_writePortHalfword,
+	.writeWord = DMAArbiter_writePortWord
+};
 
 /*
  * This struct contains the state to model DMA transfers
@@ -116,8 +133,7 @@ int8_t DMAArbiter_readByte(DMAArbiter *dma, int32_t address)
 	int32_t tempWord = DMAArbiter_readWord(dma, wordAddress);
 
 	// Return correct byte of word
-	int8_t tempByte =
-			(int8_t)logical_rshift(tempWord, ((~byteIndex & 0x3) * 8));
+	int8_t tempByte = (int8_t)logical_rshift(tempWord, byteIndex * 8);
 	return tempByte;
 }
 
@@ -210,7 +226,7 @@ int32_t DMAArbiter_readWord(DMAArbiter *dma, int32_t address)
 			break;
 		case 0xE8:
 			// Impose additional restrictions on DMA6 control register
-			retVal |= 0x02000000;
+			retVal |= 0x2;
 			retVal = dma->channelRegisters[PHILPSX_DMA_OTC * 3 + 2];
 			break;
 
@@ -220,10 +236,6 @@ int32_t DMAArbiter_readWord(DMAArbiter *dma, int32_t address)
 			break;
 		case 0xF4:
 			retVal = dma->dmaInterruptRegister;
-			retVal = ((retVal << 24) & 0xFF000000) |
-					((retVal << 8) & 0xFF0000) |
-					(logical_rshift(retVal, 8) & 0xFF00) |
-					(logical_rshift(retVal, 24) & 0xFF);
 			int32_t tempInt = (retVal & 0x800000) |	(
 					(retVal & 0x7F0000) &
 					logical_rshift((retVal & 0x7F000000), 8)
@@ -233,10 +245,6 @@ int32_t DMAArbiter_readWord(DMAArbiter *dma, int32_t address)
 			} else {
 				retVal &= 0x7FFFFFFF;
 			}
-			retVal = ((retVal << 24) & 0xFF000000) |
-					((retVal << 8) & 0xFF0000) |
-					(logical_rshift(retVal, 8) & 0xFF00) |
-					(logical_rshift(retVal, 24) & 0xFF);
 			break;
 	}
 
@@ -273,6 +281,10 @@ void DMAArbiter_setGpu(DMAArbiter *dma, GPU *gpu)
 void DMAArbiter_setMemoryInterface(DMAArbiter *dma, SystemInterlink *smi)
 {
 	dma->system = smi;
+
+	// Register handlers for our I/O ports
+	SystemInterlink_setIOPortHandlers(smi, 0x1F801080, 0x80,
+			&dmaPortHandlers, dma);
 }
 
 /*
@@ -288,10 +300,33 @@ void DMAArbiter_writeByte(DMAArbiter *dma, int32_t address, int8_t value)
 	int32_t tempWord = DMAArbiter_readWord(dma, wordAddress);
 
 	// Mask out byte we are writing
-	tempWord &= ~(0xFF << ((~byteIndex & 0x3) * 8));
+	tempWord &= ~(0xFF << (byteIndex * 8));
 
 	// Merge in our byte
-	tempWord |= (value & 0xFF) << ((~byteIndex & 0x3) * 8);
+	tempWord |= (value & 0xFF) << (byteIndex * 8);
+
+	// Write word back
+	DMAArbiter_writeWord(dma, wordAddress, tempWord);
+}
+
+/*
+ * This function writes halfwords to the DMA Arbiter.
+ */
+void DMAArbiter_writeHalfword(DMAArbiter *dma, int32_t address,
+		int16_t value)
+{
+	// Get word address and halfword index
+	int32_t wordAddress = address & 0xFFFFFFFC;
+	int32_t halfwordIndex = logical_rshift(address, 1) & 0x1;
+
+	// Read original word
+	int32_t tempWord = DMAArbiter_readWord(dma, wordAddress);
+
+	// Mask out halfword we are writing
+	tempWord &= ~(0xFFFF << (halfwordIndex * 16));
+
+	// Merge in our halfword
+	tempWord |= (value & 0xFFFF) << (halfwordIndex * 16);
 
 	// Write word back
 	DMAArbiter_writeWord(dma, wordAddress, tempWord);
@@ -389,16 +424,8 @@ void DMAArbiter_writeWord(DMAArbiter *dma, int32_t address, int32_t word)
 			break;
 		case 0xE8:
 			// Impose additional restrictions on writable bits
-			word = ((word << 24) & 0xFF000000) |
-					((word << 8) & 0xFF0000) |
-					(logical_rshift(word, 8) & 0xFF00) |
-					(logical_rshift(word, 24) & 0xFF);
 			int32_t existingWord =
 					dma->channelRegisters[PHILPSX_DMA_OTC * 3 + 2];
-			existingWord = ((existingWord << 24) & 0xFF000000) |
-					((existingWord << 8) & 0xFF0000) |
-					(logical_rshift(existingWord, 8) & 0xFF00) |
-					(logical_rshift(existingWord, 24) & 0xFF);
 
 			// Mask writable bits out of original and set bit 1
 			existingWord &= 0xAEFFFFFF;
@@ -409,10 +436,6 @@ void DMAArbiter_writeWord(DMAArbiter *dma, int32_t address, int32_t word)
 			existingWord |= word;
 
 			// Write back
-			existingWord = ((existingWord << 24) & 0xFF000000) |
-					((existingWord << 8) & 0xFF0000) |
-					(logical_rshift(existingWord, 8) & 0xFF00) |
-					(logical_rshift(existingWord, 24) & 0xFF);
 			dma->channelRegisters[PHILPSX_DMA_OTC * 3 + 2] = existingWord;
 			DMAArbiter_handleDMATransactions(dma);
 			break;
@@ -422,17 +445,6 @@ void DMAArbiter_writeWord(DMAArbiter *dma, int32_t address, int32_t word)
 			dma->dmaControlRegister = word;
 			break;
 		case 0xF4:
-			// Swap endianness
-			word = ((word << 24) & 0xFF000000) |
-					((word << 8) & 0xFF0000) |
-					(logical_rshift(word, 8) & 0xFF00) |
-					(logical_rshift(word, 24) & 0xFF);
-			dma->dmaInterruptRegister =
-					((dma->dmaInterruptRegister << 24) & 0xFF000000) |
-					((dma->dmaInterruptRegister << 8) & 0xFF0000) |
-					(logical_rshift(dma->dmaInterruptRegister, 8) & 0xFF00) |
-					(logical_rshift(dma->dmaInterruptRegister, 24) & 0xFF);
-
 			// First deal with non-flag bits
 			dma->dmaInterruptRegister &= 0x7F000000;
 			dma->dmaInterruptRegister |= word & 0x00FFFFFF;
@@ -441,13 +453,6 @@ void DMAArbiter_writeWord(DMAArbiter *dma, int32_t address, int32_t word)
 			word = ~word & 0x7F000000;
 			dma->dmaInterruptRegister = (dma->dmaInterruptRegister & word) |
 					(dma->dmaInterruptRegister & 0x00FFFFFF);
-
-			// Swap endianness back
-			dma->dmaInterruptRegister =
-					((dma->dmaInterruptRegister << 24) & 0xFF000000) |
-					((dma->dmaInterruptRegister << 8) & 0xFF0000) |
-					(logical_rshift(dma->dmaInterruptRegister, 8) & 0xFF00) |
-					(logical_rshift(dma->dmaInterruptRegister, 24) & 0xFF);
 			break;
 	}
 }
@@ -457,20 +462,12 @@ void DMAArbiter_writeWord(DMAArbiter *dma, int32_t address, int32_t word)
  */
 static int32_t DMAArbiter_handleCDROM(DMAArbiter *dma)
 {
-	// Get DMA base address and correct endianness
+	// Get DMA base address
 	int32_t baseAddress = dma->channelRegisters[PHILPSX_DMA_CDROM * 3];
-	baseAddress = ((baseAddress << 24) & 0xFF000000) |
-			((baseAddress << 8) & 0xFF0000) |
-			(logical_rshift(baseAddress, 8) & 0xFF00) |
-			(logical_rshift(baseAddress, 24) & 0xFF);
 	baseAddress = Cop0_virtualToPhysical(R3051_getCop0(dma->cpu), baseAddress);
 
-	// Get number of words and correct endianness
+	// Get number of words
 	int32_t numberOfWords = dma->channelRegisters[PHILPSX_DMA_CDROM * 3 + 1];
-	numberOfWords = ((numberOfWords << 24) & 0xFF000000) |
-			((numberOfWords << 8) & 0xFF0000) |
-			(logical_rshift(numberOfWords, 8) & 0xFF00) |
-			(logical_rshift(numberOfWords, 24) & 0xFF);
 	numberOfWords &= 0xFFFF;
 	if (numberOfWords == 0)
 		numberOfWords = 0x10000;
@@ -495,6 +492,11 @@ static int32_t DMAArbiter_handleCDROM(DMAArbiter *dma)
 							(int32_t)startingByte,
 							numberOfBytes
 							);
+					SystemInterlink_invalidateCodeRange(
+							dma->system,
+							(int32_t)startingByte,
+							numberOfBytes
+							);
 					break;
 				default: // Doesn't end in RAM, handle normally
 					for (int32_t i = 0; i < numberOfBytes; ++i) {
@@ -522,12 +524,11 @@ static int32_t DMAArbiter_handleCDROM(DMAArbiter *dma)
 			break;
 	}
 
-	// Decrement BC if chopping enabled (detect in little-endian mode
-	// for speed)
-	switch (dma->channelRegisters[PHILPSX_DMA_CDROM * 3 + 2] & 0x10000) {
-		case 0x10000:
-			// Set BC (again in little-endian mode for speed) to 0
-			dma->channelRegisters[PHILPSX_DMA_CDROM * 3 + 1] &= 0xFFFF;
+	// Decrement BC if chopping enabled
+	switch (dma->channelRegisters[PHILPSX_DMA_CDROM * 3 + 2] & 0x100) {
+		case 0x100:
+			// Set BC to 0
+			dma->channelRegisters[PHILPSX_DMA_CDROM * 3 + 1] &= 0xFFFF0000;
 			break;
 	}
 
@@ -539,15 +540,16 @@ static int32_t DMAArbiter_handleCDROM(DMAArbiter *dma)
  */
 static void DMAArbiter_handleDMATransactions(DMAArbiter *dma)
 {
+	// Attribute time spent here to DMA when profiling
+	Profiler *profiler = SystemInterlink_getProfiler(dma->system);
+	int32_t previousSubsystem = Profiler_enterSubsystem(profiler,
+			PHILPSX_PROFILER_DMA);
+
 	// Check if we need to start any DMA requests
 	int32_t dmaChannelControl[7] = { 0, 0, 0, 0, 0, 0, 0 };
 	int32_t dmaChannelStarted[7] = { 0, 0, 0, 0, 0, 0, 0 };
 	for (int32_t i = 0; i < 7; ++i) {
-		int32_t word = dma->channelRegisters[i * 3 + 2];
-		dmaChannelControl[i] = ((word << 24) & 0xFF000000) |
-				((word << 8) & 0xFF0000) |
-				(logical_rshift(word, 8) & 0xFF00) |
-				(logical_rshift(word, 24) & 0xFF);
+		dmaChannelControl[i] = dma->channelRegisters[i * 3 + 2];
 
 		switch (logical_rshift((dmaChannelControl[i] & 0x600), 9)) {
 			case 0: // Sync mode 0
@@ -562,11 +564,7 @@ static void DMAArbiter_handleDMATransactions(DMAArbiter *dma)
 	}
 
 	// Check if each one is actually enabled
-	int32_t tempControlRegister =
-			((dma->dmaControlRegister << 24) & 0xFF000000) |
-			((dma->dmaControlRegister << 8) & 0xFF0000) |
-			(logical_rshift(dma->dmaControlRegister, 8) & 0xFF00) |
-			(logical_rshift(dma->dmaControlRegister, 24) & 0xFF);
+	int32_t tempControlRegister = dma->dmaControlRegister;
 
 	int32_t highestPriority = 8;
 	int32_t highestPriorityChannelSoFar = -1;
@@ -600,10 +598,9 @@ static void DMAArbiter_handleDMATransactions(DMAArbiter *dma)
 			// Set bus holder to DMA Arbiter
 			R3051_setBusHolder(dma->cpu, PHILPSX_COMPONENTS_DMA);
 
-			// Clear bit 28 of channel control register (remember it is
-			// stored in little-endian mode)
+			// Clear bit 28 of channel control register
 			dma->channelRegisters[highestPriorityChannelSoFar * 3 + 2] &=
-					0xFFFFFFEF;
+					0xEFFFFFFF;
 
 			// Call correct method depending on channel or mode
 			switch (highestPriorityChannelSoFar) {
@@ -634,31 +631,22 @@ static void DMAArbiter_handleDMATransactions(DMAArbiter *dma)
 					break;
 			}
 
-			// Clear bit 24 of channel control register (again, remember
-			// endianness
+			// Clear bit 24 of channel control register
 			dma->channelRegisters[highestPriorityChannelSoFar * 3 + 2] &=
-					0xFFFFFFFE;
+					0xFEFFFFFF;
 
 			// Set bus holder back to CPU
 			R3051_setBusHolder(dma->cpu, PHILPSX_COMPONENTS_CPU);
 
-			// Trigger interrupt by masking correct bit (remember endianness)
-			int32_t tempInterruptRegister =
-					((dma->dmaInterruptRegister << 24) & 0xFF000000) |
-					((dma->dmaInterruptRegister << 8) & 0xFF0000) |
-					(logical_rshift(dma->dmaInterruptRegister, 8) & 0xFF00) |
-					(logical_rshift(dma->dmaInterruptRegister, 24) & 0xFF);
+			// Trigger interrupt by masking correct bit
+			int32_t tempInterruptRegister = dma->dmaInterruptRegister;
 			int32_t intMask = 0x00010000 << highestPriorityChannelSoFar;
 			intMask |= 0x00800000;
 
 			if ((tempInterruptRegister & intMask) == intMask) {
 				intMask = 0x01000000 << highestPriorityChannelSoFar;
 				tempInterruptRegister |= intMask;
-				dma->dmaInterruptRegister =
-						((tempInterruptRegister << 24) & 0xFF000000) |
-						((tempInterruptRegister << 8) & 0xFF0000) |
-						(logical_rshift(tempInterruptRegister, 8) & 0xFF00) |
-						(logical_rshift(tempInterruptRegister, 24) & 0xFF);
+				dma->dmaInterruptRegister = tempInterruptRegister;
 
 				// Set flag in system's Interrupt Status Register
 				SystemInterlink_setDMAInterruptDelay(dma->system, 0);
@@ -668,6 +656,8 @@ static void DMAArbiter_handleDMATransactions(DMAArbiter *dma)
 	}
 
 	//SystemInterlink_appendSyncCycles(dma->system, cpuCycles);
+
+	Profiler_leaveSubsystem(profiler, previousSubsystem);
 }
 
 /*
@@ -675,27 +665,15 @@ static void DMAArbiter_handleDMATransactions(DMAArbiter *dma)
  */
 static int32_t DMAArbiter_handleGPU(DMAArbiter *dma)
 {
-	// Get DMA base address and correct endianness
+	// Get DMA base address
 	int32_t baseAddress = dma->channelRegisters[PHILPSX_DMA_GPU * 3];
-	baseAddress = ((baseAddress << 24) & 0xFF000000) |
-			((baseAddress << 8) & 0xFF0000) |
-			(logical_rshift(baseAddress, 8) & 0xFF00) |
-			(logical_rshift(baseAddress, 24) & 0xFF);
 	baseAddress = Cop0_virtualToPhysical(R3051_getCop0(dma->cpu), baseAddress);
 
-	// Get block control and correct endianness
+	// Get block control
 	int32_t blockControl = dma->channelRegisters[PHILPSX_DMA_GPU * 3 + 1];
-	blockControl = ((blockControl << 24) & 0xFF000000) |
-			((blockControl << 8) & 0xFF0000) |
-			(logical_rshift(blockControl, 8) & 0xFF00) |
-			(logical_rshift(blockControl, 24) & 0xFF);
 
-	// Get channel control register and correct endianness
+	// Get channel control register
 	int32_t channelControl = dma->channelRegisters[PHILPSX_DMA_GPU * 3 + 2];
-	channelControl = ((channelControl << 24) & 0xFF000000) |
-			((channelControl << 8) & 0xFF0000) |
-			(logical_rshift(channelControl, 8) & 0xFF00) |
-			(logical_rshift(channelControl, 24) & 0xFF);
 
 	// Act according to specified mode
 	int32_t dmaCycles = 0;
@@ -766,8 +744,8 @@ static int32_t DMAArbiter_handleGPU(DMAArbiter *dma)
 					break;
 			}
 
-			// Set BA to 0 directly in register (little-endian) for speed
-			dma->channelRegisters[PHILPSX_DMA_GPU * 3 + 1] &= 0xFFFF0000;
+			// Set BA to 0 directly in register
+			dma->channelRegisters[PHILPSX_DMA_GPU * 3 + 1] &= 0xFFFF;
 
 		}
 		break;
@@ -779,16 +757,12 @@ static int32_t DMAArbiter_handleGPU(DMAArbiter *dma)
 				// Store as current address
 				int32_t currentAddress = nextAddress;
 
-				// Read word into nextAddress, update base address
-				// register and correct endianness
+				// Read word into nextAddress and update base address
+				// register
 				nextAddress =
 						SystemInterlink_readWord(dma->system, nextAddress);
 				dma->channelRegisters[PHILPSX_DMA_GPU * 3] =
-						nextAddress & 0xFFFFFF00;
-				nextAddress = ((nextAddress << 24) & 0xFF000000) |
-						((nextAddress << 8) & 0xFF0000) |
-						(logical_rshift(nextAddress, 8) & 0xFF00) |
-						(logical_rshift(nextAddress, 24) & 0xFF);
+						nextAddress & 0xFFFFFF;
 
 				// Get number of words we need and mask them from nextAddress
 				int32_t numOfWords =
@@ -823,20 +797,12 @@ static int32_t DMAArbiter_handleGPU(DMAArbiter *dma)
  */
 static int32_t DMAArbiter_handleOTC(DMAArbiter *dma)
 {
-	// Get DMA base address and correct endianness
+	// Get DMA base address
 	int32_t baseAddress = dma->channelRegisters[PHILPSX_DMA_OTC * 3];
-	baseAddress = ((baseAddress << 24) & 0xFF000000) |
-			((baseAddress << 8) & 0xFF0000) |
-			(logical_rshift(baseAddress, 8) & 0xFF00) |
-			(logical_rshift(baseAddress, 24) & 0xFF);
 	baseAddress = Cop0_virtualToPhysical(R3051_getCop0(dma->cpu), baseAddress);
 
-	// Get number of words and correct endianness
+	// Get number of words
 	int32_t numberOfWords = dma->channelRegisters[PHILPSX_DMA_OTC * 3 + 1];
-	numberOfWords = ((numberOfWords << 24) & 0xFF000000) |
-			((numberOfWords << 8) & 0xFF0000) |
-			(logical_rshift(numberOfWords, 8) & 0xFF00) |
-			(logical_rshift(numberOfWords, 24) & 0xFF);
 	numberOfWords &= 0xFFFF;
 	if (numberOfWords == 0)
 		numberOfWords = 0x10000;
@@ -847,10 +813,6 @@ static int32_t DMAArbiter_handleOTC(DMAArbiter *dma)
 	// Perform OTC transfer
 	int64_t currentWord = 0xFFFFFFFFL & baseAddress;
 	int32_t destinationWord = (int32_t)(currentWord - 4L);
-	destinationWord = ((destinationWord << 24) & 0xFF000000) |
-			((destinationWord << 8) & 0xFF0000) |
-			(logical_rshift(destinationWord, 8) & 0xFF00) |
-			(logical_rshift(destinationWord, 24) & 0xFF);
 
 	for (int32_t i = 0; i < numberOfWords - 1; ++i) {
 		SystemInterlink_writeWord(
@@ -860,21 +822,59 @@ static int32_t DMAArbiter_handleOTC(DMAArbiter *dma)
 				);
 		currentWord -= 4L;
 		destinationWord = (int32_t)(currentWord - 4L);
-		destinationWord = ((destinationWord << 24) & 0xFF000000) |
-				((destinationWord << 8) & 0xFF0000) |
-				(logical_rshift(destinationWord, 8) & 0xFF00) |
-				(logical_rshift(destinationWord, 24) & 0xFF);
 	}
-	SystemInterlink_writeWord(dma->system, (int32_t)currentWord, 0xFFFFFF00);
+	SystemInterlink_writeWord(dma->system, (int32_t)currentWord, 0xFFFFFF);
 
-	// Decrement BC if chopping enabled (detect in little-endian mode
-	// for speed)
-	switch (dma->channelRegisters[PHILPSX_DMA_OTC * 3 + 2] & 0x10000) {
-		case 0x10000:
-			// Set BC (again in little-endian mode for speed) to 0
-			dma->channelRegisters[PHILPSX_DMA_OTC * 3 + 1] &= 0xFFFF;
+	// Decrement BC if chopping enabled
+	switch (dma->channelRegisters[PHILPSX_DMA_OTC * 3 + 2] & 0x100) {
+		case 0x100:
+			// Set BC to 0
+			dma->channelRegisters[PHILPSX_DMA_OTC * 3 + 1] &= 0xFFFF0000;
 			break;
 	}
 
 	return dmaCycles;
+}
+
+/*
+ * This function handles byte reads from our I/O ports.
+ */
+static int8_t DMAArbiter_readPortByte(void *object, int32_t address)
+{
+	return DMAArbiter_readByte(object, address);
+}
+
+/*
+ * This function handles word reads from our I/O ports.
+ */
+static int32_t DMAArbiter_readPortWord(void *object, int32_t address)
+{
+	return DMAArbiter_readWord(object, address);
+}
+
+/*
+ * This function handles byte writes to our I/O ports.
+ */
+static void DMAArbiter_writePortByte(void *object, int32_t address,
+		int8_t value)
+{
+	DMAArbiter_writeByte(object, address, value);
+}
+
+/*
+ * This function handles halfword writes to our I/O ports.
+ */
+static void DMAArbiter_writePortHalfword(void *object, int32_t address,
+		int16_t value)
+{
+	DMAArbiter_writeHalfword(object, address, value);
+}
+
+/*
+ * This function handles word writes to our I/O ports.
+ */
+static void DMAArbiter_writePortWord(void *object, int32_t address,
+		int32_t word)
+{
+	DMAArbiter_writeWord(object, address, word);
 }
\ No newline at end of file
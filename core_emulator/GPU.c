@@ -16,6 +16,7 @@
 #include "../headers/GPU.h"
 #include "../headers/SystemInterlink.h"
 #include "../headers/ArrayList.h"
+#include "../headers/ClockDomain.h"
 #include "../headers/GLFunctionPointers.h"
 #include "../headers/WorkQueue.h"
 #include "../headers/math_utils.h"
@@ -94,6 +95,8 @@ static GLuint GPU_createShaderProgram(GPU *gpu, const char *name,
 		int shaderNumber);
 static void GPU_displayScreen(GPU *gpu);
 static void GPU_displayScreen_implementation(GpuCommand *command);
+static int64_t GPU_getCycleAfterGpuCycles(GPU *gpu, int32_t gpuCycles);
+static int32_t GPU_getFramePosition(GPU *gpu);
 static void GPU_monochromePolygon(GPU *gpu, int32_t command, int32_t vertex1,
 		int32_t vertex2, int32_t vertex3, int32_t vertex4);
 static void GPU_monochromePolygon_implementation(GpuCommand *command);
@@ -101,7 +104,9 @@ static void GPU_monochromeRectangle(GPU *gpu, int32_t command, int32_t vertex,
 		int32_t widthAndHeight);
 static void GPU_monochromeRectangle_implementation(GpuCommand *command);
 static int8_t GPU_readDMABuffer(GPU *gpu, int32_t index);
+static int32_t GPU_readPort(void *object, int32_t address);
 static bool GPU_realCheckOpenGLErrors(GPU *gpu, const char *message);
+static void GPU_scheduleVblankEvent(GPU *gpu);
 static void GPU_shadedPolygon(GPU *gpu, int32_t command, int32_t vertex1,
 		int32_t colour2, int32_t vertex2, int32_t colour3, int32_t vertex3,
 		int32_t colour4, int32_t vertex4);
@@ -121,7 +126,15 @@ static void GPU_texturedRectangle(GPU *gpu, int32_t command, int32_t vertex,
 		int32_t texCoordAndPalette, int32_t widthAndHeight);
 static void GPU_texturedRectangle_implementation(GpuCommand *command);
 static void GPU_triggerVblankInterrupt(GPU *gpu);
+static void GPU_vblankEvent(void *object);
 static void GPU_writeDMABuffer(GPU *gpu, int32_t index, int8_t value);
+static void GPU_writePort(void *object, int32_t address, int32_t word);
+
+// Handlers for our I/O ports, which only allow word access
+static const IOPortHandlers gpuPortHandlers = {
+	.readWord = GPU_readPort,
+	.writeWord = GPU_writePort
+};
 
 /*
  * This struct contains registers and state that we need in order to model
@@ -204,8 +217,9 @@ struct GPU {
 	int32_t gpureadLatchValue;
 	bool gpureadLatched;
 
-	// CPU and GPU cycle stores
-	int32_t cpuCycles;
+	// GPU clock, counting ticks since the GPU was last synced, and GPU cycle
+	// store
+	ClockDomain clock;
 	int32_t gpuCycles;
 
 	// This allows us to dynamically create the odd/even
@@ -223,8 +237,10 @@ struct GPU {
 	int32_t realHorizontalRes;
 	int32_t realVerticalRes;
 
-	// This lets us trigger only once per frame
+	// This lets us trigger only once per frame, and counts the frames
+	// displayed so far
 	bool vblankTriggered;
+	int64_t frameCount;
 };
 
 /*
@@ -319,12 +335,14 @@ GPU *construct_GPU(void)
 	gpu->gpureadLatchValue = 0;
 	gpu->gpureadLatched = false;
 
-	// Cpu cycles and gpu cycles
-	gpu->cpuCycles = 0;
+	// Last sync point and gpu cycles
+	construct_ClockDomain(&gpu->clock, PHILPSX_CLOCK_GPU_MULTIPLIER,
+			PHILPSX_CLOCK_GPU_DIVISOR, 0);
 	gpu->gpuCycles = 0;
 
-	// Setup VBLANK triggered flag
+	// Setup VBLANK triggered flag and frame count
 	gpu->vblankTriggered = false;
+	gpu->frameCount = 0;
 	
 	// Normal return:
 	return gpu;
@@ -357,14 +375,6 @@ void destruct_GPU(GPU *gpu)
 	free(gpu);
 }
 
-/*
- * This function updates the number of cycles the GPU needs to sync up by.
- */
-void GPU_appendSyncCycles(GPU *gpu, int32_t cycles)
-{
-	gpu->cpuCycles += cycles;
-}
-
 /*
  * This function cleans up OpenGL-related resources that are referenced by
  * the GPU. It is intended to be called from the GL context thread.
@@ -401,12 +411,16 @@ void GPU_cleanupGL(GPU *gpu)
 }
 
 /*
- * This function deals with counters and such like.
+ * This function deals with counters and such like, catching up with the CPU
+ * cycles that have passed since it was last called.
  */
 void GPU_executeGPUCycles(GPU *gpu)
 {
-	// Convert CPU cycles to GPU cycles
-	int32_t newGpuCycles = gpu->gpuCycles + gpu->cpuCycles * 11 / 7;
+	// Count GPU cycles since last sync, carrying any part of one over
+	int64_t currentCycle =
+			Scheduler_getCycles(SystemInterlink_getScheduler(gpu->system));
+	int32_t newGpuCycles = gpu->gpuCycles +
+			(int32_t)ClockDomain_consumeTicks(&gpu->clock, currentCycle);
 
 	// Test if we need to trigger a vblank interrupt
 	if (newGpuCycles > GPU_CYCLES_VBLANK && !gpu->vblankTriggered) {
@@ -414,7 +428,7 @@ void GPU_executeGPUCycles(GPU *gpu)
 		GPU_triggerVblankInterrupt(gpu);
 	}
 	
-	if (newGpuCycles > GPU_CYCLES_PER_FRAME) {
+	if (newGpuCycles >= GPU_CYCLES_PER_FRAME) {
 		// Reset vblank interrupt status
 		gpu->vblankTriggered = false;
 
@@ -429,43 +443,65 @@ void GPU_executeGPUCycles(GPU *gpu)
 
 	// Store state
 	gpu->gpuCycles = newGpuCycles;
-	gpu->cpuCycles = 0;
+
+	// Work out when the next vblank is due
+	GPU_scheduleVblankEvent(gpu);
 }
 
 /*
- * This function tells the caller how many gpu cycles should
- * be left after a round of incrementation based on the dotclock timer.
+ * This function returns the number of GPU cycles per dot at the current
+ * horizontal resolution, which is how often the dotclock ticks.
  */
-int32_t GPU_howManyDotclockGpuCyclesLeft(GPU *gpu, int32_t gpuCycles)
+int32_t GPU_getCyclesPerDot(GPU *gpu)
 {
-	return gpuCycles % gpu->dotFactor;
+	return gpu->dotFactor;
 }
 
 /*
- * This function tells the caller how many times to increment
- * the dotclock timer if needed.
+ * This function returns the number of GPU cycles per scanline, which is how
+ * often hblank comes round.
  */
-int32_t GPU_howManyDotclockIncrements(GPU *gpu, int32_t gpuCycles)
+int32_t GPU_getCyclesPerScanline(GPU *gpu)
 {
-	return gpuCycles / gpu->dotFactor;
+	return GPU_CYCLES_PER_SCANLINE;
 }
 
 /*
- * This function tells the caller how many gpu cycles should
- * be left after a round of incrementation based on the hblank timer.
+ * This function returns the CPU cycle at which the GPU next enters or leaves
+ * hblank, working it out directly from the position in the scanline.
  */
-int32_t GPU_howManyHblankGpuCyclesLeft(GPU *gpu, int32_t gpuCycles)
+int64_t GPU_getNextHblankChange(GPU *gpu)
 {
-	return gpuCycles % GPU_CYCLES_PER_SCANLINE;
+	int32_t positionInScanline =
+			GPU_getFramePosition(gpu) % GPU_CYCLES_PER_SCANLINE;
+	int32_t hblankStart = gpu->horizontalRes * gpu->dotFactor + 1;
+	int32_t gpuCyclesLeft = positionInScanline < hblankStart ?
+			hblankStart - positionInScanline :
+			GPU_CYCLES_PER_SCANLINE - positionInScanline;
+
+	return GPU_getCycleAfterGpuCycles(gpu, gpuCyclesLeft);
 }
 
 /*
- * This function tells the caller how many times to increment
- * the hblank timer if needed.
+ * This function returns the CPU cycle at which the GPU next enters or leaves
+ * vblank, working it out directly from the position in the frame.
  */
-int32_t GPU_howManyHblankIncrements(GPU *gpu, int32_t gpuCycles)
+int64_t GPU_getNextVblankChange(GPU *gpu)
 {
-	return gpuCycles / GPU_CYCLES_PER_SCANLINE;
+	int32_t positionInFrame = GPU_getFramePosition(gpu);
+	int32_t gpuCyclesLeft = positionInFrame <= GPU_CYCLES_VBLANK ?
+			GPU_CYCLES_VBLANK + 1 - positionInFrame :
+			GPU_CYCLES_PER_FRAME - positionInFrame;
+
+	return GPU_getCycleAfterGpuCycles(gpu, gpuCyclesLeft);
+}
+
+/*
+ * This function returns the number of frames displayed so far.
+ */
+int64_t GPU_getFrameCount(GPU *gpu)
+{
+	return gpu->frameCount;
 }
 
 /*
@@ -771,30 +807,25 @@ bool GPU_initGL(GPU *gpu)
 }
 
 /*
- * This function tells us whether the GPU is in hblank phase of scanline.
+ * This function tells us whether the GPU is in hblank phase of scanline, as
+ * of the current cycle count.
  */
 bool GPU_isInHblank(GPU *gpu)
 {
-	// Get scanline
-	int32_t scanline = gpu->gpuCycles / GPU_CYCLES_PER_SCANLINE;
-
-	// Get position in scanline
-	float positionInScanline = (float)gpu->gpuCycles -
-			(float)scanline * (float)GPU_CYCLES_PER_SCANLINE;
-
-	// Get dot value we are on
-	positionInScanline /= gpu->dotFactor;
-
-	return positionInScanline > gpu->horizontalRes;
+	// Past the last dot of the scanline means we are in hblank
+	int32_t positionInScanline =
+			GPU_getFramePosition(gpu) % GPU_CYCLES_PER_SCANLINE;
+	return positionInScanline > gpu->horizontalRes * gpu->dotFactor;
 }
 
 /*
- * This function tells us whether the GPU is in vblank phase of screen.
+ * This function tells us whether the GPU is in vblank phase of screen, as of
+ * the current cycle count.
  */
 bool GPU_isInVblank(GPU *gpu)
 {
 	// If we are over GPU_CYCLES_VBLANK we must be in vblank area
-	return gpu->gpuCycles > GPU_CYCLES_VBLANK;
+	return GPU_getFramePosition(gpu) > GPU_CYCLES_VBLANK;
 }
 
 /*
@@ -833,13 +864,10 @@ int32_t GPU_readResponse(GPU *gpu)
 					+ tempRowPixelOffset;
 
 			// Organise bytes into original structure
-			retVal = (int32_t)((int64_t)(GPU_readDMABuffer(gpu, pixelIndex + 3)
-						& 0x1) << 31);
-			retVal |= (GPU_readDMABuffer(gpu, pixelIndex + 2) & 0x1F) << 26;
-			retVal |= (GPU_readDMABuffer(gpu, pixelIndex + 1) & 0x1F) << 21;
-			retVal |= (GPU_readDMABuffer(gpu, pixelIndex) & 0x1F) << 16;
-			retVal = logical_rshift((retVal & 0xFF000000), 8) |
-					((retVal & 0xFF0000) << 8);
+			retVal = (GPU_readDMABuffer(gpu, pixelIndex + 3) & 0x1) << 15;
+			retVal |= (GPU_readDMABuffer(gpu, pixelIndex + 2) & 0x1F) << 10;
+			retVal |= (GPU_readDMABuffer(gpu, pixelIndex + 1) & 0x1F) << 5;
+			retVal |= GPU_readDMABuffer(gpu, pixelIndex) & 0x1F;
 
 			// Increment dmaBufferIndex by 4
 			gpu->dmaBufferIndex += 4;
@@ -856,13 +884,11 @@ int32_t GPU_readResponse(GPU *gpu)
 							 + tempRowPixelOffset;
 
 				// Organise bytes into original structure
-				retVal |= (GPU_readDMABuffer(gpu, pixelIndex + 3) & 0x1) << 15;
-				retVal |= (GPU_readDMABuffer(gpu, pixelIndex + 2) & 0x1F) << 10;
-				retVal |= (GPU_readDMABuffer(gpu, pixelIndex + 1) & 0x1F) << 5;
-				retVal |= GPU_readDMABuffer(gpu, pixelIndex) & 0x1F;
-				retVal = (retVal & 0xFFFF0000) |
-						 logical_rshift((retVal & 0xFF00), 8) |
-						 ((retVal & 0xFF) << 8);
+				retVal |= (int32_t)((int64_t)(GPU_readDMABuffer(gpu,
+						pixelIndex + 3) & 0x1) << 31);
+				retVal |= (GPU_readDMABuffer(gpu, pixelIndex + 2) & 0x1F) << 26;
+				retVal |= (GPU_readDMABuffer(gpu, pixelIndex + 1) & 0x1F) << 21;
+				retVal |= (GPU_readDMABuffer(gpu, pixelIndex) & 0x1F) << 16;
 				gpu->dmaBufferIndex += 4;
 			}
 
@@ -883,12 +909,6 @@ int32_t GPU_readResponse(GPU *gpu)
 			if (gpu->gpureadLatched) {
 				retVal = gpu->gpureadLatchValue;
 			}
-
-			// Reverse endianness as we are dealing with a register value
-			retVal = ((retVal << 24) & 0xFF000000) |
-					 ((retVal << 8) & 0xFF0000) |
-					 (logical_rshift(retVal, 8) & 0xFF00) |
-					 (logical_rshift(retVal, 24) & 0xFF);
 			break;
 	}
 
@@ -946,10 +966,7 @@ int32_t GPU_readStatus(GPU *gpu)
 
 	tempStatus |= mergeVal;
 
-	return ((tempStatus << 24) & 0xFF000000) |
-			((tempStatus << 8) & 0xFF0000) |
-			(logical_rshift(tempStatus, 8) & 0xFF00) |
-			(logical_rshift(tempStatus, 24) & 0xFF);
+	return tempStatus;
 }
 
 /*
@@ -967,6 +984,17 @@ void GPU_setGLFunctionPointers(GPU *gpu)
 void GPU_setMemoryInterface(GPU *gpu, SystemInterlink *smi)
 {
 	gpu->system = smi;
+
+	// Register handlers for our I/O ports
+	SystemInterlink_setIOPortHandlers(smi, 0x1F801810, 0x8,
+			&gpuPortHandlers, gpu);
+
+	// Setup vblank event, starting from the current cycle count
+	Scheduler *sched = SystemInterlink_getScheduler(smi);
+	Scheduler_setHandler(sched, PHILPSX_EVENT_VBLANK, GPU_vblankEvent, gpu);
+	construct_ClockDomain(&gpu->clock, PHILPSX_CLOCK_GPU_MULTIPLIER,
+			PHILPSX_CLOCK_GPU_DIVISOR, Scheduler_getCycles(sched));
+	GPU_scheduleVblankEvent(gpu);
 }
 
 /*
@@ -1001,6 +1029,11 @@ void GPU_setWorkQueue(GPU *gpu, WorkQueue *wq)
  */
 void GPU_submitToGP0(GPU *gpu, int32_t word)
 {
+	// Attribute time spent here to the GPU when profiling
+	Profiler *profiler = SystemInterlink_getProfiler(gpu->system);
+	int32_t previousSubsystem = Profiler_enterSubsystem(profiler,
+			PHILPSX_PROFILER_GPU);
+
 	// Sync up to CPU
 	GPU_executeGPUCycles(gpu);
 
@@ -1009,38 +1042,29 @@ void GPU_submitToGP0(GPU *gpu, int32_t word)
 		case -1: // No read
 			break;
 		default: // Read happening, return from method
+			Profiler_leaveSubsystem(profiler, previousSubsystem);
 			return;
 	}
 
-	// Switch endianness
-	int32_t commandByte = word & 0xFF;
-	word = ((word << 24) & 0xFF000000) |
-			((word << 8) & 0xFF0000) |
-			(logical_rshift(word, 8) & 0xFF00) |
-			(logical_rshift(word, 24) & 0xFF);
+	// Get command byte
+	int32_t commandByte = logical_rshift(word, 24) & 0xFF;
 
 	switch (gpu->dmaWriteInProgress) {
 		default: // Write in progress, handle appropriately
-			// Swap word order back as we are dumping this data straight to VRAM
-			word = ((word << 24) & 0xFF000000) |
-					((word << 8) & 0xFF0000) |
-					(logical_rshift(word, 8) & 0xFF00) |
-					(logical_rshift(word, 24) & 0xFF);
-
 			// Split first pixel into buffer
 			GPU_writeDMABuffer(gpu, gpu->dmaBufferIndex++,
-					(int8_t)(logical_rshift(word, 24) & 0xFF));
+					(int8_t)(word & 0xFF));
 			GPU_writeDMABuffer(gpu, gpu->dmaBufferIndex++,
-					(int8_t)(logical_rshift(word, 16) & 0xFF));
+					(int8_t)(logical_rshift(word, 8) & 0xFF));
 			GPU_writeDMABuffer(gpu, gpu->dmaBufferIndex++, (int8_t)0);
 			GPU_writeDMABuffer(gpu, gpu->dmaBufferIndex++, (int8_t)0);
 
 			// Test for second pixel and split as well if needed
 			if (gpu->dmaBufferIndex != gpu->dmaNeededBytes) {
 				GPU_writeDMABuffer(gpu, gpu->dmaBufferIndex++,
-						(int8_t)(logical_rshift(word, 8) & 0xFF));
+						(int8_t)(logical_rshift(word, 16) & 0xFF));
 				GPU_writeDMABuffer(gpu, gpu->dmaBufferIndex++,
-						(int8_t)(word & 0xFF));
+						(int8_t)(logical_rshift(word, 24) & 0xFF));
 				GPU_writeDMABuffer(gpu, gpu->dmaBufferIndex++, (int8_t)0);
 				GPU_writeDMABuffer(gpu, gpu->dmaBufferIndex++, (int8_t)0);
 			}
@@ -1999,6 +2023,8 @@ void GPU_submitToGP0(GPU *gpu, int32_t word)
 			}
 			break;
 	}
+
+	Profiler_leaveSubsystem(profiler, previousSubsystem);
 }
 
 /*
@@ -2006,15 +2032,14 @@ void GPU_submitToGP0(GPU *gpu, int32_t word)
  */
 void GPU_submitToGP1(GPU *gpu, int32_t word)
 {
+	// Attribute time spent here to the GPU when profiling
+	Profiler *profiler = SystemInterlink_getProfiler(gpu->system);
+	int32_t previousSubsystem = Profiler_enterSubsystem(profiler,
+			PHILPSX_PROFILER_GPU);
+
 	// Sync up to CPU
 	GPU_executeGPUCycles(gpu);
 
-	// Switch endianness
-	word = ((word << 24) & 0xFF000000) |
-			((word << 8) & 0xFF0000) |
-			(logical_rshift(word, 8) & 0xFF00) |
-			(logical_rshift(word, 24) & 0xFF);
-
 	// Submit to correct method
 	switch (logical_rshift(word, 24) & 0xFF) {
 		case 0:
@@ -2148,6 +2173,8 @@ void GPU_submitToGP1(GPU *gpu, int32_t word)
 					word);
 			break;
 	}
+
+	Profiler_leaveSubsystem(profiler, previousSubsystem);
 }
 
 /*
@@ -2852,6 +2879,7 @@ static void GPU_GP1_08(GPU *gpu, int32_t command)
 	gpu->statusRegister |= (command & 0x80) << 7;
 
 	// Now set cache values for horizontal resolution and dot factor
+	int32_t oldDotFactor = gpu->dotFactor;
 	switch (tempHoriz2) {
 		case 1:
 			gpu->horizontalRes = 368;
@@ -2879,6 +2907,10 @@ static void GPU_GP1_08(GPU *gpu, int32_t command)
 			break;
 	}
 
+	// Let the timers know if the dotclock has changed speed
+	if (gpu->dotFactor != oldDotFactor)
+		SystemInterlink_updateTimerClocks(gpu->system);
+
 	// Now set cache value for vertical resolution
 	switch (tempVert) {
 		case 0:
@@ -3459,6 +3491,32 @@ static void GPU_displayScreen_implementation(GpuCommand *command)
 	SDL_GL_SwapWindow(gpu->window);
 }
 
+/*
+ * This function returns the CPU cycle by which the GPU will have gone the
+ * specified number of GPU cycles past its position as of the current cycle
+ * count.
+ */
+static int64_t GPU_getCycleAfterGpuCycles(GPU *gpu, int32_t gpuCycles)
+{
+	int64_t currentCycle =
+			Scheduler_getCycles(SystemInterlink_getScheduler(gpu->system));
+	return ClockDomain_getCycleOfTick(&gpu->clock,
+			ClockDomain_getTicks(&gpu->clock, currentCycle) + gpuCycles);
+}
+
+/*
+ * This function returns the position of the GPU within the frame in GPU
+ * cycles, as of the current cycle count, without syncing it.
+ */
+static int32_t GPU_getFramePosition(GPU *gpu)
+{
+	int64_t currentCycle =
+			Scheduler_getCycles(SystemInterlink_getScheduler(gpu->system));
+	return (int32_t)((gpu->gpuCycles +
+			ClockDomain_getTicks(&gpu->clock, currentCycle)) %
+			GPU_CYCLES_PER_FRAME);
+}
+
 /*
  * This function draws a monochrome three or four point polygon, by queuing
  * this work on the rendering thread.
@@ -3921,6 +3979,18 @@ static int8_t GPU_readDMABuffer(GPU *gpu, int32_t index)
 	return value;
 }
 
+/*
+ * This function handles word reads from our I/O ports, returning a command
+ * response or the status register.
+ */
+static int32_t GPU_readPort(void *object, int32_t address)
+{
+	if ((address & 0x4) == 0)
+		return GPU_readResponse(object);
+	else
+		return GPU_readStatus(object);
+}
+
 /*
  * This function checks for and displays OpenGL errors.
  */
@@ -3978,6 +4048,23 @@ static bool GPU_realCheckOpenGLErrors(GPU *gpu, const char *message)
 	return errorDetected;
 }
 
+/*
+ * This function schedules the vblank event for the CPU cycle at which the GPU
+ * next passes the start of vblank, rounding up so it is never early.
+ */
+static void GPU_scheduleVblankEvent(GPU *gpu)
+{
+	// Work out GPU cycles until vblank is triggered
+	int64_t gpuCyclesLeft = GPU_CYCLES_VBLANK + 1 - gpu->gpuCycles;
+	if (gpu->vblankTriggered)
+		gpuCyclesLeft += GPU_CYCLES_PER_FRAME;
+
+	// Convert to CPU cycles and schedule
+	Scheduler_scheduleEvent(SystemInterlink_getScheduler(gpu->system),
+			PHILPSX_EVENT_VBLANK,
+			ClockDomain_getCycleOfTick(&gpu->clock, gpuCyclesLeft));
+}
+
 /**
  * This function draws a shaded three or four point polygon, by queuing
  * this work on the rendering thread.
@@ -5277,6 +5364,16 @@ static void GPU_triggerVblankInterrupt(GPU *gpu)
 
 	// Update screen
 	GPU_displayScreen(gpu);
+	++gpu->frameCount;
+}
+
+/*
+ * This function is run when the vblank event is due. Catching up the GPU
+ * triggers the vblank interrupt and schedules the next one.
+ */
+static void GPU_vblankEvent(void *object)
+{
+	GPU_executeGPUCycles(object);
 }
 
 /*
@@ -5287,4 +5384,16 @@ static void GPU_writeDMABuffer(GPU *gpu, int32_t index, int8_t value)
 	pthread_mutex_lock(&gpu->dmaBufferMutex);
 	gpu->dmaBuffer[index] = value;
 	pthread_mutex_unlock(&gpu->dmaBufferMutex);
+}
+
+/*
+ * This function handles word writes to our I/O ports, submitting the word to
+ * GP0 or GP1.
+ */
+static void GPU_writePort(void *object, int32_t address, int32_t word)
+{
+	if ((address & 0x4) == 0)
+		GPU_submitToGP0(object, word);
+	else
+		GPU_submitToGP1(object, word);
 }
\ No newline at end of file
@@ -0,0 +1,1260 @@
+/*
+ * This C file models the arithmetic kernels behind the heavy GTE functions
+ * (RTPT, MVMVA, NCDT, NCCT and DPCT) as a class. Each kernel runs the whole
+ * calculation of its function, working on all three lanes of a MAC or IR
+ * vector at once and keeping intermediate values in registers, and reports
+ * the flag register bits raised. There is a plain C version of each, and on
+ * x86-64 hosts an AVX2 version of each and SSE4.1 versions of the transforms
+ * too, with the best set the host CPU supports chosen at runtime. All
+ * versions give bit-exact results, flags included.
+ *
+ * GteKernels.c - Copyright Phillip Potter, 2020, under GPLv3
+ */
+#include <stdint.h>
+#include <stdbool.h>
+#include "../headers/GteKernels.h"
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+// Limit MAC1, MAC2 and MAC3 are checked against, along with the flag bits
+// set for lane 0 (the other lanes use the next bits down, in order)
+#define PHILPSX_GTEKERNELS_MAC_LIMIT 0x80000000000L
+#define PHILPSX_GTEKERNELS_MAC_POSITIVE_FLAG 0x40000000
+#define PHILPSX_GTEKERNELS_MAC_NEGATIVE_FLAG 0x8000000
+
+// Saturation limits of IR1, IR2 and IR3 and their flag bits
+#define PHILPSX_GTEKERNELS_IR_UPPER 0x7FFFL
+#define PHILPSX_GTEKERNELS_IR_LOWER -0x8000L
+#define PHILPSX_GTEKERNELS_IR_FLAG 0x1000000
+
+// Saturation limit of colour FIFO components and their flag bits
+#define PHILPSX_GTEKERNELS_COLOUR_UPPER 0xFFL
+#define PHILPSX_GTEKERNELS_COLOUR_FLAG 0x200000
+
+// Stages of the kernels must be inlined so that values stay in registers
+// between them
+#define PHILPSX_GTEKERNELS_INLINE static inline __attribute__((always_inline))
+
+// The saturation checks almost always go the same way, so the plain C
+// kernels are quicker branching on them than with GCC's conditional moves
+#if defined(__GNUC__) && !defined(__clang__)
+#define PHILPSX_GTEKERNELS_BRANCHES \
+	__attribute__((optimize("no-if-conversion", "no-if-conversion2")))
+#else
+#define PHILPSX_GTEKERNELS_BRANCHES
+#endif
+
+// Register numbers of kernel inputs
+#define PHILPSX_GTEKERNELS_BK 13
+#define PHILPSX_GTEKERNELS_FC 21
+#define PHILPSX_GTEKERNELS_RGBC 6
+#define PHILPSX_GTEKERNELS_IR0 8
+#define PHILPSX_GTEKERNELS_RGB0 20
+
+/*
+ * This struct holds lane masks (bit 0 for lane 0 and so on) of the
+ * conditions that raise flags, built up over a calculation.
+ */
+typedef struct {
+	int32_t macPositive;
+	int32_t macNegative;
+	int32_t ir;
+	int32_t colour;
+} GteKernelsMasks;
+
+// Forward declarations for functions private to this class
+// Plain C kernels:
+static void GteKernels_depthCueColoursScalar(const int32_t *controlRegisters,
+		const int32_t *dataRegisters, int32_t sf, int64_t lowerBound,
+		GteResult *results);
+static void GteKernels_lightVerticesScalar(const int16_t *lightMatrix,
+		const int16_t *colourMatrix, const int16_t *vectors,
+		const int32_t *controlRegisters, const int32_t *dataRegisters,
+		bool depthCue, int32_t sf, int64_t lowerBound, GteResult *results);
+static void GteKernels_transformScalar(const int16_t *matrix,
+		const int64_t *vector, const int64_t *translation, int32_t sf,
+		int64_t lowerBound, GteResult *result);
+static void GteKernels_transformVerticesScalar(const int16_t *matrix,
+		const int16_t *vectors, const int32_t *translation, int32_t sf,
+		GteResult *results);
+
+#if defined(__x86_64__)
+// SSE4.1 kernels:
+static void GteKernels_transformSse41(const int16_t *matrix,
+		const int64_t *vector, const int64_t *translation, int32_t sf,
+		int64_t lowerBound, GteResult *result);
+static void GteKernels_transformVerticesSse41(const int16_t *matrix,
+		const int16_t *vectors, const int32_t *translation, int32_t sf,
+		GteResult *results);
+
+// AVX2 kernels:
+static void GteKernels_depthCueColoursAvx2(const int32_t *controlRegisters,
+		const int32_t *dataRegisters, int32_t sf, int64_t lowerBound,
+		GteResult *results);
+static void GteKernels_lightVerticesAvx2(const int16_t *lightMatrix,
+		const int16_t *colourMatrix, const int16_t *vectors,
+		const int32_t *controlRegisters, const int32_t *dataRegisters,
+		bool depthCue, int32_t sf, int64_t lowerBound, GteResult *results);
+static void GteKernels_transformAvx2(const int16_t *matrix,
+		const int64_t *vector, const int64_t *translation, int32_t sf,
+		int64_t lowerBound, GteResult *result);
+static void GteKernels_transformVerticesAvx2(const int16_t *matrix,
+		const int16_t *vectors, const int32_t *translation, int32_t sf,
+		GteResult *results);
+#endif
+
+// Kernel sets to choose from
+static const GteKernels scalarKernels = {
+	.transform = GteKernels_transformScalar,
+	.transformVertices = GteKernels_transformVerticesScalar,
+	.lightVertices = GteKernels_lightVerticesScalar,
+	.depthCueColours = GteKernels_depthCueColoursScalar
+};
+
+#if defined(__x86_64__)
+// SSE4.1 has no 64-bit comparison, and the extra work to emulate it makes
+// the colour kernels slower than plain C, so those are kept scalar
+static const GteKernels sse41Kernels = {
+	.transform = GteKernels_transformSse41,
+	.transformVertices = GteKernels_transformVerticesSse41,
+	.lightVertices = GteKernels_lightVerticesScalar,
+	.depthCueColours = GteKernels_depthCueColoursScalar
+};
+
+static const GteKernels avx2Kernels = {
+	.transform = GteKernels_transformAvx2,
+	.transformVertices = GteKernels_transformVerticesAvx2,
+	.lightVertices = GteKernels_lightVerticesAvx2,
+	.depthCueColours = GteKernels_depthCueColoursAvx2
+};
+#endif
+
+/*
+ * This function returns the fastest set of kernels the host CPU supports.
+ */
+const GteKernels *GteKernels_select(void)
+{
+#if defined(__x86_64__)
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2"))
+		return &avx2Kernels;
+	if (__builtin_cpu_supports("sse4.1"))
+		return &sse41Kernels;
+#endif
+	return &scalarKernels;
+}
+
+/*
+ * This function converts a mask of lanes (bit 0 for lane 0 and so on) to
+ * flag bits, given the flag bit for lane 0.
+ */
+PHILPSX_GTEKERNELS_INLINE int32_t GteKernels_laneFlags(int32_t lanes, int32_t lane0Flag)
+{
+	// Reverse order of lane bits, as lane 0 uses the highest flag bit
+	static const int32_t reversedLanes[8] = { 0, 4, 2, 6, 1, 5, 3, 7 };
+	return reversedLanes[lanes & 7] * (lane0Flag >> 2);
+}
+
+/*
+ * This function converts the lane masks built up over a calculation to flag
+ * register bits.
+ */
+PHILPSX_GTEKERNELS_INLINE int32_t GteKernels_maskFlags(const GteKernelsMasks *masks)
+{
+	return GteKernels_laneFlags(masks->macPositive,
+			PHILPSX_GTEKERNELS_MAC_POSITIVE_FLAG) |
+			GteKernels_laneFlags(masks->macNegative,
+			PHILPSX_GTEKERNELS_MAC_NEGATIVE_FLAG) |
+			GteKernels_laneFlags(masks->ir, PHILPSX_GTEKERNELS_IR_FLAG) |
+			GteKernels_laneFlags(masks->colour,
+			PHILPSX_GTEKERNELS_COLOUR_FLAG);
+}
+
+/*
+ * The plain C kernels are built from the stages below, which mirror the
+ * steps the original per-function code took, with the three lanes written
+ * out so the compiler can keep them in registers. Each stage takes the lane
+ * masks to update, or NULL when the flags aren't needed.
+ */
+
+/*
+ * This function clamps a value to lower..upper, setting the specified lane
+ * bit in lanes if it had to.
+ */
+PHILPSX_GTEKERNELS_INLINE int64_t GteKernels_clampScalar(int64_t value, int64_t lower,
+		int64_t upper, int32_t lane, int32_t *lanes)
+{
+	if (value > upper) {
+		*lanes |= 1 << lane;
+		return upper;
+	} else if (value < lower) {
+		*lanes |= 1 << lane;
+		return lower;
+	}
+
+	return value;
+}
+
+/*
+ * This function checks MAC for overflow.
+ */
+PHILPSX_GTEKERNELS_INLINE void GteKernels_checkMacScalar(const int64_t *mac,
+		GteKernelsMasks *masks)
+{
+	if (!masks)
+		return;
+
+	masks->macPositive |= (mac[0] > PHILPSX_GTEKERNELS_MAC_LIMIT) |
+			(mac[1] > PHILPSX_GTEKERNELS_MAC_LIMIT) << 1 |
+			(mac[2] > PHILPSX_GTEKERNELS_MAC_LIMIT) << 2;
+	masks->macNegative |= (mac[0] < -PHILPSX_GTEKERNELS_MAC_LIMIT) |
+			(mac[1] < -PHILPSX_GTEKERNELS_MAC_LIMIT) << 1 |
+			(mac[2] < -PHILPSX_GTEKERNELS_MAC_LIMIT) << 2;
+}
+
+/*
+ * This function saturates a vector to IR within lowerBound..0x7FFF.
+ */
+PHILPSX_GTEKERNELS_INLINE void GteKernels_saturateIrScalar(const int64_t *value,
+		int64_t lowerBound, int64_t *ir, GteKernelsMasks *masks)
+{
+	int32_t lanes = 0;
+	ir[0] = GteKernels_clampScalar(value[0], lowerBound,
+			PHILPSX_GTEKERNELS_IR_UPPER, 0, &lanes);
+	ir[1] = GteKernels_clampScalar(value[1], lowerBound,
+			PHILPSX_GTEKERNELS_IR_UPPER, 1, &lanes);
+	ir[2] = GteKernels_clampScalar(value[2], lowerBound,
+			PHILPSX_GTEKERNELS_IR_UPPER, 2, &lanes);
+	if (masks)
+		masks->ir |= lanes;
+}
+
+/*
+ * This function shifts a vector right by (sf * 12) bits, preserving the sign
+ * bit.
+ */
+PHILPSX_GTEKERNELS_INLINE void GteKernels_shiftScalar(int64_t *vector, int32_t sf)
+{
+	vector[0] = vector[0] >> (sf * 12);
+	vector[1] = vector[1] >> (sf * 12);
+	vector[2] = vector[2] >> (sf * 12);
+}
+
+/*
+ * This function shifts MAC right by (sf * 12) bits, preserving the sign bit,
+ * then saturates it to IR and to the colour components.
+ */
+PHILPSX_GTEKERNELS_INLINE void GteKernels_finishScalar(int64_t *mac, int32_t sf,
+		int64_t lowerBound, int64_t *ir, int64_t *colour,
+		GteKernelsMasks *masks)
+{
+	GteKernels_shiftScalar(mac, sf);
+	GteKernels_checkMacScalar(mac, masks);
+	GteKernels_saturateIrScalar(mac, lowerBound, ir, masks);
+
+	int32_t lanes = 0;
+	colour[0] = GteKernels_clampScalar(mac[0] / 16, 0,
+			PHILPSX_GTEKERNELS_COLOUR_UPPER, 0, &lanes);
+	colour[1] = GteKernels_clampScalar(mac[1] / 16, 0,
+			PHILPSX_GTEKERNELS_COLOUR_UPPER, 1, &lanes);
+	colour[2] = GteKernels_clampScalar(mac[2] / 16, 0,
+			PHILPSX_GTEKERNELS_COLOUR_UPPER, 2, &lanes);
+	if (masks)
+		masks->colour |= lanes;
+}
+
+/*
+ * This function interpolates MAC towards the far colour by IR0.
+ */
+PHILPSX_GTEKERNELS_INLINE void GteKernels_interpolateScalar(const int64_t *farColour,
+		int64_t ir0, int32_t sf, int64_t *mac, GteKernelsMasks *masks)
+{
+	int64_t difference[3], ir[3];
+	difference[0] = farColour[0] * 0x1000 - mac[0];
+	difference[1] = farColour[1] * 0x1000 - mac[1];
+	difference[2] = farColour[2] * 0x1000 - mac[2];
+	GteKernels_shiftScalar(difference, sf);
+	GteKernels_saturateIrScalar(difference, PHILPSX_GTEKERNELS_IR_LOWER, ir,
+			masks);
+
+	mac[0] = ir[0] * ir0 + mac[0];
+	mac[1] = ir[1] * ir0 + mac[1];
+	mac[2] = ir[2] * ir0 + mac[2];
+	GteKernels_checkMacScalar(mac, masks);
+}
+
+/*
+ * This function multiplies the colour by IR into MAC.
+ */
+PHILPSX_GTEKERNELS_INLINE void GteKernels_modulateScalar(const int64_t *colour,
+		const int64_t *ir, int64_t *mac, GteKernelsMasks *masks)
+{
+	mac[0] = colour[0] * ir[0] * 16;
+	mac[1] = colour[1] * ir[1] * 16;
+	mac[2] = colour[2] * ir[2] * 16;
+	GteKernels_checkMacScalar(mac, masks);
+}
+
+/*
+ * This function multiplies the vector by the matrix (already unpacked) and
+ * adds the translation into MAC, then saturates it to IR.
+ */
+PHILPSX_GTEKERNELS_INLINE void GteKernels_multiplyScalar(const int64_t *matrix,
+		const int64_t *vector, const int64_t *translation, int32_t sf,
+		int64_t lowerBound, int64_t *mac, int64_t *ir,
+		GteKernelsMasks *masks)
+{
+	mac[0] = translation[0] * 0x1000 + matrix[0] * vector[0] +
+			matrix[1] * vector[1] + matrix[2] * vector[2];
+	mac[1] = translation[1] * 0x1000 + matrix[3] * vector[0] +
+			matrix[4] * vector[1] + matrix[5] * vector[2];
+	mac[2] = translation[2] * 0x1000 + matrix[6] * vector[0] +
+			matrix[7] * vector[1] + matrix[8] * vector[2];
+	GteKernels_shiftScalar(mac, sf);
+	GteKernels_checkMacScalar(mac, masks);
+	GteKernels_saturateIrScalar(mac, lowerBound, ir, masks);
+}
+
+/*
+ * This function reads three sign extended 32-bit registers into a vector.
+ */
+PHILPSX_GTEKERNELS_INLINE void GteKernels_readRegistersScalar(const int32_t *registers,
+		int64_t *vector)
+{
+	vector[0] = registers[0];
+	vector[1] = registers[1];
+	vector[2] = registers[2];
+}
+
+/*
+ * This function reads the 8-bit colour components of a register into a
+ * vector.
+ */
+PHILPSX_GTEKERNELS_INLINE void GteKernels_readColourScalar(int32_t colour,
+		int64_t *vector)
+{
+	vector[0] = 0xFF & colour;
+	vector[1] = 0xFF & (colour >> 8);
+	vector[2] = 0xFF & (colour >> 16);
+}
+
+/*
+ * This function reads the nine elements of a matrix.
+ */
+PHILPSX_GTEKERNELS_INLINE void GteKernels_readMatrixScalar(const int16_t *matrix,
+		int64_t *elements)
+{
+	for (int32_t i = 0; i < 9; ++i)
+		elements[i] = matrix[i];
+}
+
+/*
+ * This function reads the specified vector (V0, V1 or V2) into vector, sign
+ * extended.
+ */
+PHILPSX_GTEKERNELS_INLINE void GteKernels_readVectorScalar(const int16_t *vectors,
+		int32_t index, int64_t *vector)
+{
+	vector[0] = vectors[index * 3];
+	vector[1] = vectors[index * 3 + 1];
+	vector[2] = vectors[index * 3 + 2];
+}
+
+/*
+ * This function stores a vector to a result array.
+ */
+PHILPSX_GTEKERNELS_INLINE void GteKernels_storeScalar(int64_t *destination,
+		const int64_t *vector)
+{
+	destination[0] = vector[0];
+	destination[1] = vector[1];
+	destination[2] = vector[2];
+}
+
+/*
+ * This function performs the depthCueColours calculation for one colour,
+ * only working out flags if last is set.
+ */
+PHILPSX_GTEKERNELS_INLINE void GteKernels_depthCueColourScalar(const int64_t *farColour,
+		int64_t ir0, int32_t colourRegister, int32_t sf, int64_t lowerBound,
+		bool last, GteResult *result)
+{
+	GteKernelsMasks masks = { 0, 0, 0, 0 };
+	GteKernelsMasks *flagMasks = last ? &masks : NULL;
+	int64_t mac[3], ir[3], colour[3];
+	GteKernels_readColourScalar(colourRegister, colour);
+	mac[0] = colour[0] << 16;
+	mac[1] = colour[1] << 16;
+	mac[2] = colour[2] << 16;
+	GteKernels_interpolateScalar(farColour, ir0, sf, mac, flagMasks);
+	GteKernels_finishScalar(mac, sf, lowerBound, ir, colour, flagMasks);
+
+	GteKernels_storeScalar(result->mac, mac);
+	GteKernels_storeScalar(result->ir, ir);
+	GteKernels_storeScalar(result->colour, colour);
+	result->flags = GteKernels_maskFlags(&masks);
+}
+
+/*
+ * This function is the plain C version of depthCueColours.
+ */
+PHILPSX_GTEKERNELS_BRANCHES
+static void GteKernels_depthCueColoursScalar(const int32_t *controlRegisters,
+		const int32_t *dataRegisters, int32_t sf, int64_t lowerBound,
+		GteResult *results)
+{
+	int64_t farColour[3];
+	GteKernels_readRegistersScalar(controlRegisters + PHILPSX_GTEKERNELS_FC,
+			farColour);
+	int64_t ir0 = (int16_t)dataRegisters[PHILPSX_GTEKERNELS_IR0];
+
+	GteKernels_depthCueColourScalar(farColour, ir0,
+			dataRegisters[PHILPSX_GTEKERNELS_RGB0], sf, lowerBound, false,
+			results);
+	GteKernels_depthCueColourScalar(farColour, ir0,
+			dataRegisters[PHILPSX_GTEKERNELS_RGB0 + 1], sf, lowerBound, false,
+			results + 1);
+	GteKernels_depthCueColourScalar(farColour, ir0,
+			dataRegisters[PHILPSX_GTEKERNELS_RGB0 + 2], sf, lowerBound, true,
+			results + 2);
+}
+
+/*
+ * This function performs the lightVertices calculation for one vector, only
+ * working out flags if last is set.
+ */
+PHILPSX_GTEKERNELS_INLINE void GteKernels_lightVertexScalar(const int64_t *lightMatrix,
+		const int64_t *colourMatrix, const int64_t *backgroundColour,
+		const int64_t *farColour, const int64_t *colour, int64_t ir0,
+		const int16_t *vectors, int32_t index, bool depthCue,
+		int32_t sf, int64_t lowerBound, bool last, GteResult *result)
+{
+	static const int64_t noTranslation[3] = { 0, 0, 0 };
+	GteKernelsMasks masks = { 0, 0, 0, 0 };
+	GteKernelsMasks *flagMasks = last ? &masks : NULL;
+	int64_t vector[3], mac[3], lightIr[3], colourIr[3], ir[3], colourOut[3];
+	GteKernels_readVectorScalar(vectors, index, vector);
+	GteKernels_multiplyScalar(lightMatrix, vector, noTranslation, sf,
+			lowerBound, mac, lightIr, flagMasks);
+	GteKernels_multiplyScalar(colourMatrix, lightIr, backgroundColour, sf,
+			lowerBound, mac, colourIr, flagMasks);
+	GteKernels_modulateScalar(colour, colourIr, mac, flagMasks);
+	if (depthCue)
+		GteKernels_interpolateScalar(farColour, ir0, sf, mac, flagMasks);
+	GteKernels_finishScalar(mac, sf, lowerBound, ir, colourOut, flagMasks);
+
+	GteKernels_storeScalar(result->mac, mac);
+	GteKernels_storeScalar(result->ir, ir);
+	GteKernels_storeScalar(result->colour, colourOut);
+	result->flags = GteKernels_maskFlags(&masks);
+}
+
+/*
+ * This function is the plain C version of lightVertices.
+ */
+PHILPSX_GTEKERNELS_BRANCHES
+static void GteKernels_lightVerticesScalar(const int16_t *lightMatrix,
+		const int16_t *colourMatrix, const int16_t *vectors,
+		const int32_t *controlRegisters, const int32_t *dataRegisters,
+		bool depthCue, int32_t sf, int64_t lowerBound, GteResult *results)
+{
+	int64_t lightElements[9], colourElements[9];
+	int64_t backgroundColour[3], farColour[3], colour[3];
+	GteKernels_readMatrixScalar(lightMatrix, lightElements);
+	GteKernels_readMatrixScalar(colourMatrix, colourElements);
+	GteKernels_readRegistersScalar(controlRegisters + PHILPSX_GTEKERNELS_BK,
+			backgroundColour);
+	GteKernels_readRegistersScalar(controlRegisters + PHILPSX_GTEKERNELS_FC,
+			farColour);
+	GteKernels_readColourScalar(dataRegisters[PHILPSX_GTEKERNELS_RGBC],
+			colour);
+	int64_t ir0 = (int16_t)dataRegisters[PHILPSX_GTEKERNELS_IR0];
+
+	GteKernels_lightVertexScalar(lightElements, colourElements,
+			backgroundColour,
+			farColour, colour, ir0, vectors, 0, depthCue, sf,
+			lowerBound, false, results);
+	GteKernels_lightVertexScalar(lightElements, colourElements,
+			backgroundColour,
+			farColour, colour, ir0, vectors, 1, depthCue, sf,
+			lowerBound, false, results + 1);
+	GteKernels_lightVertexScalar(lightElements, colourElements,
+			backgroundColour,
+			farColour, colour, ir0, vectors, 2, depthCue, sf,
+			lowerBound, true, results + 2);
+}
+
+/*
+ * This function is the plain C version of transform.
+ */
+PHILPSX_GTEKERNELS_BRANCHES
+static void GteKernels_transformScalar(const int16_t *matrix,
+		const int64_t *vector, const int64_t *translation, int32_t sf,
+		int64_t lowerBound, GteResult *result)
+{
+	GteKernelsMasks masks = { 0, 0, 0, 0 };
+	int64_t elements[9], mac[3], ir[3];
+	GteKernels_readMatrixScalar(matrix, elements);
+	GteKernels_multiplyScalar(elements, vector, translation, sf, lowerBound,
+			mac, ir, &masks);
+
+	GteKernels_storeScalar(result->mac, mac);
+	GteKernels_storeScalar(result->ir, ir);
+	result->flags = GteKernels_maskFlags(&masks);
+}
+
+/*
+ * This function performs the transformVertices calculation for one vector,
+ * only working out flags if last is set.
+ */
+PHILPSX_GTEKERNELS_INLINE void GteKernels_transformVertexScalar(const int64_t *matrix,
+		const int64_t *translation, const int16_t *vectors,
+		int32_t index, int32_t sf, bool last, GteResult *result)
+{
+	GteKernelsMasks masks = { 0, 0, 0, 0 };
+	int64_t vector[3], mac[3], ir[3];
+	GteKernels_readVectorScalar(vectors, index, vector);
+	GteKernels_multiplyScalar(matrix, vector, translation, sf,
+			PHILPSX_GTEKERNELS_IR_LOWER, mac, ir, last ? &masks : NULL);
+
+	GteKernels_storeScalar(result->mac, mac);
+	GteKernels_storeScalar(result->ir, ir);
+	result->flags = GteKernels_maskFlags(&masks);
+}
+
+/*
+ * This function is the plain C version of transformVertices.
+ */
+PHILPSX_GTEKERNELS_BRANCHES
+static void GteKernels_transformVerticesScalar(const int16_t *matrix,
+		const int16_t *vectors, const int32_t *translation, int32_t sf,
+		GteResult *results)
+{
+	int64_t elements[9], offset[3];
+	GteKernels_readMatrixScalar(matrix, elements);
+	GteKernels_readRegistersScalar(translation, offset);
+
+	GteKernels_transformVertexScalar(elements, offset, vectors, 0,
+			sf, false, results);
+	GteKernels_transformVertexScalar(elements, offset, vectors, 1,
+			sf, false, results + 1);
+	GteKernels_transformVertexScalar(elements, offset, vectors, 2,
+			sf, true, results + 2);
+}
+
+#if defined(__x86_64__)
+/*
+ * The vector kernels are built from the same stages as the plain C ones.
+ * The SSE4.1 stages keep lanes 0 and 1 in one register and lane 2 in the low
+ * half of another, while the AVX2 stages keep all three in one register. The
+ * spare lane is never looked at, so it can hold anything. Conditions raising
+ * flags are collected as lane masks in registers, and only turned into flag
+ * bits at the end of a calculation. As with the plain C stages, the masks
+ * are NULL when the flags aren't needed.
+ *
+ * Neither instruction set can shift 64-bit lanes arithmetically, and SSE4.1
+ * can't compare them either, so these are built from other operations. The
+ * SSE4.1 comparisons subtract and test the sign of the result, which is exact
+ * as GTE intermediate values stay well within 48 bits.
+ */
+
+/*
+ * This struct holds the SSE4.1 lane masks of the conditions that raise
+ * flags, built up over a calculation.
+ */
+typedef struct {
+	__m128i macPositive[2];
+	__m128i macNegative[2];
+	__m128i ir[2];
+} GteKernelsSse41Masks;
+
+/*
+ * This function clears a set of SSE4.1 lane masks.
+ */
+__attribute__((target("sse4.1")))
+PHILPSX_GTEKERNELS_INLINE void GteKernels_clearMasksSse41(GteKernelsSse41Masks *masks)
+{
+	for (int32_t i = 0; i < 2; ++i) {
+		masks->macPositive[i] = _mm_setzero_si128();
+		masks->macNegative[i] = _mm_setzero_si128();
+		masks->ir[i] = _mm_setzero_si128();
+	}
+}
+
+/*
+ * This function returns a bit mask of the set lanes of a vector.
+ */
+__attribute__((target("sse4.1")))
+PHILPSX_GTEKERNELS_INLINE int32_t GteKernels_lanesSse41(const __m128i *mask)
+{
+	return _mm_movemask_pd(_mm_castsi128_pd(mask[0])) |
+			(_mm_movemask_pd(_mm_castsi128_pd(mask[1])) & 1) << 2;
+}
+
+/*
+ * This function converts a set of SSE4.1 lane masks to flag register bits.
+ */
+__attribute__((target("sse4.1")))
+PHILPSX_GTEKERNELS_INLINE int32_t GteKernels_maskFlagsSse41(
+		const GteKernelsSse41Masks *masks)
+{
+	GteKernelsMasks lanes = {
+		.macPositive = GteKernels_lanesSse41(masks->macPositive),
+		.macNegative = GteKernels_lanesSse41(masks->macNegative),
+		.ir = GteKernels_lanesSse41(masks->ir)
+	};
+	return GteKernels_maskFlags(&lanes);
+}
+
+/*
+ * This function broadcasts a lane of a vector to a whole register.
+ */
+__attribute__((target("sse4.1")))
+PHILPSX_GTEKERNELS_INLINE __m128i GteKernels_broadcastSse41(const __m128i *vector,
+		int32_t lane)
+{
+	switch (lane) {
+		case 0:
+			return _mm_unpacklo_epi64(vector[0], vector[0]);
+		case 1:
+			return _mm_unpackhi_epi64(vector[0], vector[0]);
+		default:
+			return _mm_unpacklo_epi64(vector[1], vector[1]);
+	}
+}
+
+/*
+ * This function returns a mask of the lanes of a that are greater than those
+ * of b.
+ */
+__attribute__((target("sse4.1")))
+PHILPSX_GTEKERNELS_INLINE __m128i GteKernels_greaterThanSse41(__m128i a, __m128i b)
+{
+	return _mm_shuffle_epi32(_mm_srai_epi32(_mm_sub_epi64(b, a), 31),
+			_MM_SHUFFLE(3, 3, 1, 1));
+}
+
+/*
+ * This function checks MAC for overflow.
+ */
+__attribute__((target("sse4.1")))
+PHILPSX_GTEKERNELS_INLINE void GteKernels_checkMacSse41(const __m128i *mac,
+		GteKernelsSse41Masks *masks)
+{
+	if (!masks)
+		return;
+
+	__m128i positiveLimit = _mm_set1_epi64x(PHILPSX_GTEKERNELS_MAC_LIMIT);
+	__m128i negativeLimit = _mm_set1_epi64x(-PHILPSX_GTEKERNELS_MAC_LIMIT);
+	for (int32_t i = 0; i < 2; ++i) {
+		masks->macPositive[i] = _mm_or_si128(masks->macPositive[i],
+				GteKernels_greaterThanSse41(mac[i], positiveLimit));
+		masks->macNegative[i] = _mm_or_si128(masks->macNegative[i],
+				GteKernels_greaterThanSse41(negativeLimit, mac[i]));
+	}
+}
+
+/*
+ * This function saturates a vector to IR within lowerBound..0x7FFF.
+ */
+__attribute__((target("sse4.1")))
+PHILPSX_GTEKERNELS_INLINE void GteKernels_saturateIrSse41(const __m128i *value,
+		int64_t lowerBound, __m128i *ir, GteKernelsSse41Masks *masks)
+{
+	__m128i upper = _mm_set1_epi64x(PHILPSX_GTEKERNELS_IR_UPPER);
+	__m128i lower = _mm_set1_epi64x(lowerBound);
+	for (int32_t i = 0; i < 2; ++i) {
+		__m128i tooHigh = GteKernels_greaterThanSse41(value[i], upper);
+		__m128i tooLow = GteKernels_greaterThanSse41(lower, value[i]);
+		ir[i] = _mm_blendv_epi8(_mm_blendv_epi8(value[i], upper, tooHigh),
+				lower, tooLow);
+		if (masks)
+			masks->ir[i] = _mm_or_si128(masks->ir[i],
+					_mm_or_si128(tooHigh, tooLow));
+	}
+}
+
+/*
+ * This function shifts a register right by (sf * 12) bits, preserving the
+ * sign bit.
+ */
+__attribute__((target("sse4.1")))
+PHILPSX_GTEKERNELS_INLINE __m128i GteKernels_shiftSse41(__m128i value, int32_t sf)
+{
+	if (!sf)
+		return value;
+	__m128i sign = _mm_shuffle_epi32(_mm_srai_epi32(value, 31),
+			_MM_SHUFFLE(3, 3, 1, 1));
+	return _mm_or_si128(_mm_srli_epi64(value, 12), _mm_slli_epi64(sign, 52));
+}
+
+/*
+ * This function is the SSE4.1 version of the matrix multiplication stage,
+ * taking the matrix columns, the vector lanes broadcast to whole registers
+ * and the translation already multiplied by 0x1000.
+ */
+__attribute__((target("sse4.1")))
+PHILPSX_GTEKERNELS_INLINE void GteKernels_multiplySse41(const __m128i *columns,
+		const __m128i *vector, const __m128i *translation, int32_t sf,
+		int64_t lowerBound, __m128i *mac, __m128i *ir,
+		GteKernelsSse41Masks *masks)
+{
+	for (int32_t i = 0; i < 2; ++i) {
+		__m128i sum = _mm_add_epi64(translation[i],
+				_mm_mul_epi32(columns[i], vector[0]));
+		sum = _mm_add_epi64(sum, _mm_mul_epi32(columns[i + 2], vector[1]));
+		sum = _mm_add_epi64(sum, _mm_mul_epi32(columns[i + 4], vector[2]));
+		mac[i] = GteKernels_shiftSse41(sum, sf);
+	}
+	GteKernels_checkMacSse41(mac, masks);
+	GteKernels_saturateIrSse41(mac, lowerBound, ir, masks);
+}
+
+/*
+ * This function reads the columns of a matrix, sign extended.
+ */
+__attribute__((target("sse4.1")))
+PHILPSX_GTEKERNELS_INLINE void GteKernels_readMatrixSse41(const int16_t *matrix,
+		__m128i *columns)
+{
+	__m128i elements = _mm_loadu_si128((const __m128i *)matrix);
+	__m128i column0 = _mm_shuffle_epi8(elements, _mm_setr_epi8(
+			0, 1, 6, 7, 12, 13, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1));
+	__m128i column1 = _mm_shuffle_epi8(elements, _mm_setr_epi8(
+			2, 3, 8, 9, 14, 15, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1));
+	__m128i column2 = _mm_insert_epi16(_mm_shuffle_epi8(elements,
+			_mm_setr_epi8(4, 5, 10, 11, -1, -1, -1, -1,
+			-1, -1, -1, -1, -1, -1, -1, -1)), matrix[8], 2);
+	columns[0] = _mm_cvtepi16_epi64(column0);
+	columns[1] = _mm_cvtepi16_epi64(_mm_srli_si128(column0, 4));
+	columns[2] = _mm_cvtepi16_epi64(column1);
+	columns[3] = _mm_cvtepi16_epi64(_mm_srli_si128(column1, 4));
+	columns[4] = _mm_cvtepi16_epi64(column2);
+	columns[5] = _mm_cvtepi16_epi64(_mm_srli_si128(column2, 4));
+}
+
+/*
+ * This function reads three sign extended 32-bit registers into a vector,
+ * multiplied by 0x1000.
+ */
+__attribute__((target("sse4.1")))
+PHILPSX_GTEKERNELS_INLINE void GteKernels_readRegistersSse41(const int32_t *registers,
+		__m128i *vector)
+{
+	vector[0] = _mm_slli_epi64(_mm_cvtepi32_epi64(
+			_mm_loadl_epi64((const __m128i *)registers)), 12);
+	vector[1] = _mm_slli_epi64(_mm_cvtepi32_epi64(
+			_mm_cvtsi32_si128(registers[2])), 12);
+}
+
+/*
+ * This function reads the specified vector (V0, V1 or V2) with each lane
+ * broadcast to a whole register, sign extended.
+ */
+__attribute__((target("sse4.1")))
+PHILPSX_GTEKERNELS_INLINE void GteKernels_readVectorSse41(const int16_t *vectors,
+		int32_t index, __m128i *vector)
+{
+	vector[0] = _mm_set1_epi64x(vectors[index * 3]);
+	vector[1] = _mm_set1_epi64x(vectors[index * 3 + 1]);
+	vector[2] = _mm_set1_epi64x(vectors[index * 3 + 2]);
+}
+
+/*
+ * This function stores a vector to a result array.
+ */
+__attribute__((target("sse4.1")))
+PHILPSX_GTEKERNELS_INLINE void GteKernels_storeSse41(int64_t *destination,
+		const __m128i *vector)
+{
+	_mm_storeu_si128((__m128i *)destination, vector[0]);
+	_mm_storeu_si128((__m128i *)(destination + 2), vector[1]);
+}
+
+/*
+ * This function is the SSE4.1 version of transform.
+ */
+__attribute__((target("sse4.1")))
+static void GteKernels_transformSse41(const int16_t *matrix,
+		const int64_t *vector, const int64_t *translation, int32_t sf,
+		int64_t lowerBound, GteResult *result)
+{
+	GteKernelsSse41Masks masks;
+	GteKernels_clearMasksSse41(&masks);
+	__m128i columns[6], lanes[3], offset[2], mac[2], ir[2];
+	GteKernels_readMatrixSse41(matrix, columns);
+	lanes[0] = _mm_set1_epi64x(vector[0]);
+	lanes[1] = _mm_set1_epi64x(vector[1]);
+	lanes[2] = _mm_set1_epi64x(vector[2]);
+	offset[0] = _mm_slli_epi64(
+			_mm_loadu_si128((const __m128i *)translation), 12);
+	offset[1] = _mm_slli_epi64(
+			_mm_loadl_epi64((const __m128i *)(translation + 2)), 12);
+
+	GteKernels_multiplySse41(columns, lanes, offset, sf, lowerBound, mac, ir,
+			&masks);
+	GteKernels_storeSse41(result->mac, mac);
+	GteKernels_storeSse41(result->ir, ir);
+	result->flags = GteKernels_maskFlagsSse41(&masks);
+}
+
+/*
+ * This function performs the transformVertices calculation for one vector,
+ * only working out flags if last is set.
+ */
+__attribute__((target("sse4.1")))
+PHILPSX_GTEKERNELS_INLINE void GteKernels_transformVertexSse41(
+		const __m128i *columns, const __m128i *translation,
+		const int16_t *vectors, int32_t index, int32_t sf, bool last,
+		GteResult *result)
+{
+	GteKernelsSse41Masks masks;
+	GteKernels_clearMasksSse41(&masks);
+	__m128i vector[3], mac[2], ir[2];
+	GteKernels_readVectorSse41(vectors, index, vector);
+	GteKernels_multiplySse41(columns, vector, translation, sf,
+			PHILPSX_GTEKERNELS_IR_LOWER, mac, ir, last ? &masks : NULL);
+
+	GteKernels_storeSse41(result->mac, mac);
+	GteKernels_storeSse41(result->ir, ir);
+	result->flags = last ? GteKernels_maskFlagsSse41(&masks) : 0;
+}
+
+/*
+ * This function is the SSE4.1 version of transformVertices.
+ */
+__attribute__((target("sse4.1")))
+static void GteKernels_transformVerticesSse41(const int16_t *matrix,
+		const int16_t *vectors, const int32_t *translation, int32_t sf,
+		GteResult *results)
+{
+	__m128i columns[6], offset[2];
+	GteKernels_readMatrixSse41(matrix, columns);
+	GteKernels_readRegistersSse41(translation, offset);
+
+	GteKernels_transformVertexSse41(columns, offset, vectors, 0,
+			sf, false, results);
+	GteKernels_transformVertexSse41(columns, offset, vectors, 1,
+			sf, false, results + 1);
+	GteKernels_transformVertexSse41(columns, offset, vectors, 2,
+			sf, true, results + 2);
+}
+
+/*
+ * This struct holds the AVX2 lane masks of the conditions that raise flags,
+ * built up over a calculation.
+ */
+typedef struct {
+	__m256i macPositive;
+	__m256i macNegative;
+	__m256i ir;
+	__m256i colour;
+} GteKernelsAvx2Masks;
+
+/*
+ * This function clears a set of AVX2 lane masks.
+ */
+__attribute__((target("avx2")))
+PHILPSX_GTEKERNELS_INLINE void GteKernels_clearMasksAvx2(GteKernelsAvx2Masks *masks)
+{
+	masks->macPositive = _mm256_setzero_si256();
+	masks->macNegative = _mm256_setzero_si256();
+	masks->ir = _mm256_setzero_si256();
+	masks->colour = _mm256_setzero_si256();
+}
+
+/*
+ * This function returns a bit mask of the set lanes of a register.
+ */
+__attribute__((target("avx2")))
+PHILPSX_GTEKERNELS_INLINE int32_t GteKernels_lanesAvx2(__m256i mask)
+{
+	return _mm256_movemask_pd(_mm256_castsi256_pd(mask));
+}
+
+/*
+ * This function converts a set of AVX2 lane masks to flag register bits.
+ */
+__attribute__((target("avx2")))
+PHILPSX_GTEKERNELS_INLINE int32_t GteKernels_maskFlagsAvx2(
+		const GteKernelsAvx2Masks *masks)
+{
+	GteKernelsMasks lanes = {
+		.macPositive = GteKernels_lanesAvx2(masks->macPositive),
+		.macNegative = GteKernels_lanesAvx2(masks->macNegative),
+		.ir = GteKernels_lanesAvx2(masks->ir),
+		.colour = GteKernels_lanesAvx2(masks->colour)
+	};
+	return GteKernels_maskFlags(&lanes);
+}
+
+/*
+ * This function checks MAC for overflow.
+ */
+__attribute__((target("avx2")))
+PHILPSX_GTEKERNELS_INLINE void GteKernels_checkMacAvx2(__m256i mac,
+		GteKernelsAvx2Masks *masks)
+{
+	if (!masks)
+		return;
+
+	masks->macPositive = _mm256_or_si256(masks->macPositive,
+			_mm256_cmpgt_epi64(mac,
+			_mm256_set1_epi64x(PHILPSX_GTEKERNELS_MAC_LIMIT)));
+	masks->macNegative = _mm256_or_si256(masks->macNegative,
+			_mm256_cmpgt_epi64(
+			_mm256_set1_epi64x(-PHILPSX_GTEKERNELS_MAC_LIMIT), mac));
+}
+
+/*
+ * This function saturates a register to IR within lowerBound..0x7FFF.
+ */
+__attribute__((target("avx2")))
+PHILPSX_GTEKERNELS_INLINE void GteKernels_saturateIrAvx2(__m256i value,
+		int64_t lowerBound, __m256i *ir, GteKernelsAvx2Masks *masks)
+{
+	__m256i upper = _mm256_set1_epi64x(PHILPSX_GTEKERNELS_IR_UPPER);
+	__m256i lower = _mm256_set1_epi64x(lowerBound);
+	__m256i tooHigh = _mm256_cmpgt_epi64(value, upper);
+	__m256i tooLow = _mm256_cmpgt_epi64(lower, value);
+	*ir = _mm256_blendv_epi8(_mm256_blendv_epi8(value, upper, tooHigh),
+			lower, tooLow);
+	if (masks)
+		masks->ir = _mm256_or_si256(masks->ir,
+				_mm256_or_si256(tooHigh, tooLow));
+}
+
+/*
+ * This function shifts a register right by (sf * 12) bits, preserving the
+ * sign bit.
+ */
+__attribute__((target("avx2")))
+PHILPSX_GTEKERNELS_INLINE __m256i GteKernels_shiftAvx2(__m256i value, int32_t sf)
+{
+	if (!sf)
+		return value;
+	__m256i sign = _mm256_cmpgt_epi64(_mm256_setzero_si256(), value);
+	return _mm256_or_si256(_mm256_srli_epi64(value, 12),
+			_mm256_slli_epi64(sign, 52));
+}
+
+/*
+ * This function is the AVX2 version of the finishing stage.
+ */
+__attribute__((target("avx2")))
+PHILPSX_GTEKERNELS_INLINE void GteKernels_finishAvx2(__m256i *mac, int32_t sf,
+		int64_t lowerBound, __m256i *ir, __m256i *colour,
+		GteKernelsAvx2Masks *masks)
+{
+	*mac = GteKernels_shiftAvx2(*mac, sf);
+	GteKernels_checkMacAvx2(*mac, masks);
+	GteKernels_saturateIrAvx2(*mac, lowerBound, ir, masks);
+
+	// Dividing by 16 rounds towards zero, so only values of -16 and below
+	// end up negative
+	__m256i zero = _mm256_setzero_si256();
+	__m256i upper =
+			_mm256_set1_epi64x(PHILPSX_GTEKERNELS_COLOUR_UPPER * 16 + 15);
+	__m256i tooHigh = _mm256_cmpgt_epi64(*mac, upper);
+	__m256i tooLow = _mm256_cmpgt_epi64(_mm256_set1_epi64x(-16 + 1), *mac);
+	*colour = _mm256_blendv_epi8(*mac, zero, _mm256_cmpgt_epi64(zero, *mac));
+	*colour = _mm256_srli_epi64(_mm256_blendv_epi8(*colour, upper, tooHigh),
+			4);
+	if (masks)
+		masks->colour = _mm256_or_si256(masks->colour,
+				_mm256_or_si256(tooHigh, tooLow));
+}
+
+/*
+ * This function is the AVX2 version of the interpolation stage, with the
+ * far colour already multiplied by 0x1000.
+ */
+__attribute__((target("avx2")))
+PHILPSX_GTEKERNELS_INLINE void GteKernels_interpolateAvx2(__m256i farColour,
+		__m256i ir0, int32_t sf, __m256i *mac, GteKernelsAvx2Masks *masks)
+{
+	__m256i ir;
+	GteKernels_saturateIrAvx2(GteKernels_shiftAvx2(
+			_mm256_sub_epi64(farColour, *mac), sf),
+			PHILPSX_GTEKERNELS_IR_LOWER, &ir, masks);
+
+	*mac = _mm256_add_epi64(_mm256_mul_epi32(ir, ir0), *mac);
+	GteKernels_checkMacAvx2(*mac, masks);
+}
+
+/*
+ * This function is the AVX2 version of the colour multiplication stage.
+ */
+__attribute__((target("avx2")))
+PHILPSX_GTEKERNELS_INLINE void GteKernels_modulateAvx2(__m256i colour, __m256i ir,
+		__m256i *mac, GteKernelsAvx2Masks *masks)
+{
+	*mac = _mm256_slli_epi64(_mm256_mul_epi32(colour, ir), 4);
+	GteKernels_checkMacAvx2(*mac, masks);
+}
+
+/*
+ * This function is the AVX2 version of the matrix multiplication stage,
+ * taking the matrix columns, the vector lanes broadcast to whole registers
+ * and the translation already multiplied by 0x1000.
+ */
+__attribute__((target("avx2")))
+PHILPSX_GTEKERNELS_INLINE void GteKernels_multiplyAvx2(const __m256i *columns,
+		const __m256i *vector, __m256i translation, int32_t sf,
+		int64_t lowerBound, __m256i *mac, __m256i *ir,
+		GteKernelsAvx2Masks *masks)
+{
+	__m256i sum = _mm256_add_epi64(translation,
+			_mm256_mul_epi32(columns[0], vector[0]));
+	sum = _mm256_add_epi64(sum, _mm256_mul_epi32(columns[1], vector[1]));
+	sum = _mm256_add_epi64(sum, _mm256_mul_epi32(columns[2], vector[2]));
+	*mac = GteKernels_shiftAvx2(sum, sf);
+	GteKernels_checkMacAvx2(*mac, masks);
+	GteKernels_saturateIrAvx2(*mac, lowerBound, ir, masks);
+}
+
+/*
+ * This function reads the 8-bit colour components of a register into a
+ * vector.
+ */
+__attribute__((target("avx2")))
+PHILPSX_GTEKERNELS_INLINE __m256i GteKernels_readColourAvx2(int32_t colour)
+{
+	return _mm256_cvtepu8_epi64(_mm_cvtsi32_si128(colour));
+}
+
+/*
+ * This function reads the columns of a matrix, sign extended.
+ */
+__attribute__((target("avx2")))
+PHILPSX_GTEKERNELS_INLINE void GteKernels_readMatrixAvx2(const int16_t *matrix,
+		__m256i *columns)
+{
+	__m128i elements = _mm_loadu_si128((const __m128i *)matrix);
+	columns[0] = _mm256_cvtepi16_epi64(_mm_shuffle_epi8(elements,
+			_mm_setr_epi8(0, 1, 6, 7, 12, 13, -1, -1,
+			-1, -1, -1, -1, -1, -1, -1, -1)));
+	columns[1] = _mm256_cvtepi16_epi64(_mm_shuffle_epi8(elements,
+			_mm_setr_epi8(2, 3, 8, 9, 14, 15, -1, -1,
+			-1, -1, -1, -1, -1, -1, -1, -1)));
+	columns[2] = _mm256_cvtepi16_epi64(_mm_insert_epi16(
+			_mm_shuffle_epi8(elements, _mm_setr_epi8(4, 5, 10, 11, -1, -1,
+			-1, -1, -1, -1, -1, -1, -1, -1, -1, -1)), matrix[8], 2));
+}
+
+/*
+ * This function reads three sign extended 32-bit registers into a vector,
+ * multiplied by 0x1000.
+ */
+__attribute__((target("avx2")))
+PHILPSX_GTEKERNELS_INLINE __m256i GteKernels_readRegistersAvx2(const int32_t *registers)
+{
+	return _mm256_slli_epi64(_mm256_cvtepi32_epi64(
+			_mm_loadu_si128((const __m128i *)registers)), 12);
+}
+
+/*
+ * This function reads the specified vector (V0, V1 or V2) with each lane
+ * broadcast to a whole register, sign extended.
+ */
+__attribute__((target("avx2")))
+PHILPSX_GTEKERNELS_INLINE void GteKernels_readVectorAvx2(const int16_t *vectors,
+		int32_t index, __m256i *vector)
+{
+	vector[0] = _mm256_set1_epi64x(vectors[index * 3]);
+	vector[1] = _mm256_set1_epi64x(vectors[index * 3 + 1]);
+	vector[2] = _mm256_set1_epi64x(vectors[index * 3 + 2]);
+}
+
+/*
+ * This function stores a register to a result array.
+ */
+__attribute__((target("avx2")))
+PHILPSX_GTEKERNELS_INLINE void GteKernels_storeAvx2(int64_t *destination, __m256i vector)
+{
+	_mm256_storeu_si256((__m256i *)destination, vector);
+}
+
+/*
+ * This function performs the depthCueColours calculation for one colour,
+ * only working out flags if last is set.
+ */
+__attribute__((target("avx2")))
+PHILPSX_GTEKERNELS_INLINE void GteKernels_depthCueColourAvx2(
+		__m256i farColour, __m256i ir0, int32_t colourRegister, int32_t sf,
+		int64_t lowerBound, bool last, GteResult *result)
+{
+	GteKernelsAvx2Masks masks;
+	GteKernels_clearMasksAvx2(&masks);
+	GteKernelsAvx2Masks *flagMasks = last ? &masks : NULL;
+	__m256i mac = _mm256_slli_epi64(
+			GteKernels_readColourAvx2(colourRegister), 16);
+	__m256i ir, colour;
+	GteKernels_interpolateAvx2(farColour, ir0, sf, &mac, flagMasks);
+	GteKernels_finishAvx2(&mac, sf, lowerBound, &ir, &colour, flagMasks);
+
+	GteKernels_storeAvx2(result->mac, mac);
+	GteKernels_storeAvx2(result->ir, ir);
+	GteKernels_storeAvx2(result->colour, colour);
+	result->flags = last ? GteKernels_maskFlagsAvx2(&masks) : 0;
+}
+
+/*
+ * This function is the AVX2 version of depthCueColours.
+ */
+__attribute__((target("avx2")))
+static void GteKernels_depthCueColoursAvx2(const int32_t *controlRegisters,
+		const int32_t *dataRegisters, int32_t sf, int64_t lowerBound,
+		GteResult *results)
+{
+	__m256i farColour = GteKernels_readRegistersAvx2(
+			controlRegisters + PHILPSX_GTEKERNELS_FC);
+	__m256i ir0 = _mm256_set1_epi64x(
+			(int16_t)dataRegisters[PHILPSX_GTEKERNELS_IR0]);
+
+	GteKernels_depthCueColourAvx2(farColour, ir0,
+			dataRegisters[PHILPSX_GTEKERNELS_RGB0], sf, lowerBound, false,
+			results);
+	GteKernels_depthCueColourAvx2(farColour, ir0,
+			dataRegisters[PHILPSX_GTEKERNELS_RGB0 + 1], sf, lowerBound, false,
+			results + 1);
+	GteKernels_depthCueColourAvx2(farColour, ir0,
+			dataRegisters[PHILPSX_GTEKERNELS_RGB0 + 2], sf, lowerBound, true,
+			results + 2);
+}
+
+/*
+ * This function performs the lightVertices calculation for one vector, only
+ * working out flags if last is set.
+ */
+__attribute__((target("avx2")))
+PHILPSX_GTEKERNELS_INLINE void GteKernels_lightVertexAvx2(
+		const __m256i *lightColumns, const __m256i *colourColumns,
+		__m256i backgroundColour, __m256i farColour, __m256i colour,
+		__m256i ir0, const int16_t *vectors, int32_t index,
+		bool depthCue, int32_t sf, int64_t lowerBound, bool last,
+		GteResult *result)
+{
+	GteKernelsAvx2Masks masks;
+	GteKernels_clearMasksAvx2(&masks);
+	GteKernelsAvx2Masks *flagMasks = last ? &masks : NULL;
+	__m256i vector[3], mac, ir, colourOut;
+	GteKernels_readVectorAvx2(vectors, index, vector);
+	GteKernels_multiplyAvx2(lightColumns, vector, _mm256_setzero_si256(), sf,
+			lowerBound, &mac, &ir, flagMasks);
+	vector[0] = _mm256_permute4x64_epi64(ir, _MM_SHUFFLE(0, 0, 0, 0));
+	vector[1] = _mm256_permute4x64_epi64(ir, _MM_SHUFFLE(1, 1, 1, 1));
+	vector[2] = _mm256_permute4x64_epi64(ir, _MM_SHUFFLE(2, 2, 2, 2));
+	GteKernels_multiplyAvx2(colourColumns, vector, backgroundColour, sf,
+			lowerBound, &mac, &ir, flagMasks);
+	GteKernels_modulateAvx2(colour, ir, &mac, flagMasks);
+	if (depthCue)
+		GteKernels_interpolateAvx2(farColour, ir0, sf, &mac, flagMasks);
+	GteKernels_finishAvx2(&mac, sf, lowerBound, &ir, &colourOut, flagMasks);
+
+	GteKernels_storeAvx2(result->mac, mac);
+	GteKernels_storeAvx2(result->ir, ir);
+	GteKernels_storeAvx2(result->colour, colourOut);
+	result->flags = last ? GteKernels_maskFlagsAvx2(&masks) : 0;
+}
+
+/*
+ * This function is the AVX2 version of lightVertices.
+ */
+__attribute__((target("avx2")))
+static void GteKernels_lightVerticesAvx2(const int16_t *lightMatrix,
+		const int16_t *colourMatrix, const int16_t *vectors,
+		const int32_t *controlRegisters, const int32_t *dataRegisters,
+		bool depthCue, int32_t sf, int64_t lowerBound, GteResult *results)
+{
+	__m256i lightColumns[3], colourColumns[3];
+	GteKernels_readMatrixAvx2(lightMatrix, lightColumns);
+	GteKernels_readMatrixAvx2(colourMatrix, colourColumns);
+	__m256i backgroundColour = GteKernels_readRegistersAvx2(
+			controlRegisters + PHILPSX_GTEKERNELS_BK);
+	__m256i farColour = GteKernels_readRegistersAvx2(
+			controlRegisters + PHILPSX_GTEKERNELS_FC);
+	__m256i colour = GteKernels_readColourAvx2(
+			dataRegisters[PHILPSX_GTEKERNELS_RGBC]);
+	__m256i ir0 = _mm256_set1_epi64x(
+			(int16_t)dataRegisters[PHILPSX_GTEKERNELS_IR0]);
+
+	GteKernels_lightVertexAvx2(lightColumns, colourColumns,
+			backgroundColour, farColour, colour, ir0, vectors, 0,
+			depthCue, sf, lowerBound, false, results);
+	GteKernels_lightVertexAvx2(lightColumns, colourColumns,
+			backgroundColour, farColour, colour, ir0, vectors, 1,
+			depthCue, sf, lowerBound, false, results + 1);
+	GteKernels_lightVertexAvx2(lightColumns, colourColumns,
+			backgroundColour, farColour, colour, ir0, vectors, 2,
+			depthCue, sf, lowerBound, true, results + 2);
+}
+
+/*
+ * This function is the AVX2 version of transform.
+ */
+__attribute__((target("avx2")))
+static void GteKernels_transformAvx2(const int16_t *matrix,
+		const int64_t *vector, const int64_t *translation, int32_t sf,
+		int64_t lowerBound, GteResult *result)
+{
+	GteKernelsAvx2Masks masks;
+	GteKernels_clearMasksAvx2(&masks);
+	__m256i columns[3], lanes[3], mac, ir;
+	GteKernels_readMatrixAvx2(matrix, columns);
+	lanes[0] = _mm256_set1_epi64x(vector[0]);
+	lanes[1] = _mm256_set1_epi64x(vector[1]);
+	lanes[2] = _mm256_set1_epi64x(vector[2]);
+	__m256i offset = _mm256_slli_epi64(_mm256_setr_epi64x(translation[0],
+			translation[1], translation[2], 0), 12);
+
+	GteKernels_multiplyAvx2(columns, lanes, offset, sf, lowerBound, &mac, &ir,
+			&masks);
+	GteKernels_storeAvx2(result->mac, mac);
+	GteKernels_storeAvx2(result->ir, ir);
+	result->flags = GteKernels_maskFlagsAvx2(&masks);
+}
+
+/*
+ * This function performs the transformVertices calculation for one vector,
+ * only working out flags if last is set.
+ */
+__attribute__((target("avx2")))
+PHILPSX_GTEKERNELS_INLINE void GteKernels_transformVertexAvx2(
+		const __m256i *columns, __m256i translation,
+		const int16_t *vectors, int32_t index, int32_t sf, bool last,
+		GteResult *result)
+{
+	GteKernelsAvx2Masks masks;
+	GteKernels_clearMasksAvx2(&masks);
+	__m256i vector[3], mac, ir;
+	GteKernels_readVectorAvx2(vectors, index, vector);
+	GteKernels_multiplyAvx2(columns, vector, translation, sf,
+			PHILPSX_GTEKERNELS_IR_LOWER, &mac, &ir, last ? &masks : NULL);
+
+	GteKernels_storeAvx2(result->mac, mac);
+	GteKernels_storeAvx2(result->ir, ir);
+	result->flags = last ? GteKernels_maskFlagsAvx2(&masks) : 0;
+}
+
+/*
+ * This function is the AVX2 version of transformVertices.
+ */
+__attribute__((target("avx2")))
+static void GteKernels_transformVerticesAvx2(const int16_t *matrix,
+		const int16_t *vectors, const int32_t *translation, int32_t sf,
+		GteResult *results)
+{
+	__m256i columns[3];
+	GteKernels_readMatrixAvx2(matrix, columns);
+	__m256i offset = GteKernels_readRegistersAvx2(translation);
+
+	GteKernels_transformVertexAvx2(columns, offset, vectors, 0,
+			sf, false, results);
+	GteKernels_transformVertexAvx2(columns, offset, vectors, 1,
+			sf, false, results + 1);
+	GteKernels_transformVertexAvx2(columns, offset, vectors, 2,
+			sf, true, results + 2);
+}
+#endif
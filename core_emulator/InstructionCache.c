@@ -7,8 +7,10 @@
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include "../headers/InstructionCache_all.h"
 #include "../headers/Cop0_public.h"
+#include "../headers/SystemInterlink.h"
 #include "../headers/math_utils.h"
 
 /*
@@ -18,40 +20,10 @@
  */
 InstructionCache *construct_InstructionCache(InstructionCache *cache)
 {
-	// Setup cache arrays
-	cache->cacheData = calloc(4096, sizeof(int8_t));
-	if (!cache->cacheData) {
-		fprintf(stderr, "PhilPSX: R3051: InstructionCache: Couldn't allocate "
-				"memory for cacheData array\n");
-		goto end;
-	}
-
-	cache->cacheTag = calloc(256, sizeof(int32_t));
-	if (!cache->cacheTag) {
-		fprintf(stderr, "PhilPSX: R3051: InstructionCache: Couldn't allocate "
-				"memory for cacheTag array\n");
-		goto cleanup_cachedata;
-	}
+	// Setup cache lines, all invalid
+	memset(cache->lines, 0, sizeof(cache->lines));
 
-	cache->cacheValid = calloc(256, sizeof(bool));
-	if (!cache->cacheValid) {
-		fprintf(stderr, "PhilPSX: R3051: InstructionCache: Couldn't allocate "
-				"memory for cacheValid array\n");
-		goto cleanup_cachetag;
-	}
-
-	// Normal return:
 	return cache;
-
-	// Cleanup path:
-	cleanup_cachetag:
-	free(cache->cacheTag);
-	
-	cleanup_cachedata:
-	free(cache->cacheData);
-	
-	end:
-	return NULL;
 }
 
 /*
@@ -60,9 +32,7 @@ InstructionCache *construct_InstructionCache(InstructionCache *cache)
  */
 void destruct_InstructionCache(InstructionCache *cache)
 {
-	free(cache->cacheValid);
-	free(cache->cacheTag);
-	free(cache->cacheData);
+	// Nothing to free, as the lines live inside the struct
 }
 
 /*
@@ -72,17 +42,25 @@ void destruct_InstructionCache(InstructionCache *cache)
 bool InstructionCache_checkForHit(InstructionCache *cache,
 		int32_t address)
 {
-	// Define return value
-	bool retVal = false;
+	InstructionCacheLine *line =
+			&cache->lines[logical_rshift(address, 4) & 0xFF];
+	return line->tag == ((address & 0xFFFFF000) | PHILPSX_ICACHE_VALID);
+}
 
-	int32_t tagIndex = logical_rshift(address, 4) & 0xFF;
-	int32_t expectedTag = logical_rshift(address, 12) & 0xFFFFF;
-	if (cache->cacheTag[tagIndex] ==
-			expectedTag && cache->cacheValid[tagIndex])
-		retVal = true;
+/*
+ * This function fetches the word at the specified physical address if its
+ * line is present, combining the hit check and read. It returns the word
+ * as an unsigned value, or -1 on a miss.
+ */
+int64_t InstructionCache_fetchWord(InstructionCache *cache,
+		int32_t address)
+{
+	InstructionCacheLine *line =
+			&cache->lines[logical_rshift(address, 4) & 0xFF];
+	if (line->tag != ((address & 0xFFFFF000) | PHILPSX_ICACHE_VALID))
+		return -1L;
 
-	// Return hit status
-	return retVal;
+	return line->data[logical_rshift(address, 2) & 0x3] & 0xFFFFFFFFL;
 }
 
 /*
@@ -91,20 +69,8 @@ bool InstructionCache_checkForHit(InstructionCache *cache,
 int32_t InstructionCache_readWord(InstructionCache *cache,
 		int32_t address)
 {
-	// Define word value
-	int32_t wordVal = 0;
-
-	int32_t dataIndex = address & 0xFFC;
-	wordVal = (cache->cacheData[dataIndex] & 0xFF) << 24;
-	++dataIndex;
-	wordVal |= (cache->cacheData[dataIndex] & 0xFF) << 16;
-	++dataIndex;
-	wordVal |= (cache->cacheData[dataIndex] & 0xFF) << 8;
-	++dataIndex;
-	wordVal |= cache->cacheData[dataIndex] & 0xFF;
-	
-	// Return word value
-	return wordVal;
+	return cache->lines[logical_rshift(address, 4) & 0xFF]
+			.data[logical_rshift(address, 2) & 0x3];
 }
 
 /*
@@ -113,17 +79,10 @@ int32_t InstructionCache_readWord(InstructionCache *cache,
 int8_t InstructionCache_readByte(InstructionCache *cache,
 		int32_t address)
 {
-	// Define byte value
-	int8_t byteVal = 0;
-
-	// Get address of byte
-	int32_t dataIndex = address & 0xFFF;
-
-	// Retrieve byte
-	byteVal = cache->cacheData[dataIndex];
-
-	// Return work value
-	return byteVal;
+	// Words are in host byte order, which matches guest byte order
+	InstructionCacheLine *line =
+			&cache->lines[logical_rshift(address, 4) & 0xFF];
+	return ((int8_t *)line->data)[address & 0xF];
 }
 
 /*
@@ -133,22 +92,13 @@ void InstructionCache_writeWord(InstructionCache *cache, Cop0 *sccp,
 		int32_t address, int32_t value)
 {
 	// Update correct word
-	int32_t dataIndex = address & 0xFFC;
-	cache->cacheData[dataIndex] = (int8_t)logical_rshift(value, 24);
-	++dataIndex;
-	cache->cacheData[dataIndex] = (int8_t)logical_rshift(value, 16);
-	++dataIndex;
-	cache->cacheData[dataIndex] = (int8_t)logical_rshift(value, 8);
-	++dataIndex;
-	cache->cacheData[dataIndex] = (int8_t)value;
+	InstructionCacheLine *line =
+			&cache->lines[logical_rshift(address, 4) & 0xFF];
+	line->data[logical_rshift(address, 2) & 0x3] = value;
 
 	// Invalidate line if cache is isolated
-	if (Cop0_isDataCacheIsolated(sccp)) {
-		int32_t tagIndex = logical_rshift(address, 4) & 0xFF;
-		int32_t tag = logical_rshift(address, 12) & 0xFFFFF;
-		cache->cacheTag[tagIndex] = tag;
-		cache->cacheValid[tagIndex] = false;
-	}
+	if (Cop0_isDataCacheIsolated(sccp))
+		line->tag = address & 0xFFFFF000;
 }
 
 /*
@@ -159,22 +109,19 @@ void InstructionCache_writeByte(InstructionCache *cache, Cop0 *sccp,
 		int32_t address, int8_t value)
 {
 	// Update correct byte
-	int32_t dataIndex = address & 0xFFF;
-
-	// Write byte and invalidate cache line
-	cache->cacheData[dataIndex] = value;
+	InstructionCacheLine *line =
+			&cache->lines[logical_rshift(address, 4) & 0xFF];
+	((int8_t *)line->data)[address & 0xF] = value;
 
 	// Invalidate line if cache is isolated
-	if (Cop0_isDataCacheIsolated(sccp)) {
-		int32_t tagIndex = logical_rshift(address, 4) & 0xFF;
-		int32_t tag = logical_rshift(address, 12) & 0xFFFFF;
-		cache->cacheTag[tagIndex] = tag;
-		cache->cacheValid[tagIndex] = false;
-	}
+	if (Cop0_isDataCacheIsolated(sccp))
+		line->tag = address & 0xFFFFF000;
 }
 
 /*
- * This function refills a cache line using an address.
+ * This function refills a cache line using an address. Lines backed by RAM,
+ * BIOS or scratchpad are copied straight out of the page table, and anything
+ * else is read a word at a time through the system.
  */
 void InstructionCache_refillLine(InstructionCache *cache, Cop0 *sccp,
 		SystemInterlink *system, int32_t address)
@@ -184,20 +131,26 @@ void InstructionCache_refillLine(InstructionCache *cache, Cop0 *sccp,
 	if (Cop0_isDataCacheIsolated(sccp))
 		return;
 
-	// Calculate tag index and tag
-	int32_t tagIndex = logical_rshift(address, 4) & 0xFF;
-	int32_t tag = logical_rshift(address, 12) & 0xFFFFF;
-
 	// Write tag and valid flag
-	cache->cacheTag[tagIndex] = tag;
-	cache->cacheValid[tagIndex] = true;
+	InstructionCacheLine *line =
+			&cache->lines[logical_rshift(address, 4) & 0xFF];
+	line->tag = (address & 0xFFFFF000) | PHILPSX_ICACHE_VALID;
 
-	// Refill cache line
+	// Copy line directly from memory if possible
 	int64_t startingAddress = address & 0xFFFFFFF0L;
-	for (int32_t i = 0; i < 16; ++i) {
-		cache->cacheData[(int32_t)(startingAddress & 0xFFF)] =
-				SystemInterlink_readByte(system,
+	if (startingAddress < 0x20000000L) {
+		MemoryPage *page =
+				&SystemInterlink_getPageTable(system)[startingAddress >> 12];
+		if (page->memory && (startingAddress & 0xFFF) < page->size) {
+			memcpy(line->data, page->memory + (startingAddress & 0xFFF), 16);
+			return;
+		}
+	}
+
+	// Otherwise refill cache line a word at a time
+	for (int32_t i = 0; i < 4; ++i) {
+		line->data[i] = SystemInterlink_readWord(system,
 				(int32_t)startingAddress);
-		++startingAddress;
+		startingAddress += 4;
 	}
 }
\ No newline at end of file
@@ -0,0 +1,306 @@
+/*
+ * This C file models lockstep validation of a fast R3051 execution engine as
+ * a class. Two complete consoles are started from the same state, one with
+ * the plain interpreter as a reference and the other with the engine being
+ * checked. They are run block by block, and whenever both have reached the
+ * same point in emulated time, their general purpose, HI/LO, PC, COP0 and
+ * COP2 registers are compared. RAM and scratchpad are compared less often, as
+ * this is much more expensive. At the first difference, the differing state
+ * is printed along with the program counters of the last points at which both
+ * agreed.
+ *
+ * Lockstep.c - Copyright Phillip Potter, 2020, under GPLv3
+ */
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../headers/Lockstep.h"
+#include "../headers/R3051_all.h"
+
+// Number of sync points between memory comparisons, number of sync points
+// kept for the trace, and number of blocks the two CPUs may run without
+// their cycle counts lining up before they are treated as having diverged
+#define PHILPSX_LOCKSTEP_MEMORY_INTERVAL 65536
+#define PHILPSX_LOCKSTEP_TRACE_LENGTH 32
+#define PHILPSX_LOCKSTEP_MAX_UNSYNCED 1024
+
+// Sizes of RAM and scratchpad
+#define PHILPSX_LOCKSTEP_RAM_SIZE 0x200000
+#define PHILPSX_LOCKSTEP_SCRATCHPAD_SIZE 0x400
+
+// Forward declarations for functions and subcomponents private to this class
+// Lockstep-related stuff:
+typedef struct LockstepTracePoint LockstepTracePoint;
+static void Lockstep_checkValue(Lockstep *ls, const char *name, int32_t index,
+		int32_t referenceValue, int32_t acceleratedValue);
+static void Lockstep_compareMemory(Lockstep *ls, const char *name,
+		int32_t baseAddress, const int8_t *reference,
+		const int8_t *accelerated, int32_t size);
+static void Lockstep_compareRegisters(Lockstep *ls);
+static void Lockstep_printTrace(Lockstep *ls);
+static void Lockstep_reportDivergence(Lockstep *ls);
+
+/*
+ * This struct stores a point at which both CPUs were found to agree.
+ */
+struct LockstepTracePoint {
+	int64_t cycles;
+	int32_t programCounter;
+};
+
+/*
+ * This struct contains references to both CPUs, along with the state needed
+ * to keep them in step and report where they diverged.
+ */
+struct Lockstep {
+
+	// CPU references
+	R3051 *reference;
+	R3051 *accelerated;
+
+	// Sync point counters
+	int64_t syncPoints;
+	int32_t unsyncedBlocks;
+
+	// Ring buffer of the last points at which both CPUs agreed
+	LockstepTracePoint trace[PHILPSX_LOCKSTEP_TRACE_LENGTH];
+	int32_t traceCount;
+
+	// Whether a divergence has been found
+	bool diverged;
+};
+
+/*
+ * This constructs a Lockstep object that keeps the specified CPUs in step.
+ * Both must be linked to their own fully setup consoles, started from the
+ * same state, and neither should be run except through this object.
+ */
+Lockstep *construct_Lockstep(R3051 *reference, R3051 *accelerated)
+{
+	// Allocate Lockstep struct
+	Lockstep *ls = malloc(sizeof(Lockstep));
+	if (!ls) {
+		fprintf(stderr, "PhilPSX: Lockstep: Couldn't allocate memory for "
+				"Lockstep struct\n");
+		goto end;
+	}
+
+	// Setup state
+	ls->reference = reference;
+	ls->accelerated = accelerated;
+	ls->syncPoints = 0;
+	ls->unsyncedBlocks = 0;
+	ls->traceCount = 0;
+	ls->diverged = false;
+
+	end:
+	return ls;
+}
+
+/*
+ * This destructs a Lockstep object.
+ */
+void destruct_Lockstep(Lockstep *ls)
+{
+	free(ls);
+}
+
+/*
+ * This function moves the accelerated CPU on by one block of instructions,
+ * and the reference CPU on by as many blocks as it takes to catch up. If both
+ * have then reached the same cycle, their states are compared. It returns the
+ * number of cycles the accelerated CPU ran for.
+ */
+int64_t Lockstep_executeInstructions(Lockstep *ls)
+{
+	// Run both CPUs - if the reference one is already ahead, only the
+	// accelerated one runs, so the two leapfrog each other. Emulated time is
+	// taken from each console's scheduler, as that is what the rest of the
+	// system runs by
+	int64_t cycles = R3051_executeInstructions(ls->accelerated);
+	int64_t acceleratedTime = Scheduler_getCycles(ls->accelerated->scheduler);
+	int64_t referenceTime = Scheduler_getCycles(ls->reference->scheduler);
+	while (referenceTime < acceleratedTime) {
+		R3051_executeInstructions(ls->reference);
+		referenceTime = Scheduler_getCycles(ls->reference->scheduler);
+	}
+
+	// State can only be compared if both are at the same cycle, which must
+	// happen regularly if they execute identically
+	if (referenceTime != acceleratedTime) {
+		if (++ls->unsyncedBlocks > PHILPSX_LOCKSTEP_MAX_UNSYNCED) {
+			fprintf(stderr, "PhilPSX: Lockstep: Cycle counts stopped lining "
+					"up (reference %ld, accelerated %ld)\n",
+					(long)referenceTime, (long)acceleratedTime);
+			ls->diverged = true;
+			Lockstep_printTrace(ls);
+		}
+		return cycles;
+	}
+	ls->unsyncedBlocks = 0;
+
+	// Compare registers every time, and memory at a fixed interval
+	Lockstep_compareRegisters(ls);
+	if (++ls->syncPoints % PHILPSX_LOCKSTEP_MEMORY_INTERVAL == 0) {
+		MemoryPage *referencePages =
+				SystemInterlink_getPageTable(ls->reference->system);
+		MemoryPage *acceleratedPages =
+				SystemInterlink_getPageTable(ls->accelerated->system);
+		Lockstep_compareMemory(ls, "RAM", 0,
+				SystemInterlink_getRamArray(ls->reference->system),
+				SystemInterlink_getRamArray(ls->accelerated->system),
+				PHILPSX_LOCKSTEP_RAM_SIZE);
+		Lockstep_compareMemory(ls, "Scratchpad", 0x1F800000,
+				referencePages[0x1F800000 >> 12].memory,
+				acceleratedPages[0x1F800000 >> 12].memory,
+				PHILPSX_LOCKSTEP_SCRATCHPAD_SIZE);
+	}
+
+	// Record point if both agree, or report where they didn't
+	if (ls->diverged) {
+		Lockstep_printTrace(ls);
+	} else {
+		LockstepTracePoint *point =
+				&ls->trace[ls->traceCount % PHILPSX_LOCKSTEP_TRACE_LENGTH];
+		point->cycles = Scheduler_getCycles(ls->accelerated->scheduler);
+		point->programCounter = ls->accelerated->programCounter;
+		++ls->traceCount;
+	}
+
+	return cycles;
+}
+
+/*
+ * This function tells us whether the two CPUs have diverged. Once they have,
+ * they should not be run any further.
+ */
+bool Lockstep_hasDiverged(Lockstep *ls)
+{
+	return ls->diverged;
+}
+
+/*
+ * This function compares one value from each CPU, reporting it if they
+ * differ. An index of -1 means the value is not part of a register file.
+ */
+static void Lockstep_checkValue(Lockstep *ls, const char *name, int32_t index,
+		int32_t referenceValue, int32_t acceleratedValue)
+{
+	if (referenceValue == acceleratedValue)
+		return;
+
+	// Announce divergence before listing the first difference
+	if (!ls->diverged)
+		Lockstep_reportDivergence(ls);
+
+	if (index < 0)
+		fprintf(stderr, "PhilPSX: Lockstep:   %s: reference 0x%08X, "
+				"accelerated 0x%08X\n", name, (uint32_t)referenceValue,
+				(uint32_t)acceleratedValue);
+	else
+		fprintf(stderr, "PhilPSX: Lockstep:   %s %d: reference 0x%08X, "
+				"accelerated 0x%08X\n", name, index, (uint32_t)referenceValue,
+				(uint32_t)acceleratedValue);
+}
+
+/*
+ * This function compares a memory region of each console, reporting the
+ * first differing word and the number of differing words if they differ.
+ */
+static void Lockstep_compareMemory(Lockstep *ls, const char *name,
+		int32_t baseAddress, const int8_t *reference,
+		const int8_t *accelerated, int32_t size)
+{
+	// Quick check for the common case
+	if (memcmp(reference, accelerated, size) == 0)
+		return;
+
+	// Find differing words
+	int32_t firstOffset = -1, differingWords = 0;
+	for (int32_t offset = 0; offset < size; offset += 4) {
+		if (memcmp(reference + offset, accelerated + offset, 4) != 0) {
+			if (firstOffset < 0)
+				firstOffset = offset;
+			++differingWords;
+		}
+	}
+
+	// Report them
+	int32_t referenceWord, acceleratedWord;
+	memcpy(&referenceWord, reference + firstOffset, 4);
+	memcpy(&acceleratedWord, accelerated + firstOffset, 4);
+	if (!ls->diverged)
+		Lockstep_reportDivergence(ls);
+	fprintf(stderr, "PhilPSX: Lockstep:   %s differs in %d words, first at "
+			"0x%08X: reference 0x%08X, accelerated 0x%08X\n", name,
+			differingWords, (uint32_t)(baseAddress + firstOffset),
+			(uint32_t)referenceWord, (uint32_t)acceleratedWord);
+}
+
+/*
+ * This function compares the registers of both CPUs and their
+ * co-processors.
+ */
+static void Lockstep_compareRegisters(Lockstep *ls)
+{
+	R3051 *ref = ls->reference;
+	R3051 *acc = ls->accelerated;
+
+	// CPU registers
+	Lockstep_checkValue(ls, "PC", -1, ref->programCounter,
+			acc->programCounter);
+	for (int32_t i = 1; i < 32; ++i)
+		Lockstep_checkValue(ls, "GPR", i, ref->generalRegisters[i],
+				acc->generalRegisters[i]);
+	Lockstep_checkValue(ls, "HI", -1, ref->hiReg, acc->hiReg);
+	Lockstep_checkValue(ls, "LO", -1, ref->loReg, acc->loReg);
+
+	// COP0 registers
+	for (int32_t i = 0; i < 32; ++i)
+		Lockstep_checkValue(ls, "COP0", i, ref->sccp.copRegisters[i],
+				acc->sccp.copRegisters[i]);
+
+	// COP2 registers, read through its interface so that lazily worked out
+	// state is compared as the program would see it
+	for (int32_t i = 0; i < 32; ++i)
+		Lockstep_checkValue(ls, "COP2 data", i,
+				Cop2_readDataReg(&ref->gte, i),
+				Cop2_readDataReg(&acc->gte, i));
+	for (int32_t i = 0; i < 32; ++i)
+		Lockstep_checkValue(ls, "COP2 control", i,
+				Cop2_readControlReg(&ref->gte, i),
+				Cop2_readControlReg(&acc->gte, i));
+}
+
+/*
+ * This function prints the last points at which both CPUs agreed, oldest
+ * first.
+ */
+static void Lockstep_printTrace(Lockstep *ls)
+{
+	int32_t count = ls->traceCount < PHILPSX_LOCKSTEP_TRACE_LENGTH ?
+			ls->traceCount : PHILPSX_LOCKSTEP_TRACE_LENGTH;
+	fprintf(stderr, "PhilPSX: Lockstep: Last %d points where both agreed:\n",
+			count);
+	for (int32_t i = ls->traceCount - count; i < ls->traceCount; ++i) {
+		LockstepTracePoint *point =
+				&ls->trace[i % PHILPSX_LOCKSTEP_TRACE_LENGTH];
+		fprintf(stderr, "PhilPSX: Lockstep:   cycle %ld, PC 0x%08X\n",
+				(long)point->cycles, (uint32_t)point->programCounter);
+	}
+}
+
+/*
+ * This function announces that the CPUs have diverged, before the
+ * differences are listed.
+ */
+static void Lockstep_reportDivergence(Lockstep *ls)
+{
+	fprintf(stderr, "PhilPSX: Lockstep: Divergence found at cycle %ld "
+			"(sync point %ld), PC 0x%08X:\n",
+			(long)Scheduler_getCycles(ls->accelerated->scheduler),
+			(long)ls->syncPoints, (uint32_t)ls->accelerated->programCounter);
+	ls->diverged = true;
+}
@@ -0,0 +1,504 @@
+/*
+ * This C file models a PS-X EXE executable as a class. The executable is
+ * read into memory and its header checked up front, so that it can later be
+ * copied into RAM and started in one go. This happens when the BIOS jumps to
+ * its shell, as the kernel has been initialised by then, which is what
+ * executables expect when the BIOS would otherwise load them from disc. The
+ * executable can come from a file, or from the boot executable named by
+ * SYSTEM.CNF on a CD, found through the ISO 9660 file system.
+ *
+ * PSXExe.c - Copyright Phillip Potter, 2020, under GPLv3
+ */
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include <strings.h>
+#include "../headers/PSXExe.h"
+#include "../headers/CDROMDrive.h"
+#include "../headers/R3051_all.h"
+#include "../headers/SystemInterlink.h"
+
+// Size of the header, which the text segment follows, and offsets of the
+// header fields we use
+#define PHILPSX_PSXEXE_HEADER_SIZE 0x800
+#define PHILPSX_PSXEXE_INITIAL_PC 0x10
+#define PHILPSX_PSXEXE_INITIAL_GP 0x14
+#define PHILPSX_PSXEXE_TEXT_ADDRESS 0x18
+#define PHILPSX_PSXEXE_TEXT_SIZE 0x1C
+#define PHILPSX_PSXEXE_BSS_ADDRESS 0x28
+#define PHILPSX_PSXEXE_BSS_SIZE 0x2C
+#define PHILPSX_PSXEXE_SP_BASE 0x30
+#define PHILPSX_PSXEXE_SP_OFFSET 0x34
+
+// Size of RAM, which the text and BSS segments must fit within
+#define PHILPSX_PSXEXE_RAM_SIZE 0x200000
+
+// Largest executable we accept
+#define PHILPSX_PSXEXE_MAX_SIZE \
+	(PHILPSX_PSXEXE_HEADER_SIZE + PHILPSX_PSXEXE_RAM_SIZE)
+
+// ISO 9660 details: sector size, location of the primary volume descriptor
+// and of the root directory record within it, and offsets of the directory
+// record fields we use
+#define PHILPSX_PSXEXE_SECTOR_SIZE 0x800
+#define PHILPSX_PSXEXE_VOLUME_DESCRIPTOR_LBA 16
+#define PHILPSX_PSXEXE_ROOT_RECORD 156
+#define PHILPSX_PSXEXE_RECORD_LBA 2
+#define PHILPSX_PSXEXE_RECORD_SIZE 10
+#define PHILPSX_PSXEXE_RECORD_FLAGS 25
+#define PHILPSX_PSXEXE_RECORD_NAME_LENGTH 32
+#define PHILPSX_PSXEXE_RECORD_NAME 33
+
+// Longest boot executable path we accept from SYSTEM.CNF
+#define PHILPSX_PSXEXE_MAX_PATH 256
+
+// Forward declarations for functions private to this class
+// PSXExe-related stuff:
+static bool PSXExe_findDiscFile(CDROMDrive *cdrom, const char *path,
+		int32_t *lba, int32_t *size);
+static bool PSXExe_fitsInRam(int32_t address, int32_t size);
+static bool PSXExe_parseHeader(PSXExe *exe, const char *name);
+static void PSXExe_parseSystemCnf(const char *systemCnf, char *bootPath,
+		int32_t *stack);
+static bool PSXExe_readDiscFile(CDROMDrive *cdrom, int32_t lba, int32_t size,
+		int8_t *destination);
+static int32_t PSXExe_readHeaderWord(PSXExe *exe, int32_t offset);
+
+/*
+ * This struct stores the contents of the executable, along with the header
+ * fields needed to start it.
+ */
+struct PSXExe {
+
+	// File contents
+	int8_t *data;
+	int32_t size;
+
+	// Header fields
+	int32_t initialPc;
+	int32_t initialGp;
+	int32_t textAddress;
+	int32_t textSize;
+	int32_t bssAddress;
+	int32_t bssSize;
+	int32_t initialSp;
+};
+
+/*
+ * This constructs a PSXExe object from the executable at exePath, returning
+ * NULL if it can't be read or isn't a valid PS-X EXE.
+ */
+PSXExe *construct_PSXExe(const char *exePath)
+{
+	// Allocate PSXExe struct
+	PSXExe *exe = malloc(sizeof(PSXExe));
+	if (!exe) {
+		fprintf(stderr, "PhilPSX: PSXExe: Couldn't allocate memory for "
+				"PSXExe struct\n");
+		goto end;
+	}
+
+	// Open executable and get its size
+	int exeFileDescriptor = open(exePath, O_RDONLY);
+	if (exeFileDescriptor == -1) {
+		fprintf(stderr, "PhilPSX: PSXExe: Couldn't open %s\n", exePath);
+		goto cleanup_exe;
+	}
+	off_t exeSize = lseek(exeFileDescriptor, 0, SEEK_END);
+	if (exeSize == -1 || lseek(exeFileDescriptor, 0, SEEK_SET) == -1) {
+		fprintf(stderr, "PhilPSX: PSXExe: Couldn't seek within %s\n",
+				exePath);
+		goto cleanup_openfile;
+	}
+	if (exeSize < PHILPSX_PSXEXE_HEADER_SIZE ||
+			exeSize > PHILPSX_PSXEXE_MAX_SIZE) {
+		fprintf(stderr, "PhilPSX: PSXExe: Size of %s is not valid for a "
+				"PS-X EXE\n", exePath);
+		goto cleanup_openfile;
+	}
+	exe->size = (int32_t)exeSize;
+
+	// Read executable into memory
+	exe->data = malloc(exe->size);
+	if (!exe->data) {
+		fprintf(stderr, "PhilPSX: PSXExe: Couldn't allocate memory for "
+				"data array\n");
+		goto cleanup_openfile;
+	}
+	if (read(exeFileDescriptor, exe->data, exe->size) != exe->size) {
+		fprintf(stderr, "PhilPSX: PSXExe: Couldn't read %s\n", exePath);
+		goto cleanup_data;
+	}
+
+	// Check header
+	if (!PSXExe_parseHeader(exe, exePath))
+		goto cleanup_data;
+
+	// Close file, which we no longer need
+	if (close(exeFileDescriptor))
+		fprintf(stderr, "PhilPSX: PSXExe: Couldn't close %s\n", exePath);
+
+	// Normal return:
+	return exe;
+
+	// Cleanup path:
+	cleanup_data:
+	free(exe->data);
+
+	cleanup_openfile:
+	if (close(exeFileDescriptor)) {
+		fprintf(stderr, "PhilPSX: PSXExe: Couldn't close %s during error "
+				"path\n", exePath);
+	}
+
+	cleanup_exe:
+	free(exe);
+	exe = NULL;
+
+	end:
+	return exe;
+}
+
+/*
+ * This constructs a PSXExe object from the boot executable of the CD in the
+ * specified drive, as named by the BOOT line of its SYSTEM.CNF file (or
+ * PSX.EXE if there is none). The STACK line is used for the stack pointer
+ * if the executable doesn't set one itself, as the BIOS does. NULL is
+ * returned if the executable can't be found or isn't a valid PS-X EXE.
+ */
+PSXExe *construct_PSXExeFromDisc(CDROMDrive *cdrom)
+{
+	// Allocate PSXExe struct
+	PSXExe *exe = malloc(sizeof(PSXExe));
+	if (!exe) {
+		fprintf(stderr, "PhilPSX: PSXExe: Couldn't allocate memory for "
+				"PSXExe struct\n");
+		goto end;
+	}
+
+	// Read boot executable path and stack from SYSTEM.CNF, if present
+	char bootPath[PHILPSX_PSXEXE_MAX_PATH] = "PSX.EXE";
+	int32_t stack = 0;
+	int32_t lba = 0;
+	int32_t size = 0;
+	if (PSXExe_findDiscFile(cdrom, "SYSTEM.CNF", &lba, &size)) {
+		char systemCnf[PHILPSX_PSXEXE_SECTOR_SIZE + 1];
+		if (size > PHILPSX_PSXEXE_SECTOR_SIZE)
+			size = PHILPSX_PSXEXE_SECTOR_SIZE;
+		if (!PSXExe_readDiscFile(cdrom, lba, size, (int8_t *)systemCnf)) {
+			fprintf(stderr, "PhilPSX: PSXExe: Couldn't read SYSTEM.CNF\n");
+			goto cleanup_exe;
+		}
+		systemCnf[size] = '\0';
+		PSXExe_parseSystemCnf(systemCnf, bootPath, &stack);
+	}
+
+	// Find boot executable
+	if (!PSXExe_findDiscFile(cdrom, bootPath, &lba, &size)) {
+		fprintf(stderr, "PhilPSX: PSXExe: Couldn't find boot executable %s "
+				"on CD\n", bootPath);
+		goto cleanup_exe;
+	}
+	if (size < PHILPSX_PSXEXE_HEADER_SIZE || size > PHILPSX_PSXEXE_MAX_SIZE) {
+		fprintf(stderr, "PhilPSX: PSXExe: Size of %s is not valid for a "
+				"PS-X EXE\n", bootPath);
+		goto cleanup_exe;
+	}
+	exe->size = size;
+
+	// Read boot executable into memory
+	exe->data = malloc(exe->size);
+	if (!exe->data) {
+		fprintf(stderr, "PhilPSX: PSXExe: Couldn't allocate memory for "
+				"data array\n");
+		goto cleanup_exe;
+	}
+	if (!PSXExe_readDiscFile(cdrom, lba, exe->size, exe->data)) {
+		fprintf(stderr, "PhilPSX: PSXExe: Couldn't read %s\n", bootPath);
+		goto cleanup_data;
+	}
+
+	// Check header, using stack from SYSTEM.CNF if needed
+	if (!PSXExe_parseHeader(exe, bootPath))
+		goto cleanup_data;
+	if (exe->initialSp == 0)
+		exe->initialSp = stack;
+	fprintf(stdout, "PhilPSX: PSXExe: Boot executable is %s\n", bootPath);
+
+	// Normal return:
+	return exe;
+
+	// Cleanup path:
+	cleanup_data:
+	free(exe->data);
+
+	cleanup_exe:
+	free(exe);
+	exe = NULL;
+
+	end:
+	return exe;
+}
+
+/*
+ * This destructs a PSXExe object.
+ */
+void destruct_PSXExe(PSXExe *exe)
+{
+	free(exe->data);
+	free(exe);
+}
+
+/*
+ * This function copies the text segment into RAM, clears the BSS segment,
+ * and sets the program counter, global pointer and stack pointer of the CPU
+ * so that the executable starts running next. Any code the CPU has cached is
+ * discarded, as the BIOS would do after loading an executable.
+ */
+void PSXExe_start(PSXExe *exe, R3051 *cpu)
+{
+	// Copy segments into RAM
+	int8_t *ram = SystemInterlink_getRamArray(cpu->system);
+	int32_t textAddress = exe->textAddress & (PHILPSX_PSXEXE_RAM_SIZE - 1);
+	memcpy(ram + textAddress, exe->data + PHILPSX_PSXEXE_HEADER_SIZE,
+			exe->textSize);
+	SystemInterlink_invalidateCodeRange(cpu->system, textAddress,
+			exe->textSize);
+	if (exe->bssSize != 0) {
+		int32_t bssAddress = exe->bssAddress & (PHILPSX_PSXEXE_RAM_SIZE - 1);
+		memset(ram + bssAddress, 0, exe->bssSize);
+		SystemInterlink_invalidateCodeRange(cpu->system, bssAddress,
+				exe->bssSize);
+	}
+	construct_InstructionCache(&cpu->instructionCache);
+
+	// Setup registers
+	cpu->generalRegisters[28] = exe->initialGp;
+	if (exe->initialSp != 0) {
+		cpu->generalRegisters[29] = exe->initialSp;
+		cpu->generalRegisters[30] = exe->initialSp;
+	}
+	cpu->programCounter = exe->initialPc;
+	cpu->jumpPending = false;
+
+	fprintf(stdout, "PhilPSX: PSXExe: Started executable at 0x%08X\n",
+			(uint32_t)exe->initialPc);
+}
+
+/*
+ * This function looks up the file at the specified path (with components
+ * separated by backslashes, and optional version numbers) on the CD, storing
+ * its logical block address and size. It returns false if the CD has no
+ * ISO 9660 file system or the file can't be found.
+ */
+static bool PSXExe_findDiscFile(CDROMDrive *cdrom, const char *path,
+		int32_t *lba, int32_t *size)
+{
+	// Start from root directory record of primary volume descriptor
+	int8_t sector[PHILPSX_PSXEXE_SECTOR_SIZE];
+	if (!CDROMDrive_readDataSector(cdrom,
+			PHILPSX_PSXEXE_VOLUME_DESCRIPTOR_LBA, sector) ||
+			sector[0] != 1 || memcmp(sector + 1, "CD001", 5) != 0)
+		return false;
+	int32_t directoryLba = 0;
+	int32_t directorySize = 0;
+	memcpy(&directoryLba, sector + PHILPSX_PSXEXE_ROOT_RECORD +
+			PHILPSX_PSXEXE_RECORD_LBA, 4);
+	memcpy(&directorySize, sector + PHILPSX_PSXEXE_ROOT_RECORD +
+			PHILPSX_PSXEXE_RECORD_SIZE, 4);
+
+	// Look up each path component in turn
+	while (true) {
+		// Get next component, ignoring any version number
+		while (*path == '\\')
+			++path;
+		size_t componentLength = strcspn(path, "\\;");
+		if (componentLength == 0)
+			return false;
+		bool lastComponent = path[componentLength] != '\\';
+
+		// Search directory for component
+		bool found = false;
+		for (int32_t offset = 0; offset < directorySize && !found;
+				offset += PHILPSX_PSXEXE_SECTOR_SIZE) {
+			if (!CDROMDrive_readDataSector(cdrom,
+					directoryLba + offset / PHILPSX_PSXEXE_SECTOR_SIZE,
+					sector))
+				return false;
+
+			int32_t recordOffset = 0;
+			while (recordOffset < PHILPSX_PSXEXE_SECTOR_SIZE -
+					PHILPSX_PSXEXE_RECORD_NAME) {
+				int8_t *record = sector + recordOffset;
+				int32_t recordLength = record[0] & 0xFF;
+				if (recordLength == 0)
+					break;
+
+				// Compare name, ignoring version number
+				int32_t nameLength =
+						record[PHILPSX_PSXEXE_RECORD_NAME_LENGTH] & 0xFF;
+				if (recordOffset + PHILPSX_PSXEXE_RECORD_NAME + nameLength >
+						PHILPSX_PSXEXE_SECTOR_SIZE)
+					break;
+				const char *name =
+						(const char *)record + PHILPSX_PSXEXE_RECORD_NAME;
+				const char *version = memchr(name, ';', nameLength);
+				if (version)
+					nameLength = (int32_t)(version - name);
+				if (nameLength == (int32_t)componentLength &&
+						strncasecmp(name, path, componentLength) == 0) {
+					memcpy(&directoryLba, record +
+							PHILPSX_PSXEXE_RECORD_LBA, 4);
+					memcpy(&directorySize, record +
+							PHILPSX_PSXEXE_RECORD_SIZE, 4);
+					found = true;
+					break;
+				}
+
+				recordOffset += recordLength;
+			}
+		}
+		if (!found)
+			return false;
+
+		// Return file details if this was the last component
+		if (lastComponent) {
+			*lba = directoryLba;
+			*size = directorySize;
+			return true;
+		}
+		path += componentLength;
+	}
+}
+
+/*
+ * This function checks whether a segment of the specified size at the
+ * specified address lies entirely within RAM (or one of its mirrors in
+ * KUSEG, KSEG0 or KSEG1).
+ */
+static bool PSXExe_fitsInRam(int32_t address, int32_t size)
+{
+	int64_t physicalAddress = address & 0x1FFFFFFFL;
+	return size >= 0 &&
+			physicalAddress + size <= PHILPSX_PSXEXE_RAM_SIZE;
+}
+
+/*
+ * This function checks the header of the executable, and reads the fields
+ * needed to start it, using name in any error messages. It returns false if
+ * the executable isn't a valid PS-X EXE.
+ */
+static bool PSXExe_parseHeader(PSXExe *exe, const char *name)
+{
+	if (exe->size < PHILPSX_PSXEXE_HEADER_SIZE ||
+			memcmp(exe->data, "PS-X EXE", 8) != 0) {
+		fprintf(stderr, "PhilPSX: PSXExe: %s is not a PS-X EXE\n", name);
+		return false;
+	}
+
+	exe->initialPc = PSXExe_readHeaderWord(exe, PHILPSX_PSXEXE_INITIAL_PC);
+	exe->initialGp = PSXExe_readHeaderWord(exe, PHILPSX_PSXEXE_INITIAL_GP);
+	exe->textAddress = PSXExe_readHeaderWord(exe,
+			PHILPSX_PSXEXE_TEXT_ADDRESS);
+	exe->textSize = PSXExe_readHeaderWord(exe, PHILPSX_PSXEXE_TEXT_SIZE);
+	exe->bssAddress = PSXExe_readHeaderWord(exe, PHILPSX_PSXEXE_BSS_ADDRESS);
+	exe->bssSize = PSXExe_readHeaderWord(exe, PHILPSX_PSXEXE_BSS_SIZE);
+	exe->initialSp = PSXExe_readHeaderWord(exe, PHILPSX_PSXEXE_SP_BASE);
+	if (exe->initialSp != 0)
+		exe->initialSp += PSXExe_readHeaderWord(exe,
+				PHILPSX_PSXEXE_SP_OFFSET);
+
+	if (exe->textSize > exe->size - PHILPSX_PSXEXE_HEADER_SIZE ||
+			!PSXExe_fitsInRam(exe->textAddress, exe->textSize) ||
+			(exe->bssSize != 0 &&
+			!PSXExe_fitsInRam(exe->bssAddress, exe->bssSize))) {
+		fprintf(stderr, "PhilPSX: PSXExe: Segments of %s don't fit in "
+				"RAM\n", name);
+		return false;
+	}
+
+	return true;
+}
+
+/*
+ * This function reads the boot executable path and stack pointer from the
+ * contents of a SYSTEM.CNF file, leaving them alone if not present. The
+ * cdrom: device prefix and leading backslashes are removed from the path,
+ * which must have room for PHILPSX_PSXEXE_MAX_PATH characters.
+ */
+static void PSXExe_parseSystemCnf(const char *systemCnf, char *bootPath,
+		int32_t *stack)
+{
+	const char *line = systemCnf;
+	while (*line) {
+		// Split line into key and value
+		size_t lineLength = strcspn(line, "\r\n");
+		const char *key = line + strspn(line, " \t");
+		const char *value = memchr(line, '=', lineLength);
+		if (value) {
+			++value;
+			value += strspn(value, " \t");
+			size_t valueLength = strcspn(value, " \t\r\n");
+
+			if (strncasecmp(key, "BOOT", 4) == 0) {
+				if (strncasecmp(value, "cdrom:", 6) == 0) {
+					value += 6;
+					valueLength -= 6;
+				}
+				while (valueLength > 0 && *value == '\\') {
+					++value;
+					--valueLength;
+				}
+				if (valueLength > 0 &&
+						valueLength < PHILPSX_PSXEXE_MAX_PATH) {
+					memcpy(bootPath, value, valueLength);
+					bootPath[valueLength] = '\0';
+				}
+			} else if (strncasecmp(key, "STACK", 5) == 0) {
+				*stack = (int32_t)strtoul(value, NULL, 16);
+			}
+		}
+
+		// Move on to next line
+		line += lineLength;
+		line += strspn(line, "\r\n");
+	}
+}
+
+/*
+ * This function reads size bytes of the file starting at the specified
+ * logical block address on the CD into destination. It returns false if
+ * there is no CD loaded.
+ */
+static bool PSXExe_readDiscFile(CDROMDrive *cdrom, int32_t lba, int32_t size,
+		int8_t *destination)
+{
+	int8_t sector[PHILPSX_PSXEXE_SECTOR_SIZE];
+	for (int32_t offset = 0; offset < size;
+			offset += PHILPSX_PSXEXE_SECTOR_SIZE) {
+		if (!CDROMDrive_readDataSector(cdrom,
+				lba + offset / PHILPSX_PSXEXE_SECTOR_SIZE, sector))
+			return false;
+		int32_t length = size - offset;
+		if (length > PHILPSX_PSXEXE_SECTOR_SIZE)
+			length = PHILPSX_PSXEXE_SECTOR_SIZE;
+		memcpy(destination + offset, sector, length);
+	}
+
+	return true;
+}
+
+/*
+ * This function reads a word from the header at the specified offset.
+ */
+static int32_t PSXExe_readHeaderWord(PSXExe *exe, int32_t offset)
+{
+	int32_t word = 0;
+	memcpy(&word, exe->data + offset, 4);
+	return word;
+}
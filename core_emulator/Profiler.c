@@ -0,0 +1,349 @@
+/*
+ * This C file models a sampling profiler for guest code as a class. A
+ * dedicated thread wakes up at a fixed interval and records the R3051 program
+ * counter, along with the subsystem (CPU, GTE, GPU, DMA or CD-ROM) the
+ * emulator thread has marked itself as being busy in. Samples therefore
+ * measure host wall-clock time. When stopped, the samples are written out in
+ * the folded stack format understood by flamegraph tools, and a summary is
+ * printed. The program counter and subsystem are read without locking, as a
+ * slightly stale sample does no harm.
+ *
+ * Profiler.c - Copyright Phillip Potter, 2020, under GPLv3
+ */
+#define _POSIX_C_SOURCE 200809L
+#include <time.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "../headers/Profiler.h"
+
+// Sampling interval in nanoseconds, size of the sample table (must be a
+// power of two) and number of entries to print in the summary
+#define PHILPSX_PROFILER_INTERVAL 1000000L
+#define PHILPSX_PROFILER_TABLE_SIZE 65536
+#define PHILPSX_PROFILER_TOP_ENTRIES 20
+
+// Forward declarations for functions and subcomponents private to this class
+// Profiler-related stuff:
+typedef struct ProfilerEntry ProfilerEntry;
+static int Profiler_compareEntries(const void *first, const void *second);
+static void Profiler_recordSample(Profiler *profiler, int32_t programCounter,
+		int32_t subsystem);
+static void *Profiler_samplingFunction(void *arg);
+static void Profiler_writeReport(Profiler *profiler);
+
+// Names of subsystems, as used in reports
+static const char *const subsystemNames[PHILPSX_PROFILER_SUBSYSTEM_COUNT] = {
+	"CPU", "GTE", "GPU", "DMA", "CDROM"
+};
+
+/*
+ * This struct stores the number of samples taken at a given program counter
+ * value within a given subsystem.
+ */
+struct ProfilerEntry {
+	int32_t programCounter;
+	int32_t subsystem;
+	int64_t samples;
+	bool used;
+};
+
+/*
+ * This struct contains the sampled data, along with the state needed to
+ * control the sampling thread.
+ */
+struct Profiler {
+
+	// CPU reference and output file path
+	R3051 *cpu;
+	const char *outputPath;
+
+	// Subsystem the emulator thread is currently in
+	volatile int32_t currentSubsystem;
+
+	// Hash table of samples, along with totals
+	ProfilerEntry *entries;
+	int64_t subsystemSamples[PHILPSX_PROFILER_SUBSYSTEM_COUNT];
+	int64_t totalSamples;
+	int64_t droppedSamples;
+
+	// Sampling thread state
+	pthread_t samplingThread;
+	pthread_mutex_t runningMutex;
+	bool running;
+};
+
+/*
+ * This constructs a Profiler object that samples the specified CPU, writing
+ * its report to outputPath when stopped. The path is not copied, so it must
+ * remain valid for the lifetime of the object. If outputPath is NULL, no
+ * report is written, and samples are only used for the share of time spent
+ * in each subsystem.
+ */
+Profiler *construct_Profiler(R3051 *cpu, const char *outputPath)
+{
+	// Allocate Profiler struct
+	Profiler *profiler = malloc(sizeof(Profiler));
+	if (!profiler) {
+		fprintf(stderr, "PhilPSX: Profiler: Couldn't allocate memory for "
+				"Profiler struct\n");
+		goto end;
+	}
+
+	// Allocate sample table
+	profiler->entries = calloc(PHILPSX_PROFILER_TABLE_SIZE,
+			sizeof(ProfilerEntry));
+	if (!profiler->entries) {
+		fprintf(stderr, "PhilPSX: Profiler: Couldn't allocate memory for "
+				"entries array\n");
+		goto cleanup_profiler;
+	}
+
+	// Setup mutex
+	if (pthread_mutex_init(&profiler->runningMutex, NULL)) {
+		fprintf(stderr, "PhilPSX: Profiler: Couldn't initialise "
+				"runningMutex\n");
+		goto cleanup_entries;
+	}
+
+	// Setup remaining state
+	profiler->cpu = cpu;
+	profiler->outputPath = outputPath;
+	profiler->currentSubsystem = PHILPSX_PROFILER_CPU;
+	for (int32_t i = 0; i < PHILPSX_PROFILER_SUBSYSTEM_COUNT; ++i)
+		profiler->subsystemSamples[i] = 0;
+	profiler->totalSamples = 0;
+	profiler->droppedSamples = 0;
+	profiler->running = false;
+
+	// Normal return:
+	return profiler;
+
+	// Cleanup path:
+	cleanup_entries:
+	free(profiler->entries);
+
+	cleanup_profiler:
+	free(profiler);
+	profiler = NULL;
+
+	end:
+	return profiler;
+}
+
+/*
+ * This destructs a Profiler object, which must not be running.
+ */
+void destruct_Profiler(Profiler *profiler)
+{
+	pthread_mutex_destroy(&profiler->runningMutex);
+	free(profiler->entries);
+	free(profiler);
+}
+
+/*
+ * This function marks the emulator thread as having entered the specified
+ * subsystem, returning the subsystem it was in before so that it can be
+ * restored with Profiler_leaveSubsystem. It does nothing if profiler is NULL,
+ * so callers need not check whether profiling is enabled.
+ */
+int32_t Profiler_enterSubsystem(Profiler *profiler, int32_t subsystem)
+{
+	if (!profiler)
+		return PHILPSX_PROFILER_CPU;
+
+	int32_t previousSubsystem = profiler->currentSubsystem;
+	profiler->currentSubsystem = subsystem;
+	return previousSubsystem;
+}
+
+/*
+ * This function returns the percentage of samples taken so far within the
+ * specified subsystem.
+ */
+double Profiler_getSubsystemShare(Profiler *profiler, int32_t subsystem)
+{
+	if (profiler->totalSamples == 0)
+		return 0.0;
+
+	return profiler->subsystemSamples[subsystem] * 100.0 /
+			profiler->totalSamples;
+}
+
+/*
+ * This function marks the emulator thread as having gone back to the
+ * subsystem it was in before the matching call to Profiler_enterSubsystem.
+ */
+void Profiler_leaveSubsystem(Profiler *profiler, int32_t previousSubsystem)
+{
+	if (profiler)
+		profiler->currentSubsystem = previousSubsystem;
+}
+
+/*
+ * This function starts the sampling thread, returning false if it could
+ * not be started.
+ */
+bool Profiler_start(Profiler *profiler)
+{
+	profiler->running = true;
+	if (pthread_create(&profiler->samplingThread, NULL,
+			&Profiler_samplingFunction, profiler)) {
+		fprintf(stderr, "PhilPSX: Profiler: Couldn't start sampling "
+				"thread\n");
+		profiler->running = false;
+		return false;
+	}
+
+	return true;
+}
+
+/*
+ * This function stops the sampling thread and writes out the report, if
+ * there is an output path. It does nothing if the profiler is not running.
+ */
+void Profiler_stop(Profiler *profiler)
+{
+	pthread_mutex_lock(&profiler->runningMutex);
+	bool wasRunning = profiler->running;
+	profiler->running = false;
+	pthread_mutex_unlock(&profiler->runningMutex);
+	if (!wasRunning)
+		return;
+
+	pthread_join(profiler->samplingThread, NULL);
+	if (profiler->outputPath)
+		Profiler_writeReport(profiler);
+}
+
+/*
+ * This function compares two entries for sorting by number of samples, in
+ * descending order.
+ */
+static int Profiler_compareEntries(const void *first, const void *second)
+{
+	const ProfilerEntry *firstEntry = first;
+	const ProfilerEntry *secondEntry = second;
+
+	if (firstEntry->samples > secondEntry->samples)
+		return -1;
+	else if (firstEntry->samples < secondEntry->samples)
+		return 1;
+	else
+		return 0;
+}
+
+/*
+ * This function adds a sample to the hash table, using linear probing.
+ * Samples that do not fit once the table is full are counted as dropped.
+ */
+static void Profiler_recordSample(Profiler *profiler, int32_t programCounter,
+		int32_t subsystem)
+{
+	// Update totals
+	++profiler->totalSamples;
+	++profiler->subsystemSamples[subsystem];
+
+	// Find entry for this program counter and subsystem
+	uint32_t hash = ((uint32_t)programCounter >> 2) * 0x9E3779B1U + subsystem;
+	for (int32_t i = 0; i < PHILPSX_PROFILER_TABLE_SIZE; ++i) {
+		ProfilerEntry *entry = &profiler->entries[
+				(hash + i) & (PHILPSX_PROFILER_TABLE_SIZE - 1)];
+		if (!entry->used) {
+			entry->programCounter = programCounter;
+			entry->subsystem = subsystem;
+			entry->used = true;
+		} else if (entry->programCounter != programCounter ||
+				entry->subsystem != subsystem) {
+			continue;
+		}
+		++entry->samples;
+		return;
+	}
+
+	++profiler->droppedSamples;
+}
+
+/*
+ * This function is intended to be called in a dedicated thread, and samples
+ * the program counter and subsystem at a fixed interval until the profiler
+ * is stopped.
+ */
+static void *Profiler_samplingFunction(void *arg)
+{
+	Profiler *profiler = arg;
+	struct timespec interval = { 0, PHILPSX_PROFILER_INTERVAL };
+
+	while (true) {
+		nanosleep(&interval, NULL);
+
+		// Check if we need to stop
+		pthread_mutex_lock(&profiler->runningMutex);
+		bool running = profiler->running;
+		pthread_mutex_unlock(&profiler->runningMutex);
+		if (!running)
+			break;
+
+		// Take sample
+		int32_t subsystem = profiler->currentSubsystem;
+		int32_t programCounter = R3051_getProgramCounter(profiler->cpu);
+		Profiler_recordSample(profiler, programCounter, subsystem);
+	}
+
+	return NULL;
+}
+
+/*
+ * This function writes all samples to the output file in folded stack format
+ * (one line per subsystem and program counter, followed by a sample count),
+ * then prints the time spent in each subsystem and the hottest program
+ * counter values.
+ */
+static void Profiler_writeReport(Profiler *profiler)
+{
+	// Gather used entries at the start of the table, sorted by samples
+	int32_t entryCount = 0;
+	for (int32_t i = 0; i < PHILPSX_PROFILER_TABLE_SIZE; ++i) {
+		if (profiler->entries[i].used)
+			profiler->entries[entryCount++] = profiler->entries[i];
+	}
+	qsort(profiler->entries, entryCount, sizeof(ProfilerEntry),
+			Profiler_compareEntries);
+
+	// Write folded stacks
+	FILE *outputFile = fopen(profiler->outputPath, "w");
+	if (!outputFile) {
+		fprintf(stderr, "PhilPSX: Profiler: Couldn't open %s for writing\n",
+				profiler->outputPath);
+	} else {
+		for (int32_t i = 0; i < entryCount; ++i) {
+			ProfilerEntry *entry = &profiler->entries[i];
+			fprintf(outputFile, "PhilPSX;%s;0x%08X %ld\n",
+					subsystemNames[entry->subsystem],
+					(uint32_t)entry->programCounter, (long)entry->samples);
+		}
+		fclose(outputFile);
+	}
+
+	// Print summary
+	fprintf(stdout, "PhilPSX: Profiler: %ld samples (%ld dropped), folded "
+			"stacks written to %s\n", (long)profiler->totalSamples,
+			(long)profiler->droppedSamples, profiler->outputPath);
+	if (profiler->totalSamples == 0)
+		return;
+	for (int32_t i = 0; i < PHILPSX_PROFILER_SUBSYSTEM_COUNT; ++i) {
+		fprintf(stdout, "PhilPSX: Profiler: %-5s %6.2f%%\n",
+				subsystemNames[i], profiler->subsystemSamples[i] * 100.0 /
+				profiler->totalSamples);
+	}
+	for (int32_t i = 0; i < entryCount && i < PHILPSX_PROFILER_TOP_ENTRIES;
+			++i) {
+		ProfilerEntry *entry = &profiler->entries[i];
+		fprintf(stdout, "PhilPSX: Profiler: 0x%08X %-5s %6.2f%%\n",
+				(uint32_t)entry->programCounter,
+				subsystemNames[entry->subsystem],
+				entry->samples * 100.0 / profiler->totalSamples);
+	}
+}
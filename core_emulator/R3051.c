@@ -8,11 +8,8 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include "../headers/R3051.h"
+#include "../headers/R3051_all.h"
 #include "../headers/Components.h"
-#include "../headers/Cop0_all.h"
-#include "../headers/Cop2_all.h"
-#include "../headers/InstructionCache_all.h"
 #include "../headers/SystemInterlink.h"
 #include "../headers/math_utils.h"
 
@@ -21,20 +18,6 @@
 #define PHILPSX_R3051_HALFWORD 16
 #define PHILPSX_R3051_WORD 32
 
-// List of exception reasons
-#define PHILPSX_EXCEPTION_INT 0
-#define PHILPSX_EXCEPTION_ADEL 4
-#define PHILPSX_EXCEPTION_ADES 5
-#define PHILPSX_EXCEPTION_IBE 6
-#define PHILPSX_EXCEPTION_DBE 7
-#define PHILPSX_EXCEPTION_SYS 8
-#define PHILPSX_EXCEPTION_BP 9
-#define PHILPSX_EXCEPTION_RI 10
-#define PHILPSX_EXCEPTION_CPU 11
-#define PHILPSX_EXCEPTION_OVF 12
-#define PHILPSX_EXCEPTION_RESET 13
-#define PHILPSX_EXCEPTION_NULL 14
-
 // Forward declarations for functions and subcomponents private to this class
 // R3051-related stuff:
 static void R3051_ADD(R3051 *cpu, int32_t instruction);
@@ -106,83 +89,44 @@ static void R3051_SWR(R3051 *cpu, int32_t instruction);
 static void R3051_SYSCALL(R3051 *cpu, int32_t instruction);
 static void R3051_XOR(R3051 *cpu, int32_t instruction);
 static void R3051_XORI(R3051 *cpu, int32_t instruction);
+static void R3051_buildBlock(R3051 *cpu, R3051Block *block,
+		int32_t physicalAddress);
+static bool R3051_completeInstruction(R3051 *cpu);
+static R3051Handler R3051_decodeOpcode(int32_t instruction, bool *endOfBlock);
+static bool R3051_detectIdleLoop(R3051Block *block,
+		int32_t delaySlotInstruction);
+static void R3051_executeBlock(R3051 *cpu, R3051Block *block);
+static void R3051_executeInterpretedOpcode(R3051 *cpu, int32_t instruction);
 static void R3051_executeOpcode(R3051 *cpu, int32_t instruction,
 		int32_t tempBranchAddress);
+static void R3051_executeSingleInstruction(R3051 *cpu);
+static void R3051_finishTraceRecord(R3051 *cpu, TraceRecord *record,
+		bool completed);
 static int32_t R3051_getHiReg(R3051 *cpu);
+static bool R3051_getIdleLoopRegisters(int32_t instruction, uint32_t *readMask,
+		uint32_t *writeMask, bool *isLoad);
 static int32_t R3051_getLoReg(R3051 *cpu);
-static int32_t R3051_getProgramCounter(R3051 *cpu);
+static MemoryPage *R3051_getMemoryPage(R3051 *cpu, int32_t address);
 static bool R3051_handleException(R3051 *cpu);
 static bool R3051_handleInterrupts(R3051 *cpu);
+static inline __attribute__((always_inline)) void R3051_interpretBlock(
+		R3051 *cpu, R3051Block *block, int32_t i, int64_t blockAddress,
+		bool cacheableSegment, bool traced);
+static R3051Block *R3051_lookupBlock(R3051 *cpu);
 static int32_t R3051_readDataValue(R3051 *cpu, int32_t width, int32_t address);
-static int64_t R3051_readInstructionWord(R3051 *cpu, int32_t address,
-		int32_t tempBranchAddress);
+static bool R3051_readInstructionWord(R3051 *cpu, int32_t address,
+		int32_t tempBranchAddress, int32_t *instruction);
 static void R3051_reset(R3051 *cpu);
-static int32_t R3051_swapWordEndianness(R3051 *cpu, int32_t word);
+static void R3051_skipIdleLoop(R3051 *cpu, R3051Block *block,
+		int64_t blockAddress);
+static void R3051_startTraceRecord(R3051 *cpu, int32_t instruction,
+		TraceRecord *record);
 static void R3051_writeDataValue(R3051 *cpu, int32_t width, int32_t address,
 		int32_t value);
 
 // MIPSException-related stuff:
-typedef struct MIPSException MIPSException;
 static void MIPSException_reset(MIPSException *exception);
 
-/*
- * This inner struct models a processor exception, which can occur during
- * any stage of the pipeline.
- */
-struct MIPSException {
-	
-	// Exception variables
-	int32_t exceptionReason;
-	int32_t programCounterOrigin;
-	int32_t badAddress;
-	int32_t coProcessorNum;
-	bool isInBranchDelaySlot;
-};
-
-/*
- * This struct contains registers, and pointers to subcomponents.
- */
-struct R3051 {
-	
-	// Component ID
-	int32_t componentId;
-
-	// Register definitions
-	int32_t generalRegisters[32];
-	int32_t programCounter;
-	int32_t hiReg;
-	int32_t loReg;
-
-	// Jump address holder and boolean
-	int32_t jumpAddress;
-	bool jumpPending;
-
-	// Co-processor definitions
-	Cop0 sccp;
-	Cop2 gte;
-
-	// Bus holder definition
-	int32_t busHolder;
-
-	// System link
-	SystemInterlink *system;
-
-	// This stores the current exception
-	MIPSException exception;
-
-	// This stores the instruction cache
-	InstructionCache instructionCache;
-
-	// This tells us if the last instruction was a branch/jump instruction
-	bool prevWasBranch;
-	bool isBranch;
-
-	// This counts the cycles of the current instruction
-	int32_t cycles;
-	int32_t gteCycles;
-	int64_t totalCycles;
-};
-
 /*
  * This constructs a new R3051 object.
  */
@@ -198,6 +142,8 @@ R3051 *construct_R3051(void)
 	
 	// Set SystemInterlink reference to NULL
 	cpu->system = NULL;
+	cpu->pageTable = NULL;
+	cpu->scheduler = NULL;
 
 	// Set component ID
 	cpu->componentId = PHILPSX_COMPONENTS_CPU;
@@ -206,6 +152,7 @@ R3051 *construct_R3051(void)
 	cpu->cycles = 0;
 	cpu->gteCycles = 0;
 	cpu->totalCycles = 0;
+	cpu->instructionCount = 0;
 
 	// Setup registers (remember, r1 should always be 0)
 	memset(cpu->generalRegisters, 0, sizeof(cpu->generalRegisters));
@@ -227,6 +174,26 @@ R3051 *construct_R3051(void)
 		goto cleanup_r3051;
 	}
 
+	// Setup block cache
+	cpu->blockCache = calloc(PHILPSX_R3051_BLOCKCACHE_SIZE, sizeof(R3051Block));
+	if (!cpu->blockCache) {
+		fprintf(stderr, "PhilPSX: R3051: Couldn't allocate memory for "
+				"blockCache array\n");
+		goto cleanup_instructioncache;
+	}
+
+	// Interpret by default, until the recompiler is enabled
+	cpu->recompiler = NULL;
+
+	// Run BIOS functions from the BIOS, until their emulation is enabled
+	cpu->hle = NULL;
+
+	// Boot normally, until an executable is set
+	cpu->exe = NULL;
+
+	// Don't record instructions, until tracing is enabled
+	cpu->tracer = NULL;
+
 	// Setup the branch marker
 	cpu->prevWasBranch = false;
 	cpu->isBranch = false;
@@ -246,6 +213,9 @@ R3051 *construct_R3051(void)
 	return cpu;
 
 	// Cleanup path:
+	cleanup_instructioncache:
+	destruct_InstructionCache(&cpu->instructionCache);
+
 	cleanup_r3051:
 	free(cpu);
 	cpu = NULL;
@@ -259,85 +229,84 @@ R3051 *construct_R3051(void)
  */
 void destruct_R3051(R3051 *cpu)
 {
+	if (cpu->recompiler)
+		destruct_R3051Recompiler(cpu->recompiler);
+	if (cpu->hle)
+		destruct_BiosHLE(cpu->hle);
+	if (cpu->tracer)
+		destruct_Tracer(cpu->tracer);
+	free(cpu->blockCache);
 	destruct_InstructionCache(&cpu->instructionCache);
 	free(cpu);
 }
 
 /*
- * This function moves the whole processor on by one block of instructions.
+ * This function enables native emulation of BIOS library functions, which
+ * are then run directly when called through the A0h dispatcher. It returns
+ * false if the emulation could not be constructed, in which case the BIOS
+ * code is still used.
  */
-int64_t R3051_executeInstructions(R3051 *cpu)
+bool R3051_enableHLE(R3051 *cpu)
 {
-	// Enter loop
-	do {
-		// Setup cycle count and instruction
-		cpu->cycles = 0;
-		int32_t instruction = 0;
+	if (!cpu->hle)
+		cpu->hle = construct_BiosHLE();
 
-		// Check address is OK, throwing exception if not
-		int32_t tempAddress =
-				(int32_t)((cpu->programCounter & 0xFFFFFFFFL) - 4L);
+	return cpu->hle != NULL;
+}
 
-		// Perform read of instruction
-		int64_t tempInstruction = R3051_readInstructionWord(
-				cpu,
-				cpu->programCounter,
-				tempAddress
-				);
-		if (tempInstruction == -1L) {
-			cpu->cycles += 1;
-			cpu->totalCycles += 1;
-			SystemInterlink_appendSyncCycles(cpu->system, cpu->cycles);
-			continue;
-		}
+/*
+ * This function switches the processor over to executing recompiled host
+ * code for blocks in RAM and BIOS. It returns false if the recompiler could
+ * not be constructed, in which case the interpreter remains in use.
+ */
+bool R3051_enableRecompiler(R3051 *cpu)
+{
+	if (!cpu->recompiler)
+		cpu->recompiler = construct_R3051Recompiler();
 
-		// Cast long to int
-		instruction = (int32_t)tempInstruction;
+	return cpu->recompiler != NULL;
+}
 
-		// We now have instruction value. Swap bytes if we are in
-		// little endian mode
-		instruction = R3051_swapWordEndianness(cpu, instruction);
+/*
+ * This function starts recording every instruction executed to a binary
+ * trace file at outputPath. Traced blocks are always interpreted, even if the
+ * recompiler is enabled. It returns false if the trace recorder could not be
+ * constructed, in which case nothing is recorded.
+ */
+bool R3051_enableTracing(R3051 *cpu, const char *outputPath)
+{
+	if (!cpu->tracer)
+		cpu->tracer = construct_Tracer(outputPath);
 
-		// Execute
-		R3051_executeOpcode(cpu, instruction, tempAddress);
+	return cpu->tracer != NULL;
+}
 
-		// Handle exception if there was one
-		if (R3051_handleException(cpu)) {
-			cpu->cycles += 1;
-			cpu->totalCycles += 1;
-			SystemInterlink_appendSyncCycles(cpu->system, cpu->cycles);
-			continue;
+/*
+ * This function moves the whole processor on by one block of instructions.
+ */
+int64_t R3051_executeInstructions(R3051 *cpu)
+{
+	// Enter loop
+	do {
+		// Start executable instead of the shell once the BIOS reaches it
+		if (cpu->exe && (cpu->programCounter & 0x1FFFFFFF) ==
+				PHILPSX_PSXEXE_SHELL_ENTRY) {
+			PSXExe_start(cpu->exe, cpu);
+			cpu->exe = NULL;
 		}
 
-		// Handle interrupt if there was one
-		if (cpu->isBranch && R3051_handleInterrupts(cpu)) {
-			cpu->cycles += 1;
-			cpu->totalCycles += 1;
-			SystemInterlink_appendSyncCycles(cpu->system, cpu->cycles);
+		// Run emulated BIOS function if one is being called
+		if (cpu->hle && !cpu->prevWasBranch &&
+				BiosHLE_handleCall(cpu->hle, cpu))
 			continue;
-		}
 
-		// Jump if pending, else add four to program counter
-		if (cpu->jumpPending && cpu->prevWasBranch) {
-			cpu->programCounter = cpu->jumpAddress;
-			cpu->jumpPending = false;
-		} else {
-			tempAddress = (int32_t)((cpu->programCounter & 0xFFFFFFFFL) + 4L);
-			cpu->programCounter = tempAddress;
-		}
-
-		// Increment cycle count
-		cpu->cycles += (cpu->gteCycles == 0) ? 1 : cpu->gteCycles;
-		cpu->totalCycles += (cpu->gteCycles == 0) ? 1 : cpu->gteCycles;
-		cpu->gteCycles = 0;
-
-		// Setup whether the instruction just gone was a branch, and clear
-		// current branch status
-		cpu->prevWasBranch = cpu->isBranch;
-		cpu->isBranch = false;
-
-		// Return number of cycles instruction took
-		SystemInterlink_appendSyncCycles(cpu->system, cpu->cycles);
+		// Execute from the block cache where possible, falling back to
+		// stepping a single instruction for code outside RAM and BIOS
+		R3051Block *block = R3051_lookupBlock(cpu);
+		if (block)
+			R3051_executeBlock(cpu, block);
+		else
+			R3051_executeSingleInstruction(cpu);
 	} while (!cpu->prevWasBranch);
 	
 	// Return cycle count for this block after resetting it in the CPU object
@@ -370,6 +339,47 @@ Cop2 *R3051_getCop2(R3051 *cpu)
 	return &cpu->gte;
 }
 
+/*
+ * This function returns the number of instructions completed so far, not
+ * counting those interrupted by an exception.
+ */
+int64_t R3051_getInstructionCount(R3051 *cpu)
+{
+	return cpu->instructionCount;
+}
+
+/*
+ * This retrieves the program counter value.
+ */
+int32_t R3051_getProgramCounter(R3051 *cpu)
+{
+	return cpu->programCounter;
+}
+
+/*
+ * This function invalidates any cached blocks overlapping the physical
+ * address range specified, so that code written to memory is decoded afresh.
+ */
+void R3051_invalidateBlockCache(R3051 *cpu, int32_t address, int32_t length)
+{
+	// Any block starting up to one block length before the range may
+	// overlap it
+	int64_t startAddress = (address & 0xFFFFFFFCL) -
+			(PHILPSX_R3051_BLOCK_LENGTH - 1) * 4;
+	int64_t endAddress = (address & 0xFFFFFFFFL) + length;
+	if (startAddress < 0)
+		startAddress = 0;
+
+	// Check each possible starting address against its block cache slot
+	for (int64_t i = startAddress; i < endAddress; i += 4) {
+		R3051Block *block = &cpu->blockCache[
+				(i >> 2) & (PHILPSX_R3051_BLOCKCACHE_SIZE - 1)];
+		if (block->valid && block->physicalAddress == (int32_t)i &&
+				i + block->length * 4 > (address & 0xFFFFFFFFL))
+			block->valid = false;
+	}
+}
+
 /*
  * This function sets the current holder of the system bus.
  */
@@ -378,12 +388,25 @@ void R3051_setBusHolder(R3051 *cpu, int32_t holder)
 	cpu->busHolder = holder;
 }
 
+/*
+ * This function sets an executable to be started in place of the BIOS
+ * shell, once the BIOS has initialised the kernel and jumps to it. The
+ * executable is not owned by the processor, and must remain valid until it
+ * has been started.
+ */
+void R3051_setExe(R3051 *cpu, PSXExe *exe)
+{
+	cpu->exe = exe;
+}
+
 /*
  * This function sets the system interlink reference.
  */
 void R3051_setMemoryInterface(R3051 *cpu, SystemInterlink *system)
 {
 	cpu->system = system;
+	cpu->pageTable = SystemInterlink_getPageTable(system);
+	cpu->scheduler = SystemInterlink_getScheduler(system);
 }
 
 /*
@@ -1100,14 +1123,12 @@ static void R3051_LH(R3051 *cpu, int32_t instruction)
 		return;
 	}
 
-	// Load half-word and swap endianness, sign extend
+	// Load half-word and sign extend
 	int32_t tempHalfWord = 0xFFFF & R3051_readDataValue(
 			cpu,
 			PHILPSX_R3051_HALFWORD,
 			(int32_t)address
 			);
-	tempHalfWord = ((tempHalfWord << 8) & 0xFF00) |
-			logical_rshift(tempHalfWord, 8);
 	if ((tempHalfWord & 0x8000) == 0x8000) {
 		tempHalfWord |= 0xFFFF0000;
 	}
@@ -1149,17 +1170,13 @@ static void R3051_LHU(R3051 *cpu, int32_t instruction)
 		return;
 	}
 
-	// Load half-word and swap endianness, zero extend
+	// Load half-word and zero extend
 	int32_t tempHalfWord = 0xFFFF & R3051_readDataValue(
 			cpu,
 			PHILPSX_R3051_HALFWORD,
 			(int32_t)address
 			);
 
-	// Swap byte order
-	tempHalfWord = ((tempHalfWord << 8) & 0xFF00) |
-			logical_rshift(tempHalfWord, 8);
-
 	// Write half-word to correct register
 	cpu->generalRegisters[rt] = tempHalfWord;
 	cpu->generalRegisters[0] = 0;
@@ -1218,9 +1235,6 @@ static void R3051_LW(R3051 *cpu, int32_t instruction)
 			(int32_t)address
 			);
 
-	// Swap byte order
-	tempWord = R3051_swapWordEndianness(cpu, tempWord);
-
 	// Write word to correct register
 	cpu->generalRegisters[rt] = tempWord;
 	cpu->generalRegisters[0] = 0;
@@ -1264,9 +1278,6 @@ static void R3051_LWC2(R3051 *cpu, int32_t instruction)
 			(int32_t)address
 			);
 
-	// Swap byte order
-	tempWord = R3051_swapWordEndianness(cpu, tempWord);
-
 	// Write word to correct COP2 data register
 	Cop2_writeDataReg(&cpu->gte, rt, tempWord, false);
 }
@@ -1310,9 +1321,6 @@ static void R3051_LWL(R3051 *cpu, int32_t instruction)
 			tempAddress
 			);
 
-	// Swap byte order
-	tempWord = R3051_swapWordEndianness(cpu, tempWord);
-
 	// Shift word value left by required amount
 	tempWord = tempWord << (byteShiftIndex * 8);
 
@@ -1363,9 +1371,6 @@ static void R3051_LWR(R3051 *cpu, int32_t instruction)
 	int32_t byteShiftIndex = (int32_t)(address & 0x3);
 	int32_t tempWord = R3051_readDataValue(cpu, PHILPSX_R3051_WORD, tempAddress);
 
-	// Swap byte order
-	tempWord = R3051_swapWordEndianness(cpu, tempWord);
-
 	// Shift word value left by required amount
 	tempWord = logical_rshift(tempWord, (byteShiftIndex * 8));
 
@@ -1667,14 +1672,10 @@ static void R3051_SH(R3051 *cpu, int32_t instruction)
 		return;
 	}
 
-	// Load half-word from register and swap endianness, then write to memory
+	// Load half-word from register, then write to memory
 	// (checking for exceptions and stalls)
 	int32_t tempHalfWord = 0xFFFF & cpu->generalRegisters[rt];
 
-	// Swap byte order
-	tempHalfWord = ((tempHalfWord << 8) & 0xFF00) |
-			logical_rshift(tempHalfWord, 8);
-
 	R3051_writeDataValue(
 			cpu,
 			PHILPSX_R3051_HALFWORD,
@@ -1969,9 +1970,6 @@ static void R3051_SW(R3051 *cpu, int32_t instruction)
 	// (checking for exceptions and stalls)
 	int32_t tempWord = cpu->generalRegisters[rt];
 
-	// Swap byte order
-	tempWord = R3051_swapWordEndianness(cpu, tempWord);
-
 	R3051_writeDataValue(cpu, PHILPSX_R3051_WORD, (int32_t)address, tempWord);
 }
 
@@ -2009,9 +2007,6 @@ static void R3051_SWC2(R3051 *cpu, int32_t instruction)
 	// Load word from register, set byte order and write to memory
 	int32_t tempWord = Cop2_readDataReg(&cpu->gte, rt);
 
-	// Swap byte order
-	tempWord = R3051_swapWordEndianness(cpu, tempWord);
-
 	R3051_writeDataValue(cpu, PHILPSX_R3051_WORD, (int32_t)address, tempWord);
 }
 
@@ -2045,20 +2040,17 @@ static void R3051_SWL(R3051 *cpu, int32_t instruction)
 		return;
 	}
 
-	// Align address, fetch word, and store shift index - sort byte order too
+	// Align address, fetch word, and store shift index
 	int32_t tempAddress = (int32_t)(address & 0xFFFFFFFC);
 	int32_t byteShiftIndex = (int32_t)(~address & 0x3);
 	int32_t tempWord = cpu->generalRegisters[rt];
 
-	// Swap byte order
-	tempWord = R3051_swapWordEndianness(cpu, tempWord);
-
-	// Shift word value left by required amount
-	tempWord = tempWord << (byteShiftIndex * 8);
+	// Shift word value right by required amount
+	tempWord = logical_rshift(tempWord, (byteShiftIndex * 8));
 
 	// Fetch memory contents, and calculate mask
 	int32_t tempVal = SystemInterlink_readWord(cpu->system, tempAddress);
-	int32_t mask = ~(0xFFFFFFFF << (byteShiftIndex * 8));
+	int32_t mask = ~logical_rshift(0xFFFFFFFF, (byteShiftIndex * 8));
 	tempVal &= mask;
 
 	// Merge contents
@@ -2098,20 +2090,17 @@ static void R3051_SWR(R3051 *cpu, int32_t instruction)
 		return;
 	}
 
-	// Align address, fetch word, and store shift index - sort byte order too
+	// Align address, fetch word, and store shift index
 	int32_t tempAddress = (int32_t)(address & 0xFFFFFFFC);
 	int32_t byteShiftIndex = (int32_t)(address & 0x3);
 	int32_t tempWord = cpu->generalRegisters[rt];
 
-	// Swap byte order
-	tempWord = R3051_swapWordEndianness(cpu, tempWord);
-
-	// Shift word value right by required amount
-	tempWord = logical_rshift(tempWord, (byteShiftIndex * 8));
+	// Shift word value left by required amount
+	tempWord = tempWord << (byteShiftIndex * 8);
 
-	// Fetch rt contents, and calculate mask
+	// Fetch memory contents, and calculate mask
 	int32_t tempVal = SystemInterlink_readWord(cpu->system, tempAddress);
-	int32_t mask = ~logical_rshift(0xFFFFFFFF, (byteShiftIndex * 8));
+	int32_t mask = ~(0xFFFFFFFF << (byteShiftIndex * 8));
 	tempVal &= mask;
 
 	// Merge contents
@@ -2168,6 +2157,401 @@ static void R3051_XORI(R3051 *cpu, int32_t instruction)
 	cpu->generalRegisters[0] = 0;
 }
 
+/*
+ * This function decodes a basic block starting at the specified physical
+ * address into the block supplied. Decoding stops after any branch, jump,
+ * exception-raising or COP0 instruction, at the end of the 4KB page, or when
+ * the block is full.
+ */
+static void R3051_buildBlock(R3051 *cpu, R3051Block *block,
+		int32_t physicalAddress)
+{
+	// Setup block
+	block->physicalAddress = physicalAddress;
+	block->length = 0;
+	block->valid = true;
+	block->compiledCode = NULL;
+
+	// Mark RAM pages as containing code, so writes to them invalidate us
+	int64_t tempAddress = physicalAddress & 0xFFFFFFFFL;
+	if (tempAddress < PHILPSX_RAM_MIRROR_SPAN)
+		SystemInterlink_markCodePage(cpu->system, physicalAddress);
+
+	// Fetch cost is constant throughout a page
+	int32_t fetchCycles =
+			SystemInterlink_howManyStallCycles(cpu->system, physicalAddress);
+
+	// Decode instructions
+	bool endOfBlock = false;
+	while (!endOfBlock && block->length < PHILPSX_R3051_BLOCK_LENGTH) {
+		int32_t instruction =
+				SystemInterlink_readWord(cpu->system, (int32_t)tempAddress);
+		R3051Op *op = &block->ops[block->length];
+		op->handler = R3051_decodeOpcode(instruction, &endOfBlock);
+		op->instruction = instruction;
+		op->fetchCycles = fetchCycles;
+		++block->length;
+
+		// Stop at page boundary
+		tempAddress += 4;
+		if ((tempAddress & 0xFFF) == 0)
+			endOfBlock = true;
+	}
+
+	// Check if the block is an idle loop, which needs its branch delay slot
+	// to be in the same page
+	block->idleLoop = (tempAddress & 0xFFF) != 0 && R3051_detectIdleLoop(
+			block,
+			SystemInterlink_readWord(cpu->system, (int32_t)tempAddress)
+			);
+}
+
+/*
+ * This function finishes off an instruction once its handler has run. It
+ * deals with any exception or interrupt, moves the program counter on and
+ * accounts for the cycles the instruction took. It returns false if an
+ * exception or interrupt was taken.
+ */
+static bool R3051_completeInstruction(R3051 *cpu)
+{
+	// Handle exception if there was one
+	if (R3051_handleException(cpu)) {
+		cpu->cycles += 1;
+		cpu->totalCycles += 1;
+		SystemInterlink_appendSyncCycles(cpu->system, cpu->cycles);
+		return false;
+	}
+
+	// Handle interrupt if there was one
+	if (cpu->isBranch && R3051_handleInterrupts(cpu)) {
+		cpu->cycles += 1;
+		cpu->totalCycles += 1;
+		SystemInterlink_appendSyncCycles(cpu->system, cpu->cycles);
+		return false;
+	}
+
+	// Jump if pending, else add four to program counter
+	if (cpu->jumpPending && cpu->prevWasBranch) {
+		cpu->programCounter = cpu->jumpAddress;
+		cpu->jumpPending = false;
+	} else {
+		cpu->programCounter =
+				(int32_t)((cpu->programCounter & 0xFFFFFFFFL) + 4L);
+	}
+
+	// Increment cycle and instruction counts
+	cpu->cycles += (cpu->gteCycles == 0) ? 1 : cpu->gteCycles;
+	cpu->totalCycles += (cpu->gteCycles == 0) ? 1 : cpu->gteCycles;
+	cpu->gteCycles = 0;
+	++cpu->instructionCount;
+
+	// Setup whether the instruction just gone was a branch, and clear
+	// current branch status
+	cpu->prevWasBranch = cpu->isBranch;
+	cpu->isBranch = false;
+
+	// Return number of cycles instruction took
+	SystemInterlink_appendSyncCycles(cpu->system, cpu->cycles);
+	return true;
+}
+
+/*
+ * This function returns the handler for an instruction, so it can be stored
+ * in a pre-decoded block. Instructions whose dispatch depends on COP0 state
+ * or which are reserved are handed back to the interpreter. It also sets
+ * endOfBlock to signal whether the instruction should end the block.
+ */
+static R3051Handler R3051_decodeOpcode(int32_t instruction, bool *endOfBlock)
+{
+	// Deal with opcode
+	int32_t opcode = logical_rshift(instruction, 26);
+	switch (opcode) {
+		case 0: // SPECIAL
+		{
+			int32_t specialVal = instruction & 0x3F;
+			switch (specialVal) {
+				case 0:
+					return R3051_SLL;
+				case 2:
+					return R3051_SRL;
+				case 3:
+					return R3051_SRA;
+				case 4:
+					return R3051_SLLV;
+				case 6:
+					return R3051_SRLV;
+				case 7:
+					return R3051_SRAV;
+				case 8:
+					*endOfBlock = true;
+					return R3051_JR;
+				case 9:
+					*endOfBlock = true;
+					return R3051_JALR;
+				case 12:
+					*endOfBlock = true;
+					return R3051_SYSCALL;
+				case 13:
+					*endOfBlock = true;
+					return R3051_BREAK;
+				case 16:
+					return R3051_MFHI;
+				case 17:
+					return R3051_MTHI;
+				case 18:
+					return R3051_MFLO;
+				case 19:
+					return R3051_MTLO;
+				case 24:
+					return R3051_MULT;
+				case 25:
+					return R3051_MULTU;
+				case 26:
+					return R3051_DIV;
+				case 27:
+					return R3051_DIVU;
+				case 32:
+					return R3051_ADD;
+				case 33:
+					return R3051_ADDU;
+				case 34:
+					return R3051_SUB;
+				case 35:
+					return R3051_SUBU;
+				case 36:
+					return R3051_AND;
+				case 37:
+					return R3051_OR;
+				case 38:
+					return R3051_XOR;
+				case 39:
+					return R3051_NOR;
+				case 42:
+					return R3051_SLT;
+				case 43:
+					return R3051_SLTU;
+			}
+		}
+		break;
+		case 1: // BCOND
+		{
+			*endOfBlock = true;
+			int32_t bcondVal = logical_rshift(instruction, 16) & 0x1F;
+			switch (bcondVal) {
+				case 0:
+					return R3051_BLTZ;
+				case 1:
+					return R3051_BGEZ;
+				case 16:
+					return R3051_BLTZAL;
+				case 17:
+					return R3051_BGEZAL;
+			}
+		}
+		break;
+		case 2:
+			*endOfBlock = true;
+			return R3051_J;
+		case 3:
+			*endOfBlock = true;
+			return R3051_JAL;
+		case 4:
+			*endOfBlock = true;
+			return R3051_BEQ;
+		case 5:
+			*endOfBlock = true;
+			return R3051_BNE;
+		case 6:
+			*endOfBlock = true;
+			return R3051_BLEZ;
+		case 7:
+			*endOfBlock = true;
+			return R3051_BGTZ;
+		case 8:
+			return R3051_ADDI;
+		case 9:
+			return R3051_ADDIU;
+		case 10:
+			return R3051_SLTI;
+		case 11:
+			return R3051_SLTIU;
+		case 12:
+			return R3051_ANDI;
+		case 13:
+			return R3051_ORI;
+		case 14:
+			return R3051_XORI;
+		case 15:
+			return R3051_LUI;
+		case 16: // COP0
+			*endOfBlock = true;
+			break;
+		case 32:
+			return R3051_LB;
+		case 33:
+			return R3051_LH;
+		case 34:
+			return R3051_LWL;
+		case 35:
+			return R3051_LW;
+		case 36:
+			return R3051_LBU;
+		case 37:
+			return R3051_LHU;
+		case 38:
+			return R3051_LWR;
+		case 40:
+			return R3051_SB;
+		case 41:
+			return R3051_SH;
+		case 42:
+			return R3051_SWL;
+		case 43:
+			return R3051_SW;
+		case 46:
+			return R3051_SWR;
+		case 50:
+			return R3051_LWC2;
+		case 58:
+			return R3051_SWC2;
+	}
+
+	// Everything else goes through the interpreter
+	return R3051_executeInterpretedOpcode;
+}
+
+/*
+ * This function tells us if a block is a short loop that only polls memory
+ * or I/O ports, so that spinning in it until the next system event can be
+ * skipped. The block must end in a conditional branch back to its own start,
+ * and neither it nor the branch delay slot may have side effects or carry
+ * register values from one iteration to the next. Load base registers must
+ * still hold the values they were used with once the branch has run, so the
+ * polled addresses can be checked at that point.
+ */
+static bool R3051_detectIdleLoop(R3051Block *block,
+		int32_t delaySlotInstruction)
+{
+	// Check block ends in a conditional branch back to its start
+	int32_t branch = block->ops[block->length - 1].instruction;
+	int32_t opcode = logical_rshift(branch, 26);
+	if (opcode != 1 && (opcode < 4 || opcode > 7))
+		return false;
+	int32_t offset = branch & 0xFFFF;
+	if ((offset & 0x8000) == 0x8000) {
+		offset |= 0xFFFF0000;
+	}
+	if (block->physicalAddress + block->length * 4 + (offset << 2) !=
+			block->physicalAddress)
+		return false;
+
+	// Get registers read and written by each instruction, including the
+	// delay slot, which must not load
+	int32_t count = block->length + 1;
+	uint32_t readMasks[PHILPSX_R3051_BLOCK_LENGTH + 1];
+	uint32_t writeMasks[PHILPSX_R3051_BLOCK_LENGTH + 1];
+	bool isLoad[PHILPSX_R3051_BLOCK_LENGTH + 1];
+	uint32_t loopWrites = 0;
+	for (int32_t i = 0; i < count; ++i) {
+		int32_t instruction = (i < block->length) ?
+				block->ops[i].instruction : delaySlotInstruction;
+		if (!R3051_getIdleLoopRegisters(instruction, &readMasks[i],
+				&writeMasks[i], &isLoad[i]))
+			return false;
+		if (i == block->length && isLoad[i])
+			return false;
+		loopWrites |= writeMasks[i];
+	}
+
+	// Check registers written by the loop are always written before being
+	// read in the same iteration, and that load base registers are not
+	// overwritten after the load (including by the load itself)
+	uint32_t writtenSoFar = 0;
+	for (int32_t i = 0; i < count; ++i) {
+		if ((readMasks[i] & loopWrites & ~writtenSoFar) != 0)
+			return false;
+		writtenSoFar |= writeMasks[i];
+
+		if (isLoad[i]) {
+			uint32_t baseMask = readMasks[i];
+			for (int32_t j = i; j < count; ++j) {
+				if ((writeMasks[j] & baseMask) != 0)
+					return false;
+			}
+		}
+	}
+
+	return true;
+}
+
+/*
+ * This function executes instructions from a pre-decoded block, mirroring
+ * R3051_executeSingleInstruction for each one. If the recompiler is enabled
+ * and tracing is not, the block's host code runs first, and any instructions
+ * it hands back are finished off here. It returns early when the program
+ * counter leaves the block, the block is invalidated by a write, or a branch
+ * instruction has completed.
+ */
+static void R3051_executeBlock(R3051 *cpu, R3051Block *block)
+{
+	// Store virtual address of block start, and whether it is in a cacheable
+	// segment (which holds for the whole block)
+	int64_t blockAddress = cpu->programCounter & 0xFFFFFFFFL;
+	bool cacheableSegment = Cop0_isCacheable(&cpu->sccp, cpu->programCounter);
+	int32_t i = 0;
+
+	// Interpret the whole block with tracing if it is enabled
+	if (cpu->tracer) {
+		R3051_interpretBlock(cpu, block, 0, blockAddress, cacheableSegment,
+				true);
+		return;
+	}
+
+	// Run recompiled code if we have it, compiling it first if needed
+	if (cpu->recompiler) {
+		bool instructionCacheEnabled = cacheableSegment &&
+				SystemInterlink_instructionCacheEnabled(cpu->system);
+		if (!block->compiledCode ||
+				block->compiledWithInstructionCache !=
+				instructionCacheEnabled)
+			R3051Recompiler_compileBlock(cpu->recompiler, cpu, block,
+					instructionCacheEnabled);
+
+		if (block->compiledCode) {
+			// The exit code holds the index of the instruction to carry on
+			// from, and whether that instruction's handler has already run
+			int32_t exitCode = block->compiledCode(cpu);
+			i = exitCode >> 1;
+			if ((exitCode & 1) == 1) {
+				if (!R3051_completeInstruction(cpu))
+					return;
+				if (cpu->prevWasBranch && block->idleLoop)
+					R3051_skipIdleLoop(cpu, block, blockAddress);
+				if (cpu->prevWasBranch || !block->valid ||
+						(cpu->programCounter & 0xFFFFFFFFL) !=
+						blockAddress + (i + 1) * 4)
+					return;
+				++i;
+			}
+		}
+	}
+
+	// Interpret whatever is left
+	R3051_interpretBlock(cpu, block, i, blockAddress, cacheableSegment,
+			false);
+}
+
+/*
+ * This function is the handler used by pre-decoded blocks for instructions
+ * that need the full interpreter.
+ */
+static void R3051_executeInterpretedOpcode(R3051 *cpu, int32_t instruction)
+{
+	int32_t tempBranchAddress =
+			(int32_t)((cpu->programCounter & 0xFFFFFFFFL) - 4L);
+	R3051_executeOpcode(cpu, instruction, tempBranchAddress);
+}
+
 /*
  * This function executes an opcode in interpretive mode.
  */
@@ -2502,9 +2886,15 @@ static void R3051_executeOpcode(R3051 *cpu, int32_t instruction,
 				case 28:
 				case 29:
 				case 30:
-				case 31:
-					// Co-processor specific
+				case 31: // Co-processor specific
+				{
+					Profiler *profiler =
+							SystemInterlink_getProfiler(cpu->system);
+					int32_t previousSubsystem = Profiler_enterSubsystem(
+							profiler, PHILPSX_PROFILER_GTE);
 					cpu->gteCycles = Cop2_gteFunction(&cpu->gte, instruction);
+					Profiler_leaveSubsystem(profiler, previousSubsystem);
+				}
 					break;
 			}
 		}
@@ -2631,6 +3021,65 @@ static void R3051_executeOpcode(R3051 *cpu, int32_t instruction,
 	}
 }
 
+/*
+ * This function executes a single instruction, fetching and decoding it
+ * through the interpreter.
+ */
+static void R3051_executeSingleInstruction(R3051 *cpu)
+{
+	// Setup cycle count and instruction
+	cpu->cycles = 0;
+	int32_t instruction = 0;
+
+	// Check address is OK, throwing exception if not
+	int32_t tempAddress =
+			(int32_t)((cpu->programCounter & 0xFFFFFFFFL) - 4L);
+
+	// Perform read of instruction
+	if (!R3051_readInstructionWord(cpu, cpu->programCounter, tempAddress,
+			&instruction)) {
+		cpu->cycles += 1;
+		cpu->totalCycles += 1;
+		SystemInterlink_appendSyncCycles(cpu->system, cpu->cycles);
+		return;
+	}
+
+	// Execute, recording the instruction if tracing
+	TraceRecord record;
+	if (cpu->tracer)
+		R3051_startTraceRecord(cpu, instruction, &record);
+	R3051_executeOpcode(cpu, instruction, tempAddress);
+	bool completed = R3051_completeInstruction(cpu);
+	if (cpu->tracer)
+		R3051_finishTraceRecord(cpu, &record, completed);
+}
+
+/*
+ * This function completes a trace record started by R3051_startTraceRecord
+ * once the instruction has run, and adds it to the trace.
+ */
+static void R3051_finishTraceRecord(R3051 *cpu, TraceRecord *record,
+		bool completed)
+{
+	// Fill in written register, which is also the loaded value for loads
+	if (record->registerIndex != 0) {
+		record->registerValue =
+				cpu->generalRegisters[record->registerIndex];
+		if (record->memoryAccess == PHILPSX_TRACER_ACCESS_LOAD)
+			record->memoryValue = record->registerValue;
+	} else if (record->memoryAccess == PHILPSX_TRACER_ACCESS_LOAD) {
+		// LWC2 loads straight into a GTE data register
+		record->memoryValue = Cop2_readDataReg(&cpu->gte,
+				logical_rshift(record->instruction, 16) & 0x1F);
+	}
+
+	// Mark instructions that raised an exception or were interrupted
+	if (!completed)
+		record->flags |= PHILPSX_TRACER_FLAG_EXCEPTION;
+
+	Tracer_addRecord(cpu->tracer, record);
+}
+
 /*
  * This function returns the hi register.
  */
@@ -2639,6 +3088,99 @@ static int32_t R3051_getHiReg(R3051 *cpu)
 	return cpu->hiReg;
 }
 
+/*
+ * This function works out which general registers an instruction reads and
+ * writes (as bitmasks, ignoring register 0), and whether it is a load, for
+ * idle loop detection. It returns false for any instruction that cannot be
+ * part of an idle loop, which is anything other than simple ALU operations,
+ * plain loads and conditional branches without link.
+ */
+static bool R3051_getIdleLoopRegisters(int32_t instruction, uint32_t *readMask,
+		uint32_t *writeMask, bool *isLoad)
+{
+	// Get rs, rt and rd
+	int32_t rs = logical_rshift(instruction, 21) & 0x1F;
+	int32_t rt = logical_rshift(instruction, 16) & 0x1F;
+	int32_t rd = logical_rshift(instruction, 11) & 0x1F;
+
+	// Set defaults
+	*readMask = 0;
+	*writeMask = 0;
+	*isLoad = false;
+
+	// Deal with opcode
+	int32_t opcode = logical_rshift(instruction, 26);
+	switch (opcode) {
+		case 0: // SPECIAL
+			switch (instruction & 0x3F) {
+				case 0: // SLL
+				case 2: // SRL
+				case 3: // SRA
+					*readMask = 1U << rt;
+					*writeMask = 1U << rd;
+					break;
+				case 4: // SLLV
+				case 6: // SRLV
+				case 7: // SRAV
+				case 33: // ADDU
+				case 35: // SUBU
+				case 36: // AND
+				case 37: // OR
+				case 38: // XOR
+				case 39: // NOR
+				case 42: // SLT
+				case 43: // SLTU
+					*readMask = (1U << rs) | (1U << rt);
+					*writeMask = 1U << rd;
+					break;
+				default:
+					return false;
+			}
+			break;
+		case 1: // BLTZ and BGEZ
+			if (rt > 1)
+				return false;
+			*readMask = 1U << rs;
+			break;
+		case 4: // BEQ
+		case 5: // BNE
+			*readMask = (1U << rs) | (1U << rt);
+			break;
+		case 6: // BLEZ
+		case 7: // BGTZ
+			*readMask = 1U << rs;
+			break;
+		case 9: // ADDIU
+		case 10: // SLTI
+		case 11: // SLTIU
+		case 12: // ANDI
+		case 13: // ORI
+		case 14: // XORI
+			*readMask = 1U << rs;
+			*writeMask = 1U << rt;
+			break;
+		case 15: // LUI
+			*writeMask = 1U << rt;
+			break;
+		case 32: // LB
+		case 33: // LH
+		case 35: // LW
+		case 36: // LBU
+		case 37: // LHU
+			*readMask = 1U << rs;
+			*writeMask = 1U << rt;
+			*isLoad = true;
+			break;
+		default:
+			return false;
+	}
+
+	// Register 0 is constant
+	*readMask &= 0xFFFFFFFE;
+	*writeMask &= 0xFFFFFFFE;
+	return true;
+}
+
 /*
  * This function returns the lo register.
  */
@@ -2648,11 +3190,25 @@ static int32_t R3051_getLoReg(R3051 *cpu)
 }
 
 /*
- * This retrieves the program counter value.
+ * This function returns the page table entry backing the specified virtual
+ * address, or NULL if it is not backed by host memory (as is the case for
+ * I/O ports and kseg2).
  */
-static int32_t R3051_getProgramCounter(R3051 *cpu)
+static MemoryPage *R3051_getMemoryPage(R3051 *cpu, int32_t address)
 {
-	return cpu->programCounter;
+	// Only kuseg, kseg0 and kseg1 can map onto the 512MB of physical
+	// memory covered by the page table
+	int64_t tempAddress = address & 0xFFFFFFFFL;
+	int32_t segment = (int32_t)(tempAddress >> 29);
+	if (segment != 0 && segment != 4 && segment != 5)
+		return NULL;
+
+	// Check page is backed at this offset
+	MemoryPage *page = &cpu->pageTable[(tempAddress & 0x1FFFFFFFL) >> 12];
+	if (!page->memory || (tempAddress & 0xFFF) >= page->size)
+		return NULL;
+
+	return page;
 }
 
 /*
@@ -2922,67 +3478,128 @@ static bool R3051_handleException(R3051 *cpu)
  */
 static bool R3051_handleInterrupts(R3051 *cpu)
 {
-	// Resync system timers
-	SystemInterlink_resyncAllTimers(cpu->system);
-
-	// Resync GPU
-	SystemInterlink_executeGPUCycles(cpu->system);
-
-	// Increment all interrupt counters
-	SystemInterlink_incrementInterruptCounters(cpu->system);
-
-	// Get interrupt status and mask registers
-	int32_t interruptStatus = R3051_swapWordEndianness(
-			cpu,
-			SystemInterlink_readWord(cpu->system, 0x1F801070)
-			) & 0x7FF;
-	int32_t interruptMask = R3051_swapWordEndianness(
-			cpu,
-			SystemInterlink_readWord(cpu->system, 0x1F801074)
-			) & 0x7FF;
-
-	// Mask the interrupt status register
-	interruptStatus &= interruptMask;
+	// Run any system events that are due, such as vblank or timers
+	Scheduler_runDueEvents(cpu->scheduler);
+
+	// Trigger interrupt if one is pending - Cop0 keeps track of this
+	// whenever the interrupt line or its status and cause registers change
+	if (Cop0_isInterruptPending(&cpu->sccp)) {
+		cpu->exception.exceptionReason = PHILPSX_EXCEPTION_INT;
+		cpu->exception.programCounterOrigin = cpu->programCounter;
+		cpu->exception.isInBranchDelaySlot = cpu->prevWasBranch;
+		R3051_handleException(cpu);
 
-	// Set bit 10 of COP0 cause register if needed
-	if (interruptStatus != 0) {
-		int32_t causeRegister = Cop0_readReg(&cpu->sccp, 13);
-		causeRegister |= 0x400;
-		Cop0_writeReg(&cpu->sccp, 13, causeRegister, true);
-	} else {
-		int32_t causeRegister = Cop0_readReg(&cpu->sccp, 13);
-		causeRegister &= 0xFFFFFBFF;
-		Cop0_writeReg(&cpu->sccp, 13, causeRegister, true);
+		// Signal that interrupt occurred and was handled
+		// by exception routine
+		return true;
 	}
 
-	// Get status reg and cause reg from COP0
-	int32_t statusRegister = Cop0_readReg(&cpu->sccp, 12);
-	int32_t causeRegister = Cop0_readReg(&cpu->sccp, 13);
-
-	// Check if interrupts are enabled, if not then do nothing
-	if ((statusRegister & 0x1) == 0x1) {
+	// Signal that no interrupt occurred
+	return false;
+}
 
-		// Use IM mask from status register to mask interrupt bits
-		// in cause register
-		statusRegister &= 0x0000FF00;
-		causeRegister &= 0x0000FF00;
-		causeRegister &= statusRegister;
+/*
+ * This function interprets the instructions of a pre-decoded block from index
+ * i onwards, for R3051_executeBlock. It is inlined into separate copies with
+ * and without tracing, so that tracing costs nothing when it is disabled.
+ */
+static inline __attribute__((always_inline)) void R3051_interpretBlock(
+		R3051 *cpu, R3051Block *block, int32_t i, int64_t blockAddress,
+		bool cacheableSegment, bool traced)
+{
+	for (; i < block->length; ++i) {
+		// Setup cycle count and instruction
+		cpu->cycles = 0;
+		R3051Op *op = &block->ops[i];
+		int32_t physicalAddress = block->physicalAddress + i * 4;
+
+		// Account for instruction fetch, stalling for one cycle if the BIU is
+		// being used by another component
+		if (cacheableSegment &&
+				SystemInterlink_instructionCacheEnabled(cpu->system)) {
+
+			// Refill cache on a miss
+			if (!InstructionCache_checkForHit(&cpu->instructionCache,
+					physicalAddress)) {
+				if (R3051_getBusHolder(cpu) != PHILPSX_COMPONENTS_CPU) {
+					cpu->cycles += 1;
+					cpu->totalCycles += 1;
+					SystemInterlink_appendSyncCycles(cpu->system, cpu->cycles);
+					return;
+				}
+				int32_t stallCycles = SystemInterlink_howManyStallCycles(
+						cpu->system,
+						physicalAddress
+						);
+				cpu->cycles += stallCycles;
+				cpu->totalCycles += stallCycles;
+				InstructionCache_refillLine(
+						&cpu->instructionCache,
+						&cpu->sccp,
+						cpu->system,
+						physicalAddress
+						);
+			}
+		} else {
+			if (R3051_getBusHolder(cpu) != PHILPSX_COMPONENTS_CPU) {
+				cpu->cycles += 1;
+				cpu->totalCycles += 1;
+				SystemInterlink_appendSyncCycles(cpu->system, cpu->cycles);
+				return;
+			}
+			cpu->cycles += op->fetchCycles;
+			cpu->totalCycles += op->fetchCycles;
+		}
 
-		// If resulting value is non-zero, trigger interrupt
-		if (causeRegister != 0) {
-			cpu->exception.exceptionReason = PHILPSX_EXCEPTION_INT;
-			cpu->exception.programCounterOrigin = cpu->programCounter;
-			cpu->exception.isInBranchDelaySlot = cpu->prevWasBranch;
-			R3051_handleException(cpu);
+		// Execute, recording the instruction if tracing
+		TraceRecord record;
+		if (traced)
+			R3051_startTraceRecord(cpu, op->instruction, &record);
+		op->handler(cpu, op->instruction);
+		bool completed = R3051_completeInstruction(cpu);
+		if (traced)
+			R3051_finishTraceRecord(cpu, &record, completed);
+		if (!completed)
+			return;
 
-			// Signal that interrupt occurred and was handled
-			// by exception routine
-			return true;
-		}
+		// Skip ahead if this is an idle loop, then leave block if needed
+		if (cpu->prevWasBranch && block->idleLoop)
+			R3051_skipIdleLoop(cpu, block, blockAddress);
+		if (cpu->prevWasBranch || !block->valid ||
+				(cpu->programCounter & 0xFFFFFFFFL) !=
+				blockAddress + (i + 1) * 4)
+			return;
 	}
+}
 
-	// Signal that no interrupt occurred
-	return false;
+/*
+ * This function returns the cached block for the current program counter,
+ * decoding it first if needed. It returns NULL if the address is not
+ * allowed or misaligned (leaving the interpreter to raise the exception), or
+ * if the code is not in RAM or BIOS.
+ */
+static R3051Block *R3051_lookupBlock(R3051 *cpu)
+{
+	// Check address
+	int32_t address = cpu->programCounter;
+	const Cop0Segment *segment = Cop0_getSegment(&cpu->sccp, address);
+	if (!segment->allowed || (address & 0x3) != 0)
+		return NULL;
+
+	// Get physical address and check it is cacheable
+	int32_t physicalAddress = address & segment->physicalMask;
+	int64_t tempAddress = physicalAddress & 0xFFFFFFFFL;
+	if (!(tempAddress < PHILPSX_RAM_MIRROR_SPAN ||
+			(tempAddress >= 0x1FC00000L && tempAddress < 0x1FC80000L)))
+		return NULL;
+
+	// Find block, decoding it if it isn't present
+	R3051Block *block = &cpu->blockCache[
+			(tempAddress >> 2) & (PHILPSX_R3051_BLOCKCACHE_SIZE - 1)];
+	if (!block->valid || block->physicalAddress != physicalAddress)
+		R3051_buildBlock(cpu, block, physicalAddress);
+
+	return block;
 }
 
 /*
@@ -2997,6 +3614,32 @@ static int32_t R3051_readDataValue(R3051 *cpu, int32_t width, int32_t address)
 	// Get cache control register and other related values
 	bool dataCacheIsolated = Cop0_isDataCacheIsolated(&cpu->sccp);
 
+	// Read RAM, BIOS and scratchpad straight from host memory where possible
+	MemoryPage *page = dataCacheIsolated ?
+			NULL : R3051_getMemoryPage(cpu, address);
+	if (page) {
+		uint8_t *memory = (uint8_t *)page->memory;
+		int32_t offset = address & 0xFFF;
+		switch (width) {
+			case PHILPSX_R3051_BYTE:
+				value = memory[offset];
+				break;
+			case PHILPSX_R3051_HALFWORD:
+			{
+				uint16_t halfWord;
+				memcpy(&halfWord, memory + (offset & 0xFFE), 2);
+				value = halfWord;
+			}
+				break;
+			case PHILPSX_R3051_WORD:
+				memcpy(&value, memory + (offset & 0xFFC), 4);
+				break;
+		}
+		cpu->cycles += page->stallCycles;
+		cpu->totalCycles += page->stallCycles;
+		return value;
+	}
+
 	// Get physical address
 	int32_t physicalAddress = Cop0_virtualToPhysical(&cpu->sccp, address);
 	int64_t tempPhysicalAddress = physicalAddress & 0xFFFFFFFFL;
@@ -3019,10 +3662,10 @@ static int32_t R3051_readDataValue(R3051 *cpu, int32_t width, int32_t address)
 						(int32_t)tempPhysicalAddress
 						);
 				++tempPhysicalAddress;
-				value = (value << 8) | (0xFF & InstructionCache_readByte(
+				value |= (0xFF & InstructionCache_readByte(
 						&cpu->instructionCache,
 						(int32_t)tempPhysicalAddress
-						));
+						)) << 8;
 				break;
 			case PHILPSX_R3051_WORD:
 				value = InstructionCache_readWord(&cpu->instructionCache,
@@ -3046,15 +3689,10 @@ static int32_t R3051_readDataValue(R3051 *cpu, int32_t width, int32_t address)
 							);
 					break;
 				case PHILPSX_R3051_HALFWORD:
-					value = 0xFF & SystemInterlink_readByte(
+					value = 0xFFFF & SystemInterlink_readHalfword(
 							cpu->system,
-							(int32_t)tempPhysicalAddress
+							physicalAddress
 							);
-					++tempPhysicalAddress;
-					value = (value << 8) | (0xFF & SystemInterlink_readByte(
-							cpu->system,
-							(int32_t)tempPhysicalAddress
-							));
 					break;
 				case PHILPSX_R3051_WORD:
 					value = SystemInterlink_readWord(
@@ -3084,19 +3722,10 @@ static int32_t R3051_readDataValue(R3051 *cpu, int32_t width, int32_t address)
 						);
 				break;
 			case PHILPSX_R3051_HALFWORD:
-				value = 0xFF & SystemInterlink_readByte(
+				value = 0xFFFF & SystemInterlink_readHalfword(
 						cpu->system,
-						(int32_t)tempPhysicalAddress
+						physicalAddress
 						);
-				tempPhysicalAddress =
-						SystemInterlink_okToIncrement(
-						cpu->system,
-						tempPhysicalAddress) ?
-							tempPhysicalAddress + 1 : tempPhysicalAddress;
-				value = (value << 8) | (0xFF & SystemInterlink_readByte(
-						cpu->system,
-						(int32_t)tempPhysicalAddress
-						));
 				break;
 			case PHILPSX_R3051_WORD:
 				value = SystemInterlink_readWord(cpu->system, physicalAddress);
@@ -3113,15 +3742,18 @@ static int32_t R3051_readDataValue(R3051 *cpu, int32_t width, int32_t address)
 }
 
 /*
- * This function reads an instruction word. It allows abstraction of this
- * functionality from the IF pipeline stage.
+ * This function reads an instruction word into instruction, adding the
+ * cycles taken by the fetch. It allows abstraction of this functionality
+ * from the IF pipeline stage, and returns false if the fetch could not
+ * complete, either due to an exception or due to the BIU being in use by
+ * another component.
  */
-static int64_t R3051_readInstructionWord(R3051 *cpu, int32_t address,
-		int32_t tempBranchAddress)
+static bool R3051_readInstructionWord(R3051 *cpu, int32_t address,
+		int32_t tempBranchAddress, int32_t *instruction)
 {
 	// Check for dodgy address
-	if (!Cop0_isAddressAllowed(&cpu->sccp, address) ||
-			cpu->programCounter % 4 != 0) {
+	const Cop0Segment *segment = Cop0_getSegment(&cpu->sccp, address);
+	if (!segment->allowed || cpu->programCounter % 4 != 0) {
 
 		// Trigger exception
 		cpu->exception.badAddress = address;
@@ -3131,86 +3763,43 @@ static int64_t R3051_readInstructionWord(R3051 *cpu, int32_t address,
 				= cpu->exception.isInBranchDelaySlot ?
 					tempBranchAddress : address;
 		R3051_handleException(cpu);
-		return -1L;
+		return false;
 	}
 
-	// Define word variable
-	int32_t wordVal = 0;
-
-	// Check if instruction cache enabled
-	bool instructionCacheEnabled =
-			SystemInterlink_instructionCacheEnabled(cpu->system);
-
 	// Get physical address
-	int32_t physicalAddress = Cop0_virtualToPhysical(&cpu->sccp, address);
-
-	// Check if address is cacheable or not
-	if (Cop0_isCacheable(&cpu->sccp, address) && instructionCacheEnabled) {
+	int32_t physicalAddress = address & segment->physicalMask;
 
-		// Check cache for hit
-		if (InstructionCache_checkForHit(&cpu->instructionCache,
-				physicalAddress)) {
-			wordVal = InstructionCache_readWord(&cpu->instructionCache,
-					physicalAddress);
-		} else {
-
-			// Refill cache then set wordVal
-			if (R3051_getBusHolder(cpu) != PHILPSX_COMPONENTS_CPU) {
-
-				// Stall for one cycle as BIU is being used by
-				// another component
-				return -1L;
-			} else {
-				// Begin transaction
-
-				cpu->cycles += SystemInterlink_howManyStallCycles(
-						cpu->system,
-						physicalAddress
-						);
-				cpu->totalCycles += SystemInterlink_howManyStallCycles(
-						cpu->system,
-						physicalAddress
-						);
-				InstructionCache_refillLine(
-						&cpu->instructionCache,
-						&cpu->sccp,
-						cpu->system,
-						physicalAddress
-						);
-				wordVal = InstructionCache_readWord(
-						&cpu->instructionCache,
-						physicalAddress
-						);
-
-				// End transaction
-			}
+	// Check cache for hit if address is cacheable and cache is enabled
+	bool cached = segment->cacheable &&
+			SystemInterlink_instructionCacheEnabled(cpu->system);
+	if (cached) {
+		int64_t cachedWord = InstructionCache_fetchWord(
+				&cpu->instructionCache, physicalAddress);
+		if (cachedWord != -1L) {
+			*instruction = (int32_t)cachedWord;
+			return true;
 		}
-	} else {
-
-		// Read word straight from system, stalling if being used
-		if (R3051_getBusHolder(cpu) != PHILPSX_COMPONENTS_CPU) {
-
-			// Stall for one cycle as BIU is being used by another component
-			return -1L;
-		} else {
-			// Begin transaction
+	}
 
-			cpu->cycles += SystemInterlink_howManyStallCycles(
-					cpu->system,
-					physicalAddress
-					);
-			cpu->totalCycles += SystemInterlink_howManyStallCycles(
-					cpu->system,
-					physicalAddress
-					);
-			wordVal = SystemInterlink_readWord(cpu->system, physicalAddress);
+	// Stall for one cycle if BIU is being used by another component
+	if (R3051_getBusHolder(cpu) != PHILPSX_COMPONENTS_CPU)
+		return false;
 
-			// End transaction
-		}
-	}
+	// Read word straight from system, refilling cache line if needed
+	int32_t fetchCycles = 0;
+	*instruction = SystemInterlink_fetchWord(cpu->system, physicalAddress,
+			&fetchCycles);
+	cpu->cycles += fetchCycles;
+	cpu->totalCycles += fetchCycles;
+	if (cached)
+		InstructionCache_refillLine(
+				&cpu->instructionCache,
+				&cpu->sccp,
+				cpu->system,
+				physicalAddress
+				);
 
-	// Return word variable
-	return 0xFFFFFFFFL & wordVal;
+	return true;
 }
 
 /*
@@ -3222,16 +3811,151 @@ static void R3051_reset(R3051 *cpu)
 }
 
 /*
- * This is a utility function to swap the endianness of a word. It can be
- * used to allow the processor to operate in both endian modes by transparently
- * swapping the byte order before writing or after writing.
+ * This function is called once an idle loop block has run its branch. If the
+ * branch was taken and every load in the loop polls RAM, BIOS, scratchpad or
+ * the interrupt registers, the cycle count is moved straight on to the next
+ * system event. Those are only changed by the CPU or by scheduled events, so
+ * the loop cannot see a new value any sooner. Loops polling the GPU status
+ * register are left alone, as some of its bits change without an event, such
+ * as the one giving the line being drawn in interlaced modes.
+ */
+static void R3051_skipIdleLoop(R3051 *cpu, R3051Block *block,
+		int64_t blockAddress)
+{
+	// Check branch back to start of loop was taken
+	if (!cpu->jumpPending || (cpu->jumpAddress & 0xFFFFFFFFL) != blockAddress)
+		return;
+
+	// Check polled addresses
+	for (int32_t i = 0; i < block->length; ++i) {
+		int32_t instruction = block->ops[i].instruction;
+		if (logical_rshift(instruction, 26) < 32)
+			continue;
+
+		// Get address
+		int32_t base = logical_rshift(instruction, 21) & 0x1F;
+		int32_t offset = instruction & 0xFFFF;
+		if ((offset & 0x8000) == 0x8000) {
+			offset |= 0xFFFF0000;
+		}
+		int32_t address = cpu->generalRegisters[base] + offset;
+
+		// Memory is fine, as are the interrupt status and mask registers
+		if (R3051_getMemoryPage(cpu, address))
+			continue;
+		int64_t tempAddress = address & 0xFFFFFFFFL;
+		int32_t segment = (int32_t)(tempAddress >> 29);
+		tempAddress &= 0x1FFFFFFCL;
+		if ((segment != 0 && segment != 4 && segment != 5) ||
+				(tempAddress != 0x1F801070L && tempAddress != 0x1F801074L))
+			return;
+	}
+
+	// Move on to next event
+	int64_t cyclesLeft = Scheduler_getNextDeadline(cpu->scheduler) -
+			Scheduler_getCycles(cpu->scheduler);
+	if (cyclesLeft <= 0 || cyclesLeft > INT32_MAX)
+		return;
+	cpu->totalCycles += cyclesLeft;
+	SystemInterlink_appendSyncCycles(cpu->system, (int32_t)cyclesLeft);
+}
+
+/*
+ * This function starts a trace record for an instruction about to run at the
+ * program counter, working out the register it writes and the memory it
+ * accesses from the opcode while the source registers are still intact.
  */
-static int32_t R3051_swapWordEndianness(R3051 *cpu, int32_t word)
+static void R3051_startTraceRecord(R3051 *cpu, int32_t instruction,
+		TraceRecord *record)
 {
-	return (word << 24) |
-			((word << 8) & 0xFF0000) |
-			(logical_rshift(word, 8) & 0xFF00) |
-			(logical_rshift(word, 24) & 0xFF);
+	int32_t opcode = logical_rshift(instruction, 26) & 0x3F;
+	int32_t rs = logical_rshift(instruction, 21) & 0x1F;
+	int32_t rt = logical_rshift(instruction, 16) & 0x1F;
+	int32_t rd = logical_rshift(instruction, 11) & 0x1F;
+	int32_t function = instruction & 0x3F;
+
+	// Setup record
+	memset(record, 0, sizeof(TraceRecord));
+	record->programCounter = cpu->programCounter;
+	record->instruction = instruction;
+
+	// Determine written register
+	switch (opcode) {
+		case 0x00: // SPECIAL
+			if (function != 0x08 && function != 0x0C && function != 0x0D &&
+					function != 0x11 && function != 0x13 &&
+					(function < 0x18 || function > 0x1B))
+				record->registerIndex = rd;
+			break;
+		case 0x01: // BCOND
+			if ((rt & 0x1E) == 0x10)
+				record->registerIndex = 31;
+			break;
+		case 0x03: // JAL
+			record->registerIndex = 31;
+			break;
+		case 0x10: // COP0
+		case 0x12: // COP2
+			if (rs == 0x00 || rs == 0x02)
+				record->registerIndex = rt;
+			break;
+		default:
+			if ((opcode >= 0x08 && opcode <= 0x0F) ||
+					(opcode >= 0x20 && opcode <= 0x26))
+				record->registerIndex = rt;
+			break;
+	}
+
+	// Determine memory access, taking stored value now
+	if (opcode < 0x20)
+		return;
+	switch (opcode) {
+		case 0x20: // LB
+		case 0x24: // LBU
+			record->memoryAccess = PHILPSX_TRACER_ACCESS_LOAD;
+			record->memoryWidth = 1;
+			break;
+		case 0x21: // LH
+		case 0x25: // LHU
+			record->memoryAccess = PHILPSX_TRACER_ACCESS_LOAD;
+			record->memoryWidth = 2;
+			break;
+		case 0x22: // LWL
+		case 0x23: // LW
+		case 0x26: // LWR
+		case 0x32: // LWC2
+			record->memoryAccess = PHILPSX_TRACER_ACCESS_LOAD;
+			record->memoryWidth = 4;
+			break;
+		case 0x28: // SB
+			record->memoryAccess = PHILPSX_TRACER_ACCESS_STORE;
+			record->memoryWidth = 1;
+			record->memoryValue = cpu->generalRegisters[rt] & 0xFF;
+			break;
+		case 0x29: // SH
+			record->memoryAccess = PHILPSX_TRACER_ACCESS_STORE;
+			record->memoryWidth = 2;
+			record->memoryValue = cpu->generalRegisters[rt] & 0xFFFF;
+			break;
+		case 0x2A: // SWL
+		case 0x2B: // SW
+		case 0x2E: // SWR
+			record->memoryAccess = PHILPSX_TRACER_ACCESS_STORE;
+			record->memoryWidth = 4;
+			record->memoryValue = cpu->generalRegisters[rt];
+			break;
+		case 0x3A: // SWC2
+			record->memoryAccess = PHILPSX_TRACER_ACCESS_STORE;
+			record->memoryWidth = 4;
+			record->memoryValue = Cop2_readDataReg(&cpu->gte, rt);
+			break;
+		default:
+			return;
+	}
+	int32_t offset = instruction & 0xFFFF;
+	if ((offset & 0x8000) == 0x8000)
+		offset |= 0xFFFF0000;
+	record->memoryAddress = cpu->generalRegisters[rs] + offset;
 }
 
 /*
@@ -3244,6 +3968,42 @@ static void R3051_writeDataValue(R3051 *cpu, int32_t width, int32_t address,
 	// Get cache control register and other related values
 	bool dataCacheIsolated = Cop0_isDataCacheIsolated(&cpu->sccp);
 
+	// Write RAM and scratchpad straight to host memory where possible
+	MemoryPage *page = dataCacheIsolated ?
+			NULL : R3051_getMemoryPage(cpu, address);
+	if (page && !page->readOnly) {
+		int8_t *memory = page->memory;
+		int32_t offset = address & 0xFFF;
+		int32_t length = 1;
+		switch (width) {
+			case PHILPSX_R3051_BYTE:
+				memory[offset] = (int8_t)value;
+				break;
+			case PHILPSX_R3051_HALFWORD:
+			{
+				uint16_t halfWord = (uint16_t)value;
+				memcpy(memory + (offset & 0xFFE), &halfWord, 2);
+				length = 2;
+			}
+				break;
+			case PHILPSX_R3051_WORD:
+				memcpy(memory + (offset & 0xFFC), &value, 4);
+				length = 4;
+				break;
+		}
+		cpu->cycles += page->stallCycles;
+		cpu->totalCycles += page->stallCycles;
+
+		// Throw away any cached code we just wrote over
+		if (page->containsCode)
+			SystemInterlink_invalidateCodeRange(
+					cpu->system,
+					Cop0_virtualToPhysical(&cpu->sccp, address),
+					length
+					);
+		return;
+	}
+
 	// Get physical address
 	int32_t physicalAddress = Cop0_virtualToPhysical(&cpu->sccp, address);
 	int64_t tempPhysicalAddress = physicalAddress & 0xFFFFFFFFL;
@@ -3266,14 +4026,14 @@ static void R3051_writeDataValue(R3051 *cpu, int32_t width, int32_t address,
 						&cpu->instructionCache,
 						&cpu->sccp,
 						(int32_t)tempPhysicalAddress,
-						(int8_t)logical_rshift(value, 8)
+						(int8_t)value
 						);
 				++tempPhysicalAddress;
 				InstructionCache_writeByte(
 						&cpu->instructionCache,
 						&cpu->sccp,
 						(int32_t)tempPhysicalAddress,
-						(int8_t)value
+						(int8_t)logical_rshift(value, 8)
 						);
 				break;
 			case PHILPSX_R3051_WORD:
@@ -3302,16 +4062,11 @@ static void R3051_writeDataValue(R3051 *cpu, int32_t width, int32_t address,
 							(int8_t)value);
 					break;
 				case PHILPSX_R3051_HALFWORD:
-					SystemInterlink_writeByte(
+					SystemInterlink_writeHalfword(
 							cpu->system,
-							(int32_t)tempPhysicalAddress,
-							(int8_t)logical_rshift(value, 8)
+							physicalAddress,
+							(int16_t)value
 							);
-					++tempPhysicalAddress;
-					SystemInterlink_writeByte(
-							cpu->system,
-							(int32_t)tempPhysicalAddress,
-							(int8_t)value);
 					break;
 				case PHILPSX_R3051_WORD:
 					SystemInterlink_writeWord(
@@ -3343,21 +4098,10 @@ static void R3051_writeDataValue(R3051 *cpu, int32_t width, int32_t address,
 						);
 				break;
 			case PHILPSX_R3051_HALFWORD:
-				SystemInterlink_writeByte(
+				SystemInterlink_writeHalfword(
 						cpu->system,
-						(int32_t)tempPhysicalAddress,
-						(int8_t)logical_rshift(value, 8)
-						);
-				tempPhysicalAddress =
-						SystemInterlink_okToIncrement(
-							cpu->system,
-							tempPhysicalAddress
-							) ?
-							tempPhysicalAddress + 1 : tempPhysicalAddress;
-				SystemInterlink_writeByte(
-						cpu->system,
-						(int32_t)tempPhysicalAddress,
-						(int8_t)value
+						physicalAddress,
+						(int16_t)value
 						);
 				break;
 			case PHILPSX_R3051_WORD:
@@ -0,0 +1,894 @@
+/*
+ * This C file models an x86-64 dynamic recompiler for the MIPS R3051
+ * processor of the PlayStation as a class. It translates pre-decoded blocks
+ * into host code, which works on the R3051 struct directly. Simple ALU
+ * instructions are emitted inline, whereas everything else (loads, stores,
+ * branches, COP0, COP2 and rare instructions) calls the interpreter's
+ * handler for it. Whenever an instruction needs work the generated code
+ * cannot do itself (an exception, a branch, an interrupt check or an
+ * instruction cache miss), the code hands back to the interpreter, telling it
+ * which instruction to carry on from.
+ *
+ * R3051Recompiler.c - Copyright Phillip Potter, 2020, under GPLv3
+ */
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include "../headers/R3051_all.h"
+#include "../headers/R3051Recompiler.h"
+#include "../headers/Components.h"
+#include "../headers/SystemInterlink.h"
+#include "../headers/math_utils.h"
+
+// Code buffer dimensions - a block never needs more than the maximum size
+#define PHILPSX_R3051RECOMPILER_BUFFER_SIZE 16777216
+#define PHILPSX_R3051RECOMPILER_MAX_BLOCK_SIZE 32768
+
+// Host registers
+#define PHILPSX_X64_RAX 0
+#define PHILPSX_X64_RCX 1
+#define PHILPSX_X64_RDX 2
+#define PHILPSX_X64_RBX 3
+#define PHILPSX_X64_RSP 4
+#define PHILPSX_X64_RBP 5
+#define PHILPSX_X64_RSI 6
+#define PHILPSX_X64_RDI 7
+#define PHILPSX_X64_R12 12
+#define PHILPSX_X64_R14 14
+#define PHILPSX_X64_R15 15
+
+// Host condition codes
+#define PHILPSX_X64_CC_B 0x2
+#define PHILPSX_X64_CC_E 0x4
+#define PHILPSX_X64_CC_NE 0x5
+#define PHILPSX_X64_CC_L 0xC
+
+// Offsets of R3051 fields used by generated code
+#define PHILPSX_R3051_OFFSET_REG(reg) \
+	(int32_t)(offsetof(R3051, generalRegisters) + (reg) * 4)
+#define PHILPSX_R3051_OFFSET(field) (int32_t)offsetof(R3051, field)
+
+/*
+ * Generated code keeps the following in host registers:
+ * rbx - the R3051 struct
+ * r12d - cycles not yet passed on to the rest of the system
+ * r14d - the virtual address of the start of the block
+ * r15 - the block itself
+ */
+
+// Forward declarations for functions and subcomponents private to this class
+// R3051Recompiler-related stuff:
+static void R3051Recompiler_emitByte(R3051Recompiler *rec, int32_t value);
+static void R3051Recompiler_emitCall(R3051Recompiler *rec, void *function);
+static void R3051Recompiler_emitCycleFlush(R3051Recompiler *rec);
+static void R3051Recompiler_emitEpilogue(R3051Recompiler *rec);
+static void R3051Recompiler_emitExit(R3051Recompiler *rec, int32_t condition,
+		size_t epilogue, int32_t pcIndex, int32_t exitCode);
+static void R3051Recompiler_emitFetchCheck(R3051Recompiler *rec,
+		R3051Block *block, int32_t index, bool instructionCacheEnabled,
+		size_t epilogue);
+static void R3051Recompiler_emitHandlerCall(R3051Recompiler *rec,
+		R3051Op *op, int32_t index, int32_t fetchCycles);
+static bool R3051Recompiler_emitInlineOp(R3051Recompiler *rec,
+		int32_t instruction);
+static void R3051Recompiler_emitInstructionCount(R3051Recompiler *rec);
+static void R3051Recompiler_emitJumpCheck(R3051Recompiler *rec,
+		int32_t length, size_t epilogue);
+static size_t R3051Recompiler_emitJumpShort(R3051Recompiler *rec,
+		int32_t condition);
+static void R3051Recompiler_emitMemInstruction(R3051Recompiler *rec,
+		bool wide, int32_t opcode, int32_t reg, int32_t base, int32_t disp);
+static void R3051Recompiler_emitMovImm32(R3051Recompiler *rec, int32_t reg,
+		int32_t value);
+static void R3051Recompiler_emitMovImm64(R3051Recompiler *rec, int32_t reg,
+		uint64_t value);
+static void R3051Recompiler_emitPrologue(R3051Recompiler *rec,
+		R3051Block *block);
+static void R3051Recompiler_emitRegInstruction(R3051Recompiler *rec,
+		bool wide, int32_t opcode, int32_t reg, int32_t rm);
+static void R3051Recompiler_emitWord(R3051Recompiler *rec, int32_t value);
+static void R3051Recompiler_flushCodeBuffer(R3051Recompiler *rec,
+		R3051 *cpu);
+static bool R3051Recompiler_isStore(int32_t instruction);
+static void R3051Recompiler_patchJumpShort(R3051Recompiler *rec,
+		size_t position);
+
+/*
+ * This struct holds the executable code buffer that recompiled blocks are
+ * written to.
+ */
+struct R3051Recompiler {
+
+	// Code buffer variables
+	uint8_t *codeBuffer;
+	size_t codeBufferSize;
+	size_t codeBufferUsed;
+
+	// Number of instructions completed by the code emitted so far for the
+	// current block, which have not yet been added to the CPU's count
+	int32_t pendingInstructions;
+};
+
+/*
+ * This constructs a new R3051Recompiler object, returning NULL if the host
+ * is not supported or the code buffer could not be mapped.
+ */
+R3051Recompiler *construct_R3051Recompiler(void)
+{
+	// Allocate R3051Recompiler struct
+	R3051Recompiler *rec = NULL;
+#if !defined(__x86_64__)
+	fprintf(stderr, "PhilPSX: R3051Recompiler: The recompiler is only "
+			"supported on x86-64 hosts\n");
+	goto end;
+#endif
+	rec = malloc(sizeof(R3051Recompiler));
+	if (!rec) {
+		fprintf(stderr, "PhilPSX: R3051Recompiler: Couldn't allocate memory "
+				"for R3051Recompiler struct\n");
+		goto end;
+	}
+
+	// Map executable code buffer
+	rec->codeBufferSize = PHILPSX_R3051RECOMPILER_BUFFER_SIZE;
+	rec->codeBufferUsed = 0;
+	rec->pendingInstructions = 0;
+	rec->codeBuffer = mmap(NULL, rec->codeBufferSize,
+			PROT_READ | PROT_WRITE | PROT_EXEC,
+			MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (rec->codeBuffer == MAP_FAILED) {
+		fprintf(stderr, "PhilPSX: R3051Recompiler: Couldn't map executable "
+				"code buffer\n");
+		goto cleanup_recompiler;
+	}
+
+	// Normal return:
+	return rec;
+
+	// Cleanup path:
+	cleanup_recompiler:
+	free(rec);
+	rec = NULL;
+
+	end:
+	return rec;
+}
+
+/*
+ * This destructs an R3051Recompiler object.
+ */
+void destruct_R3051Recompiler(R3051Recompiler *rec)
+{
+	munmap(rec->codeBuffer, rec->codeBufferSize);
+	free(rec);
+}
+
+/*
+ * This function generates host code for the block supplied, storing it in
+ * the block. The instructionCacheEnabled parameter states whether fetches
+ * for this block go through the instruction cache. It returns false if the
+ * block could not be compiled.
+ */
+bool R3051Recompiler_compileBlock(R3051Recompiler *rec, R3051 *cpu,
+		R3051Block *block, bool instructionCacheEnabled)
+{
+	// Make room, throwing away all existing code if the buffer is full
+	block->compiledCode = NULL;
+	if (rec->codeBufferUsed + PHILPSX_R3051RECOMPILER_MAX_BLOCK_SIZE >
+			rec->codeBufferSize)
+		R3051Recompiler_flushCodeBuffer(rec, cpu);
+
+	// A store can switch the instruction cache on or off for the rest of the
+	// block if it is in a cacheable segment
+	bool cacheableSegment = Cop0_isCacheable(&cpu->sccp, cpu->programCounter);
+
+	// Emit shared exit path first, then entry point
+	size_t epilogue = rec->codeBufferUsed;
+	R3051Recompiler_emitEpilogue(rec);
+	size_t entry = rec->codeBufferUsed;
+	R3051Recompiler_emitPrologue(rec, block);
+
+	// Emit each instruction
+	bool fetchCheckNeeded = true;
+	rec->pendingInstructions = 0;
+	for (int32_t i = 0; i < block->length; ++i) {
+		R3051Op *op = &block->ops[i];
+		int32_t physicalAddress = block->physicalAddress + i * 4;
+		int32_t fetchCycles = instructionCacheEnabled ? 0 : op->fetchCycles;
+
+		// Check instruction can be fetched, at the start of the block, after
+		// any handler (which may touch the cache or bus) and at the start of
+		// each cache line
+		if (instructionCacheEnabled && (physicalAddress & 0xF) == 0)
+			fetchCheckNeeded = true;
+		if (fetchCheckNeeded)
+			R3051Recompiler_emitFetchCheck(rec, block, i,
+					instructionCacheEnabled, epilogue);
+		fetchCheckNeeded = false;
+
+		// Try inline version first
+		if (R3051Recompiler_emitInlineOp(rec, op->instruction)) {
+			R3051Recompiler_emitRegInstruction(rec, false, 0x81, 0,
+					PHILPSX_X64_R12);
+			R3051Recompiler_emitWord(rec, fetchCycles + 1);
+			++rec->pendingInstructions;
+			if (i == 0)
+				R3051Recompiler_emitJumpCheck(rec, block->length, epilogue);
+			continue;
+		}
+
+		// Otherwise call handler, leaving the interpreter to finish the
+		// instruction off if it raised an exception or was a branch
+		R3051Recompiler_emitHandlerCall(rec, op, i, fetchCycles);
+		R3051Recompiler_emitMemInstruction(rec, false, 0x81, 7,
+				PHILPSX_X64_RBX,
+				PHILPSX_R3051_OFFSET(exception.exceptionReason));
+		R3051Recompiler_emitWord(rec, PHILPSX_EXCEPTION_NULL);
+		R3051Recompiler_emitExit(rec, PHILPSX_X64_CC_NE, epilogue, -1,
+				(i << 1) | 1);
+		R3051Recompiler_emitMemInstruction(rec, false, 0x80, 7,
+				PHILPSX_X64_RBX, PHILPSX_R3051_OFFSET(isBranch));
+		R3051Recompiler_emitByte(rec, 0);
+		R3051Recompiler_emitExit(rec, PHILPSX_X64_CC_NE, epilogue, -1,
+				(i << 1) | 1);
+
+		// The fetch and any memory stalls are already in the running total,
+		// so take them back off it, as they are added again along with the
+		// rest of the instruction's cycles when r12d is flushed
+		R3051Recompiler_emitMemInstruction(rec, true, 0x63, PHILPSX_X64_RAX,
+				PHILPSX_X64_RBX, PHILPSX_R3051_OFFSET(cycles));
+		R3051Recompiler_emitMemInstruction(rec, true, 0x29, PHILPSX_X64_RAX,
+				PHILPSX_X64_RBX, PHILPSX_R3051_OFFSET(totalCycles));
+
+		// Add cycles: eax = (gteCycles == 0) ? 1 : gteCycles, plus cycles
+		R3051Recompiler_emitMemInstruction(rec, false, 0x8B, PHILPSX_X64_RAX,
+				PHILPSX_X64_RBX, PHILPSX_R3051_OFFSET(gteCycles));
+		R3051Recompiler_emitMovImm32(rec, PHILPSX_X64_RCX, 1);
+		R3051Recompiler_emitRegInstruction(rec, false, 0x85, PHILPSX_X64_RAX,
+				PHILPSX_X64_RAX);
+		R3051Recompiler_emitRegInstruction(rec, false, 0x0F44,
+				PHILPSX_X64_RAX, PHILPSX_X64_RCX);
+		R3051Recompiler_emitMemInstruction(rec, false, 0x03, PHILPSX_X64_RAX,
+				PHILPSX_X64_RBX, PHILPSX_R3051_OFFSET(cycles));
+		R3051Recompiler_emitRegInstruction(rec, false, 0x01, PHILPSX_X64_RAX,
+				PHILPSX_X64_R12);
+		R3051Recompiler_emitMemInstruction(rec, false, 0xC7, 0,
+				PHILPSX_X64_RBX, PHILPSX_R3051_OFFSET(gteCycles));
+		R3051Recompiler_emitWord(rec, 0);
+		++rec->pendingInstructions;
+		if (i == 0)
+			R3051Recompiler_emitJumpCheck(rec, block->length, epilogue);
+
+		// Leave if the handler wrote over this block
+		R3051Recompiler_emitMemInstruction(rec, false, 0x80, 7,
+				PHILPSX_X64_R15, (int32_t)offsetof(R3051Block, valid));
+		R3051Recompiler_emitByte(rec, 0);
+		R3051Recompiler_emitExit(rec, PHILPSX_X64_CC_E, epilogue, i + 1,
+				block->length << 1);
+
+		// Leave if a store switched the instruction cache on or off
+		if (cacheableSegment && R3051Recompiler_isStore(op->instruction)) {
+			R3051Recompiler_emitMemInstruction(rec, true, 0x8B,
+					PHILPSX_X64_RDI, PHILPSX_X64_RBX,
+					PHILPSX_R3051_OFFSET(system));
+			R3051Recompiler_emitCall(rec,
+					(void *)SystemInterlink_instructionCacheEnabled);
+			R3051Recompiler_emitRegInstruction(rec, false, 0x80, 7,
+					PHILPSX_X64_RAX);
+			R3051Recompiler_emitByte(rec, instructionCacheEnabled ? 1 : 0);
+			R3051Recompiler_emitExit(rec, PHILPSX_X64_CC_NE, epilogue, i + 1,
+					block->length << 1);
+		}
+		fetchCheckNeeded = true;
+	}
+
+	// Emit normal exit, past the end of the block
+	R3051Recompiler_emitInstructionCount(rec);
+	R3051Recompiler_emitMemInstruction(rec, false, 0x8D, PHILPSX_X64_RAX,
+			PHILPSX_X64_R14, block->length * 4);
+	R3051Recompiler_emitMemInstruction(rec, false, 0x89, PHILPSX_X64_RAX,
+			PHILPSX_X64_RBX, PHILPSX_R3051_OFFSET(programCounter));
+	R3051Recompiler_emitMovImm32(rec, PHILPSX_X64_RAX, block->length << 1);
+	R3051Recompiler_emitByte(rec, 0xE9);
+	R3051Recompiler_emitWord(rec,
+			(int32_t)(epilogue - (rec->codeBufferUsed + 4)));
+
+	// Store code in block
+	block->compiledCode =
+			(R3051CompiledCode)(void *)(rec->codeBuffer + entry);
+	block->compiledWithInstructionCache = instructionCacheEnabled;
+	return true;
+}
+
+/*
+ * This function emits a single byte.
+ */
+static void R3051Recompiler_emitByte(R3051Recompiler *rec, int32_t value)
+{
+	rec->codeBuffer[rec->codeBufferUsed++] = (uint8_t)value;
+}
+
+/*
+ * This function emits a call to the specified C function, clobbering rax.
+ */
+static void R3051Recompiler_emitCall(R3051Recompiler *rec, void *function)
+{
+	R3051Recompiler_emitMovImm64(rec, PHILPSX_X64_RAX, (uintptr_t)function);
+	R3051Recompiler_emitRegInstruction(rec, false, 0xFF, 2, PHILPSX_X64_RAX);
+}
+
+/*
+ * This function emits code to pass the cycles accumulated in r12d on to the
+ * rest of the system and the CPU's running total, so that other components
+ * are up to date before a handler or the interpreter takes over.
+ */
+static void R3051Recompiler_emitCycleFlush(R3051Recompiler *rec)
+{
+	// Skip if there is nothing to flush
+	R3051Recompiler_emitRegInstruction(rec, false, 0x85, PHILPSX_X64_R12,
+			PHILPSX_X64_R12);
+	size_t skip = R3051Recompiler_emitJumpShort(rec, PHILPSX_X64_CC_E);
+
+	// totalCycles += r12d
+	R3051Recompiler_emitRegInstruction(rec, true, 0x63, PHILPSX_X64_RAX,
+			PHILPSX_X64_R12);
+	R3051Recompiler_emitMemInstruction(rec, true, 0x01, PHILPSX_X64_RAX,
+			PHILPSX_X64_RBX, PHILPSX_R3051_OFFSET(totalCycles));
+
+	// SystemInterlink_appendSyncCycles(cpu->system, r12d)
+	R3051Recompiler_emitMemInstruction(rec, true, 0x8B, PHILPSX_X64_RDI,
+			PHILPSX_X64_RBX, PHILPSX_R3051_OFFSET(system));
+	R3051Recompiler_emitRegInstruction(rec, false, 0x89, PHILPSX_X64_R12,
+			PHILPSX_X64_RSI);
+	R3051Recompiler_emitCall(rec, (void *)SystemInterlink_appendSyncCycles);
+	R3051Recompiler_emitRegInstruction(rec, false, 0x31, PHILPSX_X64_R12,
+			PHILPSX_X64_R12);
+
+	R3051Recompiler_patchJumpShort(rec, skip);
+}
+
+/*
+ * This function emits the exit path shared by all exits from a block. It
+ * expects the exit code in eax.
+ */
+static void R3051Recompiler_emitEpilogue(R3051Recompiler *rec)
+{
+	// Keep exit code safe in r14d while flushing cycles
+	R3051Recompiler_emitRegInstruction(rec, false, 0x89, PHILPSX_X64_RAX,
+			PHILPSX_X64_R14);
+	R3051Recompiler_emitCycleFlush(rec);
+	R3051Recompiler_emitRegInstruction(rec, false, 0x89, PHILPSX_X64_R14,
+			PHILPSX_X64_RAX);
+
+	// Restore callee-saved registers and return
+	R3051Recompiler_emitByte(rec, 0x41);
+	R3051Recompiler_emitByte(rec, 0x5F);
+	R3051Recompiler_emitByte(rec, 0x41);
+	R3051Recompiler_emitByte(rec, 0x5E);
+	R3051Recompiler_emitByte(rec, 0x41);
+	R3051Recompiler_emitByte(rec, 0x5C);
+	R3051Recompiler_emitByte(rec, 0x5D);
+	R3051Recompiler_emitByte(rec, 0x5B);
+	R3051Recompiler_emitByte(rec, 0xC3);
+}
+
+/*
+ * This function emits a conditional exit from the block. If pcIndex is not
+ * negative, the program counter is first set to the address of that
+ * instruction within the block. Instructions completed since the count was
+ * last brought up to date are added to it on the way out.
+ */
+static void R3051Recompiler_emitExit(R3051Recompiler *rec, int32_t condition,
+		size_t epilogue, int32_t pcIndex, int32_t exitCode)
+{
+	// Skip over exit if condition isn't met
+	size_t skip = R3051Recompiler_emitJumpShort(rec, condition ^ 1);
+
+	R3051Recompiler_emitInstructionCount(rec);
+	if (pcIndex >= 0) {
+		R3051Recompiler_emitMemInstruction(rec, false, 0x8D, PHILPSX_X64_RAX,
+				PHILPSX_X64_R14, pcIndex * 4);
+		R3051Recompiler_emitMemInstruction(rec, false, 0x89, PHILPSX_X64_RAX,
+				PHILPSX_X64_RBX, PHILPSX_R3051_OFFSET(programCounter));
+	}
+	R3051Recompiler_emitMovImm32(rec, PHILPSX_X64_RAX, exitCode);
+	R3051Recompiler_emitByte(rec, 0xE9);
+	R3051Recompiler_emitWord(rec,
+			(int32_t)(epilogue - (rec->codeBufferUsed + 4)));
+
+	R3051Recompiler_patchJumpShort(rec, skip);
+}
+
+/*
+ * This function emits a check that the instruction at the specified index
+ * can be fetched without the interpreter's help. With the instruction cache
+ * enabled, this means its cache line must be present. Otherwise, the CPU must
+ * hold the bus. If not, the interpreter carries on from that instruction.
+ */
+static void R3051Recompiler_emitFetchCheck(R3051Recompiler *rec,
+		R3051Block *block, int32_t index, bool instructionCacheEnabled,
+		size_t epilogue)
+{
+	if (instructionCacheEnabled) {
+		int32_t physicalAddress = block->physicalAddress + index * 4;
+		int32_t tagIndex = logical_rshift(physicalAddress, 4) & 0xFF;
+
+		// Check tag and valid flag together
+		R3051Recompiler_emitMemInstruction(rec, false, 0x81, 7,
+				PHILPSX_X64_RBX, PHILPSX_R3051_OFFSET(instructionCache.lines) +
+				tagIndex * (int32_t)sizeof(InstructionCacheLine));
+		R3051Recompiler_emitWord(rec,
+				(physicalAddress & 0xFFFFF000) | PHILPSX_ICACHE_VALID);
+		R3051Recompiler_emitExit(rec, PHILPSX_X64_CC_NE, epilogue, index,
+				index << 1);
+	} else {
+		R3051Recompiler_emitMemInstruction(rec, false, 0x81, 7,
+				PHILPSX_X64_RBX, PHILPSX_R3051_OFFSET(busHolder));
+		R3051Recompiler_emitWord(rec, PHILPSX_COMPONENTS_CPU);
+		R3051Recompiler_emitExit(rec, PHILPSX_X64_CC_NE, epilogue, index,
+				index << 1);
+	}
+}
+
+/*
+ * This function emits a call to the interpreter's handler for an
+ * instruction, making sure the program counter, cycle count and the rest of
+ * the system are up to date first. As in the interpreter, the fetch cycles
+ * are added to the running total straight away, so they are counted even if
+ * the interpreter finishes the instruction off.
+ */
+static void R3051Recompiler_emitHandlerCall(R3051Recompiler *rec,
+		R3051Op *op, int32_t index, int32_t fetchCycles)
+{
+	R3051Recompiler_emitCycleFlush(rec);
+	R3051Recompiler_emitInstructionCount(rec);
+	rec->pendingInstructions = 0;
+
+	// Set program counter and cycle count
+	R3051Recompiler_emitMemInstruction(rec, false, 0x8D, PHILPSX_X64_RAX,
+			PHILPSX_X64_R14, index * 4);
+	R3051Recompiler_emitMemInstruction(rec, false, 0x89, PHILPSX_X64_RAX,
+			PHILPSX_X64_RBX, PHILPSX_R3051_OFFSET(programCounter));
+	R3051Recompiler_emitMemInstruction(rec, false, 0xC7, 0, PHILPSX_X64_RBX,
+			PHILPSX_R3051_OFFSET(cycles));
+	R3051Recompiler_emitWord(rec, fetchCycles);
+	if (fetchCycles != 0) {
+		R3051Recompiler_emitMemInstruction(rec, true, 0x81, 0,
+				PHILPSX_X64_RBX, PHILPSX_R3051_OFFSET(totalCycles));
+		R3051Recompiler_emitWord(rec, fetchCycles);
+	}
+
+	// handler(cpu, instruction)
+	R3051Recompiler_emitRegInstruction(rec, true, 0x89, PHILPSX_X64_RBX,
+			PHILPSX_X64_RDI);
+	R3051Recompiler_emitMovImm32(rec, PHILPSX_X64_RSI, op->instruction);
+	R3051Recompiler_emitCall(rec, (void *)op->handler);
+}
+
+/*
+ * This function emits host code for an instruction that can be executed
+ * without the interpreter. It returns false (emitting nothing) if the
+ * instruction needs its handler instead. Writes to r0 are skipped entirely,
+ * as it always reads as zero.
+ */
+static bool R3051Recompiler_emitInlineOp(R3051Recompiler *rec,
+		int32_t instruction)
+{
+	// Decode fields
+	int32_t opcode = logical_rshift(instruction, 26);
+	int32_t rs = logical_rshift(instruction, 21) & 0x1F;
+	int32_t rt = logical_rshift(instruction, 16) & 0x1F;
+	int32_t rd = logical_rshift(instruction, 11) & 0x1F;
+	int32_t shamt = logical_rshift(instruction, 6) & 0x1F;
+	int32_t immediate = instruction & 0xFFFF;
+	int32_t signedImmediate = (int16_t)immediate;
+
+	// Host opcodes for eax = eax op [rbx+disp], and /digit for
+	// eax = eax shift by imm8/cl
+	int32_t aluOpcode = -1;
+	int32_t shiftDigit = -1;
+
+	switch (opcode) {
+		case 0: // SPECIAL
+			switch (instruction & 0x3F) {
+				case 0: // SLL
+				case 2: // SRL
+				case 3: // SRA
+					if (rd == 0)
+						return true;
+					shiftDigit = ((instruction & 0x3F) == 0) ? 4 :
+							((instruction & 0x3F) == 2) ? 5 : 7;
+					R3051Recompiler_emitMemInstruction(rec, false, 0x8B,
+							PHILPSX_X64_RAX, PHILPSX_X64_RBX,
+							PHILPSX_R3051_OFFSET_REG(rt));
+					R3051Recompiler_emitRegInstruction(rec, false, 0xC1,
+							shiftDigit, PHILPSX_X64_RAX);
+					R3051Recompiler_emitByte(rec, shamt);
+					break;
+				case 4: // SLLV
+				case 6: // SRLV
+				case 7: // SRAV
+					if (rd == 0)
+						return true;
+					shiftDigit = ((instruction & 0x3F) == 4) ? 4 :
+							((instruction & 0x3F) == 6) ? 5 : 7;
+					R3051Recompiler_emitMemInstruction(rec, false, 0x8B,
+							PHILPSX_X64_RCX, PHILPSX_X64_RBX,
+							PHILPSX_R3051_OFFSET_REG(rs));
+					R3051Recompiler_emitMemInstruction(rec, false, 0x8B,
+							PHILPSX_X64_RAX, PHILPSX_X64_RBX,
+							PHILPSX_R3051_OFFSET_REG(rt));
+					R3051Recompiler_emitRegInstruction(rec, false, 0xD3,
+							shiftDigit, PHILPSX_X64_RAX);
+					break;
+				case 16: // MFHI
+				case 18: // MFLO
+					if (rd == 0)
+						return true;
+					R3051Recompiler_emitMemInstruction(rec, false, 0x8B,
+							PHILPSX_X64_RAX, PHILPSX_X64_RBX,
+							((instruction & 0x3F) == 16) ?
+							PHILPSX_R3051_OFFSET(hiReg) :
+							PHILPSX_R3051_OFFSET(loReg));
+					break;
+				case 17: // MTHI
+				case 19: // MTLO
+					R3051Recompiler_emitMemInstruction(rec, false, 0x8B,
+							PHILPSX_X64_RAX, PHILPSX_X64_RBX,
+							PHILPSX_R3051_OFFSET_REG(rs));
+					R3051Recompiler_emitMemInstruction(rec, false, 0x89,
+							PHILPSX_X64_RAX, PHILPSX_X64_RBX,
+							((instruction & 0x3F) == 17) ?
+							PHILPSX_R3051_OFFSET(hiReg) :
+							PHILPSX_R3051_OFFSET(loReg));
+					return true;
+				case 24: // MULT
+				case 25: // MULTU
+					// Sign or zero extend operands, then take 64-bit product
+					if ((instruction & 0x3F) == 24) {
+						R3051Recompiler_emitMemInstruction(rec, true, 0x63,
+								PHILPSX_X64_RAX, PHILPSX_X64_RBX,
+								PHILPSX_R3051_OFFSET_REG(rs));
+						R3051Recompiler_emitMemInstruction(rec, true, 0x63,
+								PHILPSX_X64_RCX, PHILPSX_X64_RBX,
+								PHILPSX_R3051_OFFSET_REG(rt));
+					} else {
+						R3051Recompiler_emitMemInstruction(rec, false, 0x8B,
+								PHILPSX_X64_RAX, PHILPSX_X64_RBX,
+								PHILPSX_R3051_OFFSET_REG(rs));
+						R3051Recompiler_emitMemInstruction(rec, false, 0x8B,
+								PHILPSX_X64_RCX, PHILPSX_X64_RBX,
+								PHILPSX_R3051_OFFSET_REG(rt));
+					}
+					R3051Recompiler_emitRegInstruction(rec, true, 0x0FAF,
+							PHILPSX_X64_RAX, PHILPSX_X64_RCX);
+					R3051Recompiler_emitMemInstruction(rec, false, 0x89,
+							PHILPSX_X64_RAX, PHILPSX_X64_RBX,
+							PHILPSX_R3051_OFFSET(loReg));
+					R3051Recompiler_emitRegInstruction(rec, true, 0xC1, 5,
+							PHILPSX_X64_RAX);
+					R3051Recompiler_emitByte(rec, 32);
+					R3051Recompiler_emitMemInstruction(rec, false, 0x89,
+							PHILPSX_X64_RAX, PHILPSX_X64_RBX,
+							PHILPSX_R3051_OFFSET(hiReg));
+					return true;
+				case 33: // ADDU
+					aluOpcode = 0x03;
+					break;
+				case 35: // SUBU
+					aluOpcode = 0x2B;
+					break;
+				case 36: // AND
+					aluOpcode = 0x23;
+					break;
+				case 37: // OR
+				case 39: // NOR
+					aluOpcode = 0x0B;
+					break;
+				case 38: // XOR
+					aluOpcode = 0x33;
+					break;
+				case 42: // SLT
+				case 43: // SLTU
+					aluOpcode = 0x3B;
+					break;
+				default:
+					return false;
+			}
+
+			// Deal with three-register forms
+			if (aluOpcode != -1) {
+				if (rd == 0)
+					return true;
+				R3051Recompiler_emitMemInstruction(rec, false, 0x8B,
+						PHILPSX_X64_RAX, PHILPSX_X64_RBX,
+						PHILPSX_R3051_OFFSET_REG(rs));
+				R3051Recompiler_emitMemInstruction(rec, false, aluOpcode,
+						PHILPSX_X64_RAX, PHILPSX_X64_RBX,
+						PHILPSX_R3051_OFFSET_REG(rt));
+				switch (instruction & 0x3F) {
+					case 39: // NOR
+						R3051Recompiler_emitRegInstruction(rec, false, 0xF7,
+								2, PHILPSX_X64_RAX);
+						break;
+					case 42: // SLT
+					case 43: // SLTU
+						R3051Recompiler_emitRegInstruction(rec, false,
+								0x0F90 | (((instruction & 0x3F) == 42) ?
+								PHILPSX_X64_CC_L : PHILPSX_X64_CC_B),
+								0, PHILPSX_X64_RAX);
+						R3051Recompiler_emitRegInstruction(rec, false,
+								0x0FB6, PHILPSX_X64_RAX, PHILPSX_X64_RAX);
+						break;
+				}
+			}
+
+			// Store result
+			R3051Recompiler_emitMemInstruction(rec, false, 0x89,
+					PHILPSX_X64_RAX, PHILPSX_X64_RBX,
+					PHILPSX_R3051_OFFSET_REG(rd));
+			return true;
+		case 9: // ADDIU
+		case 10: // SLTI
+		case 12: // ANDI
+		case 13: // ORI
+		case 14: // XORI
+			if (rt == 0)
+				return true;
+			R3051Recompiler_emitMemInstruction(rec, false, 0x8B,
+					PHILPSX_X64_RAX, PHILPSX_X64_RBX,
+					PHILPSX_R3051_OFFSET_REG(rs));
+			switch (opcode) {
+				case 9: // ADDIU
+					R3051Recompiler_emitRegInstruction(rec, false, 0x81, 0,
+							PHILPSX_X64_RAX);
+					R3051Recompiler_emitWord(rec, signedImmediate);
+					break;
+				case 10: // SLTI
+					R3051Recompiler_emitRegInstruction(rec, false, 0x81, 7,
+							PHILPSX_X64_RAX);
+					R3051Recompiler_emitWord(rec, signedImmediate);
+					R3051Recompiler_emitRegInstruction(rec, false,
+							0x0F90 | PHILPSX_X64_CC_L, 0, PHILPSX_X64_RAX);
+					R3051Recompiler_emitRegInstruction(rec, false, 0x0FB6,
+							PHILPSX_X64_RAX, PHILPSX_X64_RAX);
+					break;
+				case 12: // ANDI
+					R3051Recompiler_emitRegInstruction(rec, false, 0x81, 4,
+							PHILPSX_X64_RAX);
+					R3051Recompiler_emitWord(rec, immediate);
+					break;
+				case 13: // ORI
+					R3051Recompiler_emitRegInstruction(rec, false, 0x81, 1,
+							PHILPSX_X64_RAX);
+					R3051Recompiler_emitWord(rec, immediate);
+					break;
+				case 14: // XORI
+					R3051Recompiler_emitRegInstruction(rec, false, 0x81, 6,
+							PHILPSX_X64_RAX);
+					R3051Recompiler_emitWord(rec, immediate);
+					break;
+			}
+			R3051Recompiler_emitMemInstruction(rec, false, 0x89,
+					PHILPSX_X64_RAX, PHILPSX_X64_RBX,
+					PHILPSX_R3051_OFFSET_REG(rt));
+			return true;
+		case 15: // LUI
+			if (rt == 0)
+				return true;
+			R3051Recompiler_emitMemInstruction(rec, false, 0xC7, 0,
+					PHILPSX_X64_RBX, PHILPSX_R3051_OFFSET_REG(rt));
+			R3051Recompiler_emitWord(rec, immediate << 16);
+			return true;
+	}
+
+	// Everything else goes through its handler
+	return false;
+}
+
+/*
+ * This function emits code to add the instructions completed since the count
+ * was last brought up to date to the CPU's count, if there are any.
+ */
+static void R3051Recompiler_emitInstructionCount(R3051Recompiler *rec)
+{
+	if (rec->pendingInstructions == 0)
+		return;
+
+	R3051Recompiler_emitMemInstruction(rec, true, 0x81, 0, PHILPSX_X64_RBX,
+			PHILPSX_R3051_OFFSET(instructionCount));
+	R3051Recompiler_emitWord(rec, rec->pendingInstructions);
+}
+
+/*
+ * This function emits the check made after the first instruction of a
+ * block, which may be sitting in the delay slot of the branch that ended the
+ * previous block. If that branch was taken, the program counter is set to
+ * the branch target and the block is left.
+ */
+static void R3051Recompiler_emitJumpCheck(R3051Recompiler *rec,
+		int32_t length, size_t epilogue)
+{
+	// Nothing to do if previous instruction wasn't a branch
+	R3051Recompiler_emitMemInstruction(rec, false, 0x80, 7, PHILPSX_X64_RBX,
+			PHILPSX_R3051_OFFSET(prevWasBranch));
+	R3051Recompiler_emitByte(rec, 0);
+	size_t notBranch = R3051Recompiler_emitJumpShort(rec, PHILPSX_X64_CC_E);
+
+	// Clear branch status, then jump if pending
+	R3051Recompiler_emitMemInstruction(rec, false, 0xC6, 0, PHILPSX_X64_RBX,
+			PHILPSX_R3051_OFFSET(prevWasBranch));
+	R3051Recompiler_emitByte(rec, 0);
+	R3051Recompiler_emitMemInstruction(rec, false, 0x80, 7, PHILPSX_X64_RBX,
+			PHILPSX_R3051_OFFSET(jumpPending));
+	R3051Recompiler_emitByte(rec, 0);
+	size_t notPending = R3051Recompiler_emitJumpShort(rec, PHILPSX_X64_CC_E);
+	R3051Recompiler_emitMemInstruction(rec, false, 0xC6, 0, PHILPSX_X64_RBX,
+			PHILPSX_R3051_OFFSET(jumpPending));
+	R3051Recompiler_emitByte(rec, 0);
+	R3051Recompiler_emitMemInstruction(rec, false, 0x8B, PHILPSX_X64_RAX,
+			PHILPSX_X64_RBX, PHILPSX_R3051_OFFSET(jumpAddress));
+	R3051Recompiler_emitMemInstruction(rec, false, 0x89, PHILPSX_X64_RAX,
+			PHILPSX_X64_RBX, PHILPSX_R3051_OFFSET(programCounter));
+	R3051Recompiler_emitInstructionCount(rec);
+	R3051Recompiler_emitMovImm32(rec, PHILPSX_X64_RAX, length << 1);
+	R3051Recompiler_emitByte(rec, 0xE9);
+	R3051Recompiler_emitWord(rec,
+			(int32_t)(epilogue - (rec->codeBufferUsed + 4)));
+
+	R3051Recompiler_patchJumpShort(rec, notBranch);
+	R3051Recompiler_patchJumpShort(rec, notPending);
+}
+
+/*
+ * This function emits a short conditional jump with its target left blank,
+ * returning the position to patch it at.
+ */
+static size_t R3051Recompiler_emitJumpShort(R3051Recompiler *rec,
+		int32_t condition)
+{
+	R3051Recompiler_emitByte(rec, 0x70 | condition);
+	R3051Recompiler_emitByte(rec, 0);
+	return rec->codeBufferUsed - 1;
+}
+
+/*
+ * This function emits an instruction operating on a register and the memory
+ * at [base+disp32]. Two-byte opcodes are passed as 0x0FXX, and reg can also
+ * be a /digit opcode extension.
+ */
+static void R3051Recompiler_emitMemInstruction(R3051Recompiler *rec,
+		bool wide, int32_t opcode, int32_t reg, int32_t base, int32_t disp)
+{
+	// Emit REX prefix if needed
+	int32_t rex = (wide ? 0x8 : 0) | ((reg & 0x8) ? 0x4 : 0) |
+			((base & 0x8) ? 0x1 : 0);
+	if (rex != 0)
+		R3051Recompiler_emitByte(rec, 0x40 | rex);
+
+	// Emit opcode, ModRM (plus SIB for rsp/r12 bases) and displacement
+	if (opcode > 0xFF)
+		R3051Recompiler_emitByte(rec, logical_rshift(opcode, 8));
+	R3051Recompiler_emitByte(rec, opcode & 0xFF);
+	R3051Recompiler_emitByte(rec, 0x80 | ((reg & 0x7) << 3) | (base & 0x7));
+	if ((base & 0x7) == PHILPSX_X64_RSP)
+		R3051Recompiler_emitByte(rec, 0x24);
+	R3051Recompiler_emitWord(rec, disp);
+}
+
+/*
+ * This function emits a move of a 32-bit immediate into a register.
+ */
+static void R3051Recompiler_emitMovImm32(R3051Recompiler *rec, int32_t reg,
+		int32_t value)
+{
+	if ((reg & 0x8) != 0)
+		R3051Recompiler_emitByte(rec, 0x41);
+	R3051Recompiler_emitByte(rec, 0xB8 | (reg & 0x7));
+	R3051Recompiler_emitWord(rec, value);
+}
+
+/*
+ * This function emits a move of a 64-bit immediate into a register.
+ */
+static void R3051Recompiler_emitMovImm64(R3051Recompiler *rec, int32_t reg,
+		uint64_t value)
+{
+	R3051Recompiler_emitByte(rec, ((reg & 0x8) != 0) ? 0x49 : 0x48);
+	R3051Recompiler_emitByte(rec, 0xB8 | (reg & 0x7));
+	R3051Recompiler_emitWord(rec, (int32_t)value);
+	R3051Recompiler_emitWord(rec, (int32_t)(value >> 32));
+}
+
+/*
+ * This function emits the block entry code, which saves the callee-saved
+ * registers used and loads them up.
+ */
+static void R3051Recompiler_emitPrologue(R3051Recompiler *rec,
+		R3051Block *block)
+{
+	// Save registers (five pushes keep the stack 16-byte aligned for calls)
+	R3051Recompiler_emitByte(rec, 0x53);
+	R3051Recompiler_emitByte(rec, 0x55);
+	R3051Recompiler_emitByte(rec, 0x41);
+	R3051Recompiler_emitByte(rec, 0x54);
+	R3051Recompiler_emitByte(rec, 0x41);
+	R3051Recompiler_emitByte(rec, 0x56);
+	R3051Recompiler_emitByte(rec, 0x41);
+	R3051Recompiler_emitByte(rec, 0x57);
+
+	// Load registers
+	R3051Recompiler_emitRegInstruction(rec, true, 0x89, PHILPSX_X64_RDI,
+			PHILPSX_X64_RBX);
+	R3051Recompiler_emitRegInstruction(rec, false, 0x31, PHILPSX_X64_R12,
+			PHILPSX_X64_R12);
+	R3051Recompiler_emitMemInstruction(rec, false, 0x8B, PHILPSX_X64_R14,
+			PHILPSX_X64_RBX, PHILPSX_R3051_OFFSET(programCounter));
+	R3051Recompiler_emitMovImm64(rec, PHILPSX_X64_R15, (uintptr_t)block);
+}
+
+/*
+ * This function emits an instruction operating on two registers. Two-byte
+ * opcodes are passed as 0x0FXX, and reg can also be a /digit opcode
+ * extension.
+ */
+static void R3051Recompiler_emitRegInstruction(R3051Recompiler *rec,
+		bool wide, int32_t opcode, int32_t reg, int32_t rm)
+{
+	// Emit REX prefix if needed
+	int32_t rex = (wide ? 0x8 : 0) | ((reg & 0x8) ? 0x4 : 0) |
+			((rm & 0x8) ? 0x1 : 0);
+	if (rex != 0)
+		R3051Recompiler_emitByte(rec, 0x40 | rex);
+
+	// Emit opcode and ModRM
+	if (opcode > 0xFF)
+		R3051Recompiler_emitByte(rec, logical_rshift(opcode, 8));
+	R3051Recompiler_emitByte(rec, opcode & 0xFF);
+	R3051Recompiler_emitByte(rec, 0xC0 | ((reg & 0x7) << 3) | (rm & 0x7));
+}
+
+/*
+ * This function emits a 32-bit value in little-endian order.
+ */
+static void R3051Recompiler_emitWord(R3051Recompiler *rec, int32_t value)
+{
+	R3051Recompiler_emitByte(rec, value & 0xFF);
+	R3051Recompiler_emitByte(rec, logical_rshift(value, 8) & 0xFF);
+	R3051Recompiler_emitByte(rec, logical_rshift(value, 16) & 0xFF);
+	R3051Recompiler_emitByte(rec, logical_rshift(value, 24) & 0xFF);
+}
+
+/*
+ * This function throws away all generated code, detaching it from every
+ * block in the CPU's block cache.
+ */
+static void R3051Recompiler_flushCodeBuffer(R3051Recompiler *rec,
+		R3051 *cpu)
+{
+	for (int32_t i = 0; i < PHILPSX_R3051_BLOCKCACHE_SIZE; ++i)
+		cpu->blockCache[i].compiledCode = NULL;
+	rec->codeBufferUsed = 0;
+}
+
+/*
+ * This function tells us if an instruction is a store.
+ */
+static bool R3051Recompiler_isStore(int32_t instruction)
+{
+	int32_t opcode = logical_rshift(instruction, 26);
+	return (opcode >= 40 && opcode <= 46) || opcode == 58;
+}
+
+/*
+ * This function points a short jump emitted earlier at the current position.
+ */
+static void R3051Recompiler_patchJumpShort(R3051Recompiler *rec,
+		size_t position)
+{
+	rec->codeBuffer[position] =
+			(uint8_t)(rec->codeBufferUsed - (position + 1));
+}
@@ -6,9 +6,26 @@
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include "../headers/SPU.h"
 #include "../headers/SystemInterlink.h"
 
+// Forward declarations for functions private to this class
+// SPU-related stuff:
+static int8_t SPU_readPortByte(void *object, int32_t address);
+static int16_t SPU_readPortHalfword(void *object, int32_t address);
+static void SPU_writePortByte(void *object, int32_t address, int8_t value);
+static void SPU_writePortHalfword(void *object, int32_t address,
+		int16_t value);
+
+// Handlers for our I/O ports
+static const IOPortHandlers spuPortHandlers = {
+	.readByte = SPU_readPortByte,
+	.readHalfword = SPU_readPortHalfword,
+	.writeByte = SPU_writePortByte,
+	.writeHalfword = SPU_writePortHalfword
+};
+
 /*
  * This struct models the SPU (sound chip) of the PlayStation, and at present
  * is a stub. It is intended merely to store and return register values in
@@ -80,6 +97,18 @@ void SPU_writeByte(SPU *spu, int32_t address, int8_t value)
 	spu->fakeRegisterSpace[(int32_t)tempAddress] = value;
 }
 
+/*
+ * This function writes a halfword to the fake store.
+ */
+void SPU_writeHalfword(SPU *spu, int32_t address, int16_t value)
+{
+	int64_t tempAddress = 0xFFFFFFFEL & address;
+	tempAddress -= 0x1F801C00L;
+
+	// Store halfword
+	memcpy(spu->fakeRegisterSpace + (int32_t)tempAddress, &value, 2);
+}
+
 /*
  * This function reads a byte from the fake store.
  */
@@ -92,10 +121,61 @@ int8_t SPU_readByte(SPU *spu, int32_t address)
 	return spu->fakeRegisterSpace[(int32_t)tempAddress];
 }
 
+/*
+ * This function reads a halfword from the fake store.
+ */
+int16_t SPU_readHalfword(SPU *spu, int32_t address)
+{
+	int64_t tempAddress = 0xFFFFFFFEL & address;
+	tempAddress -= 0x1F801C00L;
+
+	// Retrieve halfword
+	int16_t retVal;
+	memcpy(&retVal, spu->fakeRegisterSpace + (int32_t)tempAddress, 2);
+	return retVal;
+}
+
 /*
  * This function sets the system reference to that of the supplied argument.
  */
 void SPU_setMemoryInterface(SPU *spu, SystemInterlink *smi)
 {
 	spu->system = smi;
+
+	// Register handlers for our I/O ports
+	SystemInterlink_setIOPortHandlers(smi, 0x1F801C00, 0x400,
+			&spuPortHandlers, spu);
+}
+
+/*
+ * This function handles byte reads from our I/O ports.
+ */
+static int8_t SPU_readPortByte(void *object, int32_t address)
+{
+	return SPU_readByte(object, address);
+}
+
+/*
+ * This function handles halfword reads from our I/O ports.
+ */
+static int16_t SPU_readPortHalfword(void *object, int32_t address)
+{
+	return SPU_readHalfword(object, address);
+}
+
+/*
+ * This function handles byte writes to our I/O ports.
+ */
+static void SPU_writePortByte(void *object, int32_t address, int8_t value)
+{
+	SPU_writeByte(object, address, value);
+}
+
+/*
+ * This function handles halfword writes to our I/O ports.
+ */
+static void SPU_writePortHalfword(void *object, int32_t address,
+		int16_t value)
+{
+	SPU_writeHalfword(object, address, value);
 }
\ No newline at end of file
@@ -0,0 +1,251 @@
+/*
+ * This C file models the event scheduler of the emulator as a class. It owns
+ * the global count of CPU cycles, and a binary min-heap of the timed events
+ * (such as vblank or delayed interrupts) that are pending, so the CPU only
+ * needs to compare the cycle count against the earliest deadline rather
+ * than updating every component after each instruction.
+ *
+ * Scheduler.c - Copyright Phillip Potter, 2020, under GPLv3
+ */
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "../headers/Scheduler.h"
+
+// Deadline used when no events are pending
+#define PHILPSX_SCHEDULER_NO_DEADLINE INT64_MAX
+
+// Forward declarations for functions private to this class
+// Scheduler-related stuff:
+static void Scheduler_siftDown(Scheduler *sched, int32_t position);
+static void Scheduler_siftUp(Scheduler *sched, int32_t position);
+static void Scheduler_swap(Scheduler *sched, int32_t first, int32_t second);
+
+/*
+ * This struct contains the global cycle count, along with the details of
+ * each event and the heap ordering the pending ones.
+ */
+struct Scheduler {
+
+	// Global count of CPU cycles, and cycle the earliest event is due at
+	int64_t cycles;
+	int64_t nextDeadline;
+
+	// Event details, indexed by event number
+	int64_t timestamps[PHILPSX_EVENT_COUNT];
+	SchedulerHandler handlers[PHILPSX_EVENT_COUNT];
+	void *objects[PHILPSX_EVENT_COUNT];
+	int32_t heapPositions[PHILPSX_EVENT_COUNT];	// -1 when not pending
+
+	// Min-heap of pending event numbers, ordered by timestamp
+	int32_t heap[PHILPSX_EVENT_COUNT];
+	int32_t heapSize;
+};
+
+/*
+ * This constructs a Scheduler object with no events pending.
+ */
+Scheduler *construct_Scheduler(void)
+{
+	// Allocate Scheduler struct
+	Scheduler *sched = malloc(sizeof(Scheduler));
+	if (!sched) {
+		fprintf(stderr, "PhilPSX: Scheduler: Couldn't allocate memory for "
+				"Scheduler struct\n");
+		goto end;
+	}
+
+	// Setup cycle count and events
+	sched->cycles = 0;
+	sched->nextDeadline = PHILPSX_SCHEDULER_NO_DEADLINE;
+	for (int32_t i = 0; i < PHILPSX_EVENT_COUNT; ++i) {
+		sched->timestamps[i] = 0;
+		sched->handlers[i] = NULL;
+		sched->objects[i] = NULL;
+		sched->heapPositions[i] = -1;
+		sched->heap[i] = 0;
+	}
+	sched->heapSize = 0;
+
+	// Normal return:
+	return sched;
+
+	// Cleanup path:
+	end:
+	return sched;
+}
+
+/*
+ * This destructs a Scheduler object.
+ */
+void destruct_Scheduler(Scheduler *sched)
+{
+	free(sched);
+}
+
+/*
+ * This function moves the global cycle count on by the specified number of
+ * CPU cycles. Events are not run here, so that it is cheap enough to call
+ * after every instruction.
+ */
+void Scheduler_appendCycles(Scheduler *sched, int32_t cycles)
+{
+	sched->cycles += cycles;
+}
+
+/*
+ * This function removes the specified event from the heap if it is pending.
+ */
+void Scheduler_cancelEvent(Scheduler *sched, int32_t event)
+{
+	int32_t position = sched->heapPositions[event];
+	if (position == -1)
+		return;
+
+	// Move last event into the gap and restore heap order around it
+	--sched->heapSize;
+	if (position != sched->heapSize) {
+		Scheduler_swap(sched, position, sched->heapSize);
+		Scheduler_siftDown(sched, position);
+		Scheduler_siftUp(sched, position);
+	}
+	sched->heapPositions[event] = -1;
+
+	// Update deadline
+	sched->nextDeadline = (sched->heapSize == 0) ?
+			PHILPSX_SCHEDULER_NO_DEADLINE :
+			sched->timestamps[sched->heap[0]];
+}
+
+/*
+ * This function returns the global count of CPU cycles.
+ */
+int64_t Scheduler_getCycles(Scheduler *sched)
+{
+	return sched->cycles;
+}
+
+/*
+ * This function returns the cycle the earliest pending event is due at.
+ */
+int64_t Scheduler_getNextDeadline(Scheduler *sched)
+{
+	return sched->nextDeadline;
+}
+
+/*
+ * This function runs the handlers of all events that are due, in timestamp
+ * order. Handlers are free to schedule further events, including their own.
+ * It returns true if any events were run.
+ */
+bool Scheduler_runDueEvents(Scheduler *sched)
+{
+	// Exit early if nothing is due yet
+	if (sched->cycles < sched->nextDeadline)
+		return false;
+
+	while (sched->heapSize > 0 &&
+			sched->timestamps[sched->heap[0]] <= sched->cycles) {
+		int32_t event = sched->heap[0];
+		Scheduler_cancelEvent(sched, event);
+		sched->handlers[event](sched->objects[event]);
+	}
+
+	return true;
+}
+
+/*
+ * This function sets the specified event to be due at the cycle count
+ * given by timestamp, replacing any previous deadline for it.
+ */
+void Scheduler_scheduleEvent(Scheduler *sched, int32_t event,
+		int64_t timestamp)
+{
+	sched->timestamps[event] = timestamp;
+
+	// Add to heap if not already pending
+	int32_t position = sched->heapPositions[event];
+	if (position == -1) {
+		position = sched->heapSize++;
+		sched->heap[position] = event;
+		sched->heapPositions[event] = position;
+	}
+
+	// Restore heap order
+	Scheduler_siftUp(sched, position);
+	Scheduler_siftDown(sched, sched->heapPositions[event]);
+
+	// Update deadline
+	sched->nextDeadline = sched->timestamps[sched->heap[0]];
+}
+
+/*
+ * This function sets the handler that is run when the specified event is
+ * due, along with the object it is passed.
+ */
+void Scheduler_setHandler(Scheduler *sched, int32_t event,
+		SchedulerHandler handler, void *object)
+{
+	sched->handlers[event] = handler;
+	sched->objects[event] = object;
+}
+
+/*
+ * This function moves the event at the specified heap position down until
+ * neither of its children are due before it.
+ */
+static void Scheduler_siftDown(Scheduler *sched, int32_t position)
+{
+	while (true) {
+		int32_t smallest = position;
+		int32_t left = position * 2 + 1;
+		int32_t right = left + 1;
+
+		if (left < sched->heapSize &&
+				sched->timestamps[sched->heap[left]] <
+				sched->timestamps[sched->heap[smallest]])
+			smallest = left;
+		if (right < sched->heapSize &&
+				sched->timestamps[sched->heap[right]] <
+				sched->timestamps[sched->heap[smallest]])
+			smallest = right;
+
+		if (smallest == position)
+			break;
+
+		Scheduler_swap(sched, position, smallest);
+		position = smallest;
+	}
+}
+
+/*
+ * This function moves the event at the specified heap position up until its
+ * parent is not due after it.
+ */
+static void Scheduler_siftUp(Scheduler *sched, int32_t position)
+{
+	while (position > 0) {
+		int32_t parent = (position - 1) / 2;
+		if (sched->timestamps[sched->heap[parent]] <=
+				sched->timestamps[sched->heap[position]])
+			break;
+
+		Scheduler_swap(sched, position, parent);
+		position = parent;
+	}
+}
+
+/*
+ * This function swaps the events at two heap positions, keeping track of
+ * where each event now lives.
+ */
+static void Scheduler_swap(Scheduler *sched, int32_t first, int32_t second)
+{
+	int32_t temp = sched->heap[first];
+	sched->heap[first] = sched->heap[second];
+	sched->heap[second] = temp;
+
+	sched->heapPositions[sched->heap[first]] = first;
+	sched->heapPositions[sched->heap[second]] = second;
+}
@@ -4,73 +4,166 @@
  * 
  * SystemInterlink.c - Copyright Phillip Potter, 2020, under GPLv3
  */
+#define _GNU_SOURCE
 #include <stdint.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/types.h>
+#include <sys/mman.h>
 #include <fcntl.h>
 #include <unistd.h>
 #include "../headers/SystemInterlink.h"
 #include "../headers/CDROMDrive.h"
+#include "../headers/ClockDomain.h"
 #include "../headers/ControllerIO.h"
 #include "../headers/R3051.h"
 #include "../headers/DMAArbiter.h"
 #include "../headers/GPU.h"
 #include "../headers/SPU.h"
+#include "../headers/Scheduler.h"
+#include "../headers/Profiler.h"
+#include "../headers/Cop0_public.h"
 #include "../headers/math_utils.h"
 
+// Number of 4-byte I/O ports from 0x1F801000 to 0x1F801FFF
+#define PHILPSX_IOPORT_COUNT 1024
+
+// Size of the host address range RAM is viewed through, which covers every
+// mirror of it in kuseg, kseg0 and kseg1
+#define PHILPSX_RAM_ARENA_SIZE 0xA0800000UL
+
 // Forward declarations for functions and subcomponents private to this class
 // SystemInterlink-related stuff:
+typedef struct IOPort IOPort;
+static void SystemInterlink_cdromInterruptEvent(void *object);
+static void SystemInterlink_dmaInterruptEvent(void *object);
+static int32_t *SystemInterlink_getMemoryControlRegister(SystemInterlink *smi,
+		int32_t address);
+static void SystemInterlink_gpuInterruptEvent(void *object);
+static void SystemInterlink_invalidateMirroredCode(SystemInterlink *smi,
+		int32_t address, int32_t length);
 static bool SystemInterlink_loadBiosFileToMemory(const char *biosPath,
 		int8_t *biosMemory);
+static int8_t *SystemInterlink_mapRam(void);
+static int32_t SystemInterlink_readInterruptPort(void *object,
+		int32_t address);
+static int32_t SystemInterlink_readMemoryControlPort(void *object,
+		int32_t address);
+static void SystemInterlink_updateCacheControl(SystemInterlink *smi);
+static void SystemInterlink_updateFetchCycles(SystemInterlink *smi);
+static void SystemInterlink_updateInterruptLine(SystemInterlink *smi);
+static void SystemInterlink_writeInterruptPortByte(void *object,
+		int32_t address, int8_t value);
+static void SystemInterlink_writeInterruptPortHalfword(void *object,
+		int32_t address, int16_t value);
+static void SystemInterlink_writeInterruptPortWord(void *object,
+		int32_t address, int32_t word);
+static void SystemInterlink_writeMemoryControlPortByte(void *object,
+		int32_t address, int8_t value);
+static void SystemInterlink_writeMemoryControlPortHalfword(void *object,
+		int32_t address, int16_t value);
+static void SystemInterlink_writeMemoryControlPortWord(void *object,
+		int32_t address, int32_t word);
 
 // TimerModule-related stuff:
 typedef struct TimerModule TimerModule;
-static void TimerModule_appendSyncCycles(TimerModule *timerModule,
-		int32_t cycles);
+static void TimerModule_advance(TimerModule *timerModule, int32_t timer);
+static bool TimerModule_isInBlank(TimerModule *timerModule, int32_t timer);
 static int32_t TimerModule_readCounterValue(TimerModule *timerModule,
 		int32_t timer);
 static int32_t TimerModule_readMode(TimerModule *timerModule,
 		int32_t timer, bool override);
+static int32_t TimerModule_readPort(void *object, int32_t address);
 static int32_t TimerModule_readTargetValue(TimerModule *timerModule,
 		int32_t timer);
-static void TimerModule_resync(TimerModule *timerModule);
-static int32_t TimerModule_swapEndianness(int32_t word);
+static void TimerModule_scheduleEvent(TimerModule *timerModule);
+static int64_t TimerModule_ticksUntilValue(TimerModule *timerModule,
+		int32_t timer, int32_t value);
+static void TimerModule_timerEvent(void *object);
 static void TimerModule_triggerTimerInterrupt(TimerModule *timerModule,
 		int32_t timer);
+static void TimerModule_updateClock(TimerModule *timerModule, int32_t timer);
+static void TimerModule_updateDeadline(TimerModule *timerModule,
+		int32_t timer);
 static void TimerModule_writeCounterValue(TimerModule *timerModule,
 		int32_t timer, int32_t value);
 static void TimerModule_writeMode(TimerModule *timerModule,
 		int32_t timer, int32_t value);
+static void TimerModule_writePortByte(void *object, int32_t address,
+		int8_t value);
+static void TimerModule_writePortHalfword(void *object, int32_t address,
+		int16_t value);
+static void TimerModule_writePortWord(void *object, int32_t address,
+		int32_t word);
 static void TimerModule_writeTargetValue(TimerModule *timerModule,
 		int32_t timer, int32_t value);
 
+// Handlers for the I/O ports of the interlink's own registers, and those of
+// ports nothing is registered for
+static const IOPortHandlers memoryControlPortHandlers = {
+	.readWord = SystemInterlink_readMemoryControlPort,
+	.writeByte = SystemInterlink_writeMemoryControlPortByte,
+	.writeHalfword = SystemInterlink_writeMemoryControlPortHalfword,
+	.writeWord = SystemInterlink_writeMemoryControlPortWord
+};
+
+static const IOPortHandlers interruptPortHandlers = {
+	.readWord = SystemInterlink_readInterruptPort,
+	.writeByte = SystemInterlink_writeInterruptPortByte,
+	.writeHalfword = SystemInterlink_writeInterruptPortHalfword,
+	.writeWord = SystemInterlink_writeInterruptPortWord
+};
+
+static const IOPortHandlers timerPortHandlers = {
+	.readWord = TimerModule_readPort,
+	.writeByte = TimerModule_writePortByte,
+	.writeHalfword = TimerModule_writePortHalfword,
+	.writeWord = TimerModule_writePortWord
+};
+
+static const IOPortHandlers unusedPortHandlers = { 0 };
+
+/*
+ * This struct stores the handlers registered for a single I/O port, along
+ * with the object they are called with.
+ */
+struct IOPort {
+	const IOPortHandlers *handlers;
+	void *object;
+};
+
 /*
- * This struct models all three timers within a single object.
+ * This struct models all three timers within a single object. Counter values
+ * are not kept up to date as time passes: each timer stores its value as of a
+ * base point, and the current value is worked out from the number of times
+ * its clock source has ticked since then, only when needed. Each clock
+ * source is a clock domain whose origin is the base point, so moving the base
+ * point on never loses part of a tick.
  */
 struct TimerModule {
 
 	// Reference back to SystemInterlink container object
 	SystemInterlink *smi;
 	
-	// Variables for the three timers
+	// Registers for the three timers
 	int32_t timerMode[3];
-	int32_t timerCounterValue[3];
 	int32_t timerTargetValue[3];
-	int32_t clockSource[3];
-	int32_t incrementBy[3];
-	int32_t newValue[3];
 	bool interruptHappenedOnceOrMore[3];
 
-	// Variables to track CPU cycles and GPU cycles
-	int32_t cpuCyclesToSync[3];
-	int32_t gpuCyclesToSync[3];
-	int32_t cpuTopup[3];
-	int32_t gpuTopup[3];
-	bool hblankHappened[3];
-	bool vblankHappened[3];
+	// Counter values as of the base point, and clock sources
+	int32_t baseValue[3];
+	ClockDomain clock[3];
+
+	// CPU cycle at which each timer next needs handling, or INT64_MAX if
+	// it never does
+	int64_t deadline[3];
+
+	// Whether timers 0 and 1 have seen hblank and vblank respectively, and
+	// whether the GPU was in them as of the base point
+	bool blankHappened[2];
+	bool inBlank[2];
 };
 
 /*
@@ -86,13 +179,23 @@ struct SystemInterlink {
 	SPU *spu;
 	CDROMDrive *cdrom;
 	ControllerIO *cio;
-	int8_t *ram;		// Allocated dynamically due to size
+	int8_t *ram;		// Mapped at the start of a range holding every mirror
 	int8_t *scratchpad;	// Allocated dynamically due to size
 	int8_t *bios;		// Allocated dynamically due to size
+	Scheduler *scheduler;
+	Profiler *profiler;	// NULL unless profiling is enabled
+
+	// Page table for RAM, BIOS and scratchpad, which also tracks which 4KB
+	// pages of RAM contain code cached by the CPU
+	MemoryPage *pageTable;
 
 	// Timers declaration
 	TimerModule timerModule;
 
+	// I/O port map, indexed by offset from 0x1F801000 divided by 4, so
+	// accesses are dispatched to the right component with a single lookup
+	IOPort ioPorts[PHILPSX_IOPORT_COUNT];
+
 	// Register declarations
 	int32_t cacheControlReg;
 	int32_t interruptStatusReg;
@@ -109,19 +212,16 @@ struct SystemInterlink {
 	int32_t ramSize;
 	int8_t biosPost;
 
-	// These registers can allow us to delay interrupts so they trigger at
-	// the proper time
-	int64_t gpuInterruptDelay;
-	int64_t dmaInterruptDelay;
-	int64_t cdromInterruptDelay;
-	int64_t gpuInterruptCounter;
-	int64_t dmaInterruptCounter;
-	int64_t cdromInterruptCounter;
-	int64_t timersInterruptDelay[3];
-	int64_t timersInterruptCounter[3];
+	// Cached state for instruction fetches, kept up to date whenever the
+	// cache control or delay/size registers are written
+	bool instructionCacheEnabled;
+	int32_t ramFetchCycles;
+	int32_t biosFetchCycles;
+
+	// These registers store the details of a delayed CD-ROM interrupt, so
+	// it triggers properly when its event is due
 	int32_t cdromInterruptNumber;
 	bool cdromInterruptEnabled;
-	int32_t interruptCycles;
 };
 
 /*
@@ -138,10 +238,10 @@ SystemInterlink *construct_SystemInterlink(const char *biosPath)
 		goto end;
 	}
 	
-	// Allocate 2 MB system RAM
-	smi->ram = calloc(2097152, sizeof(int8_t));
+	// Map 2 MB system RAM
+	smi->ram = SystemInterlink_mapRam();
 	if (!smi->ram) {
-		fprintf(stderr, "PhilPSX: SystemInterlink: Couldn't allocate memory "
+		fprintf(stderr, "PhilPSX: SystemInterlink: Couldn't map memory "
 				"for ram array\n");
 		goto cleanup_systeminterlink;
 	}
@@ -162,16 +262,81 @@ SystemInterlink *construct_SystemInterlink(const char *biosPath)
 		goto cleanup_bios;
 	}
 	
+	// Allocate page table
+	smi->pageTable = calloc(PHILPSX_MEMORYPAGE_COUNT, sizeof(MemoryPage));
+	if (!smi->pageTable) {
+		fprintf(stderr, "PhilPSX: SystemInterlink: Couldn't allocate memory "
+				"for pageTable array\n");
+		goto cleanup_scratchpad;
+	}
+
+	// Construct event scheduler
+	smi->scheduler = construct_Scheduler();
+	if (!smi->scheduler) {
+		fprintf(stderr, "PhilPSX: SystemInterlink: Couldn't construct "
+				"Scheduler\n");
+		goto cleanup_pagetable;
+	}
+	
 	// Load BIOS
 	if (!SystemInterlink_loadBiosFileToMemory(biosPath, smi->bios)) {
 		fprintf(stderr, "PhilPSX: SystemInterlink: Couldn't copy BIOS data "
 				"to memory\n");
-		goto cleanup_scratchpad;
+		goto cleanup_scheduler;
+	}
+	
+	// Map RAM (including its mirrors, which the host mapping repeats) and
+	// BIOS into page table (scratchpad is mapped only while it is enabled,
+	// and no RAM pages contain cached code yet)
+	for (int32_t i = 0; i < PHILPSX_RAM_MIRROR_SPAN >> 12; ++i) {
+		MemoryPage *page = &smi->pageTable[i];
+		page->memory = smi->ram + i * 4096;
+		page->size = 4096;
+		page->stallCycles = 6;
+	}
+	for (int32_t i = 0; i < 128; ++i) {
+		MemoryPage *page = &smi->pageTable[(0x1FC00000 >> 12) + i];
+		page->memory = smi->bios + i * 4096;
+		page->size = 4096;
+		page->stallCycles = 1;
+		page->readOnly = true;
 	}
 	
 	// Zero out timer module and set interlink reference
 	memset(&smi->timerModule, 0, sizeof(smi->timerModule));
 	smi->timerModule.smi = smi;
+
+	// Setup handlers for interrupt and timer events, and work out when the
+	// timers first need handling
+	Scheduler_setHandler(smi->scheduler, PHILPSX_EVENT_GPU_INTERRUPT,
+			SystemInterlink_gpuInterruptEvent, smi);
+	Scheduler_setHandler(smi->scheduler, PHILPSX_EVENT_DMA_INTERRUPT,
+			SystemInterlink_dmaInterruptEvent, smi);
+	Scheduler_setHandler(smi->scheduler, PHILPSX_EVENT_CDROM_INTERRUPT,
+			SystemInterlink_cdromInterruptEvent, smi);
+	Scheduler_setHandler(smi->scheduler, PHILPSX_EVENT_TIMERS,
+			TimerModule_timerEvent, &smi->timerModule);
+	for (int32_t i = 0; i < 3; ++i) {
+		TimerModule_updateClock(&smi->timerModule, i);
+		TimerModule_updateDeadline(&smi->timerModule, i);
+	}
+	TimerModule_scheduleEvent(&smi->timerModule);
+
+	// Map the I/O ports of our own registers, leaving the rest unused until
+	// the other components register theirs when linked to us
+	for (int32_t i = 0; i < PHILPSX_IOPORT_COUNT; ++i) {
+		smi->ioPorts[i].handlers = &unusedPortHandlers;
+		smi->ioPorts[i].object = NULL;
+	}
+	SystemInterlink_setIOPortHandlers(smi, 0x1F801000, 0x24,
+			&memoryControlPortHandlers, smi);
+	SystemInterlink_setIOPortHandlers(smi, 0x1F801060, 0x4,
+			&memoryControlPortHandlers, smi);
+	SystemInterlink_setIOPortHandlers(smi, 0x1F801070, 0x8,
+			&interruptPortHandlers, smi);
+	for (int32_t i = 0; i < 3; ++i)
+		SystemInterlink_setIOPortHandlers(smi, 0x1F801100 + i * 0x10, 0xC,
+				&timerPortHandlers, &smi->timerModule);
 	
 	// Set all component references to NULL
 	smi->dma = NULL;
@@ -180,21 +345,11 @@ SystemInterlink *construct_SystemInterlink(const char *biosPath)
 	smi->spu = NULL;
 	smi->cdrom = NULL;
 	smi->cio = NULL;
+	smi->profiler = NULL;
 	
-	// Setup interrupt delays
-	smi->gpuInterruptDelay = -1L;
-	smi->dmaInterruptDelay = -1L;
-	smi->cdromInterruptDelay = -1L;
-	smi->gpuInterruptCounter = 0;
-	smi->dmaInterruptCounter = 0;
-	smi->cdromInterruptCounter = 0;
-	for (int32_t i = 0; i < 3; ++i) {
-		smi->timersInterruptDelay[i] = -1L;
-		smi->timersInterruptCounter[i] = 0;
-	}
+	// Setup delayed CD-ROM interrupt details
 	smi->cdromInterruptNumber = 0;
 	smi->cdromInterruptEnabled = false;
-	smi->interruptCycles = 0;
 
 	// Setup registers
 	smi->cacheControlReg = 0;
@@ -211,11 +366,21 @@ SystemInterlink *construct_SystemInterlink(const char *biosPath)
 	smi->commonDelay = 0;
 	smi->ramSize = 0;
 	smi->biosPost = 0;
+
+	// Setup cached instruction fetch state
+	smi->instructionCacheEnabled = false;
+	SystemInterlink_updateFetchCycles(smi);
 	
 	// Normal return:
 	return smi;
 	
 	// Cleanup path:
+	cleanup_scheduler:
+	destruct_Scheduler(smi->scheduler);
+
+	cleanup_pagetable:
+	free(smi->pageTable);
+	
 	cleanup_scratchpad:
 	free(smi->scratchpad);
 	
@@ -223,7 +388,7 @@ SystemInterlink *construct_SystemInterlink(const char *biosPath)
 	free(smi->bios);
 	
 	cleanup_ram:
-	free(smi->ram);
+	munmap(smi->ram, PHILPSX_RAM_ARENA_SIZE);
 	
 	cleanup_systeminterlink:
 	free(smi);
@@ -238,29 +403,49 @@ SystemInterlink *construct_SystemInterlink(const char *biosPath)
  */
 void destruct_SystemInterlink(SystemInterlink *smi)
 {
+	destruct_Scheduler(smi->scheduler);
+	free(smi->pageTable);
 	free(smi->scratchpad);
 	free(smi->bios);
-	free(smi->ram);
+	munmap(smi->ram, PHILPSX_RAM_ARENA_SIZE);
 	free(smi);
 }
 
 /*
- * This function appends CPU cycles to the timer module.
+ * This function moves the global cycle count on by the specified number of
+ * CPU cycles. Components catch up from this count lazily, or through events
+ * in the scheduler.
  */
 void SystemInterlink_appendSyncCycles(SystemInterlink *smi, int32_t cycles)
 {
-	smi->interruptCycles += cycles;
-	GPU_appendSyncCycles(smi->gpu, cycles);
-	ControllerIO_appendSyncCycles(smi->cio, cycles);
-	TimerModule_appendSyncCycles(&smi->timerModule, cycles);
+	Scheduler_appendCycles(smi->scheduler, cycles);
 }
 
 /*
- * This function wraps the GPU function to execute accumulated cycles.
+ * This function fetches an instruction word from the specified physical
+ * address, storing the number of cycles the fetch takes in cycles, so the
+ * CPU gets both from a single call. RAM and BIOS are read directly using
+ * their cached fetch latencies, with everything else going the slow way.
  */
-void SystemInterlink_executeGPUCycles(SystemInterlink *smi)
+int32_t SystemInterlink_fetchWord(SystemInterlink *smi, int32_t address,
+		int32_t *cycles)
 {
-	GPU_executeGPUCycles(smi->gpu);
+	int64_t tempAddress = address & 0xFFFFFFFCL;
+	address = (int32_t)tempAddress;
+	int32_t retVal = 0;
+
+	if (tempAddress >= 0L && tempAddress < PHILPSX_RAM_MIRROR_SPAN) {
+		memcpy(&retVal, smi->ram + address, 4);
+		*cycles = smi->ramFetchCycles;
+	} else if (tempAddress >= 0x1FC00000L && tempAddress < 0x1FC80000L) {
+		memcpy(&retVal, smi->bios + (address - 0x1FC00000), 4);
+		*cycles = smi->biosFetchCycles;
+	} else {
+		retVal = SystemInterlink_readWord(smi, address);
+		*cycles = SystemInterlink_howManyStallCycles(smi, address);
+	}
+
+	return retVal;
 }
 
 /*
@@ -304,13 +489,41 @@ GPU *SystemInterlink_getGpu(SystemInterlink *smi)
 }
 
 /*
- * This function allows us to return a reference to the RAM array.
+ * This function returns the page table describing which physical pages are
+ * backed by RAM, BIOS or scratchpad.
+ */
+MemoryPage *SystemInterlink_getPageTable(SystemInterlink *smi)
+{
+	return smi->pageTable;
+}
+
+/*
+ * This function allows us to return a reference to the RAM array. Every
+ * mirror of RAM in kuseg, kseg0 and kseg1 is mapped onto it at the same
+ * offset as its address, so any such address can be added to it directly.
  */
 int8_t *SystemInterlink_getRamArray(SystemInterlink *smi)
 {
 	return smi->ram;
 }
 
+/*
+ * This function returns the profiler of the system, or NULL if profiling is
+ * not enabled.
+ */
+Profiler *SystemInterlink_getProfiler(SystemInterlink *smi)
+{
+	return smi->profiler;
+}
+
+/*
+ * This function returns the event scheduler of the system.
+ */
+Scheduler *SystemInterlink_getScheduler(SystemInterlink *smi)
+{
+	return smi->scheduler;
+}
+
 /*
  * This function returns the SPU object of the system.
  */
@@ -333,7 +546,7 @@ int32_t SystemInterlink_howManyStallCycles(SystemInterlink *smi,
 	int32_t cycles = 4;
 
 	// Check which area the address is in and set cycles accordingly
-	if (tempAddress >= 0L && tempAddress < 0x200000L) {
+	if (tempAddress >= 0L && tempAddress < PHILPSX_RAM_MIRROR_SPAN) {
 		// RAM
 		cycles = 6;
 	} else if (tempAddress >= 0x1FC00000L && tempAddress < 0x1FC80000L) {
@@ -348,101 +561,44 @@ int32_t SystemInterlink_howManyStallCycles(SystemInterlink *smi,
 }
 
 /*
- * This function updates the counters of all the peripherals capable of
- * generating interrupts, and sets flags in the interrupt status register at
- * the right time.
+ * This tests the cache control register to see if the instruction
+ * cache is enabled.
  */
-void SystemInterlink_incrementInterruptCounters(SystemInterlink *smi)
+bool SystemInterlink_instructionCacheEnabled(SystemInterlink *smi)
 {
-	smi->gpuInterruptCounter += smi->interruptCycles;
-	smi->dmaInterruptCounter += smi->interruptCycles;
-	smi->cdromInterruptCounter += smi->interruptCycles;
-	for (int32_t i = 0; i < 3; ++i) {
-		smi->timersInterruptCounter[i] += smi->interruptCycles;
-	}
-
-	// Handle GPU
-	if (smi->gpuInterruptDelay != -1L &&
-			smi->gpuInterruptCounter > smi->gpuInterruptDelay) {
-		// Set in little-endian mode for speed
-		smi->interruptStatusReg |= 0x01000000;
-		smi->gpuInterruptDelay = -1L;
-	}
-
-	// Handle DMA
-	if (smi->dmaInterruptDelay != -1L &&
-			smi->dmaInterruptCounter > smi->dmaInterruptDelay) {
-		// Set in little-endian mode for speed
-		smi->interruptStatusReg |= 0x08000000;
-		smi->dmaInterruptDelay = -1L;
-	}
-
-	// Handle CD-ROM
-	if (smi->cdromInterruptDelay != -1L &&
-			smi->cdromInterruptCounter > smi->cdromInterruptDelay) {
-		// Set in little-endian mode for speed
-		if (smi->cdromInterruptEnabled) {
-			smi->interruptStatusReg |= 0x04000000;
-		}
-
-		// Set this interrupt handler back to inactive
-		smi->cdromInterruptDelay = -1L;
-
-		// Also set interrupt number in CD-ROM interrupt flag register
-		CDROMDrive_setInterruptNumber(smi->cdrom, smi->cdromInterruptNumber);
-	}
-
-	// Handle Timer 0
-	if (smi->timersInterruptDelay[0] != -1L &&
-			smi->timersInterruptCounter[0] > smi->timersInterruptDelay[0]) {
-		// Set in little-endian mode for speed
-		smi->interruptStatusReg |= 0x10000000;
-		smi->timersInterruptDelay[0] = -1L;
-	}
-
-	// Handle Timer 1
-	if (smi->timersInterruptDelay[1] != -1L &&
-			smi->timersInterruptCounter[1] > smi->timersInterruptDelay[1]) {
-		// Set in little-endian mode for speed
-		smi->interruptStatusReg |= 0x20000000;
-		smi->timersInterruptDelay[1] = -1L;
-	}
-
-	// Handle Timer 2
-	if (smi->timersInterruptDelay[2] != -1L &&
-			smi->timersInterruptCounter[2] > smi->timersInterruptDelay[2]) {
-		// Set in little-endian mode for speed
-		smi->interruptStatusReg |= 0x40000000;
-		smi->timersInterruptDelay[2] = -1L;
-	}
-
-	// Reset interrupt cycles
-	smi->interruptCycles = 0;
+	return smi->instructionCacheEnabled;
 }
 
 /*
- * This tests the cache control register to see if the instruction
- * cache is enabled.
+ * This function invalidates any code cached by the CPU within the physical
+ * RAM range specified. It is intended for components such as the DMA
+ * arbiter that write to the RAM array directly.
  */
-bool SystemInterlink_instructionCacheEnabled(SystemInterlink *smi)
+void SystemInterlink_invalidateCodeRange(SystemInterlink *smi,
+		int32_t address, int32_t length)
 {
-	// swap endianness of reg
-	int32_t tempReg = ((smi->cacheControlReg << 24) & 0xFF000000) | 
-			((smi->cacheControlReg << 8) & 0xFF0000) | 
-			(logical_rshift(smi->cacheControlReg, 8) & 0xFF00) | 
-			(logical_rshift(smi->cacheControlReg, 24) & 0xFF);
-
-	return((tempReg & 0x800) == 0x800);
+	// Check each page in range
+	int64_t startAddress = address & 0xFFFFF000L;
+	int64_t endAddress = (address & 0xFFFFFFFFL) + length;
+	for (int64_t i = startAddress;
+			i < endAddress && i < PHILPSX_RAM_MIRROR_SPAN; i += 0x1000) {
+		if (smi->pageTable[i >> 12].containsCode) {
+			SystemInterlink_invalidateMirroredCode(smi, address, length);
+			break;
+		}
+	}
 }
 
 /*
- * This function lets us know whether or not an address should be incremented -
- * it is mainly useful for halfword accesses where each byte should come from
- * the same address.
+ * This function marks the RAM page containing the specified physical address
+ * as holding code cached by the CPU, so writes to it (through any mirror)
+ * invalidate that code.
  */
-bool SystemInterlink_okToIncrement(SystemInterlink *smi, int64_t address)
+void SystemInterlink_markCodePage(SystemInterlink *smi, int32_t address)
 {
-	return !(address >= 0x1F801800 && address <= 0x1F801803);
+	int32_t page = logical_rshift(address, 12) & 0x1FF;
+	for (int32_t i = 0; i < PHILPSX_RAM_MIRROR_SPAN >> 12; i += 0x200)
+		smi->pageTable[page + i].containsCode = true;
 }
 
 /*
@@ -453,7 +609,7 @@ int8_t SystemInterlink_readByte(SystemInterlink *smi, int32_t address)
 	int64_t tempAddress = address & 0xFFFFFFFFL;
 	int8_t retVal = 0;
 	
-	if (tempAddress >= 0L && tempAddress < 0x200000L) {
+	if (tempAddress >= 0L && tempAddress < PHILPSX_RAM_MIRROR_SPAN) {
 		// RAM
 		// Try to read RAM first
 		retVal = smi->ram[(int32_t)tempAddress];
@@ -462,6 +618,21 @@ int8_t SystemInterlink_readByte(SystemInterlink *smi, int32_t address)
 		// BIOS ROM
 		// Then try to read ROM
 		retVal = smi->bios[(int32_t)(tempAddress - 0x1FC00000L)];
+	}
+	else if (tempAddress >= 0x1F801000L && tempAddress < 0x1F802000L) {
+		// I/O Ports
+		// Read through the port's handlers, taking the byte from a word
+		// read if it has no byte handler
+		IOPort *port = &smi->ioPorts[(tempAddress - 0x1F801000L) >> 2];
+		if (port->handlers->readByte)
+			retVal = port->handlers->readByte(port->object, address);
+		else if (port->handlers->readWord)
+			retVal = (int8_t)logical_rshift(
+					port->handlers->readWord(
+					port->object,
+					address & 0xFFFFFFFC),
+					(address & 0x3) * 8
+					);
 	} else { // Everything else
 
 		if (tempAddress >= 0x1F000000L && tempAddress < 0x1F800000L) {
@@ -476,770 +647,43 @@ int8_t SystemInterlink_readByte(SystemInterlink *smi, int32_t address)
 				tempAddress -= 0x1F800000L;
 				retVal = smi->scratchpad[(int32_t)tempAddress];
 			}
-		}
-		else if (tempAddress >= 0x1F801000L && tempAddress < 0x1F802000L) {
-			// I/O Ports
-			if (tempAddress >= 0x1F801000L && tempAddress < 0x1F801004L) {
-				int32_t shift = (int32_t)(tempAddress & 0x3L);
-				switch (shift) {
-					case 0:
-						retVal = (int8_t)logical_rshift(
-								smi->expansion1BaseAddress,
-								24
-								);
-						break;
-					case 1:
-						retVal = (int8_t)logical_rshift(
-								smi->expansion1BaseAddress,
-								16
-								);
-						break;
-					case 2:
-						retVal = (int8_t)logical_rshift(
-								smi->expansion1BaseAddress,
-								8
-								);
-						break;
-					case 3:
-						retVal = (int8_t)smi->expansion1BaseAddress;
-						break;
-				}
-			}
-			else if (tempAddress >= 0x1F801004L && tempAddress < 0x1F801008L) {
-				int32_t shift = (int32_t)(tempAddress & 0x3L);
-				switch (shift) {
-					case 0:
-						retVal = (int8_t)logical_rshift(
-								smi->expansion2BaseAddress,
-								24
-								);
-						break;
-					case 1:
-						retVal = (int8_t)logical_rshift(
-								smi->expansion2BaseAddress,
-								16
-								);
-						break;
-					case 2:
-						retVal = (int8_t)logical_rshift(
-								smi->expansion2BaseAddress,
-								8
-								);
-						break;
-					case 3:
-						retVal = (int8_t)smi->expansion2BaseAddress;
-						break;
-				}
-			}
-			else if (tempAddress >= 0x1F801008L && tempAddress < 0x1F80100CL) {
-				int32_t shift = (int32_t)(tempAddress & 0x3L);
-				switch (shift) {
-					case 0:
-						retVal = (int8_t)logical_rshift(
-								smi->expansion1DelaySize,
-								24
-								);
-						break;
-					case 1:
-						retVal = (int8_t)logical_rshift(
-								smi->expansion1DelaySize,
-								16
-								);
-						break;
-					case 2:
-						retVal = (int8_t)logical_rshift(
-								smi->expansion1DelaySize,
-								8
-								);
-						break;
-					case 3:
-						retVal = (int8_t)smi->expansion1DelaySize;
-						break;
-				}
+		} // Expansion Region 2 (I/O Ports)
+		else if (tempAddress >= 0x1F802000L && tempAddress < 0x1F803000L) {
+			// Read from BIOS post register
+			if (tempAddress == 0x1F802041L) {
+				retVal = smi->biosPost;
 			}
-			else if (tempAddress >= 0x1F80100CL && tempAddress < 0x1F801010L) {
+		} // Expansion Region 3 (Multipurpose)
+		else if (tempAddress >= 0x1FA00000L && tempAddress < 0x1FC00000L) {
+			// Do nothing for now
+			;
+		} // I/O Ports (Cache Control)
+		else if (tempAddress >= 0xFFFE0000L && tempAddress < 0xFFFE0200L) {
+			// Cache Control Register
+			if (tempAddress >= 0xFFFE0130L && tempAddress < 0xFFFE0134L) {
 				int32_t shift = (int32_t)(tempAddress & 0x3L);
 				switch (shift) {
 					case 0:
-						retVal = (int8_t)logical_rshift(
-								smi->expansion3DelaySize,
-								24
-								);
+						retVal = (int8_t)smi->cacheControlReg;
 						break;
 					case 1:
 						retVal = (int8_t)logical_rshift(
-								smi->expansion3DelaySize,
-								16
-								);
-						break;
-					case 2:
-						retVal = (int8_t)logical_rshift(
-								smi->expansion3DelaySize,
+								smi->cacheControlReg,
 								8
 								);
 						break;
-					case 3:
-						retVal = (int8_t)smi->expansion3DelaySize;
-						break;
-				}
-			}
-			else if (tempAddress >= 0x1F801010L && tempAddress < 0x1F801014L) {
-				int32_t shift = (int32_t)(tempAddress & 0x3L);
-				switch (shift) {
-					case 0:
-						retVal = (int8_t)logical_rshift(
-								smi->biosRomDelaySize,
-								24
-								);
-						break;
-					case 1:
-						retVal = (int8_t)logical_rshift(
-								smi->biosRomDelaySize,
-								16
-								);
-						break;
 					case 2:
 						retVal = (int8_t)logical_rshift(
-								smi->biosRomDelaySize,
-								8
-								);
-						break;
-					case 3:
-						retVal = (int8_t)smi->biosRomDelaySize;
-						break;
-				}
-			}
-			else if (tempAddress >= 0x1F801014L && tempAddress < 0x1F801018L) {
-				int32_t shift = (int32_t)(tempAddress & 0x3L);
-				switch (shift) {
-					case 0:
-						retVal = (int8_t)logical_rshift(
-								smi->spuDelaySize,
-								24
-								);
-						break;
-					case 1:
-						retVal = (int8_t)logical_rshift(
-								smi->spuDelaySize,
+								smi->cacheControlReg,
 								16
 								);
 						break;
-					case 2:
-						retVal = (int8_t)logical_rshift(
-								smi->spuDelaySize,
-								8
-								);
-						break;
 					case 3:
-						retVal = (int8_t)smi->spuDelaySize;
-						break;
-				}
-			}
-			else if (tempAddress >= 0x1F801018L && tempAddress < 0x1F80101CL) {
-				int32_t shift = (int32_t)(tempAddress & 0x3L);
-				switch (shift) {
-					case 0:
 						retVal = (int8_t)logical_rshift(
-								smi->cdromDelaySize,
+								smi->cacheControlReg,
 								24
 								);
 						break;
-					case 1:
-						retVal = (int8_t)logical_rshift(
-								smi->cdromDelaySize,
-								16
-								);
-						break;
-					case 2:
-						retVal = (int8_t)logical_rshift(
-								smi->cdromDelaySize,
-								8
-								);
-						break;
-					case 3:
-						retVal = (int8_t)smi->cdromDelaySize;
-						break;
-				}
-			}
-			else if (tempAddress >= 0x1F80101CL && tempAddress < 0x1F801020L) {
-				int32_t shift = (int32_t)(tempAddress & 0x3L);
-				switch (shift) {
-					case 0:
-						retVal = (int8_t)logical_rshift(
-								smi->expansion2DelaySize,
-								24
-								);
-						break;
-					case 1:
-						retVal = (int8_t)logical_rshift(
-								smi->expansion2DelaySize,
-								16
-								);
-						break;
-					case 2:
-						retVal = (int8_t)logical_rshift(
-								smi->expansion2DelaySize,
-								8
-								);
-						break;
-					case 3:
-						retVal = (int8_t)smi->expansion2DelaySize;
-						break;
-				}
-			}
-			else if (tempAddress >= 0x1F801020L && tempAddress < 0x1F801024L) {
-				int32_t shift = (int32_t)(tempAddress & 0x3L);
-				switch (shift) {
-					case 0:
-						retVal = (int8_t)logical_rshift(
-								smi->commonDelay,
-								24
-								);
-						break;
-					case 1:
-						retVal = (int8_t)logical_rshift(
-								smi->commonDelay,
-								16
-								);
-						break;
-					case 2:
-						retVal = (int8_t)logical_rshift(
-								smi->commonDelay,
-								8
-								);
-						break;
-					case 3:
-						retVal = (int8_t)smi->commonDelay;
-						break;
-				}
-			}
-			else if (tempAddress >= 0x1F801040L && tempAddress < 0x1F801050L) {
-				// Read from ControllerIO object
-				retVal = ControllerIO_readByte(smi->cio, (int32_t)tempAddress);
-			}
-			else if (tempAddress >= 0x1F801060L && tempAddress < 0x1F801064L) {
-				int32_t shift = (int32_t)(tempAddress & 0x3L);
-				switch (shift) {
-					case 0:
-						retVal = (int8_t)logical_rshift(
-								smi->ramSize,
-								24
-								);
-						break;
-					case 1:
-						retVal = (int8_t)logical_rshift(
-								smi->ramSize,
-								16
-								);
-						break;
-					case 2:
-						retVal = (int8_t)logical_rshift(
-								smi->ramSize,
-								8
-								);
-						break;
-					case 3:
-						retVal = (int8_t)smi->ramSize;
-						break;
-				}
-			} // Interrupt Status Register
-			else if (tempAddress >= 0x1F801070L && tempAddress < 0x1F801074L) {
-				int32_t shift = (int32_t)(tempAddress & 0x3L);
-				switch (shift) {
-					case 0:
-						retVal = (int8_t)logical_rshift(
-								smi->interruptStatusReg,
-								24
-								);
-						break;
-					case 1:
-						retVal = (int8_t)logical_rshift(
-								smi->interruptStatusReg,
-								16
-								);
-						break;
-					case 2:
-						retVal = (int8_t)logical_rshift(
-								smi->interruptStatusReg,
-								8
-								);
-						break;
-					case 3:
-						retVal = (int8_t)smi->interruptStatusReg;
-						break;
-				}
-			} // Interrupt Mask Register
-			else if (tempAddress >= 0x1F801074L && tempAddress < 0x1F801078L) {
-				int32_t shift = (int32_t)(tempAddress & 0x3L);
-				switch (shift) {
-					case 0:
-						retVal = (int8_t)logical_rshift(
-								smi->interruptMaskReg,
-								24
-								);
-						break;
-					case 1:
-						retVal = (int8_t)logical_rshift(
-								smi->interruptMaskReg,
-								16
-								);
-						break;
-					case 2:
-						retVal = (int8_t)logical_rshift(
-								smi->interruptMaskReg,
-								8
-								);
-						break;
-					case 3:
-						retVal = (int8_t)smi->interruptMaskReg;
-						break;
-				}
-			}
-			else if (tempAddress >= 0x1F801080L && tempAddress < 0x1F801100L) {
-				retVal = DMAArbiter_readByte(smi->dma, address);
-			}
-			else if (tempAddress >= 0x1F801100L && tempAddress < 0x1F801104L) {
-				int32_t shift = (int32_t)(tempAddress & 0x3L);
-				switch (shift) {
-					case 0:
-						retVal = (int8_t)logical_rshift(
-								TimerModule_readCounterValue(
-								&smi->timerModule,
-								0),
-								24
-								);
-						break;
-					case 1:
-						retVal = (int8_t)logical_rshift(
-								TimerModule_readCounterValue(
-								&smi->timerModule,
-								0),
-								16
-								);
-						break;
-					case 2:
-						retVal = (int8_t)logical_rshift(
-								TimerModule_readCounterValue(
-								&smi->timerModule,
-								0),
-								8
-								);
-						break;
-					case 3:
-						retVal = (int8_t)TimerModule_readCounterValue(
-								&smi->timerModule,
-								0
-								);
-						break;
-				}
-			}
-			else if (tempAddress >= 0x1F801104L && tempAddress < 0x1F801108L) {
-				int32_t shift = (int32_t)(tempAddress & 0x3L);
-				switch (shift) {
-					case 0:
-						retVal = (int8_t)logical_rshift(
-								TimerModule_readMode(
-								&smi->timerModule,
-								0,
-								false),
-								24
-								);
-						break;
-					case 1:
-						retVal = (int8_t)logical_rshift(
-								TimerModule_readMode(
-								&smi->timerModule,
-								0,
-								false),
-								16
-								);
-						break;
-					case 2:
-						retVal = (int8_t)logical_rshift(
-								TimerModule_readMode(
-								&smi->timerModule,
-								0,
-								false),
-								8
-								);
-						break;
-					case 3:
-						retVal = (int8_t)TimerModule_readMode(
-								&smi->timerModule,
-								0,
-								false
-								);
-						break;
-				}
-			}
-			else if (tempAddress >= 0x1F801108L && tempAddress < 0x1F80110CL) {
-				int32_t shift = (int32_t)(tempAddress & 0x3L);
-				switch (shift) {
-					case 0:
-						retVal = (int8_t)logical_rshift(
-								TimerModule_readTargetValue(
-								&smi->timerModule,
-								0),
-								24
-								);
-						break;
-					case 1:
-						retVal = (int8_t)logical_rshift(
-								TimerModule_readTargetValue(
-								&smi->timerModule,
-								0),
-								16
-								);
-						break;
-					case 2:
-						retVal = (int8_t)logical_rshift(
-								TimerModule_readTargetValue(
-								&smi->timerModule,
-								0),
-								8
-								);
-						break;
-					case 3:
-						retVal = (int8_t)TimerModule_readTargetValue(
-								&smi->timerModule,
-								0
-								);
-						break;
-				}
-			}
-			else if (tempAddress >= 0x1F801110L && tempAddress < 0x1F801114L) {
-				int32_t shift = (int32_t)(tempAddress & 0x3L);
-				switch (shift) {
-					case 0:
-						retVal = (int8_t)logical_rshift(
-								TimerModule_readCounterValue(
-								&smi->timerModule,
-								1),
-								24
-								);
-						break;
-					case 1:
-						retVal = (int8_t)logical_rshift(
-								TimerModule_readCounterValue(
-								&smi->timerModule,
-								1),
-								16
-								);
-						break;
-					case 2:
-						retVal = (int8_t)logical_rshift(
-								TimerModule_readCounterValue(
-								&smi->timerModule,
-								1),
-								8
-								);
-						break;
-					case 3:
-						retVal = (int8_t)TimerModule_readCounterValue(
-								&smi->timerModule,
-								1
-								);
-						break;
-				}
-			}
-			else if (tempAddress >= 0x1F801114L && tempAddress < 0x1F801118L) {
-				int32_t shift = (int32_t)(tempAddress & 0x3L);
-				switch (shift) {
-					case 0:
-						retVal = (int8_t)logical_rshift(
-								TimerModule_readMode(
-								&smi->timerModule,
-								1,
-								false),
-								24
-								);
-						break;
-					case 1:
-						retVal = (int8_t)logical_rshift(
-								TimerModule_readMode(
-								&smi->timerModule,
-								1,
-								false),
-								16
-								);
-						break;
-					case 2:
-						retVal = (int8_t)logical_rshift(
-								TimerModule_readMode(
-								&smi->timerModule,
-								1,
-								false),
-								8
-								);
-						break;
-					case 3:
-						retVal = (int8_t)TimerModule_readMode(
-								&smi->timerModule,
-								1,
-								false
-								);
-						break;
-				}
-			}
-			else if (tempAddress >= 0x1F801118L && tempAddress < 0x1F80111CL) {
-				int32_t shift = (int32_t)(tempAddress & 0x3L);
-				switch (shift) {
-					case 0:
-						retVal = (int8_t)logical_rshift(
-								TimerModule_readTargetValue(
-								&smi->timerModule,
-								1),
-								24
-								);
-						break;
-					case 1:
-						retVal = (int8_t)logical_rshift(
-								TimerModule_readTargetValue(
-								&smi->timerModule,
-								1),
-								16
-								);
-						break;
-					case 2:
-						retVal = (int8_t)logical_rshift(
-								TimerModule_readTargetValue(
-								&smi->timerModule,
-								1),
-								8
-								);
-						break;
-					case 3:
-						retVal = (int8_t)TimerModule_readTargetValue(
-								&smi->timerModule,
-								1
-								);
-						break;
-				}
-			}
-			else if (tempAddress >= 0x1F801120L && tempAddress < 0x1F801124L) {
-				int32_t shift = (int32_t)(tempAddress & 0x3L);
-				switch (shift) {
-					case 0:
-						retVal = (int8_t)logical_rshift(
-								TimerModule_readCounterValue(
-								&smi->timerModule,
-								2),
-								24
-								);
-						break;
-					case 1:
-						retVal = (int8_t)logical_rshift(
-								TimerModule_readCounterValue(
-								&smi->timerModule,
-								2),
-								16
-								);
-						break;
-					case 2:
-						retVal = (int8_t)logical_rshift(
-								TimerModule_readCounterValue(
-								&smi->timerModule,
-								2),
-								8
-								);
-						break;
-					case 3:
-						retVal = (int8_t)TimerModule_readCounterValue(
-								&smi->timerModule,
-								2
-								);
-						break;
-				}
-			}
-			else if (tempAddress >= 0x1F801124L && tempAddress < 0x1F801128L) {
-				int32_t shift = (int32_t)(tempAddress & 0x3L);
-				switch (shift) {
-					case 0:
-						retVal = (int8_t)logical_rshift(
-								TimerModule_readMode(
-								&smi->timerModule,
-								2,
-								false),
-								24
-								);
-						break;
-					case 1:
-						retVal = (int8_t)logical_rshift(
-								TimerModule_readMode(
-								&smi->timerModule,
-								2,
-								false),
-								16
-								);
-						break;
-					case 2:
-						retVal = (int8_t)logical_rshift(
-								TimerModule_readMode(
-								&smi->timerModule,
-								2,
-								false),
-								8
-								);
-						break;
-					case 3:
-						retVal = (int8_t)TimerModule_readMode(
-								&smi->timerModule,
-								2,
-								false
-								);
-						break;
-				}
-			}
-			else if (tempAddress >= 0x1F801128L && tempAddress < 0x1F80112CL) {
-				int32_t shift = (int32_t)(tempAddress & 0x3L);
-				switch (shift) {
-					case 0:
-						retVal = (int8_t)logical_rshift(
-								TimerModule_readTargetValue(
-								&smi->timerModule,
-								2),
-								24
-								);
-						break;
-					case 1:
-						retVal = (int8_t)logical_rshift(
-								TimerModule_readTargetValue(
-								&smi->timerModule,
-								2),
-								16
-								);
-						break;
-					case 2:
-						retVal = (int8_t)logical_rshift(
-								TimerModule_readTargetValue(
-								&smi->timerModule,
-								2),
-								8
-								);
-						break;
-					case 3:
-						retVal = (int8_t)TimerModule_readTargetValue(
-								&smi->timerModule,
-								2
-								);
-						break;
-				}
-			}
-			else if (tempAddress >= 0x1F801810L && tempAddress < 0x1F801814L) {
-				int32_t shift = (int32_t)(tempAddress & 0x3L);
-				switch (shift) {
-					case 0:
-						retVal = (int8_t)logical_rshift(
-								GPU_readResponse(
-								smi->gpu),
-								24
-								);
-						break;
-					case 1:
-						retVal = (int8_t)logical_rshift(
-								GPU_readResponse(
-								smi->gpu),
-								16
-								);
-						break;
-					case 2:
-						retVal = (int8_t)logical_rshift(
-								GPU_readResponse(
-								smi->gpu),
-								8
-								);
-						break;
-					case 3:
-						retVal = (int8_t)GPU_readResponse(smi->gpu);
-						break;
-				}
-			}
-			else if (tempAddress >= 0x1F801814L && tempAddress < 0x1F801818L) {
-				int32_t shift = (int32_t)(tempAddress & 0x3L);
-				switch (shift) {
-					case 0:
-						retVal = (int8_t)logical_rshift(
-								GPU_readStatus(
-								smi->gpu),
-								24
-								);
-						break;
-					case 1:
-						retVal = (int8_t)logical_rshift(
-								GPU_readStatus(
-								smi->gpu),
-								16
-								);
-						break;
-					case 2:
-						retVal = (int8_t)logical_rshift(
-								GPU_readStatus(
-								smi->gpu),
-								8
-								);
-						break;
-					case 3:
-						retVal = (int8_t)GPU_readStatus(smi->gpu);
-						break;
-				}
-			} // CD-ROM
-			else if (tempAddress >= 0x1F801800L && tempAddress < 0x1F801804L) {
-				switch ((int32_t)tempAddress & 0xF) {
-					case 0:
-						retVal = CDROMDrive_read1800(smi->cdrom);
-						break;
-					case 1:
-						retVal = CDROMDrive_read1801(smi->cdrom);
-						break;
-					case 2:
-						retVal = CDROMDrive_read1802(smi->cdrom);
-						break;
-					case 3:
-						retVal = CDROMDrive_read1803(smi->cdrom);
-						break;
-				}
-			}
-			else if (tempAddress >= 0x1F801C00L && tempAddress < 0x1F802000L) {
-				// Fake SPU read
-				retVal = SPU_readByte(smi->spu, address);
-			}
-		} // Expansion Region 2 (I/O Ports)
-		else if (tempAddress >= 0x1F802000L && tempAddress < 0x1F803000L) {
-			// Read from BIOS post register
-			if (tempAddress == 0x1F802041L) {
-				retVal = smi->biosPost;
-			}
-		} // Expansion Region 3 (Multipurpose)
-		else if (tempAddress >= 0x1FA00000L && tempAddress < 0x1FC00000L) {
-			// Do nothing for now
-			;
-		} // I/O Ports (Cache Control)
-		else if (tempAddress >= 0xFFFE0000L && tempAddress < 0xFFFE0200L) {
-			// Cache Control Register
-			if (tempAddress >= 0xFFFE0130L && tempAddress < 0xFFFE0134L) {
-				int32_t shift = (int32_t)(tempAddress & 0x3L);
-				switch (shift) {
-					case 0:
-						retVal = (int8_t)logical_rshift(
-								smi->cacheControlReg,
-								24
-								);
-						break;
-					case 1:
-						retVal = (int8_t)logical_rshift(
-								smi->cacheControlReg,
-								16
-								);
-						break;
-					case 2:
-						retVal = (int8_t)logical_rshift(
-								smi->cacheControlReg,
-								8
-								);
-						break;
-					case 3:
-						retVal = (int8_t)smi->cacheControlReg;
-						break;
 				}
 			}
 		}
@@ -1248,6 +692,55 @@ int8_t SystemInterlink_readByte(SystemInterlink *smi, int32_t address)
 	return retVal;
 }
 
+/*
+ * This reads a halfword from the correct area depending on the address.
+ */
+int16_t SystemInterlink_readHalfword(SystemInterlink *smi, int32_t address)
+{
+	int64_t tempAddress = address & 0xFFFFFFFEL;
+	address = (int32_t)tempAddress;
+	int16_t retVal = 0;
+
+	// Handle RAM directly rather than going to readByte method
+	if (tempAddress >= 0L && tempAddress < PHILPSX_RAM_MIRROR_SPAN) {
+		memcpy(&retVal, smi->ram + address, 2);
+	} // Handle ROM directly rather than going to readByte method
+	else if (tempAddress >= 0x1FC00000L && tempAddress < 0x1FC80000L) {
+		memcpy(&retVal, smi->bios + (address - 0x1FC00000), 2);
+	} // Handle scratchpad directly rather than going to readByte method
+	else if (tempAddress >= 0x1F800000L && tempAddress < 0x1F800400L) {
+		if (SystemInterlink_scratchpadEnabled(smi))
+			memcpy(&retVal, smi->scratchpad + (address - 0x1F800000), 2);
+	} // Handle I/O ports through their handlers, taking the halfword from a
+	// word read or splitting it into bytes if the port has no halfword
+	// handler
+	else if (tempAddress >= 0x1F801000L && tempAddress < 0x1F802000L) {
+		IOPort *port = &smi->ioPorts[(address - 0x1F801000) >> 2];
+		if (port->handlers->readHalfword) {
+			retVal = port->handlers->readHalfword(port->object, address);
+		} else if (port->handlers->readWord) {
+			retVal = (int16_t)logical_rshift(
+					port->handlers->readWord(
+					port->object,
+					address & 0xFFFFFFFC),
+					(address & 0x2) * 8
+					);
+		} else if (port->handlers->readByte) {
+			retVal = port->handlers->readByte(
+					port->object, address) & 0xFF;
+			retVal |= (port->handlers->readByte(
+					port->object, address + 1) & 0xFF) << 8;
+		}
+	} // Handle everything else
+	else {
+		// Use readByte method to read two bytes
+		retVal = SystemInterlink_readByte(smi, address) & 0xFF;
+		retVal |= (SystemInterlink_readByte(smi, address + 1) & 0xFF) << 8;
+	}
+
+	return retVal;
+}
+
 /*
  * This function reads the interrupt status.
  */
@@ -1266,242 +759,50 @@ int32_t SystemInterlink_readWord(SystemInterlink *smi, int32_t address)
 	int32_t retVal = 0;
 
 	// Handle RAM directly rather than going to readByte method
-	if (tempAddress >= 0L && tempAddress < 0x200000L) {
-		retVal = (smi->ram[address] & 0xFF) << 24 |
-				(smi->ram[address + 1] & 0xFF) << 16 |
-				(smi->ram[address + 2] & 0xFF) << 8 |
-				(smi->ram[address + 3] & 0xFF);
+	if (tempAddress >= 0L && tempAddress < PHILPSX_RAM_MIRROR_SPAN) {
+		memcpy(&retVal, smi->ram + address, 4);
 	} // Handle ROM directly rather than going to readByte method
 	else if (tempAddress >= 0x1FC00000L && tempAddress < 0x1FC80000L) {
-		address -= 0x1FC00000;
-		retVal = (smi->bios[address] & 0xFF) << 24 |
-				(smi->bios[address + 1] & 0xFF) << 16 |
-				(smi->bios[address + 2] & 0xFF) << 8 |
-				(smi->bios[address + 3] & 0xFF);
+		memcpy(&retVal, smi->bios + (address - 0x1FC00000), 4);
+	} // Handle scratchpad directly rather than going to readByte method
+	else if (tempAddress >= 0x1F800000L && tempAddress < 0x1F800400L) {
+		if (SystemInterlink_scratchpadEnabled(smi))
+			memcpy(&retVal, smi->scratchpad + (address - 0x1F800000), 4);
+	} // Handle I/O ports through their handlers, splitting the read into
+	// halfwords or bytes if the port has no word handler
+	else if (tempAddress >= 0x1F801000L && tempAddress < 0x1F802000L) {
+		IOPort *port = &smi->ioPorts[(address - 0x1F801000) >> 2];
+		if (port->handlers->readWord) {
+			retVal = port->handlers->readWord(port->object, address);
+		} else if (port->handlers->readHalfword) {
+			retVal = port->handlers->readHalfword(
+					port->object, address) & 0xFFFF;
+			retVal |= port->handlers->readHalfword(
+					port->object, address + 2) << 16;
+		} else if (port->handlers->readByte) {
+			for (int32_t i = 0; i < 4; ++i)
+				retVal |= (port->handlers->readByte(
+						port->object, address + i) & 0xFF) << (i * 8);
+		}
 	} // Handle everything else
 	else {
 		switch (address) {
-			case 0x1F801070:
-				retVal = smi->interruptStatusReg;
-				break;
-			case 0x1F801074:
-				retVal = smi->interruptMaskReg;
-				break;
 			case 0xFFFE0130:
 				retVal = smi->cacheControlReg;
 				break;
-			case 0x1F801080:
-			case 0x1F801081:
-			case 0x1F801082:
-			case 0x1F801083:
-			case 0x1F801084:
-			case 0x1F801085:
-			case 0x1F801086:
-			case 0x1F801087:
-			case 0x1F801088:
-			case 0x1F801089:
-			case 0x1F80108A:
-			case 0x1F80108B:
-			case 0x1F80108C:
-			case 0x1F80108D:
-			case 0x1F80108E:
-			case 0x1F80108F:
-			case 0x1F801090:
-			case 0x1F801091:
-			case 0x1F801092:
-			case 0x1F801093:
-			case 0x1F801094:
-			case 0x1F801095:
-			case 0x1F801096:
-			case 0x1F801097:
-			case 0x1F801098:
-			case 0x1F801099:
-			case 0x1F80109A:
-			case 0x1F80109B:
-			case 0x1F80109C:
-			case 0x1F80109D:
-			case 0x1F80109E:
-			case 0x1F80109F:
-			case 0x1F8010A0:
-			case 0x1F8010A1:
-			case 0x1F8010A2:
-			case 0x1F8010A3:
-			case 0x1F8010A4:
-			case 0x1F8010A5:
-			case 0x1F8010A6:
-			case 0x1F8010A7:
-			case 0x1F8010A8:
-			case 0x1F8010A9:
-			case 0x1F8010AA:
-			case 0x1F8010AB:
-			case 0x1F8010AC:
-			case 0x1F8010AD:
-			case 0x1F8010AE:
-			case 0x1F8010AF:
-			case 0x1F8010B0:
-			case 0x1F8010B1:
-			case 0x1F8010B2:
-			case 0x1F8010B3:
-			case 0x1F8010B4:
-			case 0x1F8010B5:
-			case 0x1F8010B6:
-			case 0x1F8010B7:
-			case 0x1F8010B8:
-			case 0x1F8010B9:
-			case 0x1F8010BA:
-			case 0x1F8010BB:
-			case 0x1F8010BC:
-			case 0x1F8010BD:
-			case 0x1F8010BE:
-			case 0x1F8010BF:
-			case 0x1F8010C0:
-			case 0x1F8010C1:
-			case 0x1F8010C2:
-			case 0x1F8010C3:
-			case 0x1F8010C4:
-			case 0x1F8010C5:
-			case 0x1F8010C6:
-			case 0x1F8010C7:
-			case 0x1F8010C8:
-			case 0x1F8010C9:
-			case 0x1F8010CA:
-			case 0x1F8010CB:
-			case 0x1F8010CC:
-			case 0x1F8010CD:
-			case 0x1F8010CE:
-			case 0x1F8010CF:
-			case 0x1F8010D0:
-			case 0x1F8010D1:
-			case 0x1F8010D2:
-			case 0x1F8010D3:
-			case 0x1F8010D4:
-			case 0x1F8010D5:
-			case 0x1F8010D6:
-			case 0x1F8010D7:
-			case 0x1F8010D8:
-			case 0x1F8010D9:
-			case 0x1F8010DA:
-			case 0x1F8010DB:
-			case 0x1F8010DC:
-			case 0x1F8010DD:
-			case 0x1F8010DE:
-			case 0x1F8010DF:
-			case 0x1F8010E0:
-			case 0x1F8010E1:
-			case 0x1F8010E2:
-			case 0x1F8010E3:
-			case 0x1F8010E4:
-			case 0x1F8010E5:
-			case 0x1F8010E6:
-			case 0x1F8010E7:
-			case 0x1F8010E8:
-			case 0x1F8010E9:
-			case 0x1F8010EA:
-			case 0x1F8010EB:
-			case 0x1F8010EC:
-			case 0x1F8010ED:
-			case 0x1F8010EE:
-			case 0x1F8010EF:
-			case 0x1F8010F0:
-			case 0x1F8010F1:
-			case 0x1F8010F2:
-			case 0x1F8010F3:
-			case 0x1F8010F4:
-			case 0x1F8010F5:
-			case 0x1F8010F6:
-			case 0x1F8010F7:
-			case 0x1F8010F8:
-			case 0x1F8010F9:
-			case 0x1F8010FA:
-			case 0x1F8010FB:
-			case 0x1F8010FC:
-			case 0x1F8010FD:
-			case 0x1F8010FE:
-			case 0x1F8010FF:
-				retVal = DMAArbiter_readWord(smi->dma, address);
-				break;
-			case 0x1F801100:
-				retVal = TimerModule_readCounterValue(&smi->timerModule, 0);
-				break;
-			case 0x1F801104:
-				retVal = TimerModule_readMode(&smi->timerModule, 0, false);
-				break;
-			case 0x1F801108:
-				retVal = TimerModule_readTargetValue(&smi->timerModule, 0);
-				break;
-			case 0x1F801110:
-				retVal = TimerModule_readCounterValue(&smi->timerModule, 1);
-				break;
-			case 0x1F801114:
-				retVal = TimerModule_readMode(&smi->timerModule, 1, false);
-				break;
-			case 0x1F801118:
-				retVal = TimerModule_readTargetValue(&smi->timerModule, 1);
-				break;
-			case 0x1F801120:
-				retVal = TimerModule_readCounterValue(&smi->timerModule, 2);
-				break;
-			case 0x1F801124:
-				retVal = TimerModule_readMode(&smi->timerModule, 2, false);
-				break;
-			case 0x1F801128:
-				retVal = TimerModule_readTargetValue(&smi->timerModule, 2);
-				break;
-			case 0x1F801000:
-				retVal = smi->expansion1BaseAddress;
-				break;
-			case 0x1F801004:
-				retVal = smi->expansion2BaseAddress;
-				break;
-			case 0x1F801008:
-				retVal = smi->expansion1DelaySize;
-				break;
-			case 0x1F80100C:
-				retVal = smi->expansion3DelaySize;
-				break;
-			case 0x1F801010:
-				retVal = smi->biosRomDelaySize;
-				break;
-			case 0x1F801014:
-				retVal = smi->spuDelaySize;
-				break;
-			case 0x1F801018:
-				retVal = smi->cdromDelaySize;
-				break;
-			case 0x1F80101C:
-				retVal = smi->expansion2DelaySize;
-				break;
-			case 0x1F801020:
-				retVal = smi->commonDelay;
-				break;
-			case 0x1F801060:
-				retVal = smi->ramSize;
-				break;
-			case 0x1F801810:
-				retVal = GPU_readResponse(smi->gpu);
-				break;
-			case 0x1F801814:
-				retVal = GPU_readStatus(smi->gpu);
-				break;
-			case 0x1F801800:
-			case 0x1F801801:
-			case 0x1F801802:
-			case 0x1F801803:
-				// Do nothing as we don't allow word reads from CD-ROM range
-				break;
 			default:
 				// Use readByte method to read four bytes
-				retVal = (SystemInterlink_readByte(
-						smi, (int32_t)tempAddress) & 0xFF) << 24;
+				retVal = SystemInterlink_readByte(
+						smi, (int32_t)tempAddress) & 0xFF;
 				++tempAddress;
 				retVal |= (SystemInterlink_readByte(
-						smi, (int32_t)tempAddress) & 0xFF) << 16;
+						smi, (int32_t)tempAddress) & 0xFF) << 8;
 				++tempAddress;
 				retVal |= (SystemInterlink_readByte(
-						smi, (int32_t)tempAddress) & 0xFF) << 8;
+						smi, (int32_t)tempAddress) & 0xFF) << 16;
 				++tempAddress;
-				retVal |= SystemInterlink_readByte(
-						smi, (int32_t)tempAddress) & 0xFF;
+				retVal |= (SystemInterlink_readByte(
+						smi, (int32_t)tempAddress) & 0xFF) << 24;
 				break;
 		}
 	}
@@ -1509,36 +810,23 @@ int32_t SystemInterlink_readWord(SystemInterlink *smi, int32_t address)
 	return retVal;
 }
 
-/*
- * This function syncs all timers up to the current point.
- */
-void SystemInterlink_resyncAllTimers(SystemInterlink *smi)
-{
-	TimerModule_resync(&smi->timerModule);
-}
-
 /*
  * This tests the cache control register to see if scratchpad is enabled.
  */
 bool SystemInterlink_scratchpadEnabled(SystemInterlink *smi)
 {
-	// Swap endianness of reg
-	int32_t tempReg = ((smi->cacheControlReg << 24) & 0xFF000000) |
-			((smi->cacheControlReg << 8) & 0xFF0000) |
-			(logical_rshift(smi->cacheControlReg, 8) & 0xFF00) |
-			(logical_rshift(smi->cacheControlReg, 24) & 0xFF);
-
-	return ((tempReg & 0x88) == 0x88);
+	return (smi->cacheControlReg & 0x88) == 0x88;
 }
 
 /*
- * This sets the CD-ROM interrupt delay.
+ * This sets the CD-ROM interrupt delay, scheduling the interrupt to trigger
+ * once more than delay cycles have passed.
  */
 void SystemInterlink_setCDROMInterruptDelay(SystemInterlink *smi,
 		int32_t delay)
 {
-	smi->cdromInterruptDelay = delay;
-	smi->cdromInterruptCounter = 0;
+	Scheduler_scheduleEvent(smi->scheduler, PHILPSX_EVENT_CDROM_INTERRUPT,
+			Scheduler_getCycles(smi->scheduler) + delay + 1);
 }
 
 /*
@@ -1583,15 +871,17 @@ void SystemInterlink_setControllerIO(SystemInterlink *smi,
 void SystemInterlink_setCpu(SystemInterlink *smi, R3051 *cpu)
 {
 	smi->cpu = cpu;
+	SystemInterlink_updateInterruptLine(smi);
 }
 
 /*
- * This sets the DMA interrupt delay.
+ * This sets the DMA interrupt delay, scheduling the interrupt to trigger
+ * once more than delay cycles have passed.
  */
 void SystemInterlink_setDMAInterruptDelay(SystemInterlink *smi, int32_t delay)
 {
-	smi->dmaInterruptDelay = delay;
-	smi->dmaInterruptCounter = 0;
+	Scheduler_scheduleEvent(smi->scheduler, PHILPSX_EVENT_DMA_INTERRUPT,
+			Scheduler_getCycles(smi->scheduler) + delay + 1);
 }
 
 /*
@@ -1603,12 +893,13 @@ void SystemInterlink_setDma(SystemInterlink *smi, DMAArbiter *dma)
 }
 
 /*
- * This sets the GPU interrupt delay.
+ * This sets the GPU interrupt delay, scheduling the interrupt to trigger
+ * once more than delay cycles have passed.
  */
 void SystemInterlink_setGPUInterruptDelay(SystemInterlink *smi, int32_t delay)
 {
-	smi->gpuInterruptDelay = delay;
-	smi->gpuInterruptCounter = 0;
+	Scheduler_scheduleEvent(smi->scheduler, PHILPSX_EVENT_GPU_INTERRUPT,
+			Scheduler_getCycles(smi->scheduler) + delay + 1);
 }
 
 /*
@@ -1619,6 +910,32 @@ void SystemInterlink_setGpu(SystemInterlink *smi, GPU *gpu)
 	smi->gpu = gpu;
 }
 
+/*
+ * This function registers the handlers for the I/O ports covering length
+ * bytes from the specified address, which must be word aligned and lie
+ * between 0x1F801000 and 0x1F801FFF. The handlers are called with object as
+ * their first argument.
+ */
+void SystemInterlink_setIOPortHandlers(SystemInterlink *smi, int32_t address,
+		int32_t length, const IOPortHandlers *handlers, void *object)
+{
+	int32_t firstPort = (address - 0x1F801000) >> 2;
+	int32_t lastPort = (address - 0x1F801000 + length - 1) >> 2;
+	for (int32_t i = firstPort; i <= lastPort; ++i) {
+		smi->ioPorts[i].handlers = handlers;
+		smi->ioPorts[i].object = object;
+	}
+}
+
+/*
+ * This sets the profiler reference to that supplied by the argument, which
+ * may be NULL to disable profiling.
+ */
+void SystemInterlink_setProfiler(SystemInterlink *smi, Profiler *profiler)
+{
+	smi->profiler = profiler;
+}
+
 /*
  * This sets the SPU reference to that supplied by the argument.
  */
@@ -1632,13 +949,22 @@ void SystemInterlink_setSpu(SystemInterlink *smi, SPU *spu)
  */
 bool SystemInterlink_tagTestEnabled(SystemInterlink *smi)
 {
-	// Swap endianness of reg
-	int32_t tempReg = ((smi->cacheControlReg << 24) & 0xFF000000) |
-			((smi->cacheControlReg << 8) & 0xFF0000) |
-			(logical_rshift(smi->cacheControlReg, 8) & 0xFF00) |
-			(logical_rshift(smi->cacheControlReg, 24) & 0xFF);
+	return (smi->cacheControlReg & 0x4) == 0x4;
+}
 
-	return ((tempReg & 0x4) == 0x4);
+/*
+ * This function brings the timers up to date and works out how fast their
+ * clock sources tick again. It must be called whenever the GPU changes the
+ * speed of the dotclock, which also moves the start of hblank.
+ */
+void SystemInterlink_updateTimerClocks(SystemInterlink *smi)
+{
+	for (int32_t i = 0; i < 3; ++i) {
+		TimerModule_advance(&smi->timerModule, i);
+		TimerModule_updateClock(&smi->timerModule, i);
+		TimerModule_updateDeadline(&smi->timerModule, i);
+	}
+	TimerModule_scheduleEvent(&smi->timerModule);
 }
 
 /*
@@ -1650,8 +976,11 @@ void SystemInterlink_writeByte(SystemInterlink *smi, int32_t address,
 	int64_t tempAddress = address & 0xFFFFFFFFL;
 
 	// RAM
-	if (tempAddress >= 0L && tempAddress < 0x200000L) {
+	if (tempAddress >= 0L && tempAddress < PHILPSX_RAM_MIRROR_SPAN) {
 		smi->ram[(int32_t)tempAddress] = value;
+		if (smi->pageTable[tempAddress >> 12].containsCode)
+			SystemInterlink_invalidateMirroredCode(smi,
+					(int32_t)tempAddress, 1);
 	} // Expansion Region 1
 	else if (tempAddress >= 0x1F000000L && tempAddress < 0x1F800000L) {
 		// Do nothing for now
@@ -1665,386 +994,10 @@ void SystemInterlink_writeByte(SystemInterlink *smi, int32_t address,
 		}
 	} // I/O Ports
 	else if (tempAddress >= 0x1F801000L && tempAddress < 0x1F802000L) {
-		if (tempAddress >= 0x1F801000L && tempAddress < 0x1F801004L) {
-			int32_t shift = (int32_t)(tempAddress & 0x3L);
-			switch (shift) {
-				case 0:
-					smi->expansion1BaseAddress = (value & 0xFF) << 24;
-					break;
-				case 1:
-					smi->expansion1BaseAddress =
-							(smi->expansion1BaseAddress & 0xFF000000) |
-							((value & 0xFF) << 16);
-					break;
-			}
-		}
-		else if (tempAddress >= 0x1F801004L && tempAddress < 0x1F801008L) {
-			int32_t shift = (int32_t)(tempAddress & 0x3L);
-			switch (shift) {
-				case 0:
-					smi->expansion2BaseAddress = (value & 0xFF) << 24;
-					break;
-				case 1:
-					smi->expansion2BaseAddress =
-							(smi->expansion2BaseAddress & 0xFF000000) |
-							((value & 0xFF) << 16);
-					break;
-			}
-		}
-		else if (tempAddress >= 0x1F801008L && tempAddress < 0x1F80100CL) {
-			int32_t shift = (int32_t)(tempAddress & 0x3L);
-			switch (shift) {
-				case 0:
-					smi->expansion1DelaySize = (value & 0xFF) << 24;
-					break;
-				case 1:
-					smi->expansion1DelaySize =
-							(smi->expansion1DelaySize & 0xFF000000) |
-							((value & 0xFF) << 16);
-					break;
-			}
-		}
-		else if (tempAddress >= 0x1F80100CL && tempAddress < 0x1F801010L) {
-			int32_t shift = (int32_t)(tempAddress & 0x3L);
-			switch (shift) {
-				case 0:
-					smi->expansion3DelaySize = (value & 0xFF) << 24;
-					break;
-				case 1:
-					smi->expansion3DelaySize =
-							(smi->expansion3DelaySize & 0xFF000000) |
-							((value & 0xFF) << 16);
-					break;
-			}
-		}
-		else if (tempAddress >= 0x1F801010L && tempAddress < 0x1F801014L) {
-			int32_t shift = (int32_t)(tempAddress & 0x3L);
-			switch (shift) {
-				case 0:
-					smi->biosRomDelaySize = (value & 0xFF) << 24;
-					break;
-				case 1:
-					smi->biosRomDelaySize =
-							(smi->biosRomDelaySize & 0xFF000000) |
-							((value & 0xFF) << 16);
-					break;
-			}
-		}
-		else if (tempAddress >= 0x1F801014L && tempAddress < 0x1F801018L) {
-			int32_t shift = (int32_t)(tempAddress & 0x3L);
-			switch (shift) {
-				case 0:
-					smi->spuDelaySize = (value & 0xFF) << 24;
-					break;
-				case 1:
-					smi->spuDelaySize =
-							(smi->spuDelaySize & 0xFF000000) |
-							((value & 0xFF) << 16);
-					break;
-			}
-		}
-		else if (tempAddress >= 0x1F801018L && tempAddress < 0x1F80101CL) {
-			int32_t shift = (int32_t)(tempAddress & 0x3L);
-			switch (shift) {
-				case 0:
-					smi->cdromDelaySize = (value & 0xFF) << 24;
-					break;
-				case 1:
-					smi->cdromDelaySize =
-							(smi->cdromDelaySize & 0xFF000000) |
-							((value & 0xFF) << 16);
-					break;
-			}
-		}
-		else if (tempAddress >= 0x1F80101CL && tempAddress < 0x1F801020L) {
-			int32_t shift = (int32_t)(tempAddress & 0x3L);
-			switch (shift) {
-				case 0:
-					smi->expansion2DelaySize = (value & 0xFF) << 24;
-					break;
-				case 1:
-					smi->expansion2DelaySize =
-							(smi->expansion2DelaySize & 0xFF000000) |
-							((value & 0xFF) << 16);
-					break;
-			}
-		}
-		else if (tempAddress >= 0x1F801020L && tempAddress < 0x1F801024L) {
-			int32_t shift = (int32_t)(tempAddress & 0x3L);
-			switch (shift) {
-				case 0:
-					smi->commonDelay = (value & 0xFF) << 24;
-					break;
-				case 1:
-					smi->commonDelay =
-							(smi->commonDelay & 0xFF000000) |
-							((value & 0xFF) << 16);
-					break;
-			}
-		}
-		else if (tempAddress >= 0x1F801040L && tempAddress < 0x1F801050L) {
-			// Write to ControllerIO object
-			ControllerIO_writeByte(smi->cio, (int32_t)tempAddress, value);
-		}
-		else if (tempAddress >= 0x1F801060L && tempAddress < 0x1F801064L) {
-			int32_t shift = (int32_t)(tempAddress & 0x3L);
-			switch (shift) {
-				case 0:
-					smi->ramSize = (value & 0xFF) << 24;
-					break;
-				case 1:
-					smi->ramSize =
-							(smi->ramSize & 0xFF000000) |
-							((value & 0xFF) << 16);
-					break;
-			}
-		} // Interrupt Status Register
-		else if (tempAddress >= 0x1F801070L && tempAddress < 0x1F801074L) {
-			int32_t shift = (int32_t)(tempAddress & 0x3L);
-			switch (shift) {
-				case 0:
-					// Mask first byte
-					smi->interruptStatusReg &=
-							((value & 0xFF) << 24) |
-							(smi->interruptStatusReg & 0xFF0000);
-					break;
-				case 1:
-					// Mask second byte
-					smi->interruptStatusReg &=
-							(smi->interruptStatusReg & 0xFF000000) |
-							((value & 0xFF) << 16);
-					break;
-			}
-		} // Interrupt Mask Register
-		else if (tempAddress >= 0x1F801074L && tempAddress < 0x1F801078L) {
-			int32_t shift = (int32_t)(tempAddress & 0x3L);
-			switch (shift) {
-				case 0:
-					// Write full 32-bits, with zeroes for remaining
-					// three bytes
-					smi->interruptMaskReg = (value & 0xFF) << 24;
-					break;
-				case 1:
-					// Keep first byte of interrupt mask, merge with this
-					// one, and set last two to zeroes
-					smi->interruptMaskReg =
-							(smi->interruptMaskReg & 0xFF000000) |
-							((value & 0xFF) << 16);
-					break;
-			}
-		}
-		else if (tempAddress >= 0x1F801080L && tempAddress < 0x1F801100L) {
-			DMAArbiter_writeByte(smi->dma, address, value);
-		}
-		else if (tempAddress >= 0x1F801100L && tempAddress < 0x1F801104L) {
-			int32_t shift = (int32_t)(tempAddress & 0x3L);
-			switch (shift) {
-				case 0:
-					TimerModule_writeCounterValue(
-							&smi->timerModule,
-							0,
-							(value & 0xFF) << 24
-							);
-					break;
-				case 1:
-					TimerModule_writeCounterValue(
-							&smi->timerModule,
-							0,
-							(TimerModule_readCounterValue(&smi->timerModule, 0)
-							& 0xFF000000) | 
-							((value & 0xFF) << 16)
-							);
-					break;
-			}
-		}
-		else if (tempAddress >= 0x1F801104L && tempAddress < 0x1F801108L) {
-			int32_t shift = (int32_t)(tempAddress & 0x3L);
-			switch (shift) {
-				case 0:
-					TimerModule_writeMode(
-							&smi->timerModule,
-							0,
-							(value & 0xFF) << 24
-							);
-					break;
-				case 1:
-					TimerModule_writeMode(
-							&smi->timerModule,
-							0,
-							(TimerModule_readMode(&smi->timerModule, 0, true)
-							& 0xFF000000) |
-							((value & 0xFF) << 16)
-							);
-					break;
-			}
-		}
-		else if (tempAddress >= 0x1F801108L && tempAddress < 0x1F80110CL) {
-			int32_t shift = (int32_t)(tempAddress & 0x3L);
-			switch (shift) {
-				case 0:
-					TimerModule_writeTargetValue(
-							&smi->timerModule,
-							0,
-							(value & 0xFF) << 24
-							);
-					break;
-				case 1:
-					TimerModule_writeTargetValue(
-							&smi->timerModule,
-							0,
-							(TimerModule_readTargetValue(&smi->timerModule, 0)
-							& 0xFF000000) |
-							((value & 0xFF) << 16)
-							);
-					break;
-			}
-		}
-		else if (tempAddress >= 0x1F801110L && tempAddress < 0x1F801114L) {
-			int32_t shift = (int32_t)(tempAddress & 0x3L);
-			switch (shift) {
-				case 0:
-					TimerModule_writeCounterValue(
-							&smi->timerModule,
-							1,
-							(value & 0xFF) << 24
-							);
-					break;
-				case 1:
-					TimerModule_writeCounterValue(
-							&smi->timerModule,
-							1,
-							(TimerModule_readCounterValue(&smi->timerModule, 1)
-							& 0xFF000000) |
-							((value & 0xFF) << 16)
-							);
-					break;
-			}
-		}
-		else if (tempAddress >= 0x1F801114L && tempAddress < 0x1F801118L) {
-			int32_t shift = (int32_t)(tempAddress & 0x3L);
-			switch (shift) {
-				case 0:
-					TimerModule_writeMode(
-							&smi->timerModule,
-							1,
-							(value & 0xFF) << 24
-							);
-					break;
-				case 1:
-					TimerModule_writeMode(
-							&smi->timerModule,
-							1,
-							(TimerModule_readMode(&smi->timerModule, 1, true)
-							& 0xFF000000) |
-							((value & 0xFF) << 16)
-							);
-					break;
-			}
-		}
-		else if (tempAddress >= 0x1F801118L && tempAddress < 0x1F80111CL) {
-			int32_t shift = (int32_t)(tempAddress & 0x3L);
-			switch (shift) {
-				case 0:
-					TimerModule_writeTargetValue(
-							&smi->timerModule,
-							1,
-							(value & 0xFF) << 24
-							);
-					break;
-				case 1:
-					TimerModule_writeTargetValue(
-							&smi->timerModule,
-							1,
-							(TimerModule_readTargetValue(&smi->timerModule, 1)
-							& 0xFF000000) |
-							((value & 0xFF) << 16)
-							);
-					break;
-			}
-		}
-		else if (tempAddress >= 0x1F801120L && tempAddress < 0x1F801124L) {
-			int32_t shift = (int32_t)(tempAddress & 0x3L);
-			switch (shift) {
-				case 0:
-					TimerModule_writeCounterValue(
-							&smi->timerModule,
-							2,
-							(value & 0xFF) << 24
-							);
-					break;
-				case 1:
-					TimerModule_writeCounterValue(
-							&smi->timerModule,
-							2,
-							(TimerModule_readCounterValue(&smi->timerModule, 2)
-							& 0xFF000000) |
-							((value & 0xFF) << 16)
-							);
-					break;
-			}
-		}
-		else if (tempAddress >= 0x1F801124L && tempAddress < 0x1F801128L) {
-			int32_t shift = (int32_t)(tempAddress & 0x3L);
-			switch (shift) {
-				case 0:
-					TimerModule_writeMode(
-							&smi->timerModule,
-							2,
-							(value & 0xFF) << 24
-							);
-					break;
-				case 1:
-					TimerModule_writeMode(
-							&smi->timerModule,
-							2,
-							(TimerModule_readMode(&smi->timerModule, 2, true)
-							& 0xFF000000) |
-							((value & 0xFF) << 16)
-							);
-					break;
-			}
-		}
-		else if (tempAddress >= 0x1F801128L && tempAddress < 0x1F80112CL) {
-			int32_t shift = (int32_t)(tempAddress & 0x3L);
-			switch (shift) {
-				case 0:
-					TimerModule_writeTargetValue(
-							&smi->timerModule,
-							2,
-							(value & 0xFF) << 24
-							);
-					break;
-				case 1:
-					TimerModule_writeTargetValue(
-							&smi->timerModule,
-							2,
-							(TimerModule_readTargetValue(&smi->timerModule, 2)
-							& 0xFF000000) |
-							((value & 0xFF) << 16)
-							);
-					break;
-			}
-		} // CD-ROM
-		else if (tempAddress >= 0x1F801800L && tempAddress < 0x1F801804L) {
-			switch ((int32_t)tempAddress & 0xF) {
-				case 0:
-					CDROMDrive_write1800(smi->cdrom, value);
-					break;
-				case 1:
-					CDROMDrive_write1801(smi->cdrom, value);
-					break;
-				case 2:
-					CDROMDrive_write1802(smi->cdrom, value);
-					break;
-				case 3:
-					CDROMDrive_write1803(smi->cdrom, value);
-					break;
-			}
-		}
-		else if (tempAddress >= 0x1F801C00L && tempAddress < 0x1F802000L) {
-			// Fake SPU write
-			SPU_writeByte(smi->spu, address, value);
-		}
+		// Write through the port's byte handler, if it has one
+		IOPort *port = &smi->ioPorts[(tempAddress - 0x1F801000L) >> 2];
+		if (port->handlers->writeByte)
+			port->handlers->writeByte(port->object, address, value);
 	} // Expansion Region 2 (I/O Ports)
 	else if (tempAddress >= 0x1F802000L && tempAddress < 0x1F803000L) {
 		if (tempAddress == 0x1F802041L) {
@@ -2067,17 +1020,57 @@ void SystemInterlink_writeByte(SystemInterlink *smi, int32_t address,
 				case 0:
 					// Write full 32-bits, with zeroes for remaining
 					// three bytes
-					smi->cacheControlReg = (value & 0xFF) << 24;
+					smi->cacheControlReg = value & 0xFF;
 					break;
 				case 1:
 					// Keep first byte of cache control, merge with this
 					// one, and set last two to zeroes
 					smi->cacheControlReg =
-							(smi->cacheControlReg & 0xFF000000) |
-							((value & 0xFF) << 16);
+							(smi->cacheControlReg & 0xFF) |
+							((value & 0xFF) << 8);
 					break;
 			}
+			SystemInterlink_updateCacheControl(smi);
+		}
+	}
+}
+
+/*
+ * This writes a halfword to the correct area depending on the address.
+ */
+void SystemInterlink_writeHalfword(SystemInterlink *smi, int32_t address,
+		int16_t value)
+{
+	int64_t tempAddress = address & 0xFFFFFFFEL;
+	address = (int32_t)tempAddress;
+
+	// Handle RAM specially due to its frequent use
+	if (tempAddress >= 0L && tempAddress < PHILPSX_RAM_MIRROR_SPAN) {
+		memcpy(smi->ram + address, &value, 2);
+		if (smi->pageTable[address >> 12].containsCode)
+			SystemInterlink_invalidateMirroredCode(smi, address, 2);
+	} // Handle scratchpad specially for the same reason
+	else if (tempAddress >= 0x1F800000L && tempAddress < 0x1F800400L) {
+		if (SystemInterlink_scratchpadEnabled(smi))
+			memcpy(smi->scratchpad + (address - 0x1F800000), &value, 2);
+	} // Handle I/O ports through their handlers, splitting the write into
+	// bytes if the port has no halfword handler
+	else if (tempAddress >= 0x1F801000L && tempAddress < 0x1F802000L) {
+		IOPort *port = &smi->ioPorts[(address - 0x1F801000) >> 2];
+		if (port->handlers->writeHalfword) {
+			port->handlers->writeHalfword(port->object, address, value);
+		} else if (port->handlers->writeByte) {
+			port->handlers->writeByte(port->object, address,
+					(int8_t)value);
+			port->handlers->writeByte(port->object, address + 1,
+					(int8_t)(value >> 8));
 		}
+	} // Everything else
+	else {
+		// Use writeByte to write two bytes
+		SystemInterlink_writeByte(smi, address, (int8_t)value);
+		SystemInterlink_writeByte(smi, address + 1,
+				(int8_t)(value >> 8));
 	}
 }
 
@@ -2088,6 +1081,7 @@ void SystemInterlink_writeInterruptStatus(SystemInterlink *smi,
 		int32_t interruptStatus)
 {
 	smi->interruptStatusReg = interruptStatus;
+	SystemInterlink_updateInterruptLine(smi);
 }
 
 /*
@@ -2100,253 +1094,162 @@ void SystemInterlink_writeWord(SystemInterlink *smi, int32_t address,
 	address = (int32_t)tempAddress;
 
 	// Handle RAM specially due to its frequent use
-	if (tempAddress >= 0L && tempAddress < 0x200000L) {
-		smi->ram[address] = (int8_t)logical_rshift(word, 24);
-		smi->ram[address + 1] = (int8_t)logical_rshift(word, 16);
-		smi->ram[address + 2] = (int8_t)logical_rshift(word, 8);
-		smi->ram[address + 3] = (int8_t)word;
+	if (tempAddress >= 0L && tempAddress < PHILPSX_RAM_MIRROR_SPAN) {
+		memcpy(smi->ram + address, &word, 4);
+		if (smi->pageTable[address >> 12].containsCode)
+			SystemInterlink_invalidateMirroredCode(smi, address, 4);
+	} // Handle scratchpad specially for the same reason
+	else if (tempAddress >= 0x1F800000L && tempAddress < 0x1F800400L) {
+		if (SystemInterlink_scratchpadEnabled(smi))
+			memcpy(smi->scratchpad + (address - 0x1F800000), &word, 4);
+	} // Handle I/O ports through their handlers, splitting the write into
+	// halfwords or bytes if the port has no word handler
+	else if (tempAddress >= 0x1F801000L && tempAddress < 0x1F802000L) {
+		IOPort *port = &smi->ioPorts[(address - 0x1F801000) >> 2];
+		if (port->handlers->writeWord) {
+			port->handlers->writeWord(port->object, address, word);
+		} else if (port->handlers->writeHalfword) {
+			port->handlers->writeHalfword(port->object, address,
+					(int16_t)word);
+			port->handlers->writeHalfword(port->object, address + 2,
+					(int16_t)logical_rshift(word, 16));
+		} else if (port->handlers->writeByte) {
+			for (int32_t i = 0; i < 4; ++i)
+				port->handlers->writeByte(port->object, address + i,
+						(int8_t)logical_rshift(word, i * 8));
+		}
 	} // Everything else
 	else {
 		switch (address) {
-			case 0x1F801070:
-				// Mask interrupt bits
-				smi->interruptStatusReg &= word;
-				break;
-			case 0x1F801074:
-				smi->interruptMaskReg = word;
-				break;
 			case 0xFFFE0130:
 				smi->cacheControlReg = word;
-				break;
-			case 0x1F801080:
-			case 0x1F801081:
-			case 0x1F801082:
-			case 0x1F801083:
-			case 0x1F801084:
-			case 0x1F801085:
-			case 0x1F801086:
-			case 0x1F801087:
-			case 0x1F801088:
-			case 0x1F801089:
-			case 0x1F80108A:
-			case 0x1F80108B:
-			case 0x1F80108C:
-			case 0x1F80108D:
-			case 0x1F80108E:
-			case 0x1F80108F:
-			case 0x1F801090:
-			case 0x1F801091:
-			case 0x1F801092:
-			case 0x1F801093:
-			case 0x1F801094:
-			case 0x1F801095:
-			case 0x1F801096:
-			case 0x1F801097:
-			case 0x1F801098:
-			case 0x1F801099:
-			case 0x1F80109A:
-			case 0x1F80109B:
-			case 0x1F80109C:
-			case 0x1F80109D:
-			case 0x1F80109E:
-			case 0x1F80109F:
-			case 0x1F8010A0:
-			case 0x1F8010A1:
-			case 0x1F8010A2:
-			case 0x1F8010A3:
-			case 0x1F8010A4:
-			case 0x1F8010A5:
-			case 0x1F8010A6:
-			case 0x1F8010A7:
-			case 0x1F8010A8:
-			case 0x1F8010A9:
-			case 0x1F8010AA:
-			case 0x1F8010AB:
-			case 0x1F8010AC:
-			case 0x1F8010AD:
-			case 0x1F8010AE:
-			case 0x1F8010AF:
-			case 0x1F8010B0:
-			case 0x1F8010B1:
-			case 0x1F8010B2:
-			case 0x1F8010B3:
-			case 0x1F8010B4:
-			case 0x1F8010B5:
-			case 0x1F8010B6:
-			case 0x1F8010B7:
-			case 0x1F8010B8:
-			case 0x1F8010B9:
-			case 0x1F8010BA:
-			case 0x1F8010BB:
-			case 0x1F8010BC:
-			case 0x1F8010BD:
-			case 0x1F8010BE:
-			case 0x1F8010BF:
-			case 0x1F8010C0:
-			case 0x1F8010C1:
-			case 0x1F8010C2:
-			case 0x1F8010C3:
-			case 0x1F8010C4:
-			case 0x1F8010C5:
-			case 0x1F8010C6:
-			case 0x1F8010C7:
-			case 0x1F8010C8:
-			case 0x1F8010C9:
-			case 0x1F8010CA:
-			case 0x1F8010CB:
-			case 0x1F8010CC:
-			case 0x1F8010CD:
-			case 0x1F8010CE:
-			case 0x1F8010CF:
-			case 0x1F8010D0:
-			case 0x1F8010D1:
-			case 0x1F8010D2:
-			case 0x1F8010D3:
-			case 0x1F8010D4:
-			case 0x1F8010D5:
-			case 0x1F8010D6:
-			case 0x1F8010D7:
-			case 0x1F8010D8:
-			case 0x1F8010D9:
-			case 0x1F8010DA:
-			case 0x1F8010DB:
-			case 0x1F8010DC:
-			case 0x1F8010DD:
-			case 0x1F8010DE:
-			case 0x1F8010DF:
-			case 0x1F8010E0:
-			case 0x1F8010E1:
-			case 0x1F8010E2:
-			case 0x1F8010E3:
-			case 0x1F8010E4:
-			case 0x1F8010E5:
-			case 0x1F8010E6:
-			case 0x1F8010E7:
-			case 0x1F8010E8:
-			case 0x1F8010E9:
-			case 0x1F8010EA:
-			case 0x1F8010EB:
-			case 0x1F8010EC:
-			case 0x1F8010ED:
-			case 0x1F8010EE:
-			case 0x1F8010EF:
-			case 0x1F8010F0:
-			case 0x1F8010F1:
-			case 0x1F8010F2:
-			case 0x1F8010F3:
-			case 0x1F8010F4:
-			case 0x1F8010F5:
-			case 0x1F8010F6:
-			case 0x1F8010F7:
-			case 0x1F8010F8:
-			case 0x1F8010F9:
-			case 0x1F8010FA:
-			case 0x1F8010FB:
-			case 0x1F8010FC:
-			case 0x1F8010FD:
-			case 0x1F8010FE:
-			case 0x1F8010FF:
-				DMAArbiter_writeWord(smi->dma, address, word);
-				break;
-			case 0x1F801100:
-				TimerModule_writeCounterValue(&smi->timerModule, 0, word);
-				break;
-			case 0x1F801104:
-				TimerModule_writeMode(&smi->timerModule, 0, word);
-				break;
-			case 0x1F801108:
-				TimerModule_writeTargetValue(&smi->timerModule, 0, word);
-				break;
-			case 0x1F801110:
-				TimerModule_writeCounterValue(&smi->timerModule, 1, word);
-				break;
-			case 0x1F801114:
-				TimerModule_writeMode(&smi->timerModule, 1, word);
-				break;
-			case 0x1F801118:
-				TimerModule_writeTargetValue(&smi->timerModule, 1, word);
-				break;
-			case 0x1F801120:
-				TimerModule_writeCounterValue(&smi->timerModule, 2, word);
-				break;
-			case 0x1F801124:
-				TimerModule_writeMode(&smi->timerModule, 2, word);
-				break;
-			case 0x1F801128:
-				TimerModule_writeTargetValue(&smi->timerModule, 2, word);
-				break;
-			case 0x1F801000:
-				smi->expansion1BaseAddress = word;
-				break;
-			case 0x1F801004:
-				smi->expansion2BaseAddress = word;
-				break;
-			case 0x1F801008:
-				smi->expansion1DelaySize = word;
-				break;
-			case 0x1F80100C:
-				smi->expansion3DelaySize = word;
-				break;
-			case 0x1F801010:
-				smi->biosRomDelaySize = word;
-				break;
-			case 0x1F801014:
-				smi->spuDelaySize = word;
-				break;
-			case 0x1F801018:
-				smi->cdromDelaySize = word;
-				break;
-			case 0x1F80101C:
-				smi->expansion2DelaySize = word;
-				break;
-			case 0x1F801020:
-				smi->commonDelay = word;
-				break;
-			case 0x1F801060:
-				smi->ramSize = word;
-				break;
-			case 0x1F801810:
-				GPU_submitToGP0(smi->gpu, word);
-				break;
-			case 0x1F801814:
-				GPU_submitToGP1(smi->gpu, word);
-				break;
-			case 0x1F801800:
-			case 0x1F801801:
-			case 0x1F801802:
-			case 0x1F801803:
-				// Do nothing as we don't allow word writes to CDROM range
+				SystemInterlink_updateCacheControl(smi);
 				break;
 			default:
 				// Use writeByte to write four bytes
 				SystemInterlink_writeByte(
 						smi,
 						(int32_t)tempAddress,
-						(int8_t)logical_rshift(word, 24)
+						(int8_t)word
 						);
 				++tempAddress;
 				SystemInterlink_writeByte(
 						smi,
 						(int32_t)tempAddress,
-						(int8_t)logical_rshift(word, 16)
+						(int8_t)logical_rshift(word, 8)
 						);
 				++tempAddress;
 				SystemInterlink_writeByte(
 						smi,
 						(int32_t)tempAddress,
-						(int8_t)logical_rshift(word, 8)
+						(int8_t)logical_rshift(word, 16)
 						);
 				++tempAddress;
 				SystemInterlink_writeByte(
 						smi,
 						(int32_t)tempAddress,
-						(int8_t)word
+						(int8_t)logical_rshift(word, 24)
 						);
 				break;
 		}
 	}
 }
 
+/*
+ * This function is run when a delayed CD-ROM interrupt is due. It sets the
+ * interrupt number in the CD-ROM interrupt flag register, and only flags the
+ * interrupt in the interrupt status register if it is enabled.
+ */
+static void SystemInterlink_cdromInterruptEvent(void *object)
+{
+	SystemInterlink *smi = object;
+
+	if (smi->cdromInterruptEnabled) {
+		smi->interruptStatusReg |= 0x4;
+		SystemInterlink_updateInterruptLine(smi);
+	}
+
+	CDROMDrive_setInterruptNumber(smi->cdrom, smi->cdromInterruptNumber);
+}
+
+/*
+ * This function is run when a delayed DMA interrupt is due.
+ */
+static void SystemInterlink_dmaInterruptEvent(void *object)
+{
+	SystemInterlink *smi = object;
+	smi->interruptStatusReg |= 0x8;
+	SystemInterlink_updateInterruptLine(smi);
+}
+
+/*
+ * This function returns the memory control register at the specified
+ * address, for the handlers of its I/O port.
+ */
+static int32_t *SystemInterlink_getMemoryControlRegister(SystemInterlink *smi,
+		int32_t address)
+{
+	int32_t *reg = NULL;
+
+	switch (address & 0xFFFFFFFC) {
+		case 0x1F801000:
+			reg = &smi->expansion1BaseAddress;
+			break;
+		case 0x1F801004:
+			reg = &smi->expansion2BaseAddress;
+			break;
+		case 0x1F801008:
+			reg = &smi->expansion1DelaySize;
+			break;
+		case 0x1F80100C:
+			reg = &smi->expansion3DelaySize;
+			break;
+		case 0x1F801010:
+			reg = &smi->biosRomDelaySize;
+			break;
+		case 0x1F801014:
+			reg = &smi->spuDelaySize;
+			break;
+		case 0x1F801018:
+			reg = &smi->cdromDelaySize;
+			break;
+		case 0x1F80101C:
+			reg = &smi->expansion2DelaySize;
+			break;
+		case 0x1F801020:
+			reg = &smi->commonDelay;
+			break;
+		case 0x1F801060:
+			reg = &smi->ramSize;
+			break;
+	}
+
+	return reg;
+}
+
+/*
+ * This function is run when a delayed GPU interrupt is due.
+ */
+static void SystemInterlink_gpuInterruptEvent(void *object)
+{
+	SystemInterlink *smi = object;
+	smi->interruptStatusReg |= 0x1;
+	SystemInterlink_updateInterruptLine(smi);
+}
+
+/*
+ * This function invalidates any code cached by the CPU within the specified
+ * RAM range, as it may have been cached from any mirror of it.
+ */
+static void SystemInterlink_invalidateMirroredCode(SystemInterlink *smi,
+		int32_t address, int32_t length)
+{
+	int32_t offset = address & (PHILPSX_RAM_SIZE - 1);
+	for (int32_t mirror = 0; mirror < PHILPSX_RAM_MIRROR_SPAN;
+			mirror += PHILPSX_RAM_SIZE)
+		R3051_invalidateBlockCache(smi->cpu, mirror + offset, length);
+}
+
 /*
  * This function verifies the file at biosPath conforms to requirements, and
  * then copies it to the 512 KB array referenced by the biosMemory pointer.
@@ -2415,13 +1318,381 @@ static bool SystemInterlink_loadBiosFileToMemory(const char *biosPath,
 }
 
 /*
- * This tells the timer to add some cycles to the count it needs to sync by.
+ * This function creates RAM as an anonymous file, reserves a host address
+ * range as large as kuseg, kseg0 and kseg1 up to the end of the RAM mirrors,
+ * and maps the file into it at every address RAM appears at in those
+ * segments. Each mirror and segment alias is then an ordinary host pointer
+ * into the same memory, found by adding the guest address to the start of
+ * the range. It returns the start of the range, or NULL on failure.
  */
-static void TimerModule_appendSyncCycles(TimerModule *timerModule,
-		int32_t cycles)
+static int8_t *SystemInterlink_mapRam(void)
 {
-	for (int32_t i = 0; i < 3; ++i)
-		timerModule->cpuCyclesToSync[i] += cycles;
+	// Define segment bases
+	static const int64_t segmentBases[] = {
+		0x00000000L, 0x80000000L, 0xA0000000L
+	};
+
+	// Create RAM file, which starts zeroed
+	int ramFile = memfd_create("PhilPSX RAM", 0);
+	if (ramFile < 0) {
+		fprintf(stderr, "PhilPSX: SystemInterlink: Couldn't create RAM "
+				"file\n");
+		goto end;
+	}
+	if (ftruncate(ramFile, PHILPSX_RAM_SIZE) != 0) {
+		fprintf(stderr, "PhilPSX: SystemInterlink: Couldn't resize RAM "
+				"file\n");
+		goto cleanup_file;
+	}
+
+	// Reserve address range without committing any memory to it
+	int8_t *arena = mmap(NULL, PHILPSX_RAM_ARENA_SIZE, PROT_NONE,
+			MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+	if (arena == MAP_FAILED) {
+		fprintf(stderr, "PhilPSX: SystemInterlink: Couldn't reserve address "
+				"range for RAM\n");
+		goto cleanup_file;
+	}
+
+	// Map RAM over each mirror in each segment
+	for (int32_t i = 0; i < 3; ++i) {
+		for (int64_t mirror = 0; mirror < PHILPSX_RAM_MIRROR_SPAN;
+				mirror += PHILPSX_RAM_SIZE) {
+			void *view = mmap(arena + segmentBases[i] + mirror,
+					PHILPSX_RAM_SIZE, PROT_READ | PROT_WRITE,
+					MAP_SHARED | MAP_FIXED, ramFile, 0);
+			if (view == MAP_FAILED) {
+				fprintf(stderr, "PhilPSX: SystemInterlink: Couldn't map "
+						"RAM mirror\n");
+				goto cleanup_arena;
+			}
+		}
+	}
+
+	// The mappings keep RAM alive, so the file can be closed
+	close(ramFile);
+
+	// Normal return:
+	return arena;
+
+	// Cleanup path:
+	cleanup_arena:
+	munmap(arena, PHILPSX_RAM_ARENA_SIZE);
+
+	cleanup_file:
+	close(ramFile);
+
+	end:
+	return NULL;
+}
+
+/*
+ * This function handles word reads from the I/O ports of the interrupt status
+ * and mask registers.
+ */
+static int32_t SystemInterlink_readInterruptPort(void *object,
+		int32_t address)
+{
+	SystemInterlink *smi = object;
+
+	if ((address & 0x4) == 0)
+		return smi->interruptStatusReg;
+	else
+		return smi->interruptMaskReg;
+}
+
+/*
+ * This function handles word reads from the I/O ports of the memory control
+ * registers.
+ */
+static int32_t SystemInterlink_readMemoryControlPort(void *object,
+		int32_t address)
+{
+	return *SystemInterlink_getMemoryControlRegister(object, address);
+}
+
+/*
+ * This function updates the cached instruction cache enable bit after the
+ * cache control register is written. It also maps the scratchpad into the
+ * page table while it is enabled, and unmaps it otherwise.
+ */
+static void SystemInterlink_updateCacheControl(SystemInterlink *smi)
+{
+	smi->instructionCacheEnabled = (smi->cacheControlReg & 0x800) == 0x800;
+
+	MemoryPage *page = &smi->pageTable[0x1F800000 >> 12];
+	if (SystemInterlink_scratchpadEnabled(smi)) {
+		page->memory = smi->scratchpad;
+		page->size = 1024;
+		page->stallCycles = 0;
+	} else {
+		page->memory = NULL;
+		page->size = 0;
+	}
+}
+
+/*
+ * This function recalculates the cached instruction fetch latencies of RAM
+ * and BIOS, so SystemInterlink_fetchWord need not work them out on every
+ * call. It must be called whenever a delay/size register changes.
+ */
+static void SystemInterlink_updateFetchCycles(SystemInterlink *smi)
+{
+	smi->ramFetchCycles = SystemInterlink_howManyStallCycles(smi, 0);
+	smi->biosFetchCycles = SystemInterlink_howManyStallCycles(smi, 0x1FC00000);
+}
+
+/*
+ * This function recalculates the state of the CPU's hardware interrupt
+ * line from the interrupt status and mask registers. It must be called
+ * whenever either of them changes, so the CPU never has to poll them.
+ */
+static void SystemInterlink_updateInterruptLine(SystemInterlink *smi)
+{
+	if (!smi->cpu)
+		return;
+
+	Cop0_setInterruptLine(R3051_getCop0(smi->cpu),
+			(smi->interruptStatusReg & smi->interruptMaskReg & 0x7FF) != 0);
+}
+
+/*
+ * This function handles byte writes to the I/O ports of the interrupt status
+ * and mask registers. Only the lower two bytes can be written this way.
+ */
+static void SystemInterlink_writeInterruptPortByte(void *object,
+		int32_t address, int8_t value)
+{
+	SystemInterlink *smi = object;
+
+	if ((address & 0x4) == 0) {
+		switch (address & 0x3) {
+			case 0:
+				// Mask first byte
+				smi->interruptStatusReg &=
+						(value & 0xFF) |
+						(smi->interruptStatusReg & 0xFF00);
+				break;
+			case 1:
+				// Mask second byte
+				smi->interruptStatusReg &=
+						(smi->interruptStatusReg & 0xFF) |
+						((value & 0xFF) << 8);
+				break;
+		}
+	} else {
+		switch (address & 0x3) {
+			case 0:
+				// Write full 32-bits, with zeroes for remaining
+				// three bytes
+				smi->interruptMaskReg = value & 0xFF;
+				break;
+			case 1:
+				// Keep first byte of interrupt mask, merge with this
+				// one, and set last two to zeroes
+				smi->interruptMaskReg =
+						(smi->interruptMaskReg & 0xFF) |
+						((value & 0xFF) << 8);
+				break;
+		}
+	}
+	SystemInterlink_updateInterruptLine(smi);
+}
+
+/*
+ * This function handles halfword writes to the I/O ports of the interrupt
+ * status and mask registers. Only the lower halfword can be written this way.
+ */
+static void SystemInterlink_writeInterruptPortHalfword(void *object,
+		int32_t address, int16_t value)
+{
+	SystemInterlink *smi = object;
+
+	if ((address & 0x2) == 0) {
+		if ((address & 0x4) == 0)
+			smi->interruptStatusReg &= value & 0xFFFF; // Mask interrupt bits
+		else
+			smi->interruptMaskReg = value & 0xFFFF;
+	}
+	SystemInterlink_updateInterruptLine(smi);
+}
+
+/*
+ * This function handles word writes to the I/O ports of the interrupt status
+ * and mask registers.
+ */
+static void SystemInterlink_writeInterruptPortWord(void *object,
+		int32_t address, int32_t word)
+{
+	SystemInterlink *smi = object;
+
+	if ((address & 0x4) == 0)
+		smi->interruptStatusReg &= word; // Mask interrupt bits
+	else
+		smi->interruptMaskReg = word;
+	SystemInterlink_updateInterruptLine(smi);
+}
+
+/*
+ * This function handles byte writes to the I/O ports of the memory control
+ * registers. Only the lower two bytes can be written this way, and writing
+ * the first clears the rest.
+ */
+static void SystemInterlink_writeMemoryControlPortByte(void *object,
+		int32_t address, int8_t value)
+{
+	SystemInterlink *smi = object;
+	int32_t *reg = SystemInterlink_getMemoryControlRegister(smi, address);
+
+	switch (address & 0x3) {
+		case 0:
+			*reg = value & 0xFF;
+			break;
+		case 1:
+			*reg = (*reg & 0xFF) | ((value & 0xFF) << 8);
+			break;
+	}
+
+	// Refresh cached fetch latencies in case a delay/size register changed
+	SystemInterlink_updateFetchCycles(smi);
+}
+
+/*
+ * This function handles halfword writes to the I/O ports of the memory control
+ * registers. Only the lower halfword can be written this way, and writing it
+ * clears the rest.
+ */
+static void SystemInterlink_writeMemoryControlPortHalfword(void *object,
+		int32_t address, int16_t value)
+{
+	SystemInterlink *smi = object;
+
+	if ((address & 0x2) == 0)
+		*SystemInterlink_getMemoryControlRegister(smi, address) =
+				value & 0xFFFF;
+
+	// Refresh cached fetch latencies in case a delay/size register changed
+	SystemInterlink_updateFetchCycles(smi);
+}
+
+/*
+ * This function handles word writes to the I/O ports of the memory control
+ * registers.
+ */
+static void SystemInterlink_writeMemoryControlPortWord(void *object,
+		int32_t address, int32_t word)
+{
+	SystemInterlink *smi = object;
+
+	*SystemInterlink_getMemoryControlRegister(smi, address) = word;
+
+	// Refresh cached fetch latencies in case a delay/size register changed
+	SystemInterlink_updateFetchCycles(smi);
+}
+
+/*
+ * This function brings the specified timer up to the current cycle, working
+ * out its counter value from the ticks of its clock source since the base
+ * point, and making that the new base point. If the counter reached its
+ * target value or 0xFFFF on the way, the matching flags are set and an
+ * interrupt is triggered if enabled. Timers 0 and 1 are also adjusted for
+ * the blanking period they are synchronised to, if any. As they are handled
+ * whenever the GPU enters or leaves it, the GPU is taken to have been in or
+ * out of it for the whole time since the base point.
+ */
+static void TimerModule_advance(TimerModule *timerModule, int32_t timer)
+{
+	// Count ticks since the base point, moving it on past them
+	int64_t currentCycle =
+			Scheduler_getCycles(timerModule->smi->scheduler);
+	int64_t ticks = ClockDomain_consumeTicks(&timerModule->clock[timer],
+			currentCycle);
+
+	// Adjust as required by synchronisation mode - resetting at blanking is
+	// done below, once the GPU is found to have entered it
+	int32_t mode = timerModule->timerMode[timer];
+	int64_t value = timerModule->baseValue[timer];
+	bool synchronised = timer < 2 && (mode & 0x1) == 0x1;
+	int32_t syncMode = logical_rshift(mode, 1) & 0x3;
+	if (synchronised) {
+		bool blank = timerModule->inBlank[timer];
+		switch (syncMode) {
+			case 0: // Pause during blanking
+				if (blank)
+					ticks = 0;
+				break;
+			case 2: // Reset at blanking and pause outside of it
+				if (!blank)
+					ticks = 0;
+				break;
+			case 3: // Pause until blanking happens once
+				if (!timerModule->blankHappened[timer])
+					ticks = 0;
+				break;
+		}
+	}
+
+	// Work out where the counter ends up, and whether it reached its target
+	// value and 0xFFFF on the way. It wraps to 0 after its target value if
+	// reset on target is enabled and it hasn't already passed it, and after
+	// 0xFFFF otherwise
+	int32_t target = timerModule->timerTargetValue[timer];
+	bool resetOnTarget = (mode & 0x8) == 0x8;
+	int64_t top = (resetOnTarget && value <= target) ? target : 0xFFFF;
+	int64_t period = resetOnTarget ? target + 1 : 0x10000;
+	bool reachedTarget, reachedOverflow;
+	if (value + ticks <= top) {
+		reachedTarget = value < target && value + ticks >= target;
+		reachedOverflow = value < 0xFFFF && value + ticks >= 0xFFFF;
+		value += ticks;
+	} else {
+		// Count ticks after wrapping to 0 for the first time
+		int64_t wrappedTicks = ticks - (top - value) - 1;
+		reachedTarget = (value < target && target <= top) ||
+				target <= wrappedTicks;
+		reachedOverflow = (value < 0xFFFF && top == 0xFFFF) ||
+				(period == 0x10000 && wrappedTicks >= 0xFFFF);
+		value = wrappedTicks % period;
+	}
+	timerModule->baseValue[timer] = (int32_t)value;
+
+	// Check whether the GPU has entered or left the blanking period, which
+	// resets the counter in synchronisation modes 1 and 2
+	if (synchronised) {
+		bool blank = TimerModule_isInBlank(timerModule, timer);
+		if (blank && !timerModule->inBlank[timer]) {
+			timerModule->blankHappened[timer] = true;
+			if (syncMode == 1 || syncMode == 2)
+				timerModule->baseValue[timer] = 0;
+		}
+		timerModule->inBlank[timer] = blank;
+	}
+
+	// Set flags, triggering interrupt if enabled
+	bool intFlag = false;
+	if (reachedTarget) {
+		timerModule->timerMode[timer] |= 0x800;
+		if ((mode & 0x10) == 0x10)
+			intFlag = true;
+	}
+	if (reachedOverflow) {
+		timerModule->timerMode[timer] |= 0x1000;
+		if ((mode & 0x20) == 0x20)
+			intFlag = true;
+	}
+	if (intFlag)
+		TimerModule_triggerTimerInterrupt(timerModule, timer);
+}
+
+/*
+ * This function tells us whether the GPU is in the blanking period timer 0
+ * or 1 can be synchronised to, which is hblank and vblank respectively.
+ */
+static bool TimerModule_isInBlank(TimerModule *timerModule, int32_t timer)
+{
+	return timer == 0 ?
+			GPU_isInHblank(timerModule->smi->gpu) :
+			GPU_isInVblank(timerModule->smi->gpu);
 }
 
 /*
@@ -2431,14 +1702,16 @@ static int32_t TimerModule_readCounterValue(TimerModule *timerModule,
 		int32_t timer)
 {
 	// Catch up to current cycle count
-	TimerModule_resync(timerModule);
+	TimerModule_advance(timerModule, timer);
+	TimerModule_updateDeadline(timerModule, timer);
+	TimerModule_scheduleEvent(timerModule);
 
 	// If in pulse mode, set bit 10 back to 1 now
 	if ((timerModule->timerMode[timer] & 0x80) == 0) {
 		timerModule->timerMode[timer] |= 0x400;
 	}
 
-	return TimerModule_swapEndianness(timerModule->timerCounterValue[timer]);
+	return timerModule->baseValue[timer];
 }
 
 /*
@@ -2448,7 +1721,7 @@ static int32_t TimerModule_readMode(TimerModule *timerModule,
 		int32_t timer, bool override)
 {
 	// Catch up to current cycle count
-	TimerModule_resync(timerModule);
+	TimerModule_advance(timerModule, timer);
 
 	// If in pulse mode, set bit 10 back to 1 now
 	if ((timerModule->timerMode[timer] & 0x80) == 0 && !override) {
@@ -2464,9 +1737,37 @@ static int32_t TimerModule_readMode(TimerModule *timerModule,
 		timerModule->timerMode[timer] &= 0xFFFFE7FF;
 	}
 
-	return TimerModule_swapEndianness(retVal);
+	// Work out when we next need to handle the timer, as clearing the
+	// flags means reaching those values matters again
+	TimerModule_updateDeadline(timerModule, timer);
+	TimerModule_scheduleEvent(timerModule);
+
+	return retVal;
 }
 
+/*
+ * This function handles word reads from the I/O ports of the timers.
+ */
+static int32_t TimerModule_readPort(void *object, int32_t address)
+{
+	TimerModule *timerModule = object;
+	int32_t timer = logical_rshift(address, 4) & 0x3;
+	int32_t retVal = 0;
+
+	switch (address & 0xC) {
+		case 0x0:
+			retVal = TimerModule_readCounterValue(timerModule, timer);
+			break;
+		case 0x4:
+			retVal = TimerModule_readMode(timerModule, timer, false);
+			break;
+		case 0x8:
+			retVal = TimerModule_readTargetValue(timerModule, timer);
+			break;
+	}
+
+	return retVal;
+}
 /*
  * Read from the specified timer's target value register.
  */
@@ -2478,204 +1779,66 @@ static int32_t TimerModule_readTargetValue(TimerModule *timerModule,
 		timerModule->timerMode[timer] |= 0x400;
 	}
 
-	return TimerModule_swapEndianness(timerModule->timerTargetValue[timer]);
+	return timerModule->timerTargetValue[timer];
 }
-
 /*
- * Resync all timers to the current point.
+ * This function schedules the timer event for the earliest deadline of the
+ * three timers, cancelling it if none of them need handling.
  */
-static void TimerModule_resync(TimerModule *timerModule)
+static void TimerModule_scheduleEvent(TimerModule *timerModule)
 {
-	// Get HBlank and VBlank status
-	bool hblank = GPU_isInHblank(timerModule->smi->gpu);
-	bool vblank = GPU_isInVblank(timerModule->smi->gpu);
-
-	if (hblank) {
-		timerModule->hblankHappened[0] = true;
-		timerModule->hblankHappened[1] = true;
-		timerModule->hblankHappened[2] = true;
-	}
-	if (vblank) {
-		timerModule->vblankHappened[0] = true;
-		timerModule->vblankHappened[1] = true;
-		timerModule->vblankHappened[2] = true;
-	}
-
-	// Convert sync figure to GPU cycles in case needed
-	for (int32_t i = 0; i < 3; ++i) {
-		timerModule->gpuCyclesToSync[i] +=
-				timerModule->cpuCyclesToSync[i] / 7.0f * 11.0f;
-
-		// Add in top up values
-		timerModule->cpuCyclesToSync[i] += timerModule->cpuTopup[i];
-		timerModule->gpuCyclesToSync[i] += timerModule->gpuTopup[i];
-	}
-
-	// Get clock source for all three timers
-	timerModule->clockSource[0] =
-			logical_rshift(timerModule->timerMode[0], 8) & 0x3;
-	timerModule->clockSource[1] =
-			logical_rshift(timerModule->timerMode[1], 8) & 0x3;
-	timerModule->clockSource[2] =
-			logical_rshift(timerModule->timerMode[2], 8) & 0x3;
-
-	// Calculate future topup values
-	timerModule->cpuTopup[0] = 0;
-	timerModule->gpuTopup[0] = (timerModule->clockSource[0] == 0 ||
-			timerModule->clockSource[0] == 2) ?
-			0 : GPU_howManyDotclockGpuCyclesLeft(timerModule->smi->gpu,
-			timerModule->gpuCyclesToSync[0]);
-	timerModule->cpuTopup[1] = 0;
-	timerModule->gpuTopup[1] = (timerModule->clockSource[1] == 0 ||
-			timerModule->clockSource[1] == 2) ?
-			0 : GPU_howManyHblankGpuCyclesLeft(timerModule->smi->gpu,
-			timerModule->gpuCyclesToSync[1]);
-	timerModule->cpuTopup[2] = (timerModule->clockSource[2] < 2) ?
-			0 : timerModule->cpuCyclesToSync[2] % 8;
-	timerModule->gpuTopup[2] = 0;
-
-	// Get increment count for all three timers
-	timerModule->incrementBy[0] = (timerModule->clockSource[0] == 0 ||
-			timerModule->clockSource[0] == 2) ?
-			timerModule->cpuCyclesToSync[0] :
-			GPU_howManyDotclockIncrements(timerModule->smi->gpu,
-			timerModule->gpuCyclesToSync[0]);
-	timerModule->incrementBy[1] = (timerModule->clockSource[1] == 0 ||
-			timerModule->clockSource[1] == 2) ?
-			timerModule->cpuCyclesToSync[1] :
-			GPU_howManyHblankIncrements(timerModule->smi->gpu,
-			timerModule->gpuCyclesToSync[1]);
-	timerModule->incrementBy[2] = (timerModule->clockSource[2] < 2) ?
-			timerModule->cpuCyclesToSync[2] :
-			timerModule->cpuCyclesToSync[2] / 8;
-
-	// Do increment to temporary value
-	timerModule->newValue[0] =
-			timerModule->timerCounterValue[0] + timerModule->incrementBy[0];
-	timerModule->newValue[1] =
-			timerModule->timerCounterValue[1] + timerModule->incrementBy[1];
-	timerModule->newValue[2] =
-			timerModule->timerCounterValue[2] + timerModule->incrementBy[2];
-
-	// Adjust as required by synchronisation mode
-	// Timer 0
-	switch (timerModule->timerMode[0] & 0x1) {
-		case 1:
-			switch (logical_rshift(timerModule->timerMode[0], 1) & 0x3) {
-				case 0:
-					if (hblank)
-						timerModule->newValue[0] =
-								timerModule->timerCounterValue[0];
-					break;
-				case 1:
-					if (hblank)
-						timerModule->newValue[0] = 0;
-					break;
-				case 2:
-					if (hblank)
-						timerModule->newValue[0] = 0;
-					else
-						timerModule->newValue[0] =
-								timerModule->timerCounterValue[0];
-					break;
-				case 3:
-					if (!timerModule->hblankHappened[0])
-						timerModule->newValue[0] =
-								timerModule->timerCounterValue[0];
-					break;
-			}
-			break;
-	}
-
-	// Timer 1
-	switch (timerModule->timerMode[1] & 0x1) {
-		case 1:
-			switch (logical_rshift(timerModule->timerMode[1], 1) & 0x3) {
-				case 0:
-					if (vblank)
-						timerModule->newValue[1] =
-								timerModule->timerCounterValue[1];
-					break;
-				case 1:
-					if (vblank)
-						timerModule->newValue[1] = 0;
-					break;
-				case 2:
-					if (vblank)
-						timerModule->newValue[1] = 0;
-					else
-						timerModule->newValue[1] =
-								timerModule->timerCounterValue[1];
-					break;
-				case 3:
-					if (!timerModule->vblankHappened[1])
-						timerModule->newValue[1] =
-								timerModule->timerCounterValue[1];
-					break;
-			}
-			break;
-	}
-
-	// Timer 2
-	switch (timerModule->timerMode[2] & 0x1) {
-		case 1:
-			switch (logical_rshift(timerModule->timerMode[2], 1) & 0x3) {
-				case 0:
-				case 3:
-					timerModule->newValue[2] =
-							timerModule->timerCounterValue[2];
-					break;
-			}
-			break;
-	}
-
-	timerModule->timerCounterValue[0] = timerModule->newValue[0];
-	timerModule->timerCounterValue[1] = timerModule->newValue[1];
-	timerModule->timerCounterValue[2] = timerModule->newValue[2];
+	int64_t deadline = INT64_MAX;
+	for (int32_t i = 0; i < 3; ++i)
+		if (timerModule->deadline[i] < deadline)
+			deadline = timerModule->deadline[i];
+
+	if (deadline == INT64_MAX)
+		Scheduler_cancelEvent(timerModule->smi->scheduler,
+				PHILPSX_EVENT_TIMERS);
+	else
+		Scheduler_scheduleEvent(timerModule->smi->scheduler,
+				PHILPSX_EVENT_TIMERS, deadline);
+}
 
-	// Deal with interrupts and target values
-	for (int32_t i = 0; i < 3; ++i) {
-		// Wipe cycles
-		timerModule->cpuCyclesToSync[i] = 0;
-		timerModule->gpuCyclesToSync[i] = 0;
-
-		// Check for interrupts
-		bool intFlag = false;
-		if (timerModule->timerCounterValue[i] >=
-				timerModule->timerTargetValue[i]) {
-			timerModule->timerMode[i] |= 0x800;
-			if ((timerModule->timerMode[i] & 0x10) == 0x10) {
-				intFlag = true;
-			}
-		}
-		if (timerModule->timerCounterValue[i] >= 0xFFFF) {
-			timerModule->timerMode[i] |= 0x1000;
-			if ((timerModule->timerMode[i] & 0x20) == 0x20) {
-				intFlag = true;
-			}
-		}
-		if (intFlag)
-			TimerModule_triggerTimerInterrupt(timerModule, i);
-
-		// Reset values here if needed
-		if (timerModule->timerCounterValue[i] > 0xFFFF &&
-				(timerModule->timerMode[i] & 0x8) == 0) {
-			timerModule->timerCounterValue[i] = 0;
-		} else if (timerModule->timerCounterValue[i] >
-				timerModule->timerTargetValue[i] &&
-				(timerModule->timerMode[i] & 0x8) == 0x8) {
-			timerModule->timerCounterValue[i] = 0;
-		}
-	}
+/*
+ * This function works out how many ticks of its clock source it will take
+ * for the specified timer to next reach the specified value from its base
+ * point, returning -1 if it never will.
+ */
+static int64_t TimerModule_ticksUntilValue(TimerModule *timerModule,
+		int32_t timer, int32_t value)
+{
+	int32_t counter = timerModule->baseValue[timer];
+	int32_t target = timerModule->timerTargetValue[timer];
+	bool resetOnTarget = (timerModule->timerMode[timer] & 0x8) == 0x8;
+	int64_t top = (resetOnTarget && counter <= target) ? target : 0xFFFF;
+	int64_t period = resetOnTarget ? target + 1 : 0x10000;
+
+	// Check if the value is reached before wrapping, or after it if not
+	if (value > counter && value <= top)
+		return value - counter;
+	if (value >= period)
+		return -1;
+	return (top - counter) + 1 + value;
 }
 
 /*
- * This swaps the endianness of an incoming or outgoing word.
+ * This function is run when the timer event is due, handling whichever
+ * timers need it.
  */
-static int32_t TimerModule_swapEndianness(int32_t word)
+static void TimerModule_timerEvent(void *object)
 {
-	return word << 24 | (word & 0xFF00) << 8 |
-			logical_rshift(word & 0xFF0000, 8) | logical_rshift(word, 24);
+	TimerModule *timerModule = object;
+	int64_t currentCycle =
+			Scheduler_getCycles(timerModule->smi->scheduler);
+
+	for (int32_t i = 0; i < 3; ++i) {
+		if (timerModule->deadline[i] <= currentCycle) {
+			TimerModule_advance(timerModule, i);
+			TimerModule_updateDeadline(timerModule, i);
+		}
+	}
+	TimerModule_scheduleEvent(timerModule);
 }
 
 /*
@@ -2693,16 +1856,16 @@ static void TimerModule_triggerTimerInterrupt(TimerModule *timerModule,
 				// Just set bit 10 to 0 and be done with it,
 				// triggering IRQ as well
 				timerModule->timerMode[timer] &= 0xFFFFFBFF;
-				timerModule->smi->timersInterruptDelay[timer] = 0;
-				timerModule->smi->timersInterruptCounter[timer] = 0;
+				timerModule->smi->interruptStatusReg |= 0x10 << timer;
+				SystemInterlink_updateInterruptLine(timerModule->smi);
 				timerModule->interruptHappenedOnceOrMore[timer] = true;
 			} else {
 				// Invert flag, triggering IRQ if it is then 0
 				if ((timerModule->timerMode[timer] & 0x400) == 0x400) {
 					// Flip to 0 and trigger interrupt
 					timerModule->timerMode[timer] &= 0xFFFFFBFF;
-					timerModule->smi->timersInterruptDelay[timer] = 0;
-					timerModule->smi->timersInterruptCounter[timer] = 0;
+					timerModule->smi->interruptStatusReg |= 0x10 << timer;
+					SystemInterlink_updateInterruptLine(timerModule->smi);
 					timerModule->interruptHappenedOnceOrMore[timer] = true;
 				} else {
 					// Flip back to 1 and do nothing
@@ -2716,15 +1879,15 @@ static void TimerModule_triggerTimerInterrupt(TimerModule *timerModule,
 			// Just set bit 10 to 0 and be done with it,
 			// triggering IRQ as well
 			timerModule->timerMode[timer] &= 0xFFFFFBFF;
-			timerModule->smi->timersInterruptDelay[timer] = 0;
-			timerModule->smi->timersInterruptCounter[timer] = 0;
+			timerModule->smi->interruptStatusReg |= 0x10 << timer;
+			SystemInterlink_updateInterruptLine(timerModule->smi);
 		} else {
 			// Invert flag, triggering IRQ if it is then 0
 			if ((timerModule->timerMode[timer] & 0x400) == 0x400) {
 				// Flip to 0 and trigger interrupt
 				timerModule->timerMode[timer] &= 0xFFFFFBFF;
-				timerModule->smi->timersInterruptDelay[timer] = 0;
-				timerModule->smi->timersInterruptCounter[timer] = 0;
+				timerModule->smi->interruptStatusReg |= 0x10 << timer;
+				SystemInterlink_updateInterruptLine(timerModule->smi);
 			} else {
 				// Flip back to 1 and do nothing
 				timerModule->timerMode[timer] |= 0x400;
@@ -2732,6 +1895,85 @@ static void TimerModule_triggerTimerInterrupt(TimerModule *timerModule,
 		}
 	}
 }
+/*
+ * This function works out how fast the specified timer's clock source ticks,
+ * and starts counting its ticks from the current cycle. The dotclock and
+ * hblank tick once every so many cycles of the GPU clock.
+ */
+static void TimerModule_updateClock(TimerModule *timerModule, int32_t timer)
+{
+	int32_t mode = timerModule->timerMode[timer];
+	int32_t clockSource = logical_rshift(mode, 8) & 0x3;
+	int64_t multiplier = 1;
+	int64_t divisor = 1;
+
+	if (timer == 0 && (clockSource & 0x1) == 0x1) {
+		// Dotclock
+		multiplier = PHILPSX_CLOCK_GPU_MULTIPLIER;
+		divisor = PHILPSX_CLOCK_GPU_DIVISOR *
+				GPU_getCyclesPerDot(timerModule->smi->gpu);
+	} else if (timer == 1 && (clockSource & 0x1) == 0x1) {
+		// Hblank
+		multiplier = PHILPSX_CLOCK_GPU_MULTIPLIER;
+		divisor = PHILPSX_CLOCK_GPU_DIVISOR *
+				GPU_getCyclesPerScanline(timerModule->smi->gpu);
+	} else if (timer == 2) {
+		// System clock / 8
+		if (clockSource >= 2)
+			divisor = 8;
+
+		// Synchronisation modes 0 and 3 stop the counter
+		int32_t syncMode = logical_rshift(mode, 1) & 0x3;
+		if ((mode & 0x1) == 0x1 && (syncMode == 0 || syncMode == 3))
+			multiplier = 0;
+	}
+
+	construct_ClockDomain(&timerModule->clock[timer], multiplier, divisor,
+			Scheduler_getCycles(timerModule->smi->scheduler));
+}
+
+/*
+ * This function works out the CPU cycle at which the specified timer next
+ * needs handling, which is when it reaches its target value or 0xFFFF if
+ * that would set a flag that is clear or trigger an enabled interrupt.
+ * Timers synchronised to a blanking period are also handled whenever the
+ * GPU enters or leaves it.
+ */
+static void TimerModule_updateDeadline(TimerModule *timerModule,
+		int32_t timer)
+{
+	int32_t mode = timerModule->timerMode[timer];
+
+	// Find ticks until the next value that matters
+	int64_t ticks = -1;
+	if ((mode & 0x10) == 0x10 || (mode & 0x800) == 0)
+		ticks = TimerModule_ticksUntilValue(timerModule, timer,
+				timerModule->timerTargetValue[timer]);
+	if ((mode & 0x20) == 0x20 || (mode & 0x1000) == 0) {
+		int64_t overflowTicks =
+				TimerModule_ticksUntilValue(timerModule, timer, 0xFFFF);
+		if (overflowTicks >= 0 && (ticks < 0 || overflowTicks < ticks))
+			ticks = overflowTicks;
+	}
+
+	// Convert to the cycle on which the last of those ticks happens
+	int64_t deadline = INT64_MAX;
+	if (ticks >= 0)
+		deadline = ClockDomain_getCycleOfTick(&timerModule->clock[timer],
+				ticks);
+
+	// Handle the timer when the blanking period changes if synchronised to
+	// it - the deadline above may then be early, but never late
+	if (timer < 2 && (mode & 0x1) == 0x1) {
+		int64_t blankCycle = timer == 0 ?
+				GPU_getNextHblankChange(timerModule->smi->gpu) :
+				GPU_getNextVblankChange(timerModule->smi->gpu);
+		if (blankCycle < deadline)
+			deadline = blankCycle;
+	}
+
+	timerModule->deadline[timer] = deadline;
+}
 
 /*
  * Write to the specified timer's counter value register.
@@ -2739,9 +1981,10 @@ static void TimerModule_triggerTimerInterrupt(TimerModule *timerModule,
 static void TimerModule_writeCounterValue(TimerModule *timerModule,
 		int32_t timer, int32_t value)
 {
-	TimerModule_resync(timerModule);
-	value = TimerModule_swapEndianness(value);
-	timerModule->timerCounterValue[timer] = 0xFFFF & value;
+	TimerModule_advance(timerModule, timer);
+	timerModule->baseValue[timer] = 0xFFFF & value;
+	TimerModule_updateDeadline(timerModule, timer);
+	TimerModule_scheduleEvent(timerModule);
 }
 
 /*
@@ -2750,8 +1993,7 @@ static void TimerModule_writeCounterValue(TimerModule *timerModule,
 static void TimerModule_writeMode(TimerModule *timerModule,
 		int32_t timer, int32_t value)
 {
-	TimerModule_resync(timerModule);
-	value = TimerModule_swapEndianness(value);
+	TimerModule_advance(timerModule, timer);
 
 	// Set bit 10 to turn off interrupt request
 	value |= 0x400;
@@ -2759,17 +2001,126 @@ static void TimerModule_writeMode(TimerModule *timerModule,
 	// Set bits 13-15 to 0
 	value &= 0xFFFF1FFF;
 
-	// Reset hblank and vblank happened markers
-	timerModule->hblankHappened[timer] = false;
-	timerModule->vblankHappened[timer] = false;
+	// Reset blanking happened marker, and note whether we are in it now
+	if (timer < 2) {
+		timerModule->blankHappened[timer] = false;
+		if ((value & 0x1) == 0x1)
+			timerModule->inBlank[timer] =
+					TimerModule_isInBlank(timerModule, timer);
+	}
 
 	// Reset one-shot marker
 	timerModule->interruptHappenedOnceOrMore[timer] = false;
 
 	timerModule->timerMode[timer] = value;
 
-	// Reset counter value
-	timerModule->timerCounterValue[timer] = 0;
+	// Reset counter value, counting from now with the new clock source
+	timerModule->baseValue[timer] = 0;
+	TimerModule_updateClock(timerModule, timer);
+	TimerModule_updateDeadline(timerModule, timer);
+	TimerModule_scheduleEvent(timerModule);
+}
+
+/*
+ * This function handles byte writes to the I/O ports of the timers. Only the
+ * lower two bytes can be written this way, and writing the first clears the
+ * rest.
+ */
+static void TimerModule_writePortByte(void *object, int32_t address,
+		int8_t value)
+{
+	TimerModule *timerModule = object;
+	int32_t timer = logical_rshift(address, 4) & 0x3;
+
+	// Ignore upper two bytes
+	if ((address & 0x2) != 0)
+		return;
+
+	// Merge with current value if writing the second byte
+	bool secondByte = (address & 0x1) != 0;
+	switch (address & 0xC) {
+		case 0x0:
+			TimerModule_writeCounterValue(
+					timerModule,
+					timer,
+					secondByte ?
+					(TimerModule_readCounterValue(timerModule, timer)
+					& 0xFF) | ((value & 0xFF) << 8) :
+					value & 0xFF
+					);
+			break;
+		case 0x4:
+			TimerModule_writeMode(
+					timerModule,
+					timer,
+					secondByte ?
+					(TimerModule_readMode(timerModule, timer, true)
+					& 0xFF) | ((value & 0xFF) << 8) :
+					value & 0xFF
+					);
+			break;
+		case 0x8:
+			TimerModule_writeTargetValue(
+					timerModule,
+					timer,
+					secondByte ?
+					(TimerModule_readTargetValue(timerModule, timer)
+					& 0xFF) | ((value & 0xFF) << 8) :
+					value & 0xFF
+					);
+			break;
+	}
+}
+
+/*
+ * This function handles halfword writes to the I/O ports of the timers. Only
+ * the lower halfword can be written this way.
+ */
+static void TimerModule_writePortHalfword(void *object, int32_t address,
+		int16_t value)
+{
+	TimerModule *timerModule = object;
+	int32_t timer = logical_rshift(address, 4) & 0x3;
+
+	// Ignore upper halfword
+	if ((address & 0x2) != 0)
+		return;
+
+	switch (address & 0xC) {
+		case 0x0:
+			TimerModule_writeCounterValue(timerModule, timer,
+					value & 0xFFFF);
+			break;
+		case 0x4:
+			TimerModule_writeMode(timerModule, timer, value & 0xFFFF);
+			break;
+		case 0x8:
+			TimerModule_writeTargetValue(timerModule, timer,
+					value & 0xFFFF);
+			break;
+	}
+}
+
+/*
+ * This function handles word writes to the I/O ports of the timers.
+ */
+static void TimerModule_writePortWord(void *object, int32_t address,
+		int32_t word)
+{
+	TimerModule *timerModule = object;
+	int32_t timer = logical_rshift(address, 4) & 0x3;
+
+	switch (address & 0xC) {
+		case 0x0:
+			TimerModule_writeCounterValue(timerModule, timer, word);
+			break;
+		case 0x4:
+			TimerModule_writeMode(timerModule, timer, word);
+			break;
+		case 0x8:
+			TimerModule_writeTargetValue(timerModule, timer, word);
+			break;
+	}
 }
 
 /*
@@ -2778,7 +2129,8 @@ static void TimerModule_writeMode(TimerModule *timerModule,
 static void TimerModule_writeTargetValue(TimerModule *timerModule,
 		int32_t timer, int32_t value)
 {
-	TimerModule_resync(timerModule);
-	value = TimerModule_swapEndianness(value);
+	TimerModule_advance(timerModule, timer);
 	timerModule->timerTargetValue[timer] = 0xFFFF & value;
+	TimerModule_updateDeadline(timerModule, timer);
+	TimerModule_scheduleEvent(timerModule);
 }
\ No newline at end of file
@@ -0,0 +1,209 @@
+/*
+ * This C file models an execution trace recorder as a class. The emulator
+ * thread adds a fixed-size record for each instruction to a ring buffer, and
+ * a dedicated thread drains the ring to a binary file. As each ring has a
+ * single producer (the thread running the CPU it belongs to) and a single
+ * consumer, the two only share the head and tail positions, which are updated
+ * atomically without locking. If the ring fills up, the emulator thread waits
+ * for space rather than losing records.
+ *
+ * Tracer.c - Copyright Phillip Potter, 2020, under GPLv3
+ */
+#define _POSIX_C_SOURCE 200809L
+#include <time.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../headers/Tracer.h"
+
+// Number of records in the ring buffer (must be a power of two), and the
+// interval in nanoseconds the draining thread sleeps for when it is empty
+#define PHILPSX_TRACER_RING_SIZE 65536
+#define PHILPSX_TRACER_INTERVAL 1000000L
+
+// Forward declarations for functions private to this class
+static void *Tracer_drainingFunction(void *arg);
+
+/*
+ * This struct contains the ring buffer of records, along with the output file
+ * and the state needed to control the draining thread.
+ */
+struct Tracer {
+
+	// Output file
+	FILE *output;
+
+	// Ring buffer, with head written only by the emulator thread and tail
+	// written only by the draining thread
+	TraceRecord *ring;
+	_Atomic uint32_t head;
+	_Atomic uint32_t tail;
+
+	// Draining thread state
+	pthread_t drainingThread;
+	pthread_mutex_t runningMutex;
+	bool running;
+};
+
+/*
+ * This constructs a Tracer object, which writes its records to the file at
+ * outputPath, and starts its draining thread.
+ */
+Tracer *construct_Tracer(const char *outputPath)
+{
+	// Allocate Tracer struct
+	Tracer *tracer = malloc(sizeof(Tracer));
+	if (!tracer) {
+		fprintf(stderr, "PhilPSX: Tracer: Couldn't allocate memory for "
+				"Tracer struct\n");
+		goto end;
+	}
+
+	// Allocate ring buffer
+	tracer->ring = malloc(PHILPSX_TRACER_RING_SIZE * sizeof(TraceRecord));
+	if (!tracer->ring) {
+		fprintf(stderr, "PhilPSX: Tracer: Couldn't allocate memory for "
+				"ring array\n");
+		goto cleanup_tracer;
+	}
+	atomic_init(&tracer->head, 0);
+	atomic_init(&tracer->tail, 0);
+
+	// Open output file and write header
+	tracer->output = fopen(outputPath, "wb");
+	if (!tracer->output) {
+		fprintf(stderr, "PhilPSX: Tracer: Couldn't open %s\n", outputPath);
+		goto cleanup_ring;
+	}
+	uint32_t version = PHILPSX_TRACER_VERSION;
+	uint32_t recordSize = sizeof(TraceRecord);
+	if (fwrite(PHILPSX_TRACER_MAGIC, 1, 8, tracer->output) != 8 ||
+			fwrite(&version, sizeof(version), 1, tracer->output) != 1 ||
+			fwrite(&recordSize, sizeof(recordSize), 1, tracer->output) != 1) {
+		fprintf(stderr, "PhilPSX: Tracer: Couldn't write header to %s\n",
+				outputPath);
+		goto cleanup_output;
+	}
+
+	// Setup mutex
+	if (pthread_mutex_init(&tracer->runningMutex, NULL)) {
+		fprintf(stderr, "PhilPSX: Tracer: Couldn't initialise "
+				"runningMutex\n");
+		goto cleanup_output;
+	}
+
+	// Start draining thread
+	tracer->running = true;
+	if (pthread_create(&tracer->drainingThread, NULL,
+			&Tracer_drainingFunction, tracer)) {
+		fprintf(stderr, "PhilPSX: Tracer: Couldn't start draining "
+				"thread\n");
+		goto cleanup_mutex;
+	}
+
+	// Normal return:
+	return tracer;
+
+	// Cleanup path:
+	cleanup_mutex:
+	pthread_mutex_destroy(&tracer->runningMutex);
+
+	cleanup_output:
+	fclose(tracer->output);
+
+	cleanup_ring:
+	free(tracer->ring);
+
+	cleanup_tracer:
+	free(tracer);
+	tracer = NULL;
+
+	end:
+	return tracer;
+}
+
+/*
+ * This destructs a Tracer object, waiting for the draining thread to write
+ * out any records left in the ring buffer first.
+ */
+void destruct_Tracer(Tracer *tracer)
+{
+	// Stop draining thread once it has emptied the ring
+	pthread_mutex_lock(&tracer->runningMutex);
+	tracer->running = false;
+	pthread_mutex_unlock(&tracer->runningMutex);
+	pthread_join(tracer->drainingThread, NULL);
+
+	pthread_mutex_destroy(&tracer->runningMutex);
+	fclose(tracer->output);
+	free(tracer->ring);
+	free(tracer);
+}
+
+/*
+ * This function adds a record to the ring buffer. It must only be called
+ * from the thread running the CPU being traced.
+ */
+void Tracer_addRecord(Tracer *tracer, const TraceRecord *record)
+{
+	// Wait for the draining thread if the ring is full
+	uint32_t head =
+			atomic_load_explicit(&tracer->head, memory_order_relaxed);
+	while (head - atomic_load_explicit(&tracer->tail, memory_order_acquire) ==
+			PHILPSX_TRACER_RING_SIZE)
+		sched_yield();
+
+	// Store record, then make it visible to the draining thread
+	tracer->ring[head & (PHILPSX_TRACER_RING_SIZE - 1)] = *record;
+	atomic_store_explicit(&tracer->head, head + 1, memory_order_release);
+}
+
+/*
+ * This function is intended to be called in a dedicated thread. It writes
+ * records out as they are added to the ring buffer, until told to stop and
+ * the ring is empty.
+ */
+static void *Tracer_drainingFunction(void *arg)
+{
+	Tracer *tracer = arg;
+	struct timespec interval = { 0, PHILPSX_TRACER_INTERVAL };
+
+	while (true) {
+
+		// Check if we need to stop, before looking at the ring so that
+		// records added before stopping are always written
+		pthread_mutex_lock(&tracer->runningMutex);
+		bool running = tracer->running;
+		pthread_mutex_unlock(&tracer->runningMutex);
+
+		// Find available records, sleeping if there are none
+		uint32_t tail =
+				atomic_load_explicit(&tracer->tail, memory_order_relaxed);
+		uint32_t head =
+				atomic_load_explicit(&tracer->head, memory_order_acquire);
+		if (head == tail) {
+			if (!running)
+				break;
+			nanosleep(&interval, NULL);
+			continue;
+		}
+
+		// Write as many as possible without wrapping, then release space
+		uint32_t start = tail & (PHILPSX_TRACER_RING_SIZE - 1);
+		uint32_t count = head - tail;
+		if (count > PHILPSX_TRACER_RING_SIZE - start)
+			count = PHILPSX_TRACER_RING_SIZE - start;
+		if (fwrite(tracer->ring + start, sizeof(TraceRecord), count,
+				tracer->output) != count)
+			fprintf(stderr, "PhilPSX: Tracer: Couldn't write records\n");
+		atomic_store_explicit(&tracer->tail, tail + count,
+				memory_order_release);
+	}
+
+	return NULL;
+}
@@ -0,0 +1,26 @@
+/*
+ * This header file provides the public API for the high-level emulation of
+ * BIOS library functions, which are run natively instead of being stepped
+ * through instruction by instruction.
+ *
+ * BiosHLE.h - Copyright Phillip Potter, 2020, under GPLv3
+ */
+#ifndef PHILPSX_BIOSHLE_HEADER
+#define PHILPSX_BIOSHLE_HEADER
+
+// System includes
+#include <stdint.h>
+#include <stdbool.h>
+
+// Typedefs
+typedef struct BiosHLE BiosHLE;
+
+// Includes
+#include "R3051.h"
+
+// Public functions
+BiosHLE *construct_BiosHLE(void);
+void destruct_BiosHLE(BiosHLE *hle);
+bool BiosHLE_handleCall(BiosHLE *hle, R3051 *cpu);
+
+#endif
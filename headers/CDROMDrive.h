@@ -27,6 +27,8 @@ int8_t CDROMDrive_read1800(CDROMDrive *cdrom);
 int8_t CDROMDrive_read1801(CDROMDrive *cdrom);
 int8_t CDROMDrive_read1802(CDROMDrive *cdrom);
 int8_t CDROMDrive_read1803(CDROMDrive *cdrom);
+bool CDROMDrive_readDataSector(CDROMDrive *cdrom, int32_t lba,
+		int8_t *destination);
 void CDROMDrive_setInterruptNumber(CDROMDrive *cdrom, int32_t interruptNum);
 void CDROMDrive_setMemoryInterface(CDROMDrive *cdrom, SystemInterlink *smi);
 void CDROMDrive_write1800(CDROMDrive *cdrom, int8_t value);
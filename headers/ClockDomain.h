@@ -0,0 +1,44 @@
+/*
+ * This header file provides the public API for clock domains, which convert
+ * exactly between CPU cycles and the ticks of a clock running at a fixed
+ * ratio to the CPU clock, such as the GPU clock, the dotclock, hblank or the
+ * system clock divided by 8.
+ *
+ * ClockDomain.h - Copyright Phillip Potter, 2020, under GPLv3
+ */
+#ifndef PHILPSX_CLOCKDOMAIN_HEADER
+#define PHILPSX_CLOCKDOMAIN_HEADER
+
+// System includes
+#include <stdint.h>
+#include <stdbool.h>
+
+// Ratio of the GPU clock to the CPU clock
+#define PHILPSX_CLOCK_GPU_MULTIPLIER 11
+#define PHILPSX_CLOCK_GPU_DIVISOR 7
+
+// Typedefs
+typedef struct ClockDomain ClockDomain;
+
+/*
+ * This struct describes a clock that ticks every divisor / multiplier CPU
+ * cycles, or never if multiplier is 0. Ticks are counted from an origin,
+ * which is held in units of 1 / multiplier CPU cycles, so that moving it on
+ * past whole ticks carries any part of a tick over rather than losing it.
+ * It is intended to be contained inside the struct of the component that
+ * uses it.
+ */
+struct ClockDomain {
+	int64_t multiplier;
+	int64_t divisor;
+	int64_t origin;
+};
+
+// Public functions
+void construct_ClockDomain(ClockDomain *clock, int64_t multiplier,
+		int64_t divisor, int64_t cycle); // Needs a pre-allocated memory region
+int64_t ClockDomain_consumeTicks(ClockDomain *clock, int64_t cycle);
+int64_t ClockDomain_getCycleOfTick(ClockDomain *clock, int64_t ticks);
+int64_t ClockDomain_getTicks(ClockDomain *clock, int64_t cycle);
+
+#endif
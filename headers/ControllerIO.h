@@ -20,7 +20,6 @@ typedef struct ControllerIO ControllerIO;
 // Public functions
 ControllerIO *construct_ControllerIO(void);
 void destruct_ControllerIO(ControllerIO *cio);
-void ControllerIO_appendSyncCycles(ControllerIO *cio, int32_t cycles);
 int8_t ControllerIO_readByte(ControllerIO *cio, int32_t address);
 void ControllerIO_writeByte(ControllerIO *cio, int32_t address, int8_t value);
 void ControllerIO_setMemoryInterface(ControllerIO *cio, SystemInterlink *smi);
@@ -8,6 +8,17 @@
 #ifndef PHILPSX_COP0_ALL_HEADER
 #define PHILPSX_COP0_ALL_HEADER
 
+/*
+ * This struct describes how addresses within one 512MB segment of the
+ * virtual address space are handled in the current mode. Segments are
+ * indexed by the top three bits of the address, so kuseg has four entries.
+ */
+struct Cop0Segment {
+	int32_t physicalMask;	// ANDed with a virtual address to translate it
+	bool cacheable;
+	bool allowed;			// False if accessing it causes an address error
+};
+
 /*
  * The Cop0 struct models the System Control Co-Processor (Cop0), which
  * is responsible for memory management and exceptions.
@@ -19,6 +30,17 @@ struct Cop0 {
 
 	// Condition line
 	bool conditionLine;
+
+	// Whether the interrupt bits of the cause register are both enabled and
+	// unmasked, recalculated whenever the status or cause register changes
+	bool interruptPending;
+
+	// Segment table and mode flags, rebuilt whenever the status register
+	// changes so address checks don't need to decode it each time
+	struct Cop0Segment segments[8];
+	bool kernelMode;
+	bool dataCacheIsolated;
+	bool cachesSwapped;
 };
 
 // Includes
@@ -13,18 +13,22 @@
 
 // Typedefs
 typedef struct Cop0 Cop0;
+typedef struct Cop0Segment Cop0Segment;
 
 // Public functions
 void construct_Cop0(Cop0 *sccp); // Needs a pre-allocated memory region
 void Cop0_reset(Cop0 *sccp);
 bool Cop0_getConditionLineStatus(Cop0 *sccp);
 void Cop0_setConditionLineStatus(Cop0 *sccp, bool status);
+bool Cop0_isInterruptPending(Cop0 *sccp);
+void Cop0_setInterruptLine(Cop0 *sccp, bool asserted);
 void Cop0_rfe(Cop0 *sccp);
 int32_t Cop0_getResetExceptionVector(Cop0 *sccp);
 int32_t Cop0_getGeneralExceptionVector(Cop0 *sccp);
 int32_t Cop0_readReg(Cop0 *sccp, int32_t reg);
 void Cop0_writeReg(Cop0 *sccp, int32_t reg, int32_t value, bool override);
 void Cop0_setCacheMiss(Cop0 *sccp, bool value);
+const Cop0Segment *Cop0_getSegment(Cop0 *sccp, int32_t virtualAddress);
 int32_t Cop0_virtualToPhysical(Cop0 *sccp, int32_t virtualAddress);
 bool Cop0_isCacheable(Cop0 *sccp, int32_t virtualAddress);
 bool Cop0_areWeInKernelMode(Cop0 *sccp);
@@ -20,8 +20,28 @@ struct Cop2 {
 	// Data registers
 	int32_t dataRegisters[32];
 
+	// Sign extended copies of the packed 16-bit rotation, light and light
+	// colour matrices (in row order) and of V0, V1 and V2, kept up to date
+	// as their registers are written so functions needn't unpack them
+	int16_t rotationMatrix[9];
+	int16_t lightMatrix[9];
+	int16_t colourMatrix[9];
+	int16_t vectors[9];
+
+	// Raw results of the last RTPS or RTPT, from which the flag register is
+	// only worked out if it is read
+	bool flagsPending;
+	int32_t pendingSf;
+	int32_t pendingFlags;
+	int64_t pendingMac[3];
+	int64_t pendingMac0[3];
+
 	// Condition line
 	bool conditionLine;
+
+	// Arithmetic kernels for the heavy GTE functions, chosen to suit the
+	// host CPU
+	const struct GteKernels *kernels;
 };
 
 // Includes
@@ -29,6 +29,8 @@ void DMAArbiter_setCpu(DMAArbiter *dma, R3051 *cpu);
 void DMAArbiter_setGpu(DMAArbiter *dma, GPU *gpu);
 void DMAArbiter_setMemoryInterface(DMAArbiter *dma, SystemInterlink *smi);
 void DMAArbiter_writeByte(DMAArbiter *dma, int32_t address, int8_t value);
+void DMAArbiter_writeHalfword(DMAArbiter *dma, int32_t address,
+		int16_t value);
 void DMAArbiter_writeWord(DMAArbiter *dma, int32_t address, int32_t word);
 
 #endif
\ No newline at end of file
@@ -22,13 +22,13 @@ typedef struct GPU GPU;
 // Public functions
 GPU *construct_GPU(void);
 void destruct_GPU(GPU *gpu);
-void GPU_appendSyncCycles(GPU *gpu, int32_t cycles);
 void GPU_cleanupGL(GPU *gpu);
 void GPU_executeGPUCycles(GPU *gpu);
-int32_t GPU_howManyDotclockGpuCyclesLeft(GPU *gpu, int32_t gpuCycles);
-int32_t GPU_howManyDotclockIncrements(GPU *gpu, int32_t gpuCycles);
-int32_t GPU_howManyHblankGpuCyclesLeft(GPU *gpu, int32_t gpuCycles);
-int32_t GPU_howManyHblankIncrements(GPU *gpu, int32_t gpuCycles);
+int32_t GPU_getCyclesPerDot(GPU *gpu);
+int32_t GPU_getCyclesPerScanline(GPU *gpu);
+int64_t GPU_getFrameCount(GPU *gpu);
+int64_t GPU_getNextHblankChange(GPU *gpu);
+int64_t GPU_getNextVblankChange(GPU *gpu);
 bool GPU_initGL(GPU *gpu);
 bool GPU_isInHblank(GPU *gpu);
 bool GPU_isInVblank(GPU *gpu);
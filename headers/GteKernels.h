@@ -0,0 +1,74 @@
+/*
+ * This header file provides the public API for the arithmetic kernels behind
+ * the heavy GTE functions, which are chosen at runtime to suit the host CPU.
+ *
+ * GteKernels.h - Copyright Phillip Potter, 2020, under GPLv3
+ */
+#ifndef PHILPSX_GTEKERNELS_HEADER
+#define PHILPSX_GTEKERNELS_HEADER
+
+// System includes
+#include <stdint.h>
+#include <stdbool.h>
+
+// Typedefs
+typedef struct GteKernels GteKernels;
+typedef struct GteResult GteResult;
+
+/*
+ * The GteResult struct holds the results of a kernel for one vector, before
+ * they are written back to the GTE registers. Each array has a spare fourth
+ * lane so vector code can store whole registers, and flags holds the flag
+ * register bits raised, apart from bit 31. Kernels handling three vectors
+ * work out flags for the last one alone and leave the others at 0, as Cop2
+ * already clears the flag register before each vector and the kernels match
+ * that behaviour. This is not a hardware rule, so flag handling should only
+ * change along with Cop2's.
+ */
+struct GteResult {
+	int64_t mac[4];
+	int64_t ir[4];
+	int64_t colour[4];
+	int32_t flags;
+};
+
+/*
+ * The GteKernels struct holds one implementation of each kernel. Matrices
+ * are nine sign extended 16-bit elements in row order and vectors holds V0,
+ * V1 and V2 the same way, as Cop2 keeps them unpacked. The translation
+ * vector of transformVertices points at the TRX, TRY and TRZ control
+ * registers, and other inputs are read straight from the register arrays.
+ */
+struct GteKernels {
+
+	// MVMVA: MAC = (translation * 0x1000 + matrix * vector) >> (sf * 12),
+	// then IR = MAC saturated to lowerBound..0x7FFF
+	void (*transform)(const int16_t *matrix, const int64_t *vector,
+			const int64_t *translation, int32_t sf, int64_t lowerBound,
+			GteResult *result);
+
+	// RTPT: the above for V0, V1 and V2 with the rotation matrix and
+	// translation vector, saturating to -0x8000..0x7FFF
+	void (*transformVertices)(const int16_t *matrix, const int16_t *vectors,
+			const int32_t *translation, int32_t sf, GteResult *results);
+
+	// NCDT and NCCT: light V0, V1 and V2 with the light and light colour
+	// matrices and background colour, multiply by RGBC and, when depthCue is
+	// set, interpolate towards the far colour by IR0
+	void (*lightVertices)(const int16_t *lightMatrix,
+			const int16_t *colourMatrix, const int16_t *vectors,
+			const int32_t *controlRegisters, const int32_t *dataRegisters,
+			bool depthCue, int32_t sf, int64_t lowerBound,
+			GteResult *results);
+
+	// DPCT: interpolate each of RGB0, RGB1 and RGB2 towards the far colour
+	// by IR0
+	void (*depthCueColours)(const int32_t *controlRegisters,
+			const int32_t *dataRegisters, int32_t sf, int64_t lowerBound,
+			GteResult *results);
+};
+
+// Public functions
+const GteKernels *GteKernels_select(void);
+
+#endif
@@ -8,15 +8,29 @@
 #ifndef PHILPSX_INSTRUCTION_CACHE_ALL_HEADER
 #define PHILPSX_INSTRUCTION_CACHE_ALL_HEADER
 
+// Number of 16-byte lines in the cache, and the bit of a line's tag that
+// marks it as valid
+#define PHILPSX_ICACHE_LINE_COUNT 256
+#define PHILPSX_ICACHE_VALID 0x1
+
+/*
+ * This struct models one line of the R3051 instruction cache. The tag holds
+ * bits 12 to 31 of the physical address the line was filled from, with the
+ * valid flag folded into bit 0, so a hit can be checked with one comparison.
+ * Data is held as four words in host (and guest) byte order.
+ */
+typedef struct {
+	int32_t tag;
+	int32_t data[4];
+} InstructionCacheLine;
+
 /*
  * This struct models the R3051 instruction cache.
  */
 struct InstructionCache {
 	
-	// Cache variables
-	int8_t *cacheData;
-	int32_t *cacheTag;
-	bool *cacheValid;
+	// Cache lines
+	InstructionCacheLine lines[PHILPSX_ICACHE_LINE_COUNT];
 };
 
 // Includes
@@ -22,6 +22,7 @@ typedef struct InstructionCache InstructionCache;
 InstructionCache *construct_InstructionCache(InstructionCache *cache);
 void destruct_InstructionCache(InstructionCache *cache);
 bool InstructionCache_checkForHit(InstructionCache *cache, int32_t address);
+int64_t InstructionCache_fetchWord(InstructionCache *cache, int32_t address);
 int32_t InstructionCache_readWord(InstructionCache *cache, int32_t address);
 int8_t InstructionCache_readByte(InstructionCache *cache, int32_t address);
 void InstructionCache_writeWord(InstructionCache *cache, Cop0 *sccp,
@@ -0,0 +1,28 @@
+/*
+ * This header file provides the public API for lockstep validation, which
+ * runs an accelerated R3051 (such as the recompiler) alongside a reference
+ * interpreter from the same starting state, and reports the first point at
+ * which they stop being identical.
+ *
+ * Lockstep.h - Copyright Phillip Potter, 2020, under GPLv3
+ */
+#ifndef PHILPSX_LOCKSTEP_HEADER
+#define PHILPSX_LOCKSTEP_HEADER
+
+// System includes
+#include <stdint.h>
+#include <stdbool.h>
+
+// Typedefs
+typedef struct Lockstep Lockstep;
+
+// Includes
+#include "R3051.h"
+
+// Public functions
+Lockstep *construct_Lockstep(R3051 *reference, R3051 *accelerated);
+void destruct_Lockstep(Lockstep *ls);
+int64_t Lockstep_executeInstructions(Lockstep *ls);
+bool Lockstep_hasDiverged(Lockstep *ls);
+
+#endif
@@ -0,0 +1,32 @@
+/*
+ * This header file provides the public API for PS-X EXE executables, which
+ * can be loaded straight into RAM and started once the BIOS kernel has
+ * finished initialising, skipping the rest of the boot process.
+ *
+ * PSXExe.h - Copyright Phillip Potter, 2020, under GPLv3
+ */
+#ifndef PHILPSX_PSXEXE_HEADER
+#define PHILPSX_PSXEXE_HEADER
+
+// System includes
+#include <stdint.h>
+#include <stdbool.h>
+
+// Physical address of the BIOS shell, which is jumped to once the kernel
+// has finished initialising
+#define PHILPSX_PSXEXE_SHELL_ENTRY 0x30000
+
+// Typedefs
+typedef struct PSXExe PSXExe;
+
+// Includes
+#include "R3051.h"
+#include "CDROMDrive.h"
+
+// Public functions
+PSXExe *construct_PSXExe(const char *exePath);
+PSXExe *construct_PSXExeFromDisc(CDROMDrive *cdrom);
+void destruct_PSXExe(PSXExe *exe);
+void PSXExe_start(PSXExe *exe, R3051 *cpu);
+
+#endif
@@ -0,0 +1,39 @@
+/*
+ * This header file provides the public API for the guest profiler, which
+ * samples the R3051 program counter along with the subsystem the emulator
+ * thread is busy in, so that hot guest code can be found without external
+ * tools.
+ *
+ * Profiler.h - Copyright Phillip Potter, 2020, under GPLv3
+ */
+#ifndef PHILPSX_PROFILER_HEADER
+#define PHILPSX_PROFILER_HEADER
+
+// System includes
+#include <stdint.h>
+#include <stdbool.h>
+
+// List of subsystems host time is attributed to
+#define PHILPSX_PROFILER_CPU 0
+#define PHILPSX_PROFILER_GTE 1
+#define PHILPSX_PROFILER_GPU 2
+#define PHILPSX_PROFILER_DMA 3
+#define PHILPSX_PROFILER_CDROM 4
+#define PHILPSX_PROFILER_SUBSYSTEM_COUNT 5
+
+// Typedefs
+typedef struct Profiler Profiler;
+
+// Includes
+#include "R3051.h"
+
+// Public functions
+Profiler *construct_Profiler(R3051 *cpu, const char *outputPath);
+void destruct_Profiler(Profiler *profiler);
+int32_t Profiler_enterSubsystem(Profiler *profiler, int32_t subsystem);
+double Profiler_getSubsystemShare(Profiler *profiler, int32_t subsystem);
+void Profiler_leaveSubsystem(Profiler *profiler, int32_t previousSubsystem);
+bool Profiler_start(Profiler *profiler);
+void Profiler_stop(Profiler *profiler);
+
+#endif
@@ -18,15 +18,23 @@ typedef struct R3051 R3051;
 #include "Cop0_public.h"
 #include "Cop2_public.h"
 #include "SystemInterlink.h"
+#include "PSXExe.h"
 
 // Public functions
 R3051 *construct_R3051(void);
 void destruct_R3051(R3051 *cpu);
+bool R3051_enableHLE(R3051 *cpu);
+bool R3051_enableRecompiler(R3051 *cpu);
+bool R3051_enableTracing(R3051 *cpu, const char *outputPath);
 int64_t R3051_executeInstructions(R3051 *cpu);
 int32_t R3051_getBusHolder(R3051 *cpu);
 Cop0 *R3051_getCop0(R3051 *cpu);
 Cop2 *R3051_getCop2(R3051 *cpu);
+int64_t R3051_getInstructionCount(R3051 *cpu);
+int32_t R3051_getProgramCounter(R3051 *cpu);
+void R3051_invalidateBlockCache(R3051 *cpu, int32_t address, int32_t length);
 void R3051_setBusHolder(R3051 *cpu, int32_t holder);
+void R3051_setExe(R3051 *cpu, PSXExe *exe);
 void R3051_setMemoryInterface(R3051 *cpu, SystemInterlink *system);
 
 #endif
\ No newline at end of file
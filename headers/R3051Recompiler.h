@@ -0,0 +1,27 @@
+/*
+ * This header file provides the public API for the x86-64 dynamic recompiler
+ * used by the MIPS R3051 implementation of PhilPSX.
+ *
+ * R3051Recompiler.h - Copyright Phillip Potter, 2020, under GPLv3
+ */
+#ifndef PHILPSX_R3051RECOMPILER_HEADER
+#define PHILPSX_R3051RECOMPILER_HEADER
+
+// System includes
+#include <stdint.h>
+#include <stdbool.h>
+
+// Typedefs
+typedef struct R3051Recompiler R3051Recompiler;
+typedef struct R3051Block R3051Block;
+
+// Includes
+#include "R3051.h"
+
+// Public functions
+R3051Recompiler *construct_R3051Recompiler(void);
+void destruct_R3051Recompiler(R3051Recompiler *rec);
+bool R3051Recompiler_compileBlock(R3051Recompiler *rec, R3051 *cpu,
+		R3051Block *block, bool instructionCacheEnabled);
+
+#endif
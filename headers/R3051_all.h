@@ -0,0 +1,167 @@
+/*
+ * This header file provides implementation details regarding the struct
+ * for the MIPS R3051 processor of the PlayStation, so that the recompiler can
+ * generate code operating on it directly, and also includes its public
+ * header.
+ *
+ * R3051_all.h - Copyright Phillip Potter, 2020, under GPLv3
+ */
+#ifndef PHILPSX_R3051_ALL_HEADER
+#define PHILPSX_R3051_ALL_HEADER
+
+// System includes
+#include <stdint.h>
+#include <stdbool.h>
+
+// Includes
+#include "R3051.h"
+#include "R3051Recompiler.h"
+#include "BiosHLE.h"
+#include "PSXExe.h"
+#include "Tracer.h"
+#include "Cop0_all.h"
+#include "Cop2_all.h"
+#include "InstructionCache_all.h"
+#include "SystemInterlink.h"
+
+// List of exception reasons
+#define PHILPSX_EXCEPTION_INT 0
+#define PHILPSX_EXCEPTION_ADEL 4
+#define PHILPSX_EXCEPTION_ADES 5
+#define PHILPSX_EXCEPTION_IBE 6
+#define PHILPSX_EXCEPTION_DBE 7
+#define PHILPSX_EXCEPTION_SYS 8
+#define PHILPSX_EXCEPTION_BP 9
+#define PHILPSX_EXCEPTION_RI 10
+#define PHILPSX_EXCEPTION_CPU 11
+#define PHILPSX_EXCEPTION_OVF 12
+#define PHILPSX_EXCEPTION_RESET 13
+#define PHILPSX_EXCEPTION_NULL 14
+
+// Block cache dimensions (number of cached blocks must be a power of two)
+#define PHILPSX_R3051_BLOCKCACHE_SIZE 4096
+#define PHILPSX_R3051_BLOCK_LENGTH 32
+
+// Typedefs
+typedef void (*R3051Handler)(R3051 *cpu, int32_t instruction);
+typedef int32_t (*R3051CompiledCode)(R3051 *cpu);
+typedef struct MIPSException MIPSException;
+typedef struct R3051Op R3051Op;
+
+/*
+ * This struct models a processor exception, which can occur during
+ * any stage of the pipeline.
+ */
+struct MIPSException {
+
+	// Exception variables
+	int32_t exceptionReason;
+	int32_t programCounterOrigin;
+	int32_t badAddress;
+	int32_t coProcessorNum;
+	bool isInBranchDelaySlot;
+};
+
+/*
+ * This struct models a single pre-decoded instruction, storing the
+ * handler to dispatch to along with the instruction word it decodes its
+ * operands from, and the cost in cycles of fetching it without the
+ * instruction cache.
+ */
+struct R3051Op {
+
+	// Pre-decoded instruction variables
+	R3051Handler handler;
+	int32_t instruction;
+	int32_t fetchCycles;
+};
+
+/*
+ * This struct models a basic block of pre-decoded instructions, keyed
+ * by the physical address of its first instruction. A block never crosses a
+ * 4KB page boundary. It records whether the block is an idle loop that just
+ * polls memory or I/O ports. When the recompiler is in use, it also stores
+ * the host code generated for the block, and which instruction fetch mode
+ * that code was generated for.
+ */
+struct R3051Block {
+
+	// Block variables
+	int32_t physicalAddress;
+	int32_t length;
+	bool valid;
+	bool idleLoop;
+	R3051Op ops[PHILPSX_R3051_BLOCK_LENGTH];
+
+	// Recompiled code variables
+	R3051CompiledCode compiledCode;
+	bool compiledWithInstructionCache;
+};
+
+/*
+ * This struct contains registers, and pointers to subcomponents.
+ */
+struct R3051 {
+
+	// Component ID
+	int32_t componentId;
+
+	// Register definitions
+	int32_t generalRegisters[32];
+	int32_t programCounter;
+	int32_t hiReg;
+	int32_t loReg;
+
+	// Jump address holder and boolean
+	int32_t jumpAddress;
+	bool jumpPending;
+
+	// Co-processor definitions
+	Cop0 sccp;
+	Cop2 gte;
+
+	// Bus holder definition
+	int32_t busHolder;
+
+	// System link, its page table for direct memory accesses and its event
+	// scheduler
+	SystemInterlink *system;
+	MemoryPage *pageTable;
+	Scheduler *scheduler;
+
+	// This stores the current exception
+	MIPSException exception;
+
+	// This stores the instruction cache
+	InstructionCache instructionCache;
+
+	// This stores the pre-decoded block cache
+	R3051Block *blockCache;
+
+	// This stores the recompiler (NULL when interpreting)
+	R3051Recompiler *recompiler;
+
+	// This stores the BIOS function emulation (NULL when disabled)
+	BiosHLE *hle;
+
+	// This stores the executable to start when the BIOS reaches its shell
+	// (NULL if there is none, or it has already been started)
+	PSXExe *exe;
+
+	// This stores the trace recorder (NULL when not tracing)
+	Tracer *tracer;
+
+	// This tells us if the last instruction was a branch/jump instruction
+	bool prevWasBranch;
+	bool isBranch;
+
+	// This counts the cycles of the current instruction
+	int32_t cycles;
+	int32_t gteCycles;
+	int64_t totalCycles;
+
+	// This counts the instructions completed since the CPU was constructed
+	int64_t instructionCount;
+};
+
+#endif
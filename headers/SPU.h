@@ -21,7 +21,9 @@ typedef struct SPU SPU;
 SPU *construct_SPU(void);
 void destruct_SPU(SPU *spu);
 void SPU_writeByte(SPU *spu, int32_t address, int8_t value);
+void SPU_writeHalfword(SPU *spu, int32_t address, int16_t value);
 int8_t SPU_readByte(SPU *spu, int32_t address);
+int16_t SPU_readHalfword(SPU *spu, int32_t address);
 void SPU_setMemoryInterface(SPU *spu, SystemInterlink *smi);
 
 #endif
\ No newline at end of file
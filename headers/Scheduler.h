@@ -0,0 +1,40 @@
+/*
+ * This header file provides the public API for the event scheduler, which
+ * keeps the global CPU cycle count and orders timed system events by the
+ * cycle they are due at.
+ *
+ * Scheduler.h - Copyright Phillip Potter, 2020, under GPLv3
+ */
+#ifndef PHILPSX_SCHEDULER_HEADER
+#define PHILPSX_SCHEDULER_HEADER
+
+// System includes
+#include <stdint.h>
+#include <stdbool.h>
+
+// List of events (each can be pending at most once)
+#define PHILPSX_EVENT_VBLANK 0
+#define PHILPSX_EVENT_TIMERS 1
+#define PHILPSX_EVENT_GPU_INTERRUPT 2
+#define PHILPSX_EVENT_DMA_INTERRUPT 3
+#define PHILPSX_EVENT_CDROM_INTERRUPT 4
+#define PHILPSX_EVENT_COUNT 5
+
+// Typedefs
+typedef struct Scheduler Scheduler;
+typedef void (*SchedulerHandler)(void *object);
+
+// Public functions
+Scheduler *construct_Scheduler(void);
+void destruct_Scheduler(Scheduler *sched);
+void Scheduler_appendCycles(Scheduler *sched, int32_t cycles);
+void Scheduler_cancelEvent(Scheduler *sched, int32_t event);
+int64_t Scheduler_getCycles(Scheduler *sched);
+int64_t Scheduler_getNextDeadline(Scheduler *sched);
+bool Scheduler_runDueEvents(Scheduler *sched);
+void Scheduler_scheduleEvent(Scheduler *sched, int32_t event,
+		int64_t timestamp);
+void Scheduler_setHandler(Scheduler *sched, int32_t event,
+		SchedulerHandler handler, void *object);
+
+#endif
@@ -10,9 +10,55 @@
 #include <stdint.h>
 #include <stdbool.h>
 
+// Number of 4KB pages covering the 512MB physical address space
+#define PHILPSX_MEMORYPAGE_COUNT 131072
+
+// Size of RAM, and the span of the physical address space it is mirrored
+// across
+#define PHILPSX_RAM_SIZE 0x200000
+#define PHILPSX_RAM_MIRROR_SPAN 0x800000
+
+// Guest memory is little-endian and stored as-is, so words are loaded natively
+#if __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__
+#error "PhilPSX requires a little-endian host"
+#endif
+
 // Typedefs
 typedef struct SystemInterlink SystemInterlink;
 
+/*
+ * This struct describes one 4KB page of the physical address space, so that
+ * RAM, BIOS and scratchpad can be accessed without going through the
+ * interlink. Pages without host memory behind them (such as I/O ports) have
+ * a NULL memory pointer. The size is the number of bytes backed from the
+ * start of the page. Memory is held in guest (and host) byte order, so aligned
+ * halfwords and words can be copied straight out of it.
+ */
+typedef struct {
+	int8_t *memory;
+	int16_t size;
+	int8_t stallCycles;
+	bool readOnly;
+	bool containsCode;
+} MemoryPage;
+
+/*
+ * This struct holds the functions a component handles accesses to its I/O
+ * ports with, each taking the object they were registered with and the
+ * physical address. Only those a component supports need to be provided:
+ * reads without a handler are picked out of a word read if possible, accesses
+ * wider than the handlers a port has are split into halfwords or bytes, and
+ * anything else is ignored, with reads returning 0.
+ */
+typedef struct {
+	int8_t (*readByte)(void *object, int32_t address);
+	int16_t (*readHalfword)(void *object, int32_t address);
+	int32_t (*readWord)(void *object, int32_t address);
+	void (*writeByte)(void *object, int32_t address, int8_t value);
+	void (*writeHalfword)(void *object, int32_t address, int16_t value);
+	void (*writeWord)(void *object, int32_t address, int32_t word);
+} IOPortHandlers;
+
 // Includes
 #include "CDROMDrive.h"
 #include "ControllerIO.h"
@@ -20,28 +66,35 @@ typedef struct SystemInterlink SystemInterlink;
 #include "DMAArbiter.h"
 #include "GPU.h"
 #include "SPU.h"
+#include "Scheduler.h"
+#include "Profiler.h"
 
 // Public functions
 SystemInterlink *construct_SystemInterlink(const char *biosPath);
 void destruct_SystemInterlink(SystemInterlink *smi);
 void SystemInterlink_appendSyncCycles(SystemInterlink *smi, int32_t cycles);
-void SystemInterlink_executeGPUCycles(SystemInterlink *smi);
+int32_t SystemInterlink_fetchWord(SystemInterlink *smi, int32_t address,
+		int32_t *cycles);
 CDROMDrive *SystemInterlink_getCdrom(SystemInterlink *smi);
 ControllerIO *SystemInterlink_getControllerIO(SystemInterlink *smi);
 R3051 *SystemInterlink_getCpu(SystemInterlink *smi);
 DMAArbiter *SystemInterlink_getDma(SystemInterlink *smi);
 GPU *SystemInterlink_getGpu(SystemInterlink *smi);
+MemoryPage *SystemInterlink_getPageTable(SystemInterlink *smi);
+Profiler *SystemInterlink_getProfiler(SystemInterlink *smi);
 int8_t *SystemInterlink_getRamArray(SystemInterlink *smi);
+Scheduler *SystemInterlink_getScheduler(SystemInterlink *smi);
 SPU *SystemInterlink_getSpu(SystemInterlink *smi);
 int32_t SystemInterlink_howManyStallCycles(SystemInterlink *smi,
 		int32_t address);
-void SystemInterlink_incrementInterruptCounters(SystemInterlink *smi);
 bool SystemInterlink_instructionCacheEnabled(SystemInterlink *smi);
-bool SystemInterlink_okToIncrement(SystemInterlink *smi, int64_t address);
+void SystemInterlink_invalidateCodeRange(SystemInterlink *smi,
+		int32_t address, int32_t length);
+void SystemInterlink_markCodePage(SystemInterlink *smi, int32_t address);
 int8_t SystemInterlink_readByte(SystemInterlink *smi, int32_t address);
+int16_t SystemInterlink_readHalfword(SystemInterlink *smi, int32_t address);
 int32_t SystemInterlink_readInterruptStatus(SystemInterlink *smi);
 int32_t SystemInterlink_readWord(SystemInterlink *smi, int32_t address);
-void SystemInterlink_resyncAllTimers(SystemInterlink *smi);
 bool SystemInterlink_scratchpadEnabled(SystemInterlink *smi);
 void SystemInterlink_setCDROMInterruptDelay(SystemInterlink *smi,
 		int32_t delay);
@@ -58,10 +111,16 @@ void SystemInterlink_setDMAInterruptDelay(SystemInterlink *smi, int32_t delay);
 void SystemInterlink_setDma(SystemInterlink *smi, DMAArbiter *dma);
 void SystemInterlink_setGPUInterruptDelay(SystemInterlink *smi, int32_t delay);
 void SystemInterlink_setGpu(SystemInterlink *smi, GPU *gpu);
+void SystemInterlink_setIOPortHandlers(SystemInterlink *smi, int32_t address,
+		int32_t length, const IOPortHandlers *handlers, void *object);
+void SystemInterlink_setProfiler(SystemInterlink *smi, Profiler *profiler);
 void SystemInterlink_setSpu(SystemInterlink *smi, SPU *spu);
 bool SystemInterlink_tagTestEnabled(SystemInterlink *smi);
+void SystemInterlink_updateTimerClocks(SystemInterlink *smi);
 void SystemInterlink_writeByte(SystemInterlink *smi, int32_t address,
 		int8_t value);
+void SystemInterlink_writeHalfword(SystemInterlink *smi, int32_t address,
+		int16_t value);
 void SystemInterlink_writeInterruptStatus(SystemInterlink *smi,
 		int32_t interruptStatus);
 void SystemInterlink_writeWord(SystemInterlink *smi, int32_t address,
@@ -0,0 +1,56 @@
+/*
+ * This header file provides the public API for the execution trace recorder,
+ * which writes a binary record of every instruction the R3051 interprets to
+ * a file, along with the file format so that traces can be decoded.
+ *
+ * Tracer.h - Copyright Phillip Potter, 2020, under GPLv3
+ */
+#ifndef PHILPSX_TRACER_HEADER
+#define PHILPSX_TRACER_HEADER
+
+// System includes
+#include <stdint.h>
+#include <stdbool.h>
+
+// Trace files start with an 8 byte magic value, then the format version and
+// the size of each record as 32-bit values, followed by the records
+#define PHILPSX_TRACER_MAGIC "PSXTRACE"
+#define PHILPSX_TRACER_VERSION 1
+
+// List of memory access types
+#define PHILPSX_TRACER_ACCESS_NONE 0
+#define PHILPSX_TRACER_ACCESS_LOAD 1
+#define PHILPSX_TRACER_ACCESS_STORE 2
+
+// List of record flags
+#define PHILPSX_TRACER_FLAG_EXCEPTION 0x1
+
+// Typedefs
+typedef struct Tracer Tracer;
+typedef struct TraceRecord TraceRecord;
+
+/*
+ * This struct describes one executed instruction, and is written to trace
+ * files as-is (in little-endian byte order). The register index is that of
+ * the general purpose register the instruction wrote, or 0 if there wasn't
+ * one. For loads, the memory value is the value loaded into the destination
+ * register, and for stores it is the value stored.
+ */
+struct TraceRecord {
+	int32_t programCounter;
+	int32_t instruction;
+	int32_t registerValue;
+	int32_t memoryAddress;
+	int32_t memoryValue;
+	int8_t registerIndex;
+	int8_t memoryAccess;
+	int8_t memoryWidth;
+	int8_t flags;
+};
+
+// Public functions
+Tracer *construct_Tracer(const char *outputPath);
+void destruct_Tracer(Tracer *tracer);
+void Tracer_addRecord(Tracer *tracer, const TraceRecord *record);
+
+#endif
@@ -0,0 +1,120 @@
+/*
+ * This file checks that the flag register left by RTPS and RTPT survives
+ * unimplemented GTE functions. The flags those functions raise are only
+ * worked out when the register is read, so each one is run on a range of
+ * inputs, followed by an unimplemented function, and the flag register must
+ * read back the same as it does straight after the function alone.
+ *
+ * Cop2FlagTest.c - Copyright Phillip Potter, 2020, under GPLv3
+ */
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "../headers/Cop2_all.h"
+
+// Number of sets of inputs to try
+#define PHILPSX_COP2FLAGTEST_RUNS 1000
+
+// Functions under test, and unimplemented functions to follow them with
+static const int32_t functions[] = {
+	0x4A180001,	// RTPS sf=1
+	0x4A100001,	// RTPS sf=0
+	0x4A280030,	// RTPT sf=1
+	0x4A200030	// RTPT sf=0
+};
+static const int32_t unimplemented[] = {
+	0x4A000000,
+	0x4A000005
+};
+
+// Forward declarations
+static int32_t nextRandom(uint32_t *state);
+static int32_t runFunctions(uint32_t seed, int32_t function,
+		int32_t following);
+static void setupInputs(Cop2 *gte, uint32_t seed);
+
+// Cop2FlagTest entry point
+int main(void)
+{
+	// Variables
+	int retval = 1;
+
+	// Compare each function alone with it followed by each unimplemented
+	// function, for a range of inputs
+	for (uint32_t seed = 1; seed <= PHILPSX_COP2FLAGTEST_RUNS; ++seed) {
+		for (size_t i = 0; i < sizeof(functions) / sizeof(functions[0]);
+				++i) {
+			int32_t expected = runFunctions(seed, functions[i], 0);
+			for (size_t j = 0; j < sizeof(unimplemented) /
+					sizeof(unimplemented[0]); ++j) {
+				int32_t flags = runFunctions(seed, functions[i],
+						unimplemented[j]);
+				if (flags != expected) {
+					fprintf(stderr, "PhilPSX: Cop2FlagTest: Flag register "
+							"was 0x%08X rather than 0x%08X after 0x%08X "
+							"and 0x%08X (seed %u)\n", (uint32_t)flags,
+							(uint32_t)expected, (uint32_t)functions[i],
+							(uint32_t)unimplemented[j], seed);
+					goto end;
+				}
+			}
+		}
+	}
+	printf("PASS\n");
+	retval = 0;
+
+	end:
+	return retval;
+}
+
+/*
+ * This function returns the next value from a simple linear congruential
+ * generator, so that the inputs are the same on every run.
+ */
+static int32_t nextRandom(uint32_t *state)
+{
+	*state = *state * 1103515245 + 12345;
+	return (int32_t)(*state ^ (*state >> 16));
+}
+
+/*
+ * This function runs the specified function on a GTE set up with the inputs
+ * for the specified seed, followed by the specified unimplemented function
+ * if it is not 0, and returns the flag register afterwards.
+ */
+static int32_t runFunctions(uint32_t seed, int32_t function,
+		int32_t following)
+{
+	Cop2 gte;
+	construct_Cop2(&gte);
+	setupInputs(&gte, seed);
+	Cop2_gteFunction(&gte, function);
+	if (following != 0)
+		Cop2_gteFunction(&gte, following);
+	return Cop2_readControlReg(&gte, 31);
+}
+
+/*
+ * This function fills in the vectors, rotation matrix, translation vector,
+ * screen offset, projection plane distance and depth queue registers with
+ * values for the specified seed. Smaller values are used for some seeds so
+ * that runs both with and without saturation are covered.
+ */
+static void setupInputs(Cop2 *gte, uint32_t seed)
+{
+	uint32_t state = seed;
+	int32_t mask = (seed % 2 == 0) ? 0x7FFFFFFF : 0x03FF03FF;
+
+	// V0, V1 and V2
+	for (int32_t reg = 0; reg < 6; ++reg)
+		Cop2_writeDataReg(gte, reg, nextRandom(&state) & mask, false);
+
+	// Rotation matrix and translation vector
+	for (int32_t reg = 0; reg < 8; ++reg)
+		Cop2_writeControlReg(gte, reg, nextRandom(&state) & mask, false);
+
+	// Screen offset, projection plane distance and depth queue
+	for (int32_t reg = 24; reg < 29; ++reg)
+		Cop2_writeControlReg(gte, reg, nextRandom(&state), false);
+}
@@ -0,0 +1,216 @@
+/*
+ * This file checks that the interpreter and the dynamic recompiler account
+ * for CPU cycles in the same way. A small program made up of a load/store
+ * loop and a branch loop is run from a BIOS image on two consoles, one for
+ * each engine. The totals returned by R3051_executeInstructions must match
+ * each other, and must match the number of cycles the rest of the system
+ * was moved on by. Both engines must also count the same number of
+ * completed instructions.
+ *
+ * CycleAccountingTest.c - Copyright Phillip Potter, 2020, under GPLv3
+ */
+#define _POSIX_C_SOURCE 200809L
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "../headers/R3051.h"
+#include "../headers/Scheduler.h"
+#include "../headers/SystemInterlink.h"
+
+// Size of a BIOS image, the address the program stops at (the delay slot of
+// its final branch, where the CPU is left after taking it), and the maximum
+// number of calls to R3051_executeInstructions before giving up on it
+#define PHILPSX_CYCLETEST_BIOS_SIZE 524288
+#define PHILPSX_CYCLETEST_END_ADDRESS (int32_t)0xBFC00040
+#define PHILPSX_CYCLETEST_MAX_CALLS 1000000
+
+// Test program, run from the reset vector
+static const uint32_t program[] = {
+	0x3C088000,	//		lui t0, 0x8000			RAM
+	0x3C0B1F80,	//		lui t3, 0x1F80			I/O ports
+	0x24090064,	//		addiu t1, zero, 100
+	0x8D0A0000,	// 1:	lw t2, 0(t0)
+	0x8D6C1070,	//		lw t4, 0x1070(t3)		I_STAT
+	0x254A0001,	//		addiu t2, t2, 1
+	0xAD0A0004,	//		sw t2, 4(t0)
+	0x2529FFFF,	//		addiu t1, t1, -1
+	0x1520FFFA,	//		bne t1, zero, 1b
+	0x00000000,	//		nop
+	0x240903E8,	//		addiu t1, zero, 1000
+	0x2529FFFF,	// 2:	addiu t1, t1, -1
+	0x1520FFFE,	//		bne t1, zero, 2b
+	0x00000000,	//		nop
+	0x00000000,	//		nop
+	0x1000FFFF,	// 3:	b 3b
+	0x00000000	//		nop
+};
+
+// Forward declarations
+static bool runProgram(const char *biosPath, bool recompiled,
+		int64_t *totalCycles, int64_t *syncedCycles, int64_t *instructions);
+static bool writeBios(const char *biosPath);
+
+// CycleAccountingTest entry point
+int main(void)
+{
+	// Variables
+	int retval = 1;
+	int64_t interpretedTotal, interpretedSynced, interpretedInstructions;
+	int64_t recompiledTotal, recompiledSynced, recompiledInstructions;
+
+	// Write program to a temporary BIOS image
+	char biosPath[] = "/tmp/PhilPSXCycleTestXXXXXX";
+	int fd = mkstemp(biosPath);
+	if (fd < 0) {
+		fprintf(stderr, "PhilPSX: CycleAccountingTest: Couldn't create "
+				"BIOS image\n");
+		goto end;
+	}
+	close(fd);
+	if (!writeBios(biosPath))
+		goto cleanup_bios;
+
+	// Run it on both engines
+	if (!runProgram(biosPath, false, &interpretedTotal, &interpretedSynced,
+			&interpretedInstructions))
+		goto cleanup_bios;
+	if (!runProgram(biosPath, true, &recompiledTotal, &recompiledSynced,
+			&recompiledInstructions))
+		goto cleanup_bios;
+
+	// Compare results
+	printf("Interpreter: %ld cycles returned, %ld cycles synced, "
+			"%ld instructions\n", (long)interpretedTotal,
+			(long)interpretedSynced, (long)interpretedInstructions);
+	printf("Recompiler: %ld cycles returned, %ld cycles synced, "
+			"%ld instructions\n", (long)recompiledTotal,
+			(long)recompiledSynced, (long)recompiledInstructions);
+	if (interpretedTotal != interpretedSynced ||
+			recompiledTotal != recompiledSynced ||
+			interpretedTotal != recompiledTotal) {
+		fprintf(stderr, "PhilPSX: CycleAccountingTest: Cycle counts "
+				"differ\n");
+		goto cleanup_bios;
+	}
+	if (interpretedInstructions != recompiledInstructions) {
+		fprintf(stderr, "PhilPSX: CycleAccountingTest: Instruction counts "
+				"differ\n");
+		goto cleanup_bios;
+	}
+	printf("PASS\n");
+	retval = 0;
+
+	// Cleanup path:
+	cleanup_bios:
+	unlink(biosPath);
+
+	end:
+	return retval;
+}
+
+/*
+ * This function runs the test program on a console using the specified
+ * engine until it reaches the end address, storing the total of the values
+ * returned by R3051_executeInstructions, the number of cycles the rest of
+ * the system was moved on by and the number of instructions completed.
+ */
+static bool runProgram(const char *biosPath, bool recompiled,
+		int64_t *totalCycles, int64_t *syncedCycles, int64_t *instructions)
+{
+	// Variables
+	bool retval = false;
+
+	// Setup console with just a CPU, as the program only uses RAM and the
+	// interrupt registers
+	R3051 *cpu = construct_R3051();
+	if (!cpu) {
+		fprintf(stderr, "PhilPSX: CycleAccountingTest: R3051 setup "
+				"failed\n");
+		goto end;
+	}
+	if (recompiled && !R3051_enableRecompiler(cpu)) {
+		fprintf(stderr, "PhilPSX: CycleAccountingTest: R3051 recompiler "
+				"setup failed\n");
+		goto cleanup_cpu;
+	}
+	SystemInterlink *smi = construct_SystemInterlink(biosPath);
+	if (!smi) {
+		fprintf(stderr, "PhilPSX: CycleAccountingTest: System Interlink "
+				"setup failed\n");
+		goto cleanup_cpu;
+	}
+	SystemInterlink_setCpu(smi, cpu);
+	R3051_setMemoryInterface(cpu, smi);
+
+	// Run program
+	Scheduler *sched = SystemInterlink_getScheduler(smi);
+	int64_t startCycle = Scheduler_getCycles(sched);
+	*totalCycles = 0;
+	for (int32_t calls = 0; R3051_getProgramCounter(cpu) !=
+			PHILPSX_CYCLETEST_END_ADDRESS; ++calls) {
+		if (calls == PHILPSX_CYCLETEST_MAX_CALLS) {
+			fprintf(stderr, "PhilPSX: CycleAccountingTest: Program didn't "
+					"finish\n");
+			goto cleanup_smi;
+		}
+		*totalCycles += R3051_executeInstructions(cpu);
+	}
+	*syncedCycles = Scheduler_getCycles(sched) - startCycle;
+	*instructions = R3051_getInstructionCount(cpu);
+	retval = true;
+
+	// Cleanup path:
+	cleanup_smi:
+	destruct_SystemInterlink(smi);
+
+	cleanup_cpu:
+	destruct_R3051(cpu);
+
+	end:
+	return retval;
+}
+
+/*
+ * This function writes a BIOS image holding the test program to the
+ * specified path.
+ */
+static bool writeBios(const char *biosPath)
+{
+	// Variables
+	bool retval = false;
+
+	// Open file
+	FILE *bios = fopen(biosPath, "wb");
+	if (!bios) {
+		fprintf(stderr, "PhilPSX: CycleAccountingTest: Couldn't open %s\n",
+				biosPath);
+		goto end;
+	}
+
+	// Write program in little-endian byte order, padding it out to the size
+	// of a BIOS image
+	for (int32_t i = 0; i < PHILPSX_CYCLETEST_BIOS_SIZE / 4; ++i) {
+		uint32_t word = i < (int32_t)(sizeof(program) / sizeof(program[0])) ?
+				program[i] : 0;
+		uint8_t bytes[4] = {
+			word & 0xFF, (word >> 8) & 0xFF,
+			(word >> 16) & 0xFF, (word >> 24) & 0xFF
+		};
+		if (fwrite(bytes, 1, 4, bios) != 4) {
+			fprintf(stderr, "PhilPSX: CycleAccountingTest: Couldn't write "
+					"%s\n", biosPath);
+			goto cleanup_file;
+		}
+	}
+	retval = true;
+
+	// Cleanup path:
+	cleanup_file:
+	if (fclose(bios) != 0)
+		retval = false;
+
+	end:
+	return retval;
+}
@@ -0,0 +1,118 @@
+/*
+ * This file converts a binary execution trace, as written by PhilPSX with the
+ * -trace flag, into text with one line per instruction. Each line holds the
+ * program counter and instruction word, followed by the register written and
+ * its new value, the memory accessed (type, width, address and value) and a
+ * marker for instructions that raised an exception or were interrupted.
+ *
+ * TraceDecoder.c - Copyright Phillip Potter, 2020, under GPLv3
+ */
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include "../headers/Tracer.h"
+
+// Number of records read at once
+#define PHILPSX_TRACEDECODER_BATCH 4096
+
+// Forward declarations
+static void printRecord(FILE *output, const TraceRecord *record);
+
+// TraceDecoder entry point
+int main(int argc, char **argv)
+{
+	// Variables
+	int retval = 1;
+
+	// Check arguments
+	if (argc < 2 || argc > 3) {
+		fprintf(stderr, "Usage: %s <trace file> [output file]\n", argv[0]);
+		goto end;
+	}
+
+	// Open files
+	FILE *input = fopen(argv[1], "rb");
+	if (!input) {
+		fprintf(stderr, "PhilPSX: TraceDecoder: Couldn't open %s\n", argv[1]);
+		goto end;
+	}
+	FILE *output = stdout;
+	if (argc == 3) {
+		output = fopen(argv[2], "w");
+		if (!output) {
+			fprintf(stderr, "PhilPSX: TraceDecoder: Couldn't open %s\n",
+					argv[2]);
+			goto cleanup_input;
+		}
+	}
+
+	// Check header
+	char magic[8];
+	uint32_t version, recordSize;
+	if (fread(magic, 1, 8, input) != 8 ||
+			fread(&version, sizeof(version), 1, input) != 1 ||
+			fread(&recordSize, sizeof(recordSize), 1, input) != 1 ||
+			memcmp(magic, PHILPSX_TRACER_MAGIC, 8) != 0) {
+		fprintf(stderr, "PhilPSX: TraceDecoder: %s is not a trace file\n",
+				argv[1]);
+		goto cleanup_output;
+	}
+	if (version != PHILPSX_TRACER_VERSION ||
+			recordSize != sizeof(TraceRecord)) {
+		fprintf(stderr, "PhilPSX: TraceDecoder: %s has unsupported version "
+				"%u (record size %u)\n", argv[1], version, recordSize);
+		goto cleanup_output;
+	}
+
+	// Convert records in batches
+	static TraceRecord records[PHILPSX_TRACEDECODER_BATCH];
+	size_t count;
+	while ((count = fread(records, sizeof(TraceRecord),
+			PHILPSX_TRACEDECODER_BATCH, input)) > 0) {
+		for (size_t i = 0; i < count; ++i)
+			printRecord(output, &records[i]);
+	}
+	if (ferror(input)) {
+		fprintf(stderr, "PhilPSX: TraceDecoder: Couldn't read %s\n",
+				argv[1]);
+		goto cleanup_output;
+	}
+	retval = 0;
+
+	// Cleanup path:
+	cleanup_output:
+	if (output != stdout)
+		fclose(output);
+
+	cleanup_input:
+	fclose(input);
+
+	end:
+	return retval;
+}
+
+/*
+ * This function prints a single record as one line of text.
+ */
+static void printRecord(FILE *output, const TraceRecord *record)
+{
+	fprintf(output, "%08X: %08X", (uint32_t)record->programCounter,
+			(uint32_t)record->instruction);
+
+	if (record->registerIndex != 0)
+		fprintf(output, "  r%-2d = %08X", record->registerIndex,
+				(uint32_t)record->registerValue);
+
+	if (record->memoryAccess != PHILPSX_TRACER_ACCESS_NONE)
+		fprintf(output, "  %s%d [%08X] = %0*X",
+				record->memoryAccess == PHILPSX_TRACER_ACCESS_LOAD ?
+				"load" : "store", record->memoryWidth * 8,
+				(uint32_t)record->memoryAddress, record->memoryWidth * 2,
+				(uint32_t)record->memoryValue);
+
+	if ((record->flags & PHILPSX_TRACER_FLAG_EXCEPTION) != 0)
+		fprintf(output, "  exception");
+
+	fprintf(output, "\n");
+}
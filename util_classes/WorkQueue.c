@@ -136,11 +136,12 @@ GpuCommand *WorkQueue_waitForItem(WorkQueue *wq)
 	// First lock the queue mutex
 	pthread_mutex_lock(&wq->queueLock);
 
-	// Now we check the next item can be fetched
+	// Now we check the next item can be fetched, making sure not to wait if
+	// processing has already been ended
 	while (wq->retrievalMarker >= wq->submissionMarker) {
-		pthread_cond_wait(&wq->waitForWorkCond, &wq->queueLock);
 		if (wq->endProcessingByRenderingThread)
 			goto end;
+		pthread_cond_wait(&wq->waitForWorkCond, &wq->queueLock);
 	}
 	
 	// At this point, there is work for us in the queue, fetch it